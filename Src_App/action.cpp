@@ -18,42 +18,69 @@ ID Action::get_action_id() const
 // get the current price of the action
 double Action::get_current_price() const
 {
-    std::string query = fmt::format(
-        "SELECT price FROM prices WHERE action_id = {} ORDER BY date_time DESC, daily_time DESC LIMIT 1",
-        get_action_id()
-    );
+    std::string query = fmt::format(sql_last_price, get_action_id());
     return Database.execute_SQL_query_double(query);
 }
 
 
 // string representation methods
-// get the action info as a string : name quantity,price1 time1,price2 time2, ...
-std::string Action::get_action_info() const
+// get the action info as a string : name quantity,price1 time1,price2 time2, ... (prices between from and to, read from the tick store)
+std::string Action::get_action_info(const Tick_Store& tick_store, const Time& from, const Time& to) const
 {   
+    std::string result;
+    {
+        Response_Writer writer([&result](const char* data, size_t length, bool){ result.append(data, length); });
+        write_action_info(tick_store, writer, from, to);
+    }
+    return result;
+}
+
+// stream the action info in the writer, the ticks are written as they are decoded
+void Action::write_action_info(const Tick_Store& tick_store, Response_Writer& writer, const Time& from, const Time& to) const
+{
     std::string query = fmt::format(
-        R"(SELECT a.name, a.quantity, p.price, p.date_time, p.daily_time
-            FROM actions a
-            LEFT JOIN prices p ON a.action_id = p.action_id
-            WHERE a.action_id = {}
-            ORDER BY p.date_time ASC, p.daily_time ASC)",
+        "SELECT name, quantity FROM actions WHERE action_id = {}",
         get_action_id()
     );
     std::vector<std::vector<std::string>> action_info = Database.execute_SQL_query_vec_strings(query);
 
     // check if the result contains the necessary data
     if (action_info.empty() || action_info[0].size() < 2){
-        return "";  // return empty if data is missing
+        return;  // nothing written if data is missing
     }
 
-    std::ostringstream result;
-    // first row to get the name and the quantity
-    result << action_info[0][0] << " " << action_info[0][1];
-    // iterate through the remaining rows for price-time pairs
-    for (size_t i = 0; i < action_info.size(); ++i){
-        if (action_info[i].size() >= 5){
-            result << "," << action_info[i][2] << " " << two_times_to_string(std::stoll(action_info[i][3]), std::stoll(action_info[i][4]));
-        }
-    }
-    return result.str();
+    writer.write(action_info[0][0] + " " + action_info[0][1]);
+    write_price_history(tick_store, writer, from, to);
 }
 
+// stream the ,price time pairs of the action info (after a name and a quantity read elsewhere, a snapshot)
+void Action::write_price_history(const Tick_Store& tick_store, Response_Writer& writer, const Time& from, const Time& to) const
+{
+    // price-time pairs by chronological order
+    tick_store.scan(get_action_id(), from, to, [&writer](const Tick& tick){
+        writer.write(fmt::format(",{} {}", tick.price, time_to_string(tick.time)));
+    });
+}
+
+// get the bars of the action as a string : name resolution,open_time open high low close volume vwap,...
+std::string Action::get_bars_info(const Bar_Aggregator& bar_aggregator, const Time& resolution, const Time& from, const Time& to) const
+{
+    std::string query = fmt::format(
+        "SELECT name FROM actions WHERE action_id = {}",
+        get_action_id()
+    );
+    std::string result = Database.execute_SQL_query_string(query) + " " + bar_resolution_to_string(resolution);
+    for (const auto& bar : bar_aggregator.get_bars(get_action_id(), resolution, from, to)){
+        result += fmt::format(
+            ",{} {} {} {} {} {} {}",
+            time_to_string(bar.open_time),
+            bar.open,
+            bar.high,
+            bar.low,
+            bar.close,
+            bar.volume,
+            bar.get_vwap()
+        );
+    }
+    return result;
+}
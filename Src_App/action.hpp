@@ -6,6 +6,10 @@
 #include "database_management.hpp"
 
 
+#include "bars.hpp"
+#include "tick_store.hpp"
+
+
 class Action 
 {
 private:
@@ -21,7 +25,10 @@ public:
     double get_current_price() const; // get the current price of the action
     
     // string representation methods
-    std::string get_action_info() const; // get the action info as a string : name quantity,price1 time1,price2 time2, ...
+    std::string get_action_info(const Tick_Store& tick_store, const Time& from = 0, const Time& to = no_expiration_time) const; // get the action info as a string : name quantity,price1 time1,price2 time2, ... (prices between from and to, read from the tick store)
+    void write_action_info(const Tick_Store& tick_store, Response_Writer& writer, const Time& from = 0, const Time& to = no_expiration_time) const; // stream the action info in the writer (same format)
+    void write_price_history(const Tick_Store& tick_store, Response_Writer& writer, const Time& from = 0, const Time& to = no_expiration_time) const; // stream the ,price time pairs of the action info (after a name and a quantity read elsewhere, a snapshot)
+    std::string get_bars_info(const Bar_Aggregator& bar_aggregator, const Time& resolution, const Time& from = 0, const Time& to = no_expiration_time) const; // get the bars of the action as a string : name resolution,open_time open high low close volume vwap,...
 };
 
 
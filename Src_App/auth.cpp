@@ -0,0 +1,209 @@
+#include "auth.hpp"
+
+
+// constructor
+Auth_Service::Auth_Service(Database_Manager& database) : Database(database), Token_Key(random_bytes(SESSION_TOKEN_KEY_SIZE)), Stopping(false)
+{
+
+}
+
+// destructor
+Auth_Service::~Auth_Service()
+{
+    stop();
+}
+
+// start the threads (the logins submitted before wait for them)
+void Auth_Service::start(const size_t& thread_count)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Stopping = false;
+    for (size_t i = 0; i < thread_count; i++){
+        Workers.emplace_back(&Auth_Service::run_worker, this);
+    }
+}
+
+// stop the threads, the logins still waiting are refused
+void Auth_Service::stop()
+{
+    std::deque<Auth_Request> refused;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Stopping = true;
+        refused.swap(Requests);
+    }
+    Requests_Available.notify_all();
+    for (auto& worker : Workers){
+        worker.join();
+    }
+    Workers.clear();
+    for (auto& request : refused){
+        request.done("AUTHENTIFICATION_FAILURE_BUSY", -1);
+    }
+}
+
+// check a login on a thread, done is called there (at once if the queue is full)
+void Auth_Service::submit(std::string username, std::string password, Auth_Callback done)
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (!Stopping && Requests.size() < AUTH_QUEUE_SIZE){
+            Requests.push_back(Auth_Request{std::move(username), std::move(password), std::move(done)});
+            Requests_Available.notify_one();
+            return;
+        }
+    }
+    done("AUTHENTIFICATION_FAILURE_BUSY", -1);
+}
+
+// check the passwords of the logins until the service stops
+void Auth_Service::run_worker()
+{
+    while (true){
+        Auth_Request request;
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            Requests_Available.wait(lock, [this](){
+                return Stopping || !Requests.empty();
+            });
+            if (Stopping){
+                return;
+            }
+            request = std::move(Requests.front());
+            Requests.pop_front();
+        }
+        std::string response;
+        ID client_id = -1;
+        try {
+            response = check_password(request.username, request.password, client_id);
+        }
+        catch (const std::exception& e){
+            std::cerr << "Error checking a password: " << e.what() << std::endl;
+            response = "AUTHENTIFICATION_FAILURE_BUSY";
+            client_id = -1;
+        }
+        request.done(std::move(response), client_id);
+    }
+}
+
+// the answer of a login (with a token on success, client_id is then set), logged in the messages
+// (one query reads the whole stored password, the hash is computed without any lock)
+std::string Auth_Service::check_password(const std::string& username, const std::string& password, ID& client_id)
+{
+    std::optional<Client_Credentials> credentials = get_credentials(username);
+    Message authentification_message(Database.get_new_message_id(), Database);
+    if (!credentials){
+        authentification_message.log_message(0, Message::Sender::SERVER_MESSAGE, Message::Type::AUTHENTIFICATION_FAILURE_USERNAME, "Unknown username", get_current_time_ms());
+        return "AUTHENTIFICATION_FAILURE_USERNAME";
+    }
+    bool valid;
+    if (credentials->password_iterations > 0){
+        std::string hash = hash_password(password, credentials->password_salt, credentials->password_iterations);
+        valid = hash.size() == credentials->password_hash.size() && CRYPTO_memcmp(hash.data(), credentials->password_hash.data(), hash.size()) == 0;
+    }
+    else {
+        valid = encrypt_AES(password, key, iv) == credentials->encrypted_password;
+        if (valid){
+            upgrade_password(credentials->client_id, password); // hashed from now on
+        }
+    }
+    if (!valid){
+        authentification_message.log_message(credentials->client_id, Message::Sender::SERVER_MESSAGE, Message::Type::AUTHENTIFICATION_FAILURE_PASSWORD, "Wrong password", get_current_time_ms());
+        return "AUTHENTIFICATION_FAILURE_PASSWORD";
+    }
+    authentification_message.log_message(credentials->client_id, Message::Sender::SERVER_MESSAGE, Message::Type::AUTHENTIFICATION_SUCCESS, "Authentification success", get_current_time_ms());
+    client_id = credentials->client_id;
+    return fmt::format("AUTHENTIFICATION_SUCCESS {} {}", credentials->client_id, issue_token(credentials->client_id));
+}
+
+// stored password of a client, by name
+std::optional<Client_Credentials> Auth_Service::get_credentials(const std::string& username)
+{
+    std::string query(sql_client_credentials);
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(Database.get_database(), query.c_str(), -1, &stmt, nullptr) != SQLITE_OK){
+        std::cerr << "Error preparing SQL: " << sqlite3_errmsg(Database.get_database()) << std::endl;
+        return std::nullopt;
+    }
+    sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
+    std::optional<Client_Credentials> credentials;
+    if (sqlite3_step(stmt) == SQLITE_ROW){
+        auto column_bytes = [stmt](const int& column){
+            const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, column));
+            return data == nullptr ? std::string() : std::string(data, sqlite3_column_bytes(stmt, column));
+        };
+        credentials = Client_Credentials{sqlite3_column_int64(stmt, 0), column_bytes(1), column_bytes(2), column_bytes(3), sqlite3_column_int(stmt, 4)};
+    }
+    sqlite3_finalize(stmt);
+    return credentials;
+}
+
+// replace an AES password by a PBKDF2 hash
+void Auth_Service::upgrade_password(const ID& client_id, const std::string& password)
+{
+    std::string salt = random_bytes(PASSWORD_SALT_SIZE);
+    std::string hash = hash_password(password, salt, PASSWORD_HASH_ITERATIONS);
+    std::string query = "UPDATE clients SET encrypted_password = X'', password_salt = ?, password_hash = ?, password_iterations = ? WHERE client_id = ?";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(Database.get_database(), query.c_str(), -1, &stmt, nullptr) != SQLITE_OK){
+        std::cerr << "Error preparing SQL: " << sqlite3_errmsg(Database.get_database()) << std::endl;
+        return;
+    }
+    sqlite3_bind_blob(stmt, 1, salt.data(), salt.size(), SQLITE_STATIC);
+    sqlite3_bind_blob(stmt, 2, hash.data(), hash.size(), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, PASSWORD_HASH_ITERATIONS);
+    sqlite3_bind_int64(stmt, 4, client_id);
+    if (sqlite3_step(stmt) != SQLITE_DONE){
+        std::cerr << "Error updating the password of a client: " << sqlite3_errmsg(Database.get_database()) << std::endl;
+        sqlite3_finalize(stmt);
+        return;
+    }
+    sqlite3_finalize(stmt);
+}
+
+
+// session tokens
+// HMAC-SHA256 of a token, in hexadecimal
+std::string Auth_Service::sign_token(const std::string& payload) const
+{
+    unsigned char signature[EVP_MAX_MD_SIZE];
+    unsigned int signature_length = 0;
+    HMAC(EVP_sha256(), Token_Key.data(), Token_Key.size(), reinterpret_cast<const unsigned char*>(payload.data()), payload.size(), signature, &signature_length);
+    std::string hexadecimal;
+    hexadecimal.reserve(2 * signature_length);
+    for (unsigned int i = 0; i < signature_length; i++){
+        hexadecimal += fmt::format("{:02x}", signature[i]);
+    }
+    return hexadecimal;
+}
+
+// client_id.expiration_time.signature
+std::string Auth_Service::issue_token(const ID& client_id) const
+{
+    std::string payload = fmt::format("{}.{}", client_id, get_current_time_ms() + SESSION_TOKEN_LIFETIME);
+    return payload + "." + sign_token(payload);
+}
+
+// the client of a valid token, -1 if it is forged or expired
+ID Auth_Service::check_token(std::string_view token) const
+{
+    size_t signature_start = token.rfind('.');
+    size_t expiration_start = token.find('.');
+    if (signature_start == std::string_view::npos || expiration_start == signature_start){
+        return -1;
+    }
+    std::string payload(token.substr(0, signature_start));
+    std::string expected = sign_token(payload);
+    std::string_view signature = token.substr(signature_start + 1);
+    if (signature.size() != expected.size() || CRYPTO_memcmp(signature.data(), expected.data(), expected.size()) != 0){
+        return -1;
+    }
+    ID client_id = -1;
+    Time expiration_time = 0;
+    std::from_chars(payload.data(), payload.data() + expiration_start, client_id);
+    std::from_chars(payload.data() + expiration_start + 1, payload.data() + payload.size(), expiration_time);
+    if (expiration_time < get_current_time_ms()){
+        return -1;
+    }
+    return client_id;
+}
@@ -0,0 +1,74 @@
+//==========================================================================
+// File that defines the authentication of the clients : the passwords are checked by a few worker threads (slow salted hashes),
+// and a successful login gets a short-lived signed token, so that a reconnection skips the hashing
+//==========================================================================
+#ifndef AUTH_HPP
+#define AUTH_HPP
+#include "database_management.hpp"
+
+
+#include <deque>
+#include "messages.hpp"
+
+
+#define AUTH_THREAD_COUNT 2 // threads hashing the passwords (they never compete with more than this many cores)
+#define AUTH_QUEUE_SIZE 1024 // logins waiting for a thread, the next ones are refused (the client tries again later)
+#define SESSION_TOKEN_LIFETIME (15 * 60 * 1000) // milliseconds a token is accepted after the login
+#define SESSION_TOKEN_KEY_SIZE 32 // bytes of the key signing the tokens (drawn at startup : a restart invalidates them)
+
+
+// answer of a login, handed to the session of the client once the password has been checked (with the client it authenticates, -1 if it failed)
+using Auth_Callback = std::function<void(std::string response, const ID& client_id)>;
+
+// a login waiting for a thread
+struct Auth_Request
+{
+    std::string username;
+    std::string password;
+    Auth_Callback done;
+};
+
+// stored password of a client : a PBKDF2 hash, or the AES password of the clients not logged in since the hashes were introduced
+struct Client_Credentials
+{
+    ID client_id;
+    std::string encrypted_password;
+    std::string password_salt;
+    std::string password_hash;
+    int password_iterations; // 0 for an AES password
+};
+
+class Auth_Service
+{
+private:
+    Database_Manager& Database;
+    std::string Token_Key;
+    std::deque<Auth_Request> Requests;
+    std::vector<std::thread> Workers;
+    std::mutex Mutex;
+    std::condition_variable Requests_Available;
+    bool Stopping;
+
+    void run_worker(); // check the passwords of the logins until the service stops
+    std::string check_password(const std::string& username, const std::string& password, ID& client_id); // the answer of a login (with a token on success, client_id is then set), logged in the messages
+    std::optional<Client_Credentials> get_credentials(const std::string& username); // stored password of a client, by name
+    void upgrade_password(const ID& client_id, const std::string& password); // replace an AES password by a PBKDF2 hash
+    std::string sign_token(const std::string& payload) const; // HMAC-SHA256 of a token, in hexadecimal
+
+public:
+    // constructor
+    Auth_Service(Database_Manager& database);
+    // destructor
+    ~Auth_Service(); // the threads are stopped
+    Auth_Service(const Auth_Service&) = delete;
+    Auth_Service& operator=(const Auth_Service&) = delete;
+
+    void start(const size_t& thread_count); // start the threads (the logins submitted before wait for them)
+    void stop(); // stop the threads, the logins still waiting are refused
+    void submit(std::string username, std::string password, Auth_Callback done); // check a login on a thread, done is called there (at once if the queue is full)
+    std::string issue_token(const ID& client_id) const; // client_id.expiration_time.signature
+    ID check_token(std::string_view token) const; // the client of a valid token, -1 if it is forged or expired
+};
+
+
+#endif // AUTH_HPP
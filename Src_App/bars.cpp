@@ -0,0 +1,178 @@
+#include "bars.hpp"
+
+
+// volume weighted average price
+double Bar::get_vwap() const
+{
+    if (volume == 0){
+        return close;
+    }
+    return turnover / volume;
+}
+
+// resolutions of the bars, in milliseconds, and their names in the display command
+const std::array<std::pair<Time, std::string>, BAR_RESOLUTION_COUNT> bar_resolutions = {{
+    {MS_IN_S, "1s"},
+    {MS_IN_M, "1min"},
+    {5 * MS_IN_M, "5min"},
+    {24 * MS_IN_H, "1d"}
+}};
+
+// get the resolution from its name (1s, 1min, 5min, 1d), 0 if unknown
+Time get_bar_resolution_from_string(const std::string& name)
+{
+    for (const auto& [resolution, resolution_name] : bar_resolutions){
+        if (resolution_name == name){
+            return resolution;
+        }
+    }
+    return 0;
+}
+
+// get the name of a resolution
+std::string bar_resolution_to_string(const Time& resolution)
+{
+    for (const auto& [bar_resolution, resolution_name] : bar_resolutions){
+        if (bar_resolution == resolution){
+            return resolution_name;
+        }
+    }
+    return std::to_string(resolution) + "ms";
+}
+
+
+// constructor
+Bar_Aggregator::Bar_Aggregator(Database_Manager& database) : Database(database)
+{
+
+}
+
+// write (or overwrite) a bar in the database
+void Bar_Aggregator::save_bar(const ID& action_id, const Time& resolution, const Bar& bar)
+{
+    std::string query = fmt::format(
+        "INSERT OR REPLACE INTO bars (action_id, resolution, open_time, open, high, low, close, volume, turnover) VALUES ({}, {}, {}, {}, {}, {}, {}, {}, {})",
+        action_id,
+        resolution,
+        bar.open_time,
+        bar.open,
+        bar.high,
+        bar.low,
+        bar.close,
+        bar.volume,
+        bar.turnover
+    );
+    Database.execute_SQL(query);
+}
+
+// read a bar written before a restart of the server
+std::optional<Bar> Bar_Aggregator::load_bar(const ID& action_id, const Time& resolution, const Time& open_time) const
+{
+    std::string query = fmt::format(
+        "SELECT open, high, low, close, volume, turnover FROM bars WHERE action_id = {} AND resolution = {} AND open_time = {}",
+        action_id,
+        resolution,
+        open_time
+    );
+    std::vector<std::vector<std::string>> rows = Database.execute_SQL_query_vec_strings(query);
+    if (rows.empty() || rows[0].size() < 6){
+        return std::nullopt;
+    }
+    return Bar{open_time, std::stod(rows[0][0]), std::stod(rows[0][1]), std::stod(rows[0][2]), std::stod(rows[0][3]), std::stoll(rows[0][4]), std::stod(rows[0][5])};
+}
+
+// update the open bars of the action, closing the ones that are over (O(1) per resolution)
+void Bar_Aggregator::add_trade(const ID& action_id, const Time& time, const double& price, const int64_t& quantity)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto& open_bars = Open_Bars[action_id];
+    for (size_t i = 0; i < BAR_RESOLUTION_COUNT; i++){
+        Time resolution = bar_resolutions[i].first;
+        Time open_time = time - time % resolution;
+        std::optional<Bar>& bar = open_bars[i];
+        // a trade after the end of the open bar closes it (a trade before its start, if the clock went back, stays in it)
+        if (!bar || open_time > bar->open_time){
+            if (bar){
+                save_bar(action_id, resolution, *bar);
+            }
+            bar = load_bar(action_id, resolution, open_time); // the bar may have been started before a restart
+            if (!bar){
+                bar = Bar{open_time, price, price, price, price, 0, 0.0};
+            }
+        }
+        bar->high = std::max(bar->high, price);
+        bar->low = std::min(bar->low, price);
+        bar->close = price;
+        bar->volume += quantity;
+        bar->turnover += price * quantity;
+    }
+}
+
+// get the bars opened between from and to (included), the open bar included
+std::vector<Bar> Bar_Aggregator::get_bars(const ID& action_id, const Time& resolution, const Time& from, const Time& to) const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    // the bar containing from is included
+    Time first_open_time = from - from % resolution;
+    std::string query = fmt::format(
+        sql_bars_in_range,
+        action_id,
+        resolution,
+        first_open_time,
+        to
+    );
+    std::vector<std::vector<std::string>> rows = Database.execute_SQL_query_vec_strings(query);
+
+    // the open bar is kept in memory, its row in the database (if any) is outdated
+    const Bar* open_bar = nullptr;
+    auto it = Open_Bars.find(action_id);
+    if (it != Open_Bars.end()){
+        for (size_t i = 0; i < BAR_RESOLUTION_COUNT; i++){
+            if (bar_resolutions[i].first == resolution && it->second[i] && it->second[i]->open_time >= first_open_time && it->second[i]->open_time <= to){
+                open_bar = &*it->second[i];
+            }
+        }
+    }
+
+    std::vector<Bar> bars;
+    bars.reserve(rows.size() + 1);
+    for (const auto& row : rows){
+        if (row.size() < 7){
+            continue;
+        }
+        Time open_time = std::stoull(row[0]);
+        if (open_bar != nullptr && open_time >= open_bar->open_time){
+            continue;
+        }
+        bars.push_back(Bar{open_time, std::stod(row[1]), std::stod(row[2]), std::stod(row[3]), std::stod(row[4]), std::stoll(row[5]), std::stod(row[6])});
+    }
+    if (open_bar != nullptr){
+        bars.push_back(*open_bar);
+    }
+    return bars;
+}
+
+// write the open bars in the database (at the server shutdown)
+void Bar_Aggregator::flush()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    for (const auto& [action_id, open_bars] : Open_Bars){
+        for (size_t i = 0; i < BAR_RESOLUTION_COUNT; i++){
+            if (open_bars[i]){
+                save_bar(action_id, bar_resolutions[i].first, *open_bars[i]);
+            }
+        }
+    }
+}
+
+// delete the bars of an action
+void Bar_Aggregator::remove_action(const ID& action_id)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Open_Bars.erase(action_id);
+    std::string query = fmt::format(
+        "DELETE FROM bars WHERE action_id = {}",
+        action_id
+    );
+    Database.execute_SQL(query);
+}
@@ -0,0 +1,59 @@
+//==========================================================================
+// File that defines the OHLCV bars of the actions, aggregated trade by trade
+//==========================================================================
+#ifndef BARS_HPP
+#define BARS_HPP
+#include "database_management.hpp"
+
+
+#include <array>
+
+
+#define BAR_RESOLUTION_COUNT 4 // 1 s, 1 min, 5 min, 1 day
+
+
+// open/high/low/close/volume of an action over one bar
+struct Bar
+{
+    Time open_time; // milliseconds since Unix epoch, multiple of the resolution
+    double open;
+    double high;
+    double low;
+    double close;
+    int64_t volume; // number of actions exchanged
+    double turnover; // sum of price * quantity
+
+    double get_vwap() const; // volume weighted average price
+};
+
+// resolutions of the bars, in milliseconds, and their names in the display command
+extern const std::array<std::pair<Time, std::string>, BAR_RESOLUTION_COUNT> bar_resolutions;
+Time get_bar_resolution_from_string(const std::string& name); // get the resolution from its name (1s, 1min, 5min, 1d), 0 if unknown
+std::string bar_resolution_to_string(const Time& resolution); // get the name of a resolution
+
+
+// maintains the open bar of each action at each resolution, a bar is written in the database when it closes
+class Bar_Aggregator
+{
+private:
+    Database_Manager& Database; // reference to the database manager for queries
+    std::unordered_map<ID, std::array<std::optional<Bar>, BAR_RESOLUTION_COUNT>> Open_Bars; // bars being built for each action (refered by the action id)
+    mutable std::mutex Mutex; // the trades are added by the market while the clients read the bars
+
+    void save_bar(const ID& action_id, const Time& resolution, const Bar& bar); // write (or overwrite) a bar in the database
+    std::optional<Bar> load_bar(const ID& action_id, const Time& resolution, const Time& open_time) const; // read a bar written before a restart of the server
+
+public:
+    // constructor
+    Bar_Aggregator(Database_Manager& database); // simple init
+    Bar_Aggregator(const Bar_Aggregator&) = delete;
+    Bar_Aggregator& operator=(const Bar_Aggregator&) = delete;
+
+    void add_trade(const ID& action_id, const Time& time, const double& price, const int64_t& quantity); // update the open bars of the action, closing the ones that are over (O(1) per resolution)
+    std::vector<Bar> get_bars(const ID& action_id, const Time& resolution, const Time& from, const Time& to) const; // get the bars opened between from and to (included), the open bar included
+    void flush(); // write the open bars in the database (at the server shutdown)
+    void remove_action(const ID& action_id); // delete the bars of an action
+};
+
+
+#endif // BARS_HPP
@@ -65,90 +65,82 @@ void Client::withdraw(const double& amount)
 // returns True if the amount can be withdrawn
 bool Client::can_afford(const int& quantity, const double& price, const ID& action_id) const
 {   
+    double amount = get_order_cost(quantity, price, action_id);
+    if (amount < 0){
+        return false;
+    }
+    return amount <= get_available_balance();
+}
+
+// amount reserved for a buy order (a market order is valued at the last price with the safety margin)
+double Client::get_order_cost(const int& quantity, const double& price, const ID& action_id) const
+{
     double amount = quantity * price;
     if (price == max_number && action_id != -1){
-        std::string price_query = fmt::format(
-            "SELECT price FROM prices WHERE action_id = {} ORDER BY date_time DESC, daily_time DESC LIMIT 1",
-            action_id
-        );
+        std::string price_query = fmt::format(sql_last_price, action_id);
         double current_price = Database.execute_SQL_query_double(price_query);
         amount = current_price * safety_percentage;
     }
-    if (amount < 0){
-        return false;
-    }
-    std::string query = fmt::format(
-        R"(SELECT c.balance - COALESCE((
-                SELECT SUM(o.quantity * 
-                    CASE 
-                        WHEN o.order_type = 'MARKET' THEN (
-                            SELECT p.price * {}
-                            FROM prices p
-                            WHERE p.action_id = o.action_id
-                            AND (p.date_time, p.daily_time) = (
-                                SELECT p2.date_time, p2.daily_time FROM prices p2
-                                WHERE p2.action_id = o.action_id
-                                AND p2.date_time = (SELECT MAX(p3.date_time) FROM prices p3 WHERE p3.action_id = o.action_id)
-                                AND p2.daily_time = (SELECT MAX(p3.daily_time) FROM prices p3 WHERE p3.action_id = o.action_id AND p3.date_time = p2.date_time)
-                            )
-                        )
-                        ELSE o.price
-                    END
-                )
-                FROM orders o
-                WHERE o.client_id = c.client_id AND o.order_status = 'PENDING'
-            ), 0)
-        FROM clients c
-        WHERE c.client_id = {})",
-        safety_percentage,
-        get_id()
-    );
-    double available_balance = Database.execute_SQL_query_double(query); // a pending order can be executed at any time, and then substrated from the balance, so for it to remains positive, we need to substract the pending orders from the balance
-    return amount <= available_balance;
+    return amount;
+}
+
+// balance minus the amount reserved for the pending orders
+double Client::get_available_balance() const
+{
+    std::string query = fmt::format(sql_available_balance, safety_percentage, get_id());
+    return Database.execute_SQL_query_double(query); // a pending order can be executed at any time, and then substrated from the balance, so for it to remains positive, we need to substract the pending orders from the balance
 }
 
 
 // completed orders management:
 // add an order to the client's list of orders
-void Client::add_completed_order(const ID& order_id, const ID& order_time_date, const ID& order_time_daily, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time_date, const ID& expiration_time_daily)
+void Client::add_completed_order(const ID& order_id, const ID& order_time, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time)
 {
-    std::string order_type_string = order_type_to_string(order_type);
-    std::string trigger_type_string = trigger_to_string(trigger_type);
-    std::string order_status_string = "COMPLETED";
-    std::string query = fmt::format(
-        "INSERT INTO orders (order_id, order_status, order_time_date, order_time_daily, client_id, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time_date, expiration_time_daily) VALUES ({}, '{}', {}, {}, {}, '{}', {}, {}, '{}', {}, {}, {}, {}, {})",
-        order_id,
-        order_status_string,
-        order_time_date,
-        order_time_daily,
-        get_id(),
-        order_type_string,
-        quantity,
-        action_id,
-        trigger_type_string,
-        price,
-        trigger_price_lower,
-        trigger_price_upper,
-        expiration_time_date,
-        expiration_time_daily
-    );
+    add_pending_orders({Order_Request{order_id, order_time, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time}});
+}
+
+// add orders to the client's list of pending orders, in one statement (all or none)
+// (one multi-row INSERT : no transaction is opened on the connection shared by the threads of the server)
+void Client::add_pending_orders(const std::vector<Order_Request>& orders)
+{
+    if (orders.empty()){
+        return;
+    }
+    std::string query = "INSERT INTO orders (order_id, order_status, order_time, client_id, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time) VALUES ";
+    for (size_t i = 0; i < orders.size(); i++){
+        const Order_Request& order = orders[i];
+        query += fmt::format(
+            "{}({}, 'PENDING', {}, {}, '{}', {}, {}, '{}', {}, {}, {}, {})",
+            i == 0 ? "" : ", ",
+            order.order_id,
+            order.order_time,
+            get_id(),
+            order_type_to_string(order.order_type),
+            order.quantity,
+            order.action_id,
+            trigger_to_string(order.trigger_type),
+            order.price,
+            order.trigger_price_lower,
+            order.trigger_price_upper,
+            order.expiration_time
+        );
+    }
     Database.execute_SQL(query);
 }
 
 
 // pending orders management:
 // add an order to the client's list of pending orders
-void Client::add_pending_order(const ID& order_id, const ID& order_time_date, const ID& order_time_daily, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time_date, const ID& expiration_time_daily)
+void Client::add_pending_order(const ID& order_id, const ID& order_time, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time)
 {
     std::string order_type_string = order_type_to_string(order_type);
     std::string trigger_type_string = trigger_to_string(trigger_type);
     std::string order_status_string = "PENDING";
     std::string query = fmt::format(
-        "INSERT INTO orders (order_id, order_status, order_time_date, order_time_daily, client_id, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time_date, expiration_time_daily) VALUES ({}, '{}', {}, {}, {}, '{}', {}, {}, '{}', {}, {}, {}, {}, {})",
+        "INSERT INTO orders (order_id, order_status, order_time, client_id, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time) VALUES ({}, '{}', {}, {}, '{}', {}, {}, '{}', {}, {}, {}, {})",
         order_id,
         order_status_string,
-        order_time_date,
-        order_time_daily,
+        order_time,
         get_id(),
         order_type_string,
         quantity,
@@ -157,8 +149,7 @@ void Client::add_pending_order(const ID& order_id, const ID& order_time_date, co
         price,
         trigger_price_lower,
         trigger_price_upper,
-        expiration_time_date,
-        expiration_time_daily
+        expiration_time
     );
     Database.execute_SQL(query);
 }
@@ -177,7 +168,7 @@ void Client::remove_pending_order(const ID& order_id)
 
 // Portfolio management:
 // add a quantity for a specific action and update its price if necessary
-void Client::add_action(const ID& action_id, const int& quantity, const double& price, const ID& daily_time, const ID& date_time)
+void Client::add_action(const ID& action_id, const int& quantity, const double& price, const ID& time)
 {
     // if the action is already in the portfolio, we add the quantity
     if (is_action_in_portfolio(action_id)){
@@ -200,30 +191,12 @@ void Client::add_action(const ID& action_id, const int& quantity, const double&
         Database.execute_SQL(query);
     }
 
-    // check if the price and time already exist in the prices table
-    std::string check_query = fmt::format(
-        "SELECT 1 FROM prices WHERE action_id = {} AND price = {} AND daily_time = {} AND date_time = {} LIMIT 1",
-        action_id, 
-        price, 
-        daily_time, 
-        date_time
-    );
-    std::vector<std::vector<std::string>> existing_price = Database.execute_SQL_query_vec_strings(check_query);
-    // if no matching price-time exists, insert the new price-time
-    if (existing_price.empty()){
-        std::string query = fmt::format(
-            "INSERT INTO prices (action_id, price, daily_time, date_time) VALUES ({}, {}, {}, {})",
-            action_id, 
-            price, 
-            daily_time, 
-            date_time
-        );
-        Database.execute_SQL(query);
-    }
+    // the last price of the action (its history is in the tick store)
+    Database.set_last_price(action_id, price, time);
 }
 
 // remove a quantity for a specific action and update its price if necessary
-void Client::remove_action(const ID& action_id, const int& quantity, const double& price, const ID& daily_time, const ID& date_time)
+void Client::remove_action(const ID& action_id, const int& quantity, const double& price, const ID& time)
 {
     // if the action is in the portfolio, we remove the quantity
     if (is_action_in_portfolio(action_id)){
@@ -236,46 +209,34 @@ void Client::remove_action(const ID& action_id, const int& quantity, const doubl
         Database.execute_SQL(query);
     }
 
-    // check if the price and time already exist in the prices table
-    std::string check_query = fmt::format(
-        "SELECT 1 FROM prices WHERE action_id = {} AND price = {} AND daily_time = {} AND date_time = {} LIMIT 1",
-        action_id, 
-        price, 
-        daily_time, 
-        date_time
-    );
-    std::vector<std::vector<std::string>> existing_price = Database.execute_SQL_query_vec_strings(check_query);
-    // if no matching price-time exists, insert the new price-time
-    if (existing_price.empty()){
-        std::string query = fmt::format(
-            "INSERT INTO prices (action_id, price, daily_time, date_time) VALUES ({}, {}, {}, {})",
-            action_id, 
-            price, 
-            daily_time, 
-            date_time
-        );
-        Database.execute_SQL(query);
-    }
+    // the last price of the action (its history is in the tick store)
+    Database.set_last_price(action_id, price, time);
 }
 
 // returns True if the action can be removed
 bool Client::has_shares(const ID& action_id, const int& quantity) const
+{
+    return quantity > 0 && quantity <= get_shares(action_id);
+}
+
+// quantity of an action in the portfolio
+int Client::get_shares(const ID& action_id) const
 {
     std::string query = fmt::format(
         "SELECT quantity FROM client_portfolio WHERE client_id = {} AND action_id = {}",
         get_id(), 
         action_id
     );
-    return quantity > 0 && quantity <= Database.execute_SQL_query_int(query);
+    return Database.execute_SQL_query_int(query);
 }
 
 // update the portfolio with a new action (modify the client balance also)
-void Client::update_portfolio(const Order_Type& order_type, const ID& action_id, const int& quantity, const double& price, const ID& daily_time, const ID& date_time)
+void Client::update_portfolio(const Order_Type& order_type, const ID& action_id, const int& quantity, const double& price, const ID& time)
 {
     if (order_type == Order_Type::BUY){
         if (can_afford(quantity, price, action_id)){
             withdraw(price * quantity);
-            add_action(action_id, quantity, price, daily_time, date_time);
+            add_action(action_id, quantity, price, time);
         }
         else {
             std::cerr << "Error: Insufficient balance for buying.\n";
@@ -284,7 +245,7 @@ void Client::update_portfolio(const Order_Type& order_type, const ID& action_id,
     else if (order_type == Order_Type::SELL){
         if (has_shares(action_id, quantity)){
             deposit(price * quantity);
-            remove_action(action_id, quantity, price, daily_time, date_time);
+            remove_action(action_id, quantity, price, time);
         }
         else {
             std::cerr << "Error: Failed to sell action.\n";
@@ -294,145 +255,85 @@ void Client::update_portfolio(const Order_Type& order_type, const ID& action_id,
 
 
 // string representation methods
-// get the completed orders info as a string : order_time_date order_time_daily client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time_date expiration_time_daily,...
+// get the completed orders info as a string : order_time client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time,...
 std::string Client::get_completed_orders_info() const
 {   
-    std::string query = fmt::format(
-        R"(SELECT o.order_time_date, o.order_time_daily, c.name, o.order_type, o.quantity, a.name, o.trigger_type, o.price, o.trigger_price_lower, o.trigger_price_upper, o.expiration_time_date, o.expiration_time_daily
-          FROM orders o JOIN actions a ON o.action_id = a.action_id JOIN clients c ON o.client_id = c.client_id
-          WHERE o.client_id = {} AND o.order_status = 'COMPLETED')",
-        get_id()
-    );
-    std::vector<std::vector<std::string>> completed_orders_info = Database.execute_SQL_query_vec_strings(query);
-    
-    // check if we have enough data before accessing elements
-    if (completed_orders_info.empty()){
-        return ""; // return empty if data is missing
-    }
-    
     std::string result;
-    for (const auto& order : completed_orders_info){
-        if (order.size() >= 12){
-            result += fmt::format(
-                "{} {} {} {} {} {} {} {} {} {},",
-                two_times_to_string(std::stoll(order[0]), std::stoll(order[1])),
-                order[2],
-                order[3],
-                order[4],
-                order[5],
-                order[6],
-                order[7],
-                order[8],
-                order[9],
-                two_times_to_string(std::stoll(order[10]), std::stoll(order[11]))
-            );
-        }
-    }
-    if (!result.empty()){
-        result.pop_back(); // remove trailing comma
+    {
+        Response_Writer writer([&result](const char* data, size_t length, bool){ result.append(data, length); });
+        write_completed_orders_info(writer);
     }
     return result;
 }
 
-// get the pending orders info as a string : order_time_date order_time_daily client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time_date expiration_time_daily,...
+// get the pending orders info as a string : order_time client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time,...
 std::string Client::get_pending_orders_info() const
 {   
-    std::string query = fmt::format(
-        R"(SELECT o.order_time_date, o.order_time_daily, c.name, o.order_type, o.quantity, a.name, o.trigger_type, o.price, o.trigger_price_lower, o.trigger_price_upper, o.expiration_time_date, o.expiration_time_daily
-          FROM orders o JOIN actions a ON o.action_id = a.action_id JOIN clients c ON o.client_id = c.client_id
-          WHERE o.client_id = {} AND o.order_status = 'PENDING')",
-        get_id()
-    );
-    std::vector<std::vector<std::string>> completed_orders_info = Database.execute_SQL_query_vec_strings(query);
-    
-    // check if we have enough data before accessing elements
-    if (completed_orders_info.empty()){
-        return ""; // return empty if data is missing
-    }
-    
     std::string result;
-    for (const auto& order : completed_orders_info){
-        if (order.size() >= 12){
-            result += fmt::format(
-                "{} {} {} {} {} {} {} {} {} {},",
-                two_times_to_string(std::stoll(order[0]), std::stoll(order[1])),
-                order[2],
-                order[3],
-                order[4],
-                order[5],
-                order[6],
-                order[7],
-                order[8],
-                order[9],
-                two_times_to_string(std::stoll(order[10]), std::stoll(order[11]))
-            );
-        }
-    }
-    if (!result.empty()){
-        result.pop_back(); // remove trailing comma
+    {
+        Response_Writer writer([&result](const char* data, size_t length, bool){ result.append(data, length); });
+        write_pending_orders_info(writer);
     }
     return result;
 }
 
+// stream the completed orders info, row by row, in the writer
+void Client::write_completed_orders_info(Response_Writer& writer) const
+{
+    std::string query = fmt::format(sql_orders_of_client, get_id(), "COMPLETED");
+    write_orders_info(Database, query, writer);
+}
+
+// stream the pending orders info, row by row, in the writer
+void Client::write_pending_orders_info(Response_Writer& writer) const
+{
+    std::string query = fmt::format(sql_orders_of_client, get_id(), "PENDING");
+    write_orders_info(Database, query, writer);
+}
+
+// the portfolio info as a string : value balance,action_name_1 quantity1 last_price1 time1,... (from the database or from a snapshot)
+std::string format_portfolio_info(const double& balance, const std::vector<Portfolio_Row>& rows)
+{
+    // return the balance if no action is held
+    if (rows.empty()){
+        return fmt::format("0.0 {},", balance);
+    }
+    double portfolio_value = 0.0;
+    std::string result = fmt::format("{}", balance); // add balance first and portfolio value will be added later
+    for (const Portfolio_Row& row : rows){
+        portfolio_value += row.quantity * row.price;
+        result += fmt::format(
+            ",{} {} {} {}", 
+            row.action_name, 
+            row.quantity, 
+            row.price, 
+            time_to_string(row.time)
+        );
+    }
+    // add portfolio value at the start
+    return fmt::format("{} {}", portfolio_value, result);
+}
+
 // get the portfolio info as a string : value balance,action_name_1 quantity1 last_price1,action_name_2 quantity2 last_price2,...
 std::string Client::get_portfolio_info() const
 {
     std::string query = fmt::format(
-        R"(SELECT a.name, cp.quantity, p.price, p.date_time, p.daily_time
+        R"(SELECT a.name, cp.quantity, p.price, p.time
             FROM client_portfolio cp 
             JOIN actions a ON cp.action_id = a.action_id 
             LEFT JOIN prices p ON cp.action_id = p.action_id
             WHERE cp.client_id = {} 
-            AND (p.date_time, p.daily_time) = (
-                SELECT p2.date_time, p2.daily_time FROM prices p2 
-                WHERE p2.action_id = cp.action_id 
-                AND p2.date_time = (SELECT MAX(p3.date_time) FROM prices p3 WHERE p3.action_id = p2.action_id) 
-                AND p2.daily_time = (SELECT MAX(p3.daily_time) FROM prices p3 WHERE p3.action_id = p2.action_id AND p3.date_time = p2.date_time)
-            ) ORDER BY a.action_id ASC)",
+            AND p.time = (SELECT MAX(p2.time) FROM prices p2 WHERE p2.action_id = cp.action_id)
+            ORDER BY a.action_id ASC)",
         get_id()
     );
     std::vector<std::vector<std::string>> portfolio_info = Database.execute_SQL_query_vec_strings(query);
-    
-    // check if we have enough data before accessing elements
-    if (portfolio_info.empty()){
-        // return the balance if no data is found
-        std::string result = fmt::format(
-            "0.0 {},", 
-            get_balance()
-        );
-        return result;
-    }
-
-    double portfolio_value = 0.0;
-    std::string result = fmt::format(
-        "{},", 
-        get_balance()
-    ); // add balance first and portfolio value will be added later
-    // iterate over the portfolio info to calculate value and format the output
+    std::vector<Portfolio_Row> rows;
     for (const auto& row : portfolio_info){
-        if (row.size() >= 5){
-            int quantity = std::stoi(row[1]);
-            double price = std::stod(row[2]);
-            portfolio_value += quantity * price;
-            result += fmt::format(
-                "{} {} {} {},", 
-                row[0], // action name
-                quantity, 
-                price, 
-                two_times_to_string(std::stoll(row[4]), std::stoll(row[3]))
-            );
+        if (row.size() >= 4){
+            rows.push_back(Portfolio_Row{row[0], std::stoi(row[1]), std::stod(row[2]), std::stoull(row[3])});
         }
     }
-    // remove the trailing comma
-    if (!result.empty()){
-        result.pop_back();
-    }
-    // add portfolio value at the start
-    std::string full_result = fmt::format(
-        "{} {}", 
-        portfolio_value, 
-        result
-    );
-    return full_result;
+    return format_portfolio_info(get_balance(), rows);
 }
 
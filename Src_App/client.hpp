@@ -10,6 +10,17 @@
 #include "action.hpp"
 
 
+// a line of a portfolio : an action held and its last price
+struct Portfolio_Row
+{
+    std::string action_name;
+    int quantity;
+    double price;
+    Time time; // of the last price
+};
+// the portfolio info as a string : value balance,action_name_1 quantity1 last_price1 time1,... (from the database or from a snapshot)
+std::string format_portfolio_info(const double& balance, const std::vector<Portfolio_Row>& rows);
+
 class Client
 {
 private:
@@ -30,23 +41,29 @@ public:
     void deposit(const double& amount); // deposit funds into the account
     void withdraw(const double& amount); // withdraw funds from the account
     bool can_afford(const int& quantity, const double& price, const ID& action_id) const; // returns True if the amount can be withdrawn
+    double get_order_cost(const int& quantity, const double& price, const ID& action_id) const; // amount reserved for a buy order (a market order is valued at the last price with the safety margin)
+    double get_available_balance() const; // balance minus the amount reserved for the pending orders
 
     // completed orders management:
-    void add_completed_order(const ID& order_id, const ID& order_time_date, const ID& order_time_daily, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time_date, const ID& expiration_time_daily); // add an order to the client's list of completed orders
+    void add_completed_order(const ID& order_id, const ID& order_time, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time); // add an order to the client's list of completed orders
 
     // pending orders management:
-    void add_pending_order(const ID& order_id, const ID& order_time_date, const ID& order_time_daily, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time_date, const ID& expiration_time_daily); // add an order to the client's list of pending orders
+    void add_pending_order(const ID& order_id, const ID& order_time, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time); // add an order to the client's list of pending orders
+    void add_pending_orders(const std::vector<Order_Request>& orders); // add orders to the client's list of pending orders, in one statement (all or none)
     void remove_pending_order(const ID& order_id); // remove a pending order by order id 
 
     // portfolio management: 
-    void add_action(const ID& action_id, const int& quantity, const double& price, const ID& daily_time, const ID& date_time); // add a quantity for a specific action and update its price if necessary
-    void remove_action(const ID& action_id, const int& quantity, const double& price, const ID& daily_time, const ID& date_time); // remove a quantity for a specific action and update its price if necessary
+    void add_action(const ID& action_id, const int& quantity, const double& price, const ID& time); // add a quantity for a specific action and update its price if necessary
+    void remove_action(const ID& action_id, const int& quantity, const double& price, const ID& time); // remove a quantity for a specific action and update its price if necessary
     bool has_shares(const ID& action_id, const int& quantity) const; // returns True if the action can be removed
-    void update_portfolio(const Order_Type& order_type, const ID& action_id, const int& quantity, const double& price, const ID& daily_time, const ID& date_time); // update the portfolio with a new action (modify the client balance also)
+    int get_shares(const ID& action_id) const; // quantity of an action in the portfolio
+    void update_portfolio(const Order_Type& order_type, const ID& action_id, const int& quantity, const double& price, const ID& time); // update the portfolio with a new action (modify the client balance also)
 
     // strings representation methods 
-    std::string get_completed_orders_info() const; // get the completed orders info as a string : order_time_date order_time_daily client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time_date expiration_time_daily,...
-    std::string get_pending_orders_info() const; // get the pending orders info as a string : order_time_date order_time_daily client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time_date expiration_time_daily,...
+    std::string get_completed_orders_info() const; // get the completed orders info as a string : order_time client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time,...
+    std::string get_pending_orders_info() const; // get the pending orders info as a string : order_time client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time,...
+    void write_completed_orders_info(Response_Writer& writer) const; // stream the completed orders info, row by row, in the writer (same format)
+    void write_pending_orders_info(Response_Writer& writer) const; // stream the pending orders info, row by row, in the writer (same format)
     std::string get_portfolio_info() const; // get the portfolio info as a string : value balance,action_name_1 quantity1 last_price1,action_name_2 quantity2 last_price2,...
 };
 
@@ -17,68 +17,261 @@
 #define SERVER_IP "127.0.0.1"  // IP address of the server (can be localhost or a not that far distant server)
 #define PORT 8080
 #define BUFFER_SIZE 1024
+#define RECONNECT_ATTEMPTS 5 // connections tried (one second apart) once the connection to the server is lost
+#define RESUME_REQUEST "resume"
+#define COMPRESSION_REQUEST "compress zlib" // the large responses (order histories) come deflated
+#define TOKEN_AUTHENTIFICATION_PREFIX "Authentification Token: "
+#define DISPLAY_REQUEST "display "
+#define VIEW_VERSION_KEYWORD "version" // appended to the display requests with the version of the view displayed last (0 for none)
+#define VIEW_VERSION_PREFIX "Version "
+#define NOT_MODIFIED_PREFIX "NOT_MODIFIED "
 
 
 std::atomic<bool> is_running(true); 
+std::mutex requests_mutex;
+std::map<uint64_t, std::string> requests_in_flight; // requests sent and not answered yet, by correlation id
+std::mutex send_mutex; // the requests and the heartbeats are sent by two threads
+std::atomic<int64_t> last_sent_time(0); // steady clock, in milliseconds
+std::atomic<int64_t> last_received_time(0);
+std::atomic<uint64_t> next_correlation_id(1);
+std::atomic<int> server_socket(-1); // replaced when the connection is restored
+std::atomic<bool> reconnecting(false); // the receiver restores the connection, no heartbeat is sent meanwhile
+std::atomic<uint64_t> last_seen_sequence(0); // last message of the session read, the server sends the next ones again after a reconnection
+std::mutex views_mutex;
+std::map<std::string, std::pair<uint64_t, std::string>> displayed_views; // last version of each view displayed and the view, by display request (shown again when the server answers NOT_MODIFIED)
+std::string session_token; // given by the server at the login, a reconnection presents it instead of the password (read by the receiver only once set)
 
 
-// function to check if the server is running by trying to connect
-bool is_server_running()
+// milliseconds of the steady clock (the heartbeats do not follow the changes of the wall clock)
+int64_t get_steady_time_ms()
 {
-    int client_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (client_socket == -1){
-        return false;  // socket creation failed, server is not running
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// send a message to the server (from the main thread or the heartbeat thread)
+void send_to_server(const std::string& message)
+{
+    std::lock_guard<std::mutex> lock(send_mutex);
+    send_message(server_socket, message);
+    last_sent_time = get_steady_time_ms();
+}
+
+// open a connection to the server, -1 if it fails (errno tells why)
+int open_connection(const struct sockaddr_in& address)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0){
+        perror("Error socket creation");
+        exit(EXIT_FAILURE);
+    }
+    if (connect(sock, (struct sockaddr*)&address, sizeof(address)) != 0){
+        int error = errno;
+        close(sock);
+        errno = error;
+        return -1;
     }
+    return sock;
+}
 
-    sockaddr_in server_addr{};
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(SERVER_PORT);
-    if (inet_pton(AF_INET, SERVER_IP, &server_addr.sin_addr) <= 0){
-        close(client_socket);
-        return false; // invalid address
+// ask the server to sequence the messages of the session, and to send again the ones after the last one read (if any was)
+void send_resume(const ID& client_id)
+{
+    uint64_t correlation_id = next_correlation_id++;
+    {
+        std::lock_guard<std::mutex> lock(requests_mutex);
+        requests_in_flight[correlation_id] = RESUME_REQUEST;
     }
-    // try to connect to the server
-    if (connect(client_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1){
-        close(client_socket);
-        return false;  // server is not running
+    std::string message = "#" + std::to_string(correlation_id) + " " + std::to_string(client_id) + " " + RESUME_REQUEST;
+    if (last_seen_sequence > 0){
+        message += " " + std::to_string(last_seen_sequence);
     }
+    send_to_server(message);
+}
 
-    close(client_socket);
-    return true;
+// ask the server to compress the large responses of the session
+void send_compression_request(const ID& client_id)
+{
+    uint64_t correlation_id = next_correlation_id++;
+    {
+        std::lock_guard<std::mutex> lock(requests_mutex);
+        requests_in_flight[correlation_id] = COMPRESSION_REQUEST;
+    }
+    send_to_server("#" + std::to_string(correlation_id) + " " + std::to_string(client_id) + " " + COMPRESSION_REQUEST);
+}
+
+// restore a lost connection : connect again, authenticate and resume the session after the last message read, false if the server stays unavailable
+// (with the session token while the server accepts it, with the password otherwise)
+bool reconnect(const struct sockaddr_in& address, const std::string& authentification, const ID& client_id, Frame_Buffer& buffer, const Heartbeat_Policy& policy)
+{
+    reconnecting = true;
+    for (int attempt = 0; attempt < RECONNECT_ATTEMPTS && is_running; attempt++){
+        if (attempt > 0){
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+        int sock = open_connection(address);
+        if (sock < 0){
+            continue;
+        }
+        // a server accepting the connection but not answering is not available either
+        struct timeval timeout = {policy.timeout / 1000, (policy.timeout % 1000) * 1000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        buffer.clear();
+        std::string response;
+        try {
+            send_message(sock, session_token.empty() ? authentification : TOKEN_AUTHENTIFICATION_PREFIX + session_token);
+        }
+        catch (const std::exception& e){
+            close(sock);
+            continue;
+        }
+        if (!receive_message(sock, buffer, response) || response.rfind("AUTHENTIFICATION_SUCCESS", 0) != 0){
+            if (response == "AUTHENTIFICATION_FAILURE_TOKEN"){
+                session_token.clear(); // expired, or the server restarted : the next attempt logs in with the password
+            }
+            close(sock);
+            continue;
+        }
+        std::istringstream success(response);
+        std::string prefix, id, token;
+        if (success >> prefix >> id >> token){
+            session_token = token; // a login with the password gives a new token
+        }
+        timeout = {0, 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        {
+            std::lock_guard<std::mutex> lock(send_mutex);
+            close(server_socket.exchange(sock));
+        }
+        last_received_time = get_steady_time_ms();
+        last_sent_time = 0; // a heartbeat turns them on at the new session
+        try {
+            send_compression_request(client_id); // before the resume : the messages sent again may be compressed
+            send_resume(client_id);
+        }
+        catch (const std::exception& e){
+            continue;
+        }
+        reconnecting = false;
+        std::cout << "Connection restored, resuming the session after message " << last_seen_sequence << "...\n";
+        return true;
+    }
+    reconnecting = false;
+    return false;
 }
 
-// function that monitors the server and exits if it stops
-void monitor_server()
+// function that sends the heartbeats of the session, the connection is closed (and restored by the receiver) if the server stops sending anything
+void monitor_server(Heartbeat_Policy policy)
 {
     while (is_running){
-        if (!is_server_running()){
-            std::cout << "\nServer is not running. Exiting...\n";
-            is_running = false;
-            exit(0); // terminate the client process immediately
+        int64_t now = get_steady_time_ms();
+        if (!reconnecting){
+            if (now - last_received_time > policy.timeout){
+                std::cout << "\nServer is not responding. Reconnecting...\n";
+                last_received_time = now;
+                shutdown(server_socket, SHUT_RDWR); // wakes the receiver up
+            }
+            else if (now - last_sent_time >= policy.interval){
+                try {
+                    send_to_server(HEARTBEAT_MESSAGE);
+                }
+                catch (const std::exception& e){
+                    // the receiver sees the connection closed
+                }
+            }
         }
-        std::this_thread::sleep_for(std::chrono::seconds(1)); // check every second
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(policy.interval, 100)));
+    }
+}
+
+// function that receives the responses of the server, tagged with the correlation id of their request, while the next requests are sent
+// (a lost connection is restored, the server sends again the messages after the last sequence read)
+void receive_responses(Frame_Buffer& buffer, const struct sockaddr_in& address, const std::string& authentification, const ID& client_id, const Heartbeat_Policy& policy)
+{
+    std::string response;
+    while (is_running){
+        if (!receive_message(server_socket, buffer, response)){
+            if (!is_running){
+                break;
+            }
+            std::cout << "Connexion lost, reconnecting...\n";
+            if (!reconnect(address, authentification, client_id, buffer, policy)){
+                std::cout << "Server is not available. Exiting...\n";
+                is_running = false;
+                exit(0); // terminate the client process immediately
+            }
+            continue;
+        }
+        last_received_time = get_steady_time_ms();
+        if (response == HEARTBEAT_MESSAGE){
+            continue;
+        }
+        uint64_t sequence = 0;
+        size_t end = response.find(' ');
+        if (!response.empty() && response.front() == SEQUENCE_PREFIX && end != std::string::npos){
+            sequence = std::strtoull(response.c_str() + 1, nullptr, 10);
+            response.erase(0, end + 1);
+        }
+        std::string request;
+        uint64_t correlation_id = 0;
+        end = response.find(' ');
+        if (!response.empty() && response.front() == '#' && end != std::string::npos){
+            correlation_id = std::strtoull(response.c_str() + 1, nullptr, 10);
+            response.erase(0, end + 1);
+            std::lock_guard<std::mutex> lock(requests_mutex);
+            auto request_iterator = requests_in_flight.find(correlation_id);
+            if (request_iterator != requests_in_flight.end()){
+                request = std::move(request_iterator->second);
+                requests_in_flight.erase(request_iterator);
+            }
+        }
+        if (sequence > 0){
+            if (sequence <= last_seen_sequence && request != RESUME_REQUEST){
+                continue; // already read before the connection was lost
+            }
+            last_seen_sequence = sequence; // the answer of a resume sets it (the sequences restart if the server lost the journal)
+        }
+        if (response.rfind(COMPRESSION_PREFIX, 0) == 0){
+            std::string inflated;
+            if (!inflate_message(std::string_view(response).substr(sizeof(COMPRESSION_PREFIX) - 1), inflated)){
+                std::cerr << "Error: A compressed response from the server is corrupted\n";
+                continue;
+            }
+            response = std::move(inflated);
+        }
+        if (response.rfind(VIEW_VERSION_PREFIX, 0) == 0){
+            end = response.find(' ', sizeof(VIEW_VERSION_PREFIX) - 1);
+            uint64_t version = std::strtoull(response.c_str() + sizeof(VIEW_VERSION_PREFIX) - 1, nullptr, 10);
+            response.erase(0, end == std::string::npos ? response.size() : end + 1);
+            std::lock_guard<std::mutex> lock(views_mutex);
+            displayed_views[request] = {version, response};
+        }
+        else if (response.rfind(NOT_MODIFIED_PREFIX, 0) == 0){
+            uint64_t version = std::strtoull(response.c_str() + sizeof(NOT_MODIFIED_PREFIX) - 1, nullptr, 10);
+            std::lock_guard<std::mutex> lock(views_mutex);
+            auto view = displayed_views.find(request);
+            if (view != displayed_views.end() && view->second.first == version){
+                response = view->second.second + " (not modified)";
+            }
+        }
+        std::cout << "Server [" << request << "] : " << response << std::endl;
     }
 }
 
 
 int main(int argc, char* argv[])
 {
-    std::cout << "Client launched...\n";
-    std::thread server_monitor(monitor_server);
-    // wait for the server to be available
-    while (!is_server_running()){
-        std::cout << "Waiting for the server...\n";
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+    if (argc < 3){
+        std::cerr << "Usage: " << argv[0] << " <client_name> <password> [heartbeat_interval] [heartbeat_timeout]\n";
+        return EXIT_FAILURE;
     }
+    Heartbeat_Policy heartbeat_policy; // milliseconds
+    heartbeat_policy.interval = std::max(argc >= 4 ? std::stoi(argv[3]) : HEARTBEAT_INTERVAL, 1);
+    heartbeat_policy.timeout = std::max(argc >= 5 ? std::stoi(argv[4]) : HEARTBEAT_TIMEOUT, heartbeat_policy.interval);
+    std::cout << "Client launched...\n";
  
     int sock;
     struct sockaddr_in serv_addr;
-    char buffer[BUFFER_SIZE];
-    // socket creation
-    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0){
-        perror("Error socket creation");
-        exit(EXIT_FAILURE);
-    }
+    Frame_Buffer buffer; // the responses are read frame by frame, a large one is not truncated
     serv_addr.sin_family = AF_INET;
     serv_addr.sin_port = htons(PORT);
     // IP address conversion
@@ -86,34 +279,41 @@ int main(int argc, char* argv[])
         perror("Unvalid IP address");
         exit(EXIT_FAILURE);
     }
-    // server connection
-    if (connect(sock, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0){
-        perror("Error connection");
-        exit(EXIT_FAILURE);
+    // server connection (wait for the server to be available)
+    while ((sock = open_connection(serv_addr)) < 0){
+        if (errno != ECONNREFUSED){
+            perror("Error connection");
+            exit(EXIT_FAILURE);
+        }
+        std::cout << "Waiting for the server...\n";
+        std::this_thread::sleep_for(std::chrono::seconds(1));
     }
+    server_socket = sock;
 
     ID client_id = -1;
     // ask the server wether the client is already registered
-    std::string message = "Authentification Request: " + std::string(argv[1]) + " " + std::string(argv[2]);
-    send(sock, message.c_str(), message.length(), 0);
-    memset(buffer, 0, BUFFER_SIZE);
-    int valread = read(sock, buffer, BUFFER_SIZE);
-    if (valread <= 0){
+    const std::string authentification = "Authentification Request: " + std::string(argv[1]) + " " + std::string(argv[2]);
+    std::string message;
+    std::string response;
+    try {
+        send_message(sock, authentification);
+    }
+    catch (const std::exception& e){
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!receive_message(sock, buffer, response)){
         std::cout << "Connection closed by the server.\n";
         return EXIT_FAILURE;
     }
 
     // getting the response from the server
-    if (argc < 3){
-        std::cerr << "Usage: " << argv[0] << "<client_name> <password>\n";
-        return EXIT_FAILURE;
-    }
-    std::string response(buffer);
     std::cout << "Serveur authentification response: " << response << std::endl;
     const std::string authentification_prefix = "AUTHENTIFICATION_SUCCESS";
     // Check if the message starts with the expected prefix
     if (response.rfind(authentification_prefix, 0) == 0){
-        client_id = std::stoi(response.substr(authentification_prefix.size()));
+        std::istringstream success(response.substr(authentification_prefix.size()));
+        success >> client_id >> session_token;
     }
     else if (response == "AUTHENTIFICATION_FAILURE_INPUT"){
         std::cerr << "Error: Invalid input\n";
@@ -127,9 +327,22 @@ int main(int argc, char* argv[])
         std::cerr << "Error: Incorrect password\n";
         return EXIT_FAILURE;
     }
+    else if (response == "AUTHENTIFICATION_FAILURE_BUSY"){
+        std::cerr << "Error: The server is busy, try again later\n";
+        return EXIT_FAILURE;
+    }
     std::cout << "Connected to the server !\n";
     std::string connection_message = std::to_string(client_id) + " CLIENT_CONNECTED";
-    send(sock, connection_message.c_str(), connection_message.length(), 0);
+    send_to_server(connection_message);
+    send_compression_request(client_id);
+    send_resume(client_id); // the messages of the session are sequenced, the ones missed during a reconnection are sent again
+
+    // the responses are received by another thread : a request is sent without waiting for the response of the previous ones
+    last_received_time = get_steady_time_ms();
+    std::thread receiver(receive_responses, std::ref(buffer), std::cref(serv_addr), std::cref(authentification), client_id, std::cref(heartbeat_policy));
+    // heartbeats on the connection in both directions (the first one turns them on at the server), a silent server makes the client reconnect
+    last_sent_time = 0;
+    std::thread server_monitor(monitor_server, heartbeat_policy);
 
     while (is_running){
         std::cout << "Enter one of the following commands:\n"
@@ -151,12 +364,14 @@ int main(int argc, char* argv[])
                 << "   exit\n"
                 << "\n";
 
-        std::string message;
-        std::getline(std::cin, message);
-        message = std::to_string(client_id) + " " + message;
+        std::string command;
+        if (!std::getline(std::cin, command)){
+            is_running = false;
+            break;
+        }
 
         // exit conditions
-        if (message == std::to_string(client_id) + " exit"){
+        if (command == "exit"){
             is_running = false;
             std::cout << "Exiting from user command...\n";
             break;
@@ -166,20 +381,33 @@ int main(int argc, char* argv[])
             break;
         }
 
-        // send request to the server
-        send(sock, message.c_str(), message.length(), 0);
-
-        // receive response from the server
-        memset(buffer, 0, BUFFER_SIZE);
-        int valread = read(sock, buffer, BUFFER_SIZE);
-        if (valread <= 0){
-            std::cout << "Connexion closed by the server.\n";
-            break;
+        // send request to the server, tagged with a new correlation id
+        uint64_t correlation_id = next_correlation_id++;
+        {
+            std::lock_guard<std::mutex> lock(requests_mutex);
+            requests_in_flight[correlation_id] = command;
+        }
+        message = "#" + std::to_string(correlation_id) + " " + std::to_string(client_id) + " " + command;
+        if (command.rfind(DISPLAY_REQUEST, 0) == 0){ // the server answers NOT_MODIFIED if the view has not changed since it was displayed
+            std::lock_guard<std::mutex> lock(views_mutex);
+            auto view = displayed_views.find(command);
+            message += std::string(" ") + VIEW_VERSION_KEYWORD + " " + std::to_string(view != displayed_views.end() ? view->second.first : 0);
+        }
+        try {
+            send_to_server(message);
+        }
+        catch (const std::exception& e){
+            std::lock_guard<std::mutex> lock(requests_mutex);
+            requests_in_flight.erase(correlation_id);
+            std::cout << "Request not sent, the connection to the server is being restored.\n";
         }
-        std::cout << "Server : " << buffer << std::endl;
     }
 
-    close(sock);
+    is_running = false;
+    shutdown(server_socket, SHUT_RDWR); // wakes the receiver up
+    receiver.join();
+    server_monitor.join();
+    close(server_socket);
     return 0;
 }
 
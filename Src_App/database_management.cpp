@@ -1,6 +1,58 @@
 #include "database_management.hpp"
 
 
+// forward-only cursor over the rows of a query
+// constructor
+SQL_Cursor::SQL_Cursor(sqlite3* database, const std::string& query) : Statement(nullptr)
+{
+    if (sqlite3_prepare_v2(database, query.c_str(), -1, &Statement, nullptr) != SQLITE_OK){
+        std::cerr << "Error preparing SQL: " << sqlite3_errmsg(database) << std::endl;
+        sqlite3_finalize(Statement);
+        Statement = nullptr;
+    }
+}
+
+// destructor
+SQL_Cursor::~SQL_Cursor()
+{
+    sqlite3_finalize(Statement);
+}
+
+// move constructor
+SQL_Cursor::SQL_Cursor(SQL_Cursor&& other) noexcept : Statement(other.Statement)
+{
+    other.Statement = nullptr;
+}
+
+// go to the next row, false when there is no more row
+bool SQL_Cursor::next()
+{
+    return Statement != nullptr && sqlite3_step(Statement) == SQLITE_ROW;
+}
+
+int SQL_Cursor::get_column_count() const
+{
+    return sqlite3_column_count(Statement);
+}
+
+// values of the current row
+std::string SQL_Cursor::get_string(const int& column) const
+{
+    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(Statement, column));
+    return text ? text : ""; // handle NULL values
+}
+
+int64_t SQL_Cursor::get_int64(const int& column) const
+{
+    return sqlite3_column_int64(Statement, column);
+}
+
+double SQL_Cursor::get_double(const int& column) const
+{
+    return sqlite3_column_double(Statement, column);
+}
+
+
 // constructor
 Database_Manager::Database_Manager(const std::string& database_name)
 {
@@ -73,7 +125,7 @@ ID Database_Manager::execute_SQL_query_ID(const std::string& sql)
 
     if (sqlite3_prepare_v2(Database, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
         if (sqlite3_step(stmt) == SQLITE_ROW) {
-            result = sqlite3_column_int(stmt, 0);  // get the first column value
+            result = sqlite3_column_int64(stmt, 0);  // get the first column value
         }
     }
     sqlite3_finalize(stmt);
@@ -219,6 +271,12 @@ std::vector<std::vector<std::string>> Database_Manager::execute_SQL_query_vec_st
     return results;
 }
 
+// get a cursor to read the rows of a large result one by one
+SQL_Cursor Database_Manager::open_cursor(const std::string& query)
+{
+    return SQL_Cursor(Database, query);
+}
+
 // get a blob result from the database
 std::vector<unsigned char> Database_Manager::execute_SQL_query_blob(const std::string& query)
 {
@@ -348,13 +406,16 @@ void Database_Manager::create_tables()
 
     // SQL query to create the "encryption_keys" table
     std::string create_encryption_keys_table = R"(
-        CREATE TABLE encryption_keys (
+        CREATE TABLE IF NOT EXISTS encryption_keys (
             id INT AUTO_INCREMENT PRIMARY KEY,
             key BLOB,
             iv BLOB
         );
     )";
     execute_SQL(create_encryption_keys_table);
+
+    // the tables above are the base schema (version 0), the later changes are brought by the migrations
+    migrate_schema();
 }
 
 // reset all the datas in the database to have a clear market
@@ -368,64 +429,53 @@ void Database_Manager::reset_database()
     execute_SQL("DROP TABLE IF EXISTS client_portfolio;");
     execute_SQL("DROP TABLE IF EXISTS messages;");
     execute_SQL("DROP TABLE IF EXISTS encryption_keys;");
+    execute_SQL("DROP TABLE IF EXISTS bars;");
+    execute_SQL("PRAGMA user_version = 0;"); // the migrations must be applied again on the new tables
 
     // create tables
     create_tables();
 }
 
 // reset the prices in the database to the actions of the market and the client's portfolio, to the last price and the given time
-void Database_Manager::reset_database_action_prices(const ID& reset_daily_time, const ID& reset_date_time)
+void Database_Manager::reset_database_action_prices(const ID& reset_time)
+{
+    // Step 1: Delete all but the most recent price for each action_id
+    keep_last_prices();
+
+    // Step 2: update the remaining prices with the given reset_time
+    std::string update_prices_query = fmt::format(
+        "UPDATE prices SET time = {}",
+        reset_time
+    );
+    execute_SQL(update_prices_query);
+}
+
+// delete all but the last price of each action (the history is in the tick store, imported before)
+void Database_Manager::keep_last_prices()
 {
-   // Step 1: Delete all but the most recent price for each action_id based on both date_time and daily_time
-   std::string delete_old_prices_query = R"(
+    // a row goes if a later one of its action exists (an action without any price leaves the others untouched), or if its action is gone
+    std::string delete_old_prices_query = R"(
         DELETE FROM prices
-        WHERE price_id NOT IN (
-            SELECT price_id FROM (
-                SELECT price_id
-                FROM prices p
-                WHERE (p.action_id, p.date_time, p.daily_time) IN (
-                    SELECT p2.date_time, p2.daily_time
-                    FROM prices p2
-                    WHERE p2.action_id = p.action_id
-                    AND p2.date_time = (
-                        SELECT MAX(date_time)
-                        FROM prices
-                        WHERE action_id = p2.action_id
-                    )
-                    AND p2.daily_time = (
-                        SELECT MAX(daily_time)
-                        FROM prices
-                        WHERE action_id = p2.action_id
-                        AND date_time = p2.date_time
-                    )
-                )
-            )
+        WHERE action_id NOT IN (SELECT action_id FROM actions)
+           OR EXISTS (
+            SELECT 1 FROM prices p2
+            WHERE p2.action_id = prices.action_id
+              AND (p2.time > prices.time OR (p2.time = prices.time AND p2.price_id > prices.price_id))
         );
     )";
     execute_SQL(delete_old_prices_query);
+}
 
-    // Step 2: update the remaining prices with the given reset_time
-    std::string update_prices_query = 
-        "UPDATE prices "
-        "SET daily_time = " + std::to_string(reset_daily_time) + ", "
-        "date_time = " + std::to_string(reset_date_time) + " "
-        "WHERE (date_time, daily_time) = ("
-            "SELECT p2.date_time, p2.daily_time "
-            "FROM prices p2 "
-            "WHERE p2.action_id = prices.action_id "
-            "AND p2.date_time = ("
-                "SELECT MAX(date_time) "
-                "FROM prices "
-                "WHERE action_id = p2.action_id "
-            ") "
-            "AND p2.daily_time = ("
-                "SELECT MAX(daily_time) "
-                "FROM prices "
-                "WHERE action_id = p2.action_id "
-                "AND date_time = p2.date_time "
-            ") "
-        ");";
-    execute_SQL(update_prices_query);
+// replace the last price of an action : the row of the action is reused, so the table keeps one row per action
+void Database_Manager::set_last_price(const ID& action_id, const double& price, const ID& time)
+{
+    std::string query = fmt::format(
+        "INSERT OR REPLACE INTO prices (price_id, action_id, price, time) VALUES ((SELECT price_id FROM prices WHERE action_id = {0}), {0}, {1}, {2})",
+        action_id,
+        price,
+        time
+    );
+    execute_SQL(query);
 }
 
 // function to reset the log of the messages
@@ -443,7 +493,239 @@ void Database_Manager::reset_database_messages()
             time INTEGER NOT NULL,
             FOREIGN KEY (client_id) REFERENCES clients(client_id)
         );
+        CREATE INDEX IF NOT EXISTS messages_time_index ON messages(time);
     )";
     execute_SQL(create_messages_table);
 }
 
+
+
+// schema versioning
+// a migration brings the schema from version - 1 to version, it is never modified once released (add a new one instead)
+struct Schema_Migration
+{
+    int version;
+    std::string description;
+    std::string sql;
+};
+
+// SQL expression converting a legacy date_time/daily_time pair of columns to milliseconds since Unix epoch (used by the migration 2)
+// the old date is a local day number (year since 1900)*12*31 + (month from 0)*31 + day, and the daily time the milliseconds since local midnight
+// the day is added to the first of the month so that the 31st (encoded as day 0 of the next month) is converted too
+// the prices inserted by Market::add_action had the two columns swapped, so they are tried the other way round if the date is not valid
+static std::string legacy_time_to_ms(const std::string& date_column, const std::string& daily_column)
+{
+    auto conversion = [](const std::string& date, const std::string& daily){
+        return fmt::format(
+            "CAST(strftime('%s', printf('%04d-%02d-01', {0} / 372 + 1900, ({0} % 372) / 31 + 1), (({0} % 31) - 1) || ' days', 'utc') AS INTEGER) * 1000 + {1}",
+            date,
+            daily
+        );
+    };
+    return fmt::format(
+        "COALESCE({}, {}, 0)",
+        conversion(date_column, daily_column),
+        conversion(daily_column, date_column)
+    );
+}
+
+static const std::vector<Schema_Migration> schema_migrations = {
+    {
+        1,
+        "indexes for the hot queries (orders of a client, last price of an action, client login)",
+        R"(
+            CREATE INDEX IF NOT EXISTS orders_client_status_index ON orders(client_id, order_status);
+            CREATE INDEX IF NOT EXISTS orders_status_type_index ON orders(order_status, order_type);
+            CREATE INDEX IF NOT EXISTS prices_action_time_index ON prices(action_id, date_time, daily_time);
+            CREATE INDEX IF NOT EXISTS clients_name_index ON clients(name);
+        )"
+    },
+    {
+        2,
+        "single time column (milliseconds since Unix epoch) instead of the date_time/daily_time pairs",
+        fmt::format(
+        R"(
+            CREATE TABLE prices_migrated (
+                price_id INTEGER PRIMARY KEY,
+                action_id INTEGER NOT NULL,
+                price REAL NOT NULL,
+                time INTEGER NOT NULL,
+                FOREIGN KEY (action_id) REFERENCES actions(action_id)
+            );
+            INSERT INTO prices_migrated (price_id, action_id, price, time)
+            SELECT price_id, action_id, price,
+                {prices_time}
+            FROM prices;
+            DROP TABLE prices;
+            ALTER TABLE prices_migrated RENAME TO prices;
+            CREATE INDEX prices_action_time_index ON prices(action_id, time);
+
+            CREATE TABLE orders_migrated (
+                order_id INTEGER PRIMARY KEY,
+                order_status TEXT NOT NULL,                -- PENDING or COMPLETED
+                order_time INTEGER NOT NULL,               -- milliseconds since Unix epoch
+                client_id INTEGER NOT NULL,
+                order_type TEXT NOT NULL,                  -- BUY or SELL
+                quantity INTEGER NOT NULL,
+                action_id INTEGER NOT NULL,
+                trigger_type TEXT NOT NULL,                -- MARKET or LIMIT or STOP or LIMIT_STOP
+                price REAL NOT NULL,                       -- depends on the trigger type
+                trigger_price_lower REAL NOT NULL,         -- depends on the trigger type
+                trigger_price_upper REAL NOT NULL,         -- depends on the trigger type
+                expiration_time INTEGER NOT NULL,          -- INT64_MAX=no_expiration_time if no expiration
+                FOREIGN KEY (client_id) REFERENCES clients(client_id),
+                FOREIGN KEY (action_id) REFERENCES actions(action_id)
+            );
+            INSERT INTO orders_migrated (order_id, order_status, order_time, client_id, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time)
+            SELECT order_id, order_status,
+                {order_time},
+                client_id, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper,
+                CASE WHEN expiration_time_date = 65535 THEN 9223372036854775807 ELSE {expiration_time} END
+            FROM orders;
+            DROP TABLE orders;
+            ALTER TABLE orders_migrated RENAME TO orders;
+            CREATE INDEX orders_client_status_index ON orders(client_id, order_status);
+            CREATE INDEX orders_status_type_index ON orders(order_status, order_type);
+
+            CREATE TABLE messages_migrated (
+                message_id INTEGER PRIMARY KEY,
+                client_id INTEGER NOT NULL,
+                message_sender TEXT NOT NULL,
+                message_type TEXT NOT NULL,
+                content TEXT NOT NULL,
+                time INTEGER NOT NULL,                     -- milliseconds since Unix epoch
+                FOREIGN KEY (client_id) REFERENCES clients(client_id)
+            );
+            INSERT INTO messages_migrated (message_id, client_id, message_sender, message_type, content, time)
+            SELECT message_id, client_id, message_sender, message_type, content,
+                {messages_time}
+            FROM messages;
+            DROP TABLE messages;
+            ALTER TABLE messages_migrated RENAME TO messages;
+            CREATE INDEX messages_time_index ON messages(time);
+        )",
+            fmt::arg("prices_time", legacy_time_to_ms("date_time", "daily_time")),
+            fmt::arg("order_time", legacy_time_to_ms("order_time_date", "order_time_daily")),
+            fmt::arg("expiration_time", legacy_time_to_ms("expiration_time_date", "expiration_time_daily")),
+            fmt::arg("messages_time", legacy_time_to_ms("date_time", "daily_time"))
+        )
+    },
+    {
+        3,
+        "OHLCV bars of the actions (1 s, 1 min, 5 min, 1 day), written when a bar closes",
+        R"(
+            CREATE TABLE IF NOT EXISTS bars (
+                action_id INTEGER NOT NULL,
+                resolution INTEGER NOT NULL,               -- length of the bar in milliseconds
+                open_time INTEGER NOT NULL,                -- milliseconds since Unix epoch, multiple of the resolution
+                open REAL NOT NULL,
+                high REAL NOT NULL,
+                low REAL NOT NULL,
+                close REAL NOT NULL,
+                volume INTEGER NOT NULL,
+                turnover REAL NOT NULL,                    -- sum of price * quantity, for the VWAP
+                PRIMARY KEY (action_id, resolution, open_time)
+            ) WITHOUT ROWID;
+        )"
+    },
+    {
+        4,
+        "salted password hashes (PBKDF2), the AES passwords are replaced at the next login of each client",
+        R"(
+            ALTER TABLE clients ADD COLUMN password_salt BLOB;
+            ALTER TABLE clients ADD COLUMN password_hash BLOB;
+            ALTER TABLE clients ADD COLUMN password_iterations INTEGER NOT NULL DEFAULT 0;  -- 0 : the password is still the AES one
+        )"
+    }
+};
+
+// get the version of the schema stored in the database (PRAGMA user_version)
+int Database_Manager::get_schema_version()
+{
+    return execute_SQL_query_int("PRAGMA user_version;");
+}
+
+// apply, in order, the migrations that the database has not seen yet
+void Database_Manager::migrate_schema()
+{
+    int current_version = get_schema_version();
+    for (const auto& migration : schema_migrations){
+        if (migration.version <= current_version){
+            continue; // already applied
+        }
+        // each migration is applied in its own transaction, with the version bump, so that a failure leaves the database untouched
+        std::string sql = fmt::format(
+            "BEGIN; {} PRAGMA user_version = {}; COMMIT;",
+            migration.sql,
+            migration.version
+        );
+        char* error_message = nullptr;
+        if (sqlite3_exec(Database, sql.c_str(), nullptr, nullptr, &error_message) != SQLITE_OK){
+            std::string error = fmt::format(
+                "Error applying schema migration {} ({}): {}",
+                migration.version,
+                migration.description,
+                error_message ? error_message : "unknown error"
+            );
+            sqlite3_free(error_message);
+            sqlite3_exec(Database, "ROLLBACK;", nullptr, nullptr, nullptr);
+            throw std::runtime_error(error);
+        }
+        std::cout << "Schema migrated to version " << migration.version << ": " << migration.description << std::endl;
+        current_version = migration.version;
+    }
+}
+
+
+// query plans
+// get the steps of the plan chosen by SQLite for a query (EXPLAIN QUERY PLAN)
+std::vector<std::string> Database_Manager::get_query_plan(const std::string& query)
+{
+    std::vector<std::string> steps;
+    for (const auto& row : execute_SQL_query_vec_strings("EXPLAIN QUERY PLAN " + query)){
+        if (row.size() >= 4){
+            steps.push_back(row[3]); // the detail column : "SEARCH orders USING INDEX ...", "SCAN prices", ...
+        }
+    }
+    return steps;
+}
+
+// the hot queries of the market, with representative values (the same query texts as the classes running them)
+static const std::vector<std::pair<std::string, std::string>> hot_queries = {
+    {"orders of a client by status", fmt::format(sql_orders_of_client, 1, "COMPLETED")},
+    {"pending orders of the market by side", fmt::format(sql_pending_orders_of_side, "BUY")},
+    {"last price of an action", fmt::format(sql_last_price, 1)},
+    {"bars of an action in a time range", fmt::format(sql_bars_in_range, 1, 60000, 0, 1000)},
+    {"available balance of a client", fmt::format(sql_available_balance, safety_percentage, 1)},
+    {"price levels of the book", std::string(sql_book_levels)},
+    {"client login", std::string(sql_client_credentials)},
+    {"portfolio of a client", fmt::format(sql_client_portfolio, 1)}
+};
+
+// check that the hot queries are served by an index, returns the number of queries falling back to a full scan
+int Database_Manager::check_hot_query_plans()
+{
+    int full_scans = 0;
+    for (const auto& [name, query] : hot_queries){
+        bool is_full_scan = false;
+        std::vector<std::string> steps = get_query_plan(query);
+        for (const auto& step : steps){
+            // "SCAN <table>" is a full scan (even "USING INDEX", it reads the whole index), 
+            // but scanning a constant row or a materialized subquery is not
+            if (step.rfind("SCAN", 0) == 0 && step.find("CONSTANT ROW") == std::string::npos && step.find("(subquery") == std::string::npos){
+                is_full_scan = true;
+            }
+        }
+        if (steps.empty()){
+            is_full_scan = true; // the query could not be planned (missing table, ...)
+        }
+        std::cout << (is_full_scan ? "[FULL SCAN] " : "[OK] ") << name << "\n";
+        for (const auto& step : steps){
+            std::cout << "    " << step << "\n";
+        }
+        if (is_full_scan){
+            full_scans++;
+        }
+    }
+    return full_scans;
+}
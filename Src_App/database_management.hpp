@@ -6,6 +6,62 @@
 #include "utility.hpp"
 
 
+// the hot queries of the market (fmt placeholders), run by the classes and checked by check_hot_query_plans with representative values
+inline constexpr std::string_view sql_orders_of_client = R"(SELECT o.order_time, c.name, o.order_type, o.quantity, a.name, o.trigger_type, o.price, o.trigger_price_lower, o.trigger_price_upper, o.expiration_time
+    FROM orders o JOIN actions a ON o.action_id = a.action_id JOIN clients c ON o.client_id = c.client_id
+    WHERE o.client_id = {} AND o.order_status = '{}')"; // client_id, status
+inline constexpr std::string_view sql_pending_orders_of_side = R"(SELECT o.order_time, c.name, o.order_type, o.quantity, a.name, o.trigger_type, o.price, o.trigger_price_lower, o.trigger_price_upper, o.expiration_time
+    FROM orders o JOIN actions a ON o.action_id = a.action_id JOIN clients c ON o.client_id = c.client_id
+    WHERE o.order_type = '{}' AND o.order_status = 'PENDING')"; // order type
+inline constexpr std::string_view sql_last_price = "SELECT price FROM prices WHERE action_id = {} ORDER BY time DESC LIMIT 1"; // action_id
+inline constexpr std::string_view sql_bars_in_range = "SELECT open_time, open, high, low, close, volume, turnover FROM bars WHERE action_id = {} AND resolution = {} AND open_time BETWEEN {} AND {} ORDER BY open_time ASC"; // action_id, resolution, from, to
+// (a market order is valued at the last price with the safety margin)
+inline constexpr std::string_view sql_available_balance = R"(SELECT c.balance - COALESCE((
+        SELECT SUM(o.quantity * 
+            CASE 
+                WHEN o.order_type = 'MARKET' THEN (
+                    SELECT p.price * {}
+                    FROM prices p
+                    WHERE p.action_id = o.action_id
+                    ORDER BY p.time DESC LIMIT 1
+                )
+                ELSE o.price
+            END
+        )
+        FROM orders o
+        WHERE o.client_id = c.client_id AND o.order_status = 'PENDING'
+    ), 0)
+    FROM clients c
+    WHERE c.client_id = {})"; // safety margin, client_id
+inline constexpr std::string_view sql_book_levels = "SELECT action_id, order_type, price, SUM(quantity) FROM orders WHERE order_status = 'PENDING' GROUP BY action_id, order_type, price";
+inline constexpr std::string_view sql_client_credentials = "SELECT client_id, encrypted_password, password_salt, password_hash, password_iterations FROM clients WHERE name = ?"; // bound : name
+inline constexpr std::string_view sql_client_portfolio = "SELECT action_id, quantity FROM client_portfolio WHERE client_id = {} ORDER BY action_id ASC"; // client_id
+
+
+// forward-only cursor over the rows of a query, each row is read by sqlite3_step when asked (constant memory whatever the size of the result)
+class SQL_Cursor
+{
+private:
+    sqlite3_stmt* Statement;
+
+public:
+    // constructor
+    SQL_Cursor(sqlite3* database, const std::string& query); // prepare the query
+    // destructor
+    ~SQL_Cursor(); // finalize the query
+    SQL_Cursor(const SQL_Cursor&) = delete;
+    SQL_Cursor& operator=(const SQL_Cursor&) = delete;
+    SQL_Cursor(SQL_Cursor&& other) noexcept;
+
+    bool next(); // go to the next row, false when there is no more row
+    int get_column_count() const;
+    // values of the current row (valid until the next call to next)
+    std::string get_string(const int& column) const; // empty for NULL values
+    int64_t get_int64(const int& column) const;
+    double get_double(const int& column) const;
+};
+
+
 class Database_Manager
 {
 private:
@@ -35,12 +91,23 @@ public:
     std::vector<std::vector<std::string>> execute_SQL_query_vec_strings(const std::string& query); // get a vector of vectors of strings from the database
     std::vector<unsigned char> execute_SQL_query_blob(const std::string& sql); // get a blob result from the database
     std::vector<std::vector<unsigned char>> execute_SQL_query_blobs(const std::string& query); // get a vector of blobs from the database
+    SQL_Cursor open_cursor(const std::string& query); // get a cursor to read the rows of a large result one by one
 
     // database management
     void create_tables(); // create the tables in the databases
     void reset_database(); // reset all the datas in the database to have a clear market
-    void reset_database_action_prices(const ID& reset_daily_time, const ID& reset_date_time); // reset the prices in the database to the actions of the market and the client's portfolio, to the last price and the given time
+    void reset_database_action_prices(const ID& reset_time); // reset the prices in the database to the actions of the market and the client's portfolio, to the last price and the given time
+    void keep_last_prices(); // delete all but the last price of each action (the history is in the tick store)
+    void set_last_price(const ID& action_id, const double& price, const ID& time); // replace the last price of an action (one row per action)
     void reset_database_messages(); // function to reset the log of the messages
+
+    // schema versioning
+    int get_schema_version(); // get the version of the schema stored in the database (PRAGMA user_version)
+    void migrate_schema(); // apply, in order, the migrations that the database has not seen yet
+
+    // query plans
+    std::vector<std::string> get_query_plan(const std::string& query); // get the steps of the plan chosen by SQLite for a query (EXPLAIN QUERY PLAN)
+    int check_hot_query_plans(); // check that the hot queries are served by an index, returns the number of queries falling back to a full scan
 };
 
 
@@ -0,0 +1,220 @@
+#include "feed.hpp"
+
+
+// constructor
+Market_Feed::Market_Feed() : Last_Sequence(0), Phase(Market_Phase::CLOSE), Snapshot_Sequence(0), Log_Start(0)
+{
+    take_snapshot(get_current_time_ms()); // the empty market, for the subscribers arriving before the first publication
+}
+
+
+// give the next sequence to a message and log it framed (the mutex is held)
+template <typename Message>
+void Market_Feed::publish(Message message, const Feed_Key& key)
+{
+    message.sequence = ++Last_Sequence;
+    char buffer[sizeof(Message)];
+    encode_binary(message, buffer);
+    Feed_Message logged{key, ""};
+    append_message(logged.frame, buffer, sizeof(buffer));
+    Log.push_back(std::move(logged));
+}
+
+// signal the reactors that messages were published (the mutex is held)
+void Market_Feed::wake_subscribers()
+{
+    uint64_t one = 1;
+    for (const int& wake_file : Wake_Files){
+        if (write(wake_file, &one, sizeof(one)) < 0 && errno != EAGAIN){
+            perror("Error write (feed wake up)");
+        }
+    }
+}
+
+
+// publish the levels added, changed or deleted since the last publication
+void Market_Feed::publish_book(const Book_Levels& levels)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    uint64_t first_sequence = Last_Sequence + 1;
+    auto publish_level = [this](const Book_Levels::key_type& level, const int64_t& quantity, const Book_Update_Type& update){
+        Book_Update book_update{};
+        book_update.action_id = std::get<0>(level);
+        book_update.side = static_cast<uint8_t>(std::get<1>(level));
+        book_update.price = std::get<2>(level);
+        book_update.quantity = quantity;
+        book_update.update = static_cast<uint8_t>(update);
+        publish(book_update, Feed_Key{static_cast<uint8_t>(Binary_Kind::BOOK_UPDATE), book_update.action_id, book_update.side, book_update.price});
+    };
+    // both books are sorted the same way, they are merged
+    auto old_level = Levels.begin();
+    auto new_level = levels.begin();
+    while (old_level != Levels.end() || new_level != levels.end()){
+        if (new_level == levels.end() || (old_level != Levels.end() && old_level->first < new_level->first)){
+            publish_level(old_level->first, 0, Book_Update_Type::DELETE);
+            ++old_level;
+        }
+        else if (old_level == Levels.end() || new_level->first < old_level->first){
+            publish_level(new_level->first, new_level->second, Book_Update_Type::ADD);
+            ++new_level;
+        }
+        else {
+            if (old_level->second != new_level->second){
+                publish_level(new_level->first, new_level->second, Book_Update_Type::CHANGE);
+            }
+            ++old_level;
+            ++new_level;
+        }
+    }
+    Levels = levels;
+    if (Last_Sequence >= first_sequence){
+        wake_subscribers();
+    }
+}
+
+// publish a trade (the new last price of the action)
+void Market_Feed::publish_trade(const ID& action_id, const Time& time, const double& price, const int& quantity)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Market_Data market_data{};
+    market_data.action_id = action_id;
+    market_data.price = price;
+    market_data.time = time;
+    market_data.quantity = static_cast<uint32_t>(quantity);
+    publish(market_data, Feed_Key{static_cast<uint8_t>(Binary_Kind::MARKET_DATA), action_id, 0, 0.0});
+    Last_Prices[action_id] = {price, time, quantity};
+    wake_subscribers();
+}
+
+// publish a change of phase of the market session
+void Market_Feed::publish_phase(const Market_Phase& phase, const Time& time)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Phase_Change phase_change{};
+    phase_change.time = time;
+    phase_change.phase = static_cast<uint8_t>(phase);
+    publish(phase_change, Feed_Key{static_cast<uint8_t>(Binary_Kind::PHASE_CHANGE), 0, 0, 0.0});
+    Phase = phase;
+    wake_subscribers();
+}
+
+// last price known at startup (nothing is published)
+void Market_Feed::set_last_price(const ID& action_id, const Time& time, const double& price)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Last_Prices[action_id] = {price, time, 0};
+}
+
+// take a snapshot if messages were published since the last one, the older messages are dropped
+void Market_Feed::take_snapshot(const Time& time)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (!Snapshot.empty() && Snapshot_Sequence == Last_Sequence){
+        return;
+    }
+    std::vector<Snapshot_Entry> entries;
+    entries.reserve(Levels.size() + Last_Prices.size());
+    for (const auto& [level, quantity] : Levels){
+        entries.push_back(Snapshot_Entry{std::get<0>(level), std::get<2>(level), quantity, static_cast<uint8_t>(std::get<1>(level)), 0, 0, 0});
+    }
+    for (const auto& [action_id, last_price] : Last_Prices){
+        entries.push_back(Snapshot_Entry{action_id, std::get<0>(last_price), std::get<2>(last_price), SNAPSHOT_LAST_PRICE, 0, 0, 0});
+    }
+    Feed_Snapshot feed_snapshot{};
+    feed_snapshot.sequence = Last_Sequence;
+    feed_snapshot.time = time;
+    feed_snapshot.phase = static_cast<uint8_t>(Phase);
+    std::string message = encode_binary(feed_snapshot, entries);
+    Snapshot.clear();
+    append_message(Snapshot, message.data(), message.size());
+
+    // the messages before the previous snapshot are dropped : a subscriber still behind it gets the new snapshot
+    while (Log_Start < Snapshot_Sequence && !Log.empty()){
+        Log.pop_front();
+        Log_Start++;
+    }
+    Snapshot_Sequence = Last_Sequence;
+}
+
+
+// append the messages from next_sequence (0 or a dropped one : the snapshot first) to the output of a subscriber, conflated if it is far behind
+Feed_Delivery Market_Feed::deliver(const int& subscriber, uint64_t& next_sequence, std::string& output, const size_t& queued_bytes)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Feed_Subscriber& lag = Subscribers[subscriber];
+    lag.queued_bytes = queued_bytes;
+
+    // the output is bounded : a slow reader does not make it grow, its messages wait in the log
+    if (queued_bytes >= FEED_MAX_QUEUED_BYTES){
+        Time now = get_current_time_ms();
+        if (lag.lagging_since == 0){
+            lag.lagging_since = now;
+        }
+        if (now - lag.lagging_since > FEED_MAX_LAG_TIME){
+            Subscribers.erase(subscriber);
+            return Feed_Delivery::TOO_SLOW;
+        }
+        return Feed_Delivery::HELD_BACK;
+    }
+    lag.lagging_since = 0;
+
+    size_t output_size = output.size();
+    if (next_sequence == 0 || next_sequence <= Log_Start){
+        output += Snapshot;
+        next_sequence = Snapshot_Sequence + 1;
+    }
+    if (Last_Sequence + 1 - next_sequence > FEED_CONFLATION_BACKLOG){
+        // far behind : only the last message of each key, in the order of the log (a level deleted and added again keeps its last state)
+        std::map<Feed_Key, uint64_t> last_of_key;
+        for (uint64_t sequence = next_sequence; sequence <= Last_Sequence; sequence++){
+            last_of_key[Log[sequence - Log_Start - 1].key] = sequence;
+        }
+        std::vector<uint64_t> kept;
+        kept.reserve(last_of_key.size());
+        for (const auto& [key, sequence] : last_of_key){
+            kept.push_back(sequence);
+        }
+        std::sort(kept.begin(), kept.end());
+        for (const uint64_t& sequence : kept){
+            output += Log[sequence - Log_Start - 1].frame;
+        }
+        lag.conflated += Last_Sequence + 1 - next_sequence - kept.size();
+        next_sequence = Last_Sequence + 1;
+    }
+    for (; next_sequence <= Last_Sequence; next_sequence++){
+        output += Log[next_sequence - Log_Start - 1].frame;
+    }
+    lag.sequence = next_sequence - 1;
+    lag.queued_bytes = queued_bytes + output.size() - output_size;
+    return output.size() > output_size ? Feed_Delivery::DELIVERED : Feed_Delivery::NOTHING;
+}
+
+void Market_Feed::remove_subscriber(const int& subscriber)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Subscribers.erase(subscriber);
+}
+
+void Market_Feed::add_wake_file(const int& wake_file)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Wake_Files.insert(wake_file);
+}
+
+void Market_Feed::remove_wake_file(const int& wake_file)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Wake_Files.erase(wake_file);
+}
+
+// get the lag of the subscribers as a string : socket sequence lag queued_bytes conflated lagging_ms,...
+std::string Market_Feed::get_subscribers_info() const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    std::string info;
+    Time now = get_current_time_ms();
+    for (const auto& [subscriber, lag] : Subscribers){
+        info += fmt::format("{} {} {} {} {} {},", subscriber, lag.sequence, Last_Sequence - lag.sequence, lag.queued_bytes, lag.conflated, lag.lagging_since == 0 ? 0 : now - lag.lagging_since);
+    }
+    return info;
+}
@@ -0,0 +1,94 @@
+//==========================================================================
+// File that defines the market data feed : sequenced updates published once by the engine and delivered to every subscribed session
+//==========================================================================
+#ifndef FEED_HPP
+#define FEED_HPP
+#include "database_management.hpp"
+
+
+#include <deque>
+#include "order.hpp"
+#include "protocol.hpp"
+
+
+#define FEED_PUBLISH_INTERVAL 50 // milliseconds between two publications of the changes of the book
+#define FEED_SNAPSHOT_INTERVAL 1000 // milliseconds between two snapshots (late joiners, gap recovery)
+#define FEED_MAX_QUEUED_BYTES (256 * 1024) // output not written yet above which a subscriber receives nothing more (it is lagging)
+#define FEED_CONFLATION_BACKLOG 64 // messages behind above which only the newest state of each level, trade and phase is delivered
+#define FEED_MAX_LAG_TIME 5000 // milliseconds a subscriber may stay lagging before it is disconnected
+
+
+// the book by price level : the quantity pending for (action id, side, price)
+using Book_Levels = std::map<std::tuple<ID, Order_Type, double>, int64_t>;
+
+// kind, action id, side and price of a message : a lagging subscriber only receives the last message of each key
+using Feed_Key = std::tuple<uint8_t, ID, uint8_t, double>;
+
+// a message of the feed, framed
+struct Feed_Message
+{
+    Feed_Key key;
+    std::string frame;
+};
+
+// what a delivery did to a subscriber
+enum class Feed_Delivery
+{
+    NOTHING, // no message to deliver
+    DELIVERED,
+    HELD_BACK, // too much output queued, the messages wait (conflated) until it is written
+    TOO_SLOW // lagging for more than FEED_MAX_LAG_TIME, the subscriber must be disconnected
+};
+
+// lag of a subscriber, for the operations
+struct Feed_Subscriber
+{
+    uint64_t sequence; // last message delivered
+    size_t queued_bytes; // output not written yet
+    uint64_t conflated; // messages replaced by a newer one of the same key
+    Time lagging_since; // 0 if the subscriber is not held back
+};
+
+// the messages are encoded and framed once, when they are published, and copied as they are in the output of the subscribed sessions
+class Market_Feed
+{
+private:
+    mutable std::mutex Mutex;
+    uint64_t Last_Sequence; // sequence of the last message published
+    Book_Levels Levels; // the book as last published
+    std::map<ID, std::tuple<double, Time, int64_t>> Last_Prices; // price, time and quantity of the last trade of each action
+    Market_Phase Phase;
+    std::string Snapshot; // framed FeedSnapshot, the state after the message of Snapshot_Sequence
+    uint64_t Snapshot_Sequence;
+    std::deque<Feed_Message> Log; // messages published after Log_Start (at least all those after the snapshot)
+    uint64_t Log_Start;
+    std::set<int> Wake_Files; // eventfd of the reactors delivering the feed, written when messages are published
+    std::map<int, Feed_Subscriber> Subscribers; // by socket
+
+    template <typename Message>
+    void publish(Message message, const Feed_Key& key); // give the next sequence to a message and log it framed (the mutex is held)
+    void wake_subscribers(); // signal the reactors that messages were published (the mutex is held)
+
+public:
+    // constructor
+    Market_Feed();
+    Market_Feed(const Market_Feed&) = delete;
+    Market_Feed& operator=(const Market_Feed&) = delete;
+
+    // publication, by the engine
+    void publish_book(const Book_Levels& levels); // publish the levels added, changed or deleted since the last publication
+    void publish_trade(const ID& action_id, const Time& time, const double& price, const int& quantity); // publish a trade (the new last price of the action)
+    void publish_phase(const Market_Phase& phase, const Time& time); // publish a change of phase of the market session
+    void set_last_price(const ID& action_id, const Time& time, const double& price); // last price known at startup (nothing is published)
+    void take_snapshot(const Time& time); // take a snapshot if messages were published since the last one, the older messages are dropped
+
+    // delivery, by the reactors
+    Feed_Delivery deliver(const int& subscriber, uint64_t& next_sequence, std::string& output, const size_t& queued_bytes); // append the messages from next_sequence (0 or a dropped one : the snapshot first) to the output of a subscriber, conflated if it is far behind
+    void remove_subscriber(const int& subscriber);
+    void add_wake_file(const int& wake_file);
+    void remove_wake_file(const int& wake_file);
+    std::string get_subscribers_info() const; // get the lag of the subscribers as a string : socket sequence lag queued_bytes conflated lagging_ms,...
+};
+
+
+#endif // FEED_HPP
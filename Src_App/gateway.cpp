@@ -0,0 +1,1968 @@
+#include "gateway.hpp"
+
+
+// the responses computed by other threads for a session, until its transport sends them
+// constructor
+Session_Mailbox::Session_Mailbox(const int& wake_file) : Queued_Size(0), Pending(0), Wake_File(wake_file), Detached(false)
+{
+
+}
+
+// a response will be posted
+void Session_Mailbox::expect()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Pending++;
+}
+
+// a whole response is ready (from any thread), the event loop is woken up
+void Session_Mailbox::post(std::string tag, const bool& journaled, std::string response, const ID& client_id)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Queued_Size += response.size();
+    Chunks.push_back(Deferred_Chunk{std::move(tag), journaled, std::move(response), true, client_id});
+    Pending--;
+    if (Wake_File >= 0 && !Detached){
+        uint64_t one = 1;
+        if (write(Wake_File, &one, sizeof(one)) < 0 && errno != EAGAIN){
+            perror("Error waking the event loop");
+        }
+    }
+    Ready.notify_all();
+}
+
+// a chunk of a streamed response, queued at once (false once the session is closed : the producer stops)
+bool Session_Mailbox::post_chunk(const std::string& tag, const bool& journaled, const char* data, const size_t& length, const bool& last)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (Detached){
+        if (last){
+            Pending--;
+        }
+        return false;
+    }
+    Queued_Size += length;
+    Chunks.push_back(Deferred_Chunk{tag, journaled, std::string(data, length), last, -1});
+    if (last){
+        Pending--;
+    }
+    if (Wake_File >= 0){
+        uint64_t one = 1;
+        if (write(Wake_File, &one, sizeof(one)) < 0 && errno != EAGAIN){
+            perror("Error waking the event loop");
+        }
+    }
+    Ready.notify_all();
+    return true;
+}
+
+// SESSION_OUTPUT_HIGH_WATER bytes are queued, the producer must wait for the client
+bool Session_Mailbox::is_full()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    return Queued_Size >= SESSION_OUTPUT_HIGH_WATER;
+}
+
+// keep the producer until the client took chunks (resume is called then, or when the session is closed), false if there is room already
+// (the producer goes on once half of the high water is taken, not for each chunk)
+bool Session_Mailbox::park(std::function<void()> resume)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (Detached || Queued_Size < SESSION_OUTPUT_HIGH_WATER / 2){
+        return false;
+    }
+    Parked = std::move(resume);
+    Parked_Since = std::chrono::steady_clock::now();
+    return true;
+}
+
+// move the chunks ready out (up to max_size bytes, at least one if max_size is not 0), true while some are still expected
+bool Session_Mailbox::take(std::vector<Deferred_Chunk>& chunks, const size_t& max_size)
+{
+    std::function<void()> resume;
+    bool waiting;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        size_t taken_size = 0;
+        while (!Chunks.empty() && taken_size < max_size){
+            taken_size += Chunks.front().data.size();
+            Queued_Size -= Chunks.front().data.size();
+            chunks.push_back(std::move(Chunks.front()));
+            Chunks.pop_front();
+        }
+        if (taken_size > 0){
+            Parked_Since = std::chrono::steady_clock::now();
+        }
+        if (Parked && Queued_Size < SESSION_OUTPUT_HIGH_WATER / 2){
+            resume = std::move(Parked);
+            Parked = nullptr;
+        }
+        waiting = Pending > 0 || !Chunks.empty();
+    }
+    if (resume){
+        resume(); // the producer goes on
+    }
+    return waiting;
+}
+
+// chunks are ready to be taken
+bool Session_Mailbox::has_chunks()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    return !Chunks.empty();
+}
+
+// a response is expected, or its chunks are not all taken
+bool Session_Mailbox::is_waiting()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    return Pending > 0 || !Chunks.empty();
+}
+
+// a producer is parked and the client took nothing for SESSION_STREAM_STALL_TIMEOUT
+bool Session_Mailbox::is_stalled()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    return Parked && std::chrono::steady_clock::now() - Parked_Since > std::chrono::milliseconds(SESSION_STREAM_STALL_TIMEOUT);
+}
+
+// until every response expected is ready
+void Session_Mailbox::wait()
+{
+    std::unique_lock<std::mutex> lock(Mutex);
+    Ready.wait(lock, [this](){
+        return Pending == 0;
+    });
+}
+
+// the session is closed, the event loop is not woken anymore and the producers stop
+void Session_Mailbox::detach()
+{
+    std::function<void()> resume;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Detached = true;
+        resume = std::move(Parked);
+        Parked = nullptr;
+    }
+    if (resume){
+        resume(); // the parked producer unwinds (its next chunk is refused)
+    }
+}
+
+
+// a few threads producing the streamed responses of the event loop sessions
+// constructor
+Response_Workers::Response_Workers(const size_t& thread_count) : Stopping(false)
+{
+    for (size_t i = 0; i < std::max<size_t>(thread_count, 1); i++){
+        Threads.emplace_back(&Response_Workers::run_worker, this);
+    }
+}
+
+// destructor
+Response_Workers::~Response_Workers()
+{
+    stop();
+}
+
+// run a task on a thread
+void Response_Workers::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Tasks.push_back(std::move(task));
+    }
+    Tasks_Available.notify_one();
+}
+
+// stop the threads once their running task is over, the tasks still waiting are dropped (their sessions are closed)
+void Response_Workers::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Stopping = true;
+        Tasks.clear();
+    }
+    Tasks_Available.notify_all();
+    for (auto& thread : Threads){
+        thread.join();
+    }
+    Threads.clear();
+}
+
+// run the tasks until the workers stop
+void Response_Workers::run_worker()
+{
+    while (true){
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            Tasks_Available.wait(lock, [this](){
+                return Stopping || !Tasks.empty();
+            });
+            if (Stopping){
+                return;
+            }
+            task = std::move(Tasks.front());
+            Tasks.pop_front();
+        }
+        try {
+            task();
+        }
+        catch (const std::exception& e){
+            std::cerr << "Error producing a response: " << e.what() << std::endl;
+        }
+    }
+}
+
+
+
+// a streamed response of an event loop session, produced on its own stack
+// constructor
+Response_Stream::Response_Stream(std::shared_ptr<Session_Mailbox> mailbox, std::string tag, const bool& journaled, Response_Producer producer) : Mailbox(std::move(mailbox)), Tag(std::move(tag)), Journaled(journaled), Producer(std::move(producer)), Stack(MAP_FAILED), Done(false)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    Stack = mmap(nullptr, page_size + RESPONSE_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (Stack == MAP_FAILED){
+        throw std::runtime_error("Failed to map the stack of a response");
+    }
+    mprotect(Stack, page_size, PROT_NONE); // an overflow faults instead of writing over the heap
+    getcontext(&Context);
+    Context.uc_stack.ss_sp = static_cast<char*>(Stack) + page_size;
+    Context.uc_stack.ss_size = RESPONSE_STACK_SIZE;
+    Context.uc_link = &Caller; // back to the response thread when the producer ends
+    uintptr_t address = reinterpret_cast<uintptr_t>(this);
+    makecontext(&Context, reinterpret_cast<void (*)()>(&Response_Stream::run_producer), 2, static_cast<unsigned int>(address >> 32), static_cast<unsigned int>(address & 0xFFFFFFFF));
+}
+
+// destructor
+Response_Stream::~Response_Stream()
+{
+    if (Stack != MAP_FAILED){
+        munmap(Stack, sysconf(_SC_PAGESIZE) + RESPONSE_STACK_SIZE);
+    }
+}
+
+// entry of the stack (the address of the stream in two halves)
+void Response_Stream::run_producer(unsigned int high, unsigned int low)
+{
+    Response_Stream* stream = reinterpret_cast<Response_Stream*>((static_cast<uintptr_t>(high) << 32) | low);
+    try {
+        Response_Writer writer([stream](const char* data, size_t length, bool last){
+            stream->write_chunk(data, length, last);
+        });
+        stream->Producer(writer);
+        writer.finish();
+    }
+    catch (const std::exception& e){
+        std::cerr << "Error producing a response: " << e.what() << std::endl;
+    }
+    stream->Done = true;
+}
+
+// sink of the producer, suspended while the mailbox is full
+// (the last chunk never waits : it may be written while the producer unwinds)
+void Response_Stream::write_chunk(const char* data, const size_t& length, const bool& last)
+{
+    if (!Mailbox->post_chunk(Tag, Journaled, data, length, last)){
+        if (!last){
+            throw std::runtime_error("the session is closed"); // the producer stops
+        }
+        return;
+    }
+    if (!last && std::uncaught_exceptions() == 0 && Mailbox->is_full()){
+        swapcontext(&Context, &Caller); // the response thread goes on with other tasks, this one comes back on any of them
+    }
+}
+
+// run the producer on the calling response thread until it ends, or until it waits for its client
+// (the mailbox keeps the stream while the client is slow, and submits it again once the event loop took chunks)
+void Response_Stream::run(const std::shared_ptr<Response_Stream>& stream, Response_Workers& workers)
+{
+    while (true){
+        swapcontext(&stream->Caller, &stream->Context);
+        if (stream->Done){
+            return;
+        }
+        bool parked = stream->Mailbox->park([stream, &workers](){
+            workers.submit([stream, &workers](){
+                Response_Stream::run(stream, workers);
+            });
+        });
+        if (parked){
+            return;
+        }
+    }
+}
+
+
+// constructor
+Session::Session(const int& socket, const bool& blocking, const int& wake_file) : Socket(socket), Blocking(blocking), Input(REQUEST_BUFFER_SIZE), Output_Offset(0), Corked(false), Closing(false), Responding(false), Journaled(true), Client_Id(-1), Heartbeats(false), Last_Received(std::chrono::steady_clock::now()), Last_Sent(Last_Received), Wake_File(wake_file), Feed(nullptr), Feed_Sequence(0), Shared_Memory_Requested(false), Stream(nullptr), Message_Sequence(0), Limiter(nullptr), Workers(nullptr), Compression(false)
+{
+    set_send_policy(Socket, Send_Policy::NO_DELAY); // the output of a batch of requests is written at once
+}
+
+// destructor
+Session::~Session()
+{
+    unsubscribe();
+    if (Stream){
+        Stream->release(this);
+    }
+    if (Mailbox){
+        Mailbox->detach(); // a response posted later is dropped
+    }
+}
+
+
+// getters
+int Session::get_socket() const
+{
+    return Socket;
+}
+
+bool Session::has_output() const
+{
+    return Output_Offset < Output.size();
+}
+
+bool Session::is_closing() const
+{
+    return Closing;
+}
+
+Frame_Buffer& Session::get_input()
+{
+    return Input;
+}
+
+Market_Feed* Session::get_feed() const
+{
+    return Feed;
+}
+
+
+// the client authenticated by the session, -1 if none
+ID Session::get_client_id() const
+{
+    return Client_Id;
+}
+
+
+// handle the requests fully received, false if the session must be closed
+// (a thread-per-client session writes the responses of the batch together, the event loops write the output when they are done with the session)
+bool Session::process_input(const Request_Handler& handler)
+{
+    Last_Received = std::chrono::steady_clock::now(); // the transports call it for every bytes received
+    return resume_input(handler);
+}
+
+// handle the requests left in the frame buffer while a deferred response was sent, false if the session must be closed
+bool Session::resume_input(const Request_Handler& handler)
+{
+    bool keep = handle_requests(handler);
+    if (Blocking){
+        flush_output();
+    }
+    if (Stream){
+        Stream->flush(); // the messages of the batch are journaled together
+    }
+    return keep;
+}
+
+bool Session::handle_requests(const Request_Handler& handler)
+{
+    Frame frame;
+    try {
+        while (!Closing && !is_deferring() && Input.next_frame(frame)){ // the requests after a deferred response wait for it, they keep their order
+            if (frame.last && Request.empty() && std::string_view(frame.data, frame.size) == HEARTBEAT_MESSAGE){
+                Heartbeats = true; // answered by the heartbeats of the session, not by the request handler
+                continue;
+            }
+            if (frame.last && Request.empty()){
+                if (!handle_request(handler, std::string_view(frame.data, frame.size))){
+                    return false;
+                }
+            }
+            else {
+                if (Request.size() + frame.size > REQUEST_MAX_SIZE){
+                    std::cerr << "Client session " << Socket << " closed: a request longer than " << REQUEST_MAX_SIZE << " bytes" << std::endl;
+                    return false; // the continuation frames would grow the request without limit
+                }
+                Request.append(frame.data, frame.size); // a request in several frames
+                if (frame.last){
+                    std::string request = std::move(Request);
+                    Request.clear();
+                    if (!handle_request(handler, request)){
+                        return false;
+                    }
+                }
+            }
+            // a long batch of pipelined requests does not hold back the first responses
+            if (Blocking && !Output.empty() && std::chrono::steady_clock::now() - Output_Since >= std::chrono::milliseconds(SESSION_MAX_FLUSH_DELAY)){
+                flush_output();
+            }
+        }
+    }
+    catch (const std::runtime_error& e){
+        std::cerr << "Error receiving a request from the client: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+// handle a request the rate limits accept (the others are answered at once, they never reach the request handler), false if the session must be closed
+bool Session::handle_request(const Request_Handler& handler, std::string_view request)
+{
+    if (Limiter != nullptr){
+        Rate_Decision decision = Limiter->admit(Rate, Client_Id, request);
+        if (decision != Rate_Decision::ACCEPT){
+            Limiter->reject(*this, request, decision);
+            return true;
+        }
+    }
+    Journaled = true;
+    if (!handler(*this, request)){
+        return false;
+    }
+    if (Blocking && Mailbox){
+        Mailbox->wait(); // the responses keep the order of the requests
+        collect_deferred();
+    }
+    return true;
+}
+
+
+// send a response to the client
+void Session::send(const std::string& data)
+{
+    send(data.data(), data.size());
+}
+
+void Session::send(const char* data, const size_t& length)
+{
+    send_chunk(data, length, true);
+}
+
+// send a heartbeat if nothing was sent during the interval, false if the client was silent for the timeout (the sessions of the clients without heartbeats are never closed)
+// (also false when the client took nothing of a streamed response for SESSION_STREAM_STALL_TIMEOUT, heartbeats or not : the response can not end)
+bool Session::check_heartbeat(const Heartbeat_Policy& policy)
+{
+    if (!Closing && Mailbox && Mailbox->is_stalled()){
+        std::cerr << "Client session " << Socket << " closed: a streamed response waited more than " << SESSION_STREAM_STALL_TIMEOUT << " ms for the client" << std::endl;
+        return false;
+    }
+    if (!Heartbeats || Closing){
+        return true;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (is_deferring()){
+        Last_Received = now; // the heartbeats of the client are not read while a deferred response is sent, its silence counts from the end of it
+    }
+    if (now - Last_Received > std::chrono::milliseconds(policy.timeout)){
+        std::cerr << "Client session " << Socket << " timed out: nothing received for " << policy.timeout << " ms" << std::endl;
+        return false;
+    }
+    if (now - Last_Sent >= std::chrono::milliseconds(policy.interval) && !Responding){
+        write_frame(HEARTBEAT_MESSAGE, sizeof(HEARTBEAT_MESSAGE) - 1, true); // not tagged, it answers no request
+        if (Blocking){
+            flush_output();
+        }
+    }
+    return true;
+}
+
+// bind the client whose password or token was checked
+void Session::set_client_id(const ID& client_id)
+{
+    Client_Id = client_id;
+}
+
+
+// tag the next responses (a frame before the first frame of each response), empty to stop
+void Session::set_correlation_tag(std::string tag)
+{
+    Correlation_Tag = std::move(tag);
+}
+
+// sequence and journal the responses of the request being processed (the default for each request), false for the responses a gap fill does not need
+void Session::set_journaled(const bool& enabled)
+{
+    Journaled = enabled;
+}
+
+// check the requests against the rate limits before handling them
+void Session::set_rate_limiter(Rate_Limiter* limiter)
+{
+    Limiter = limiter;
+}
+
+// produce the streamed responses on these threads (event loop sessions)
+void Session::set_response_workers(Response_Workers* workers)
+{
+    Workers = workers;
+}
+
+// compress the responses of at least COMPRESSION_THRESHOLD bytes from the next one
+void Session::set_compression(const bool& enabled)
+{
+    Compression = enabled;
+}
+
+// sequence the next messages in the stream of the client, after sending the ones following the last one it saw (false if some of them are lost)
+// (without a last sequence nothing is sent again, the client only starts reading the sequences)
+bool Session::resume(Client_Stream& stream, const std::optional<uint64_t>& last_seen)
+{
+    if (Stream && Stream != &stream){
+        Stream->release(this);
+    }
+    Stream = &stream;
+    Stream->take_ownership(this); // a previous session of the client stops sequencing
+    if (!last_seen){
+        return true;
+    }
+    return Stream->replay(*last_seen, [this](const uint64_t& sequence, std::string_view message){
+        write_sequenced(sequence, message);
+    });
+}
+
+// a response computed by another thread, with the correlation tag of the request (a thread-per-client session waits for it before the next request)
+Deferred_Response Session::defer()
+{
+    if (!Mailbox){
+        Mailbox = std::make_shared<Session_Mailbox>(Wake_File);
+    }
+    Mailbox->expect();
+    return [mailbox = Mailbox, tag = Correlation_Tag, journaled = Journaled](std::string response, const ID& client_id){
+        mailbox->post(tag, journaled, std::move(response), client_id);
+    };
+}
+
+// send the deferred responses ready, true if some are still expected
+// (an event loop session takes the chunks of a streamed response while its output holds less than SESSION_OUTPUT_HIGH_WATER bytes, the producer waits for the client meanwhile)
+bool Session::collect_deferred()
+{
+    if (!Mailbox){
+        return false;
+    }
+    size_t queued = Output.size() - Output_Offset;
+    size_t room = Blocking ? std::numeric_limits<size_t>::max() : SESSION_OUTPUT_HIGH_WATER - std::min<size_t>(queued, SESSION_OUTPUT_HIGH_WATER);
+    std::vector<Deferred_Chunk> chunks;
+    bool waiting = Mailbox->take(chunks, room);
+    std::string request_tag = std::move(Correlation_Tag);
+    bool request_journaled = Journaled;
+    for (auto& chunk : chunks){
+        Correlation_Tag = std::move(chunk.tag);
+        Journaled = chunk.journaled;
+        if (chunk.client_id != -1){
+            Client_Id = chunk.client_id;
+        }
+        send_chunk(chunk.data.data(), chunk.data.size(), chunk.last);
+    }
+    Correlation_Tag = std::move(request_tag);
+    Journaled = request_journaled;
+    return waiting;
+}
+
+// chunks of deferred responses are ready to be sent
+bool Session::has_deferred_chunks() const
+{
+    return Mailbox && Mailbox->has_chunks();
+}
+
+// an event loop session waits for a deferred response : its next requests are not handled (nor received) until it is sent
+bool Session::is_deferring() const
+{
+    return !Blocking && Mailbox && Mailbox->is_waiting() && !Closing;
+}
+
+// send a large response as it is produced
+// (a thread-per-client session writes it in the socket as it goes; an event loop session hands the producer to a response thread,
+// whose chunks go through the mailbox : the database is never read by an event loop, and a slow client holds back its producer, not the memory)
+void Session::stream(const Response_Producer& producer)
+{
+    if (Blocking || Workers == nullptr){
+        Response_Writer writer(get_sink());
+        producer(writer);
+        writer.finish();
+        return;
+    }
+    if (!Mailbox){
+        Mailbox = std::make_shared<Session_Mailbox>(Wake_File);
+    }
+    auto response_stream = std::make_shared<Response_Stream>(Mailbox, Correlation_Tag, Journaled, producer);
+    Mailbox->expect();
+    Workers->submit([response_stream, workers = Workers](){
+        Response_Stream::run(response_stream, *workers);
+    });
+}
+
+// send a chunk of a response, compressed if the session asked for it and the response is large
+// (a response is compressed from its first chunk when it is not the last one, or when it is long enough by itself : the short ones keep their latency,
+// a long one is deflated chunk by chunk as it is streamed, after the COMPRESSION_PREFIX)
+void Session::send_chunk(const char* data, size_t length, const bool& last)
+{
+    if (!Deflater && !Responding && Compression && (!last || length >= COMPRESSION_THRESHOLD)){
+        Deflater = std::make_unique<Deflate_Stream>();
+        send_frames(COMPRESSION_PREFIX, sizeof(COMPRESSION_PREFIX) - 1, false);
+    }
+    if (!Deflater){
+        send_frames(data, length, last);
+        return;
+    }
+    Compressed.clear();
+    Deflater->compress(data, length, last, Compressed);
+    if (!Compressed.empty() || last){
+        send_frames(Compressed.data(), Compressed.size(), last); // zlib may keep a small chunk for the next one
+    }
+    if (last){
+        Deflater.reset();
+    }
+}
+
+// frame the data (split in frames of at most FRAME_MAX_SIZE bytes)
+// (a journaled message of a resumed session starts with its sequence frame, and its chunks are kept in the stream of the client as they are framed)
+void Session::send_frames(const char* data, size_t length, const bool& last)
+{
+    bool starting = !Responding;
+    if (starting){
+        Message_Sequence = 0;
+        if (Stream && Journaled){
+            Message_Sequence = Stream->reserve(this);
+            if (Message_Sequence == 0){
+                Stream = nullptr; // the client resumed its session elsewhere
+            }
+            else {
+                std::string sequence = SEQUENCE_PREFIX + std::to_string(Message_Sequence) + " ";
+                write_frame(sequence.data(), sequence.size(), false);
+            }
+        }
+    }
+    if (starting && !Correlation_Tag.empty()){
+        write_frame(Correlation_Tag.data(), Correlation_Tag.size(), false); // the client reads the tag and the response as one message
+        if (Message_Sequence != 0){
+            Stream->append(Message_Sequence, Correlation_Tag, true, false);
+            starting = false;
+        }
+    }
+    Responding = !last;
+    if (Message_Sequence != 0){
+        Stream->append(Message_Sequence, std::string_view(data, length), starting, last);
+    }
+    do {
+        size_t frame_length = std::min<size_t>(length, FRAME_MAX_SIZE);
+        write_frame(data, frame_length, last && frame_length == length);
+        data += frame_length;
+        length -= frame_length;
+    } while (length > 0);
+}
+
+// keep a frame in the output (a thread-per-client session writes it with the output once it is full)
+void Session::write_frame(const char* data, const size_t& length, const bool& last)
+{
+    if (Closing && Blocking){
+        return; // the socket already failed
+    }
+    char header[FRAME_HEADER_SIZE];
+    write_frame_header(header, length, last);
+    Last_Sent = std::chrono::steady_clock::now();
+    if (Blocking && Output.size() + FRAME_HEADER_SIZE + length > SESSION_COALESCE_SIZE){
+        // the output and the frame are written in one system call (no copy of the frame), the socket stays corked until the end of the batch
+        if (!Corked){
+            set_send_policy(Socket, Send_Policy::CORKED);
+            Corked = true;
+        }
+        struct iovec parts[3] = {{Output.data(), Output.size()}, {header, FRAME_HEADER_SIZE}, {const_cast<char*>(data), length}};
+        try {
+            send_parts(Socket, parts, 3);
+        }
+        catch (const std::exception& e){
+            std::cerr << "Error sending a response to the client: " << e.what() << std::endl;
+            Closing = true;
+        }
+        Output.clear();
+        return;
+    }
+    // written by the reactor when the socket is writable, or at the end of the batch of requests (thread-per-client)
+    if (Blocking && Output.empty()){
+        Output_Since = Last_Sent;
+    }
+    Output.append(header, FRAME_HEADER_SIZE);
+    Output.append(data, length);
+}
+
+// keep a message of the stream in the output, after its sequence frame
+void Session::write_sequenced(const uint64_t& sequence, std::string_view message)
+{
+    std::string prefix = SEQUENCE_PREFIX + std::to_string(sequence) + " ";
+    write_frame(prefix.data(), prefix.size(), false);
+    do {
+        size_t frame_length = std::min<size_t>(message.size(), FRAME_MAX_SIZE);
+        write_frame(message.data(), frame_length, frame_length == message.size());
+        message.remove_prefix(frame_length);
+    } while (!message.empty());
+}
+
+// write the whole output of a thread-per-client session, then uncork its socket
+void Session::flush_output()
+{
+    if (!Output.empty() && !Closing){
+        struct iovec part = {Output.data(), Output.size()};
+        try {
+            send_parts(Socket, &part, 1);
+        }
+        catch (const std::exception& e){
+            std::cerr << "Error sending a response to the client: " << e.what() << std::endl;
+            Closing = true;
+        }
+    }
+    Output.clear();
+    if (Corked && !Closing){
+        set_send_policy(Socket, Send_Policy::NO_DELAY); // the last partial segment leaves now
+    }
+    Corked = false;
+}
+
+// sink for a Response_Writer writing to this session (one response in several frames)
+Response_Sink Session::get_sink()
+{
+    return [this](const char* data, size_t length, bool last){
+        send_chunk(data, length, last);
+    };
+}
+
+// write as much of the output as the socket accepts, false on a socket error
+bool Session::write_output()
+{
+    return write_output([this](const char* data, size_t length) -> ssize_t {
+        while (true){
+            ssize_t written = ::send(Socket, data, length, MSG_NOSIGNAL);
+            if (written >= 0 || errno != EINTR){
+                return written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : written; // the socket buffer is full, wait for the next EPOLLOUT
+            }
+        }
+    });
+}
+
+// the same with another transport (the writer returns the bytes taken, 0 if it is full, -1 on error)
+bool Session::write_output(const std::function<ssize_t(const char*, size_t)>& writer)
+{
+    while (Output_Offset < Output.size()){
+        ssize_t written = writer(Output.data() + Output_Offset, Output.size() - Output_Offset);
+        if (written < 0){
+            return false;
+        }
+        if (written == 0){
+            break;
+        }
+        Output_Offset += written;
+    }
+    if (Output_Offset == Output.size()){
+        Output.clear();
+        Output_Offset = 0;
+    }
+    else if (Output_Offset > Output.size() / 2){
+        Output.erase(0, Output_Offset); // keep the buffer from growing with what is already written
+        Output_Offset = 0;
+    }
+    return true;
+}
+
+// move the pending output out of the session (for the transports writing asynchronously)
+void Session::take_output(std::string& output)
+{
+    output.assign(Output, Output_Offset, std::string::npos);
+    Output.clear();
+    Output_Offset = 0;
+}
+
+// close the session once the output is written
+void Session::close_after_output()
+{
+    Closing = true;
+}
+
+// deliver the feed to the session, from a snapshot (false for a thread-per-client session, the feed is pushed by the event loops)
+bool Session::subscribe(Market_Feed& feed)
+{
+    if (Blocking){
+        return false;
+    }
+    unsubscribe();
+    Feed = &feed;
+    Feed_Sequence = 0;
+    return true;
+}
+
+void Session::unsubscribe()
+{
+    if (Feed != nullptr){
+        Feed->remove_subscriber(Socket);
+        Feed = nullptr;
+    }
+}
+
+// append the messages of the feed not delivered yet to the output, unless the output and the bytes being sent by the transport exceed the bound
+// (the responses are written whole between two requests, the messages of the feed never split one)
+Feed_Delivery Session::deliver_feed(const size_t& sending)
+{
+    if (Feed == nullptr || Closing || Responding){
+        return Feed_Delivery::NOTHING; // a streamed response is being sent, the messages of the feed wait for its end
+    }
+    Feed_Delivery delivery = Feed->deliver(Socket, Feed_Sequence, Output, Output.size() - Output_Offset + sending);
+    if (delivery == Feed_Delivery::TOO_SLOW){
+        std::cerr << "Subscriber " << Socket << " disconnected: lagging the market data feed for more than " << FEED_MAX_LAG_TIME << " ms" << std::endl;
+        Feed = nullptr;
+    }
+    return delivery;
+}
+
+// ask the event loop to attach shared memory rings once the answer is written (false for a thread-per-client session)
+bool Session::request_shared_memory()
+{
+    if (Blocking){
+        return false;
+    }
+    Shared_Memory_Requested = true;
+    return true;
+}
+
+// true once after a request (the flag is cleared)
+bool Session::take_shared_memory_request()
+{
+    return std::exchange(Shared_Memory_Requested, false);
+}
+
+bool Session::has_shared_memory_request() const
+{
+    return Shared_Memory_Requested;
+}
+
+
+// how the kernel sends the bytes written to a TCP socket (no effect on the local sockets)
+void set_send_policy(const int& socket, const Send_Policy& policy)
+{
+#ifdef TCP_CORK
+    int cork = policy == Send_Policy::CORKED;
+    if (setsockopt(socket, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork)) < 0){
+        if (errno != EOPNOTSUPP && errno != ENOPROTOOPT){
+            perror("Error setsockopt TCP_CORK");
+        }
+        return; // not a TCP socket
+    }
+#endif
+    int no_delay = 1; // with the cork removed, the pending bytes leave at once
+    if (setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay)) < 0 && errno != EOPNOTSUPP && errno != ENOPROTOOPT){
+        perror("Error setsockopt TCP_NODELAY");
+    }
+}
+
+
+// raise the limit of open file descriptors to its maximum (one descriptor per connected client)
+void raise_file_descriptor_limit()
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max){
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) != 0){
+            perror("Error setrlimit");
+        }
+    }
+}
+
+// create the TCP listen sockets of a port, one per acceptor thread (SO_REUSEPORT : the kernel spreads the new connections across them), empty on error
+std::vector<int> create_listen_sockets(const int& port, const size_t& count, const int& backlog)
+{
+    std::vector<int> listen_sockets;
+    struct sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    for (size_t i = 0; i < std::max<size_t>(count, 1); i++){
+        int listen_socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_socket < 0){
+            perror("Error socket");
+            break;
+        }
+        listen_sockets.push_back(listen_socket);
+        int enable = 1;
+        setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)); // restart without waiting for the TIME_WAIT connections
+        if (setsockopt(listen_socket, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0){
+            perror("Error setsockopt SO_REUSEPORT");
+            break;
+        }
+        if (bind(listen_socket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0){
+            perror("Error bind");
+            break;
+        }
+        if (listen(listen_socket, backlog) < 0){ // the backlog must absorb the reconnections at the open
+            perror("Error listen");
+            break;
+        }
+    }
+    if (listen_sockets.size() < std::max<size_t>(count, 1)){
+        for (const int& listen_socket : listen_sockets){
+            close(listen_socket);
+        }
+        listen_sockets.clear();
+    }
+    return listen_sockets;
+}
+
+
+#ifdef EPOLL_AVAILABLE
+// constructor
+Epoll_Gateway::Epoll_Gateway(const std::vector<int>& reactor_listen_sockets, const std::vector<int>& shared_listen_sockets, Request_Handler handler, const Heartbeat_Policy& heartbeat, Rate_Limiter* limiter, Response_Workers* workers) : Reactor_Listen_Sockets(reactor_listen_sockets), Shared_Listen_Sockets(shared_listen_sockets), Reactor_Count(reactor_listen_sockets.size()), Handler(std::move(handler)), Heartbeat(heartbeat), Limiter(limiter), Workers(workers), Session_Count(0)
+{
+    for (const std::vector<int>* listen_sockets : {&Reactor_Listen_Sockets, &Shared_Listen_Sockets}){
+        for (const int& listen_socket : *listen_sockets){
+            int flags = fcntl(listen_socket, F_GETFL, 0);
+            fcntl(listen_socket, F_SETFL, flags | O_NONBLOCK); // the reactors accept until EAGAIN
+        }
+    }
+}
+
+// run the reactors until the flag is set, then close the sessions
+void Epoll_Gateway::run(const std::atomic<bool>& shutdown_flag)
+{
+    std::vector<std::thread> reactors;
+    for (size_t i = 0; i < Reactor_Count; i++){
+        reactors.emplace_back(&Epoll_Gateway::run_reactor, this, Reactor_Listen_Sockets[i], std::cref(shutdown_flag));
+    }
+    for (auto& reactor : reactors){
+        reactor.join();
+    }
+}
+
+// number of connected sessions
+size_t Epoll_Gateway::get_session_count() const
+{
+    return Session_Count.load();
+}
+
+// event loop of one reactor thread, accepting from its own listen socket and the shared ones
+void Epoll_Gateway::run_reactor(const int& listen_socket, const std::atomic<bool>& shutdown_flag)
+{
+    // connection of the reactor : the session, the events watched on its socket, and the shared memory rings of a local client (its socket then only tells when it leaves)
+    struct Connection
+    {
+        std::unique_ptr<Session> session;
+        uint32_t events;
+        std::unique_ptr<Shared_Memory_Channel> channel;
+    };
+    std::unordered_map<int, Connection> connections;
+    std::unordered_map<int, int> channel_sockets; // eventfd woken by a local client, and its socket
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0){
+        perror("Error epoll_create1");
+        return;
+    }
+    std::vector<int> listen_sockets = Shared_Listen_Sockets;
+    listen_sockets.push_back(listen_socket);
+    for (const int& accepting_socket : listen_sockets){
+        struct epoll_event listen_event{};
+        listen_event.events = EPOLLIN | (accepting_socket == listen_socket ? 0 : EPOLLEXCLUSIVE);
+        listen_event.data.fd = accepting_socket;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, accepting_socket, &listen_event) < 0){
+            perror("Error epoll_ctl");
+            close(epoll_fd);
+            return;
+        }
+    }
+
+    // the feed wakes the reactor through an eventfd when messages are published for its subscribed sessions
+    int wake_file = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_file < 0){
+        perror("Error eventfd");
+        close(epoll_fd);
+        return;
+    }
+    struct epoll_event wake_event{};
+    wake_event.events = EPOLLIN;
+    wake_event.data.fd = wake_file;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_file, &wake_event);
+    std::set<Market_Feed*> feeds; // feeds waking this reactor
+    std::set<int> subscribers; // sockets of the sessions subscribed to a feed
+    std::set<int> deferring; // sockets of the sessions waiting for responses computed by other threads (they wake the reactor through the same eventfd)
+
+    auto close_connection = [&](const int& socket){
+        auto it = connections.find(socket);
+        if (it != connections.end() && it->second.channel != nullptr){
+            int channel_wake = it->second.channel->get_wake_file();
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, channel_wake, nullptr); // the client holds a copy of the eventfd, closing ours would not remove it
+            channel_sockets.erase(channel_wake);
+        }
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, socket, nullptr);
+        close(socket);
+        connections.erase(socket);
+        subscribers.erase(socket);
+        deferring.erase(socket);
+        Session_Count--;
+    };
+    // write the output to the socket, or to the ring of responses of a local client (the rest goes when the client wakes the reactor up, it has read)
+    auto write_output = [&](Connection& connection){
+        if (connection.channel == nullptr){
+            return connection.session->write_output();
+        }
+        return connection.session->write_output([&connection](const char* data, size_t length){
+            return connection.channel->send(data, length);
+        });
+    };
+    // watch EPOLLOUT only while there is something to write, and EPOLLIN only while the requests are handled (the kernel holds them back during a deferred response)
+    auto update_interest = [&](const int& socket, Connection& connection){
+        Session& session = *connection.session;
+        bool waiting_writable = connection.channel == nullptr && (session.has_output() || session.has_shared_memory_request());
+        uint32_t events = (session.is_deferring() ? 0 : EPOLLIN | EPOLLRDHUP) | (waiting_writable ? EPOLLOUT : 0);
+        if (events != connection.events){
+            struct epoll_event event{};
+            event.events = events;
+            event.data.fd = socket;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, socket, &event);
+            connection.events = events;
+        }
+    };
+    // move the chunks of the deferred responses to the output as the client takes them, then handle the requests received meanwhile (false on a write error)
+    auto serve_deferred = [&](const int& socket, Connection& connection){
+        Session& session = *connection.session;
+        while (session.is_deferring()){
+            bool waiting;
+            do {
+                waiting = session.collect_deferred();
+                if (session.has_output() && !write_output(connection)){
+                    return false;
+                }
+            } while (waiting && !session.has_output() && session.has_deferred_chunks()); // the client took all of it, the next chunks follow
+            if (waiting){
+                deferring.insert(socket); // woken when the producer posts, or by EPOLLOUT
+                return true;
+            }
+            deferring.erase(socket);
+            if (session.is_closing()){
+                break;
+            }
+            if (!session.resume_input(Handler)){ // the requests received meanwhile (one of them may defer its response in turn)
+                session.close_after_output();
+            }
+        }
+        deferring.erase(socket);
+        return true;
+    };
+
+    // append the messages of the feed to the output of a session (it is a subscriber until it unsubscribes), false if it is too slow and must be closed
+    auto deliver_feed = [&](const int& socket, Connection& connection){
+        Market_Feed* feed = connection.session->get_feed();
+        if (feed == nullptr){
+            subscribers.erase(socket);
+            return true;
+        }
+        if (subscribers.insert(socket).second && feeds.insert(feed).second){
+            feed->add_wake_file(wake_file);
+        }
+        return connection.session->deliver_feed(0) != Feed_Delivery::TOO_SLOW;
+    };
+    // write the messages of the feed to every subscribed session
+    auto deliver_to_subscribers = [&](){
+        std::vector<int> subscribed(subscribers.begin(), subscribers.end());
+        for (const int& subscriber : subscribed){
+            auto it = connections.find(subscriber);
+            if (it == connections.end()){
+                subscribers.erase(subscriber);
+                continue;
+            }
+            Connection& connection = it->second;
+            if (!deliver_feed(subscriber, connection) || (connection.session->has_output() && !write_output(connection))){
+                close_connection(subscriber);
+                continue;
+            }
+            update_interest(subscriber, connection);
+        }
+    };
+    // read the requests of the ring of a local client until it stays empty, and write the responses in its ring (false on an error)
+    // (the ring is not read while a deferred response is sent : the reactor does not sleep on it, it reads it again once the response is over)
+    auto serve_channel = [&](const int& client_socket, Connection& connection){
+        Session& session = *connection.session;
+        connection.channel->clear_wake();
+        bool progress;
+        do { // the client skips the wake up while the reactor is awake, the ring is read until it stays empty
+            ssize_t received = session.is_deferring() ? 0 : connection.channel->receive(session.get_input());
+            if (received < 0){
+                return false; // the client moved the positions of the ring out of it
+            }
+            progress = received > 0;
+            if (progress && !session.is_closing() && !session.process_input(Handler)){
+                session.close_after_output();
+            }
+            if (!serve_deferred(client_socket, connection) || !deliver_feed(client_socket, connection) || !write_output(connection)){
+                return false;
+            }
+            if (session.is_closing()){
+                break;
+            }
+        } while (progress || (!session.is_deferring() && !connection.channel->sleep()));
+        return true;
+    };
+    // write the deferred responses that are ready (a login checked by the auth threads, the chunks of a streamed response)
+    auto deliver_deferred = [&](){
+        std::vector<int> waiting(deferring.begin(), deferring.end());
+        for (const int& socket : waiting){
+            auto it = connections.find(socket);
+            if (it == connections.end()){
+                deferring.erase(socket);
+                continue;
+            }
+            Connection& connection = it->second;
+            bool served = connection.channel != nullptr ? serve_channel(socket, connection) : serve_deferred(socket, connection);
+            if (!served || (connection.session->is_closing() && !connection.session->has_output())){
+                close_connection(socket);
+                continue;
+            }
+            update_interest(socket, connection);
+        }
+    };
+
+    // send the heartbeats of the idle sessions, close the sessions whose client stopped sending them
+    auto last_heartbeat_check = std::chrono::steady_clock::now();
+    auto check_heartbeats = [&](){
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_heartbeat_check < std::chrono::milliseconds(GATEWAY_WAIT_TIMEOUT)){
+            return;
+        }
+        last_heartbeat_check = now;
+        std::vector<int> dead;
+        for (auto& [socket, connection] : connections){
+            if (!connection.session->check_heartbeat(Heartbeat) || (connection.session->has_output() && !write_output(connection))){
+                dead.push_back(socket);
+                continue;
+            }
+            update_interest(socket, connection);
+        }
+        for (const int& socket : dead){
+            close_connection(socket);
+        }
+    };
+
+    struct epoll_event events[GATEWAY_MAX_EVENTS];
+    while (!shutdown_flag.load()){
+        int event_count = epoll_wait(epoll_fd, events, GATEWAY_MAX_EVENTS, GATEWAY_WAIT_TIMEOUT);
+        if (event_count < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            perror("Error epoll_wait");
+            break;
+        }
+        check_heartbeats();
+        if (event_count == 0){
+            deliver_to_subscribers(); // the lagging subscribers are checked even when nothing is published
+        }
+        for (int i = 0; i < event_count; i++){
+            int socket = events[i].data.fd;
+
+            // new connections
+            if (std::find(listen_sockets.begin(), listen_sockets.end(), socket) != listen_sockets.end()){
+                while (true){
+                    int client_socket = accept4(socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (client_socket < 0){
+                        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                            perror("Error accept");
+                        }
+                        break;
+                    }
+                    struct epoll_event event{};
+                    event.events = EPOLLIN | EPOLLRDHUP;
+                    event.data.fd = client_socket;
+                    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &event) < 0){
+                        perror("Error epoll_ctl");
+                        close(client_socket);
+                        continue;
+                    }
+                    connections[client_socket] = Connection{std::make_unique<Session>(client_socket, false, wake_file), event.events, nullptr};
+                    connections[client_socket].session->set_rate_limiter(Limiter);
+                    connections[client_socket].session->set_response_workers(Workers);
+                    Session_Count++;
+                }
+                continue;
+            }
+
+            // messages published by a feed
+            if (socket == wake_file){
+                uint64_t wake_count;
+                while (read(wake_file, &wake_count, sizeof(wake_count)) > 0);
+                deliver_to_subscribers();
+                deliver_deferred();
+                continue;
+            }
+
+            // requests written in the ring of a local client (or space in its ring of responses)
+            auto channel_it = channel_sockets.find(socket);
+            if (channel_it != channel_sockets.end()){
+                int client_socket = channel_it->second;
+                Connection& connection = connections.at(client_socket);
+                if (!serve_channel(client_socket, connection) || (connection.session->is_closing() && !connection.session->has_output())){
+                    close_connection(client_socket);
+                }
+                continue;
+            }
+
+            auto it = connections.find(socket);
+            if (it == connections.end()){
+                continue;
+            }
+            Connection& connection = it->second;
+            Session& session = *connection.session;
+
+            // the requests (received in the frame buffer of the session, handled once their frames are complete)
+            if (events[i].events & EPOLLIN){
+                ssize_t length = session.get_input().receive(socket);
+                if (length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)){
+                    close_connection(socket); // client disconnected (or a frame too large for the buffer)
+                    continue;
+                }
+                if (length > 0 && !session.is_closing() && !session.process_input(Handler)){
+                    session.close_after_output();
+                }
+            }
+            else if (events[i].events & (EPOLLHUP | EPOLLERR)){
+                close_connection(socket);
+                continue;
+            }
+
+            // the responses (the chunks of a deferred one as the socket takes them), then the messages of the feed (the snapshot follows the answer of the subscription, the messages held back go once the output is written)
+            if (!serve_deferred(socket, connection) || (session.has_output() && !write_output(connection))){
+                close_connection(socket);
+                continue;
+            }
+            // a local client moves to shared memory rings : the answer carries their descriptors, it follows the responses already written to the socket
+            if (session.take_shared_memory_request()){
+                struct sockaddr_storage local_address{};
+                socklen_t local_address_length = sizeof(local_address);
+                std::string refusal;
+                if (getsockname(socket, reinterpret_cast<struct sockaddr*>(&local_address), &local_address_length) < 0 || local_address.ss_family != AF_UNIX){
+                    refusal = "Error: Shared memory is only offered on the local socket";
+                }
+                else if (connection.channel != nullptr || session.has_output() || session.is_deferring()){
+                    refusal = "Error: Shared memory is already attached, or responses are still being sent";
+                }
+                else {
+                    try {
+                        auto channel = std::make_unique<Shared_Memory_Channel>();
+                        struct epoll_event channel_event{};
+                        channel_event.events = EPOLLIN;
+                        channel_event.data.fd = channel->get_wake_file();
+                        ssize_t sent = channel->send_descriptors(socket); // the answer and its descriptors go in one message, on the non-blocking socket
+                        if (sent == 0){
+                            session.request_shared_memory(); // the socket buffer is full, tried again when it is writable
+                        }
+                        else if (sent < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, channel->get_wake_file(), &channel_event) < 0){
+                            close_connection(socket);
+                            continue;
+                        }
+                        else {
+                            channel_sockets[channel->get_wake_file()] = socket;
+                            connection.channel = std::move(channel);
+                        }
+                    }
+                    catch (const std::runtime_error& e){
+                        refusal = std::string("Error: ") + e.what();
+                    }
+                }
+                if (!refusal.empty()){
+                    session.send(refusal);
+                    if (!write_output(connection)){
+                        close_connection(socket);
+                        continue;
+                    }
+                }
+            }
+            if (session.get_feed() != nullptr || subscribers.count(socket) > 0){
+                if (!deliver_feed(socket, connection) || (session.has_output() && !write_output(connection))){
+                    close_connection(socket);
+                    continue;
+                }
+            }
+            if (session.is_closing() && !session.has_output()){
+                close_connection(socket);
+                continue;
+            }
+            update_interest(socket, connection);
+        }
+    }
+
+    // the market session is over : the remaining sessions are closed
+    for (auto& [socket, connection] : connections){
+        close(socket);
+        Session_Count--;
+    }
+    connections.clear(); // the sessions stop their mailboxes from writing the eventfd
+    for (Market_Feed* feed : feeds){
+        feed->remove_wake_file(wake_file);
+    }
+    close(wake_file);
+    close(epoll_fd);
+}
+#endif // EPOLL_AVAILABLE
+
+
+#ifdef URING_AVAILABLE
+// an io_uring instance used without liburing
+// constructor : create and map the ring, throws if the kernel refuses it
+Uring::Uring(const unsigned& entries) : Submission_Ring(MAP_FAILED), Completion_Ring(MAP_FAILED), Submission_Entries(static_cast<io_uring_sqe*>(MAP_FAILED)), Local_Tail(0), Buffer_Ring(nullptr), Buffer_Ring_Size(0), Buffer_Count(0), Buffer_Size(0)
+{
+    struct io_uring_params params{};
+    // the ring is only used by the thread that creates it, and the completions are reaped when it asks for them
+    params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+    Ring_File = syscall(__NR_io_uring_setup, entries, &params);
+    if (Ring_File < 0 && errno == EINVAL){
+        params = io_uring_params{}; // older kernel, without these flags
+        Ring_File = syscall(__NR_io_uring_setup, entries, &params);
+    }
+    if (Ring_File < 0){
+        throw std::runtime_error(std::string("io_uring_setup failed: ") + strerror(errno));
+    }
+    Entries = params.sq_entries;
+
+    Submission_Ring_Size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    Completion_Ring_Size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mapping = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mapping){
+        Submission_Ring_Size = Completion_Ring_Size = std::max(Submission_Ring_Size, Completion_Ring_Size);
+    }
+    Submission_Ring = mmap(nullptr, Submission_Ring_Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Ring_File, IORING_OFF_SQ_RING);
+    Completion_Ring = single_mapping ? Submission_Ring : mmap(nullptr, Completion_Ring_Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Ring_File, IORING_OFF_CQ_RING);
+    void* submission_entries = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Ring_File, IORING_OFF_SQES);
+    Submission_Entries = static_cast<io_uring_sqe*>(submission_entries);
+    if (Submission_Ring == MAP_FAILED || Completion_Ring == MAP_FAILED || submission_entries == MAP_FAILED){
+        unmap();
+        throw std::runtime_error("Failed to map the io_uring queues");
+    }
+
+    char* submission_ring = static_cast<char*>(Submission_Ring);
+    Submission_Head = reinterpret_cast<unsigned*>(submission_ring + params.sq_off.head);
+    Submission_Tail = reinterpret_cast<unsigned*>(submission_ring + params.sq_off.tail);
+    Submission_Mask = reinterpret_cast<unsigned*>(submission_ring + params.sq_off.ring_mask);
+    Submission_Array = reinterpret_cast<unsigned*>(submission_ring + params.sq_off.array);
+    char* completion_ring = static_cast<char*>(Completion_Ring);
+    Completion_Head = reinterpret_cast<unsigned*>(completion_ring + params.cq_off.head);
+    Completion_Tail = reinterpret_cast<unsigned*>(completion_ring + params.cq_off.tail);
+    Completion_Mask = reinterpret_cast<unsigned*>(completion_ring + params.cq_off.ring_mask);
+    Completion_Entries = reinterpret_cast<io_uring_cqe*>(completion_ring + params.cq_off.cqes);
+    Local_Tail = *Submission_Tail;
+}
+
+// destructor (closing the ring cancels the operations still running)
+Uring::~Uring()
+{
+    unmap();
+}
+
+// unmap the queues and close the ring
+void Uring::unmap()
+{
+    if (Submission_Entries != MAP_FAILED){
+        munmap(Submission_Entries, Entries * sizeof(io_uring_sqe));
+        Submission_Entries = static_cast<io_uring_sqe*>(MAP_FAILED);
+    }
+    if (Completion_Ring != MAP_FAILED && Completion_Ring != Submission_Ring){
+        munmap(Completion_Ring, Completion_Ring_Size);
+    }
+    Completion_Ring = MAP_FAILED;
+    if (Submission_Ring != MAP_FAILED){
+        munmap(Submission_Ring, Submission_Ring_Size);
+        Submission_Ring = MAP_FAILED;
+    }
+    if (Ring_File >= 0){
+        close(Ring_File);
+        Ring_File = -1;
+    }
+    if (Buffer_Ring != nullptr){
+        munmap(Buffer_Ring, Buffer_Ring_Size);
+        Buffer_Ring = nullptr;
+    }
+}
+
+// get a free submission entry (the pending ones are submitted if the queue is full)
+io_uring_sqe* Uring::get_submission_entry()
+{
+    if (Local_Tail - __atomic_load_n(Submission_Head, __ATOMIC_ACQUIRE) >= Entries){
+        __atomic_store_n(Submission_Tail, Local_Tail, __ATOMIC_RELEASE);
+        syscall(__NR_io_uring_enter, Ring_File, Local_Tail - *Submission_Head, 0, 0, nullptr, 0);
+        if (Local_Tail - __atomic_load_n(Submission_Head, __ATOMIC_ACQUIRE) >= Entries){
+            return nullptr;
+        }
+    }
+    unsigned index = Local_Tail & *Submission_Mask;
+    io_uring_sqe* entry = &Submission_Entries[index];
+    std::memset(entry, 0, sizeof(*entry));
+    Submission_Array[index] = index;
+    Local_Tail++;
+    return entry;
+}
+
+// submit all the prepared entries and wait for a completion (or the timeout) with a single system call
+int Uring::submit_and_wait(const int& timeout_ms)
+{
+    unsigned to_submit = Local_Tail - *Submission_Tail;
+    __atomic_store_n(Submission_Tail, Local_Tail, __ATOMIC_RELEASE);
+    struct __kernel_timespec timeout{};
+    timeout.tv_sec = timeout_ms / MS_IN_S;
+    timeout.tv_nsec = (timeout_ms % MS_IN_S) * 1000000LL;
+    struct io_uring_getevents_arg argument{};
+    argument.ts = reinterpret_cast<uint64_t>(&timeout);
+    int result = syscall(__NR_io_uring_enter, Ring_File, to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &argument, sizeof(argument));
+    return result < 0 ? -errno : result;
+}
+
+// consume the completions available
+void Uring::for_each_completion(const std::function<void(const io_uring_cqe&)>& callback)
+{
+    unsigned head = *Completion_Head;
+    unsigned tail = __atomic_load_n(Completion_Tail, __ATOMIC_ACQUIRE);
+    while (head != tail){
+        io_uring_cqe completion = Completion_Entries[head & *Completion_Mask]; // copied, the callback may submit new entries
+        head++;
+        __atomic_store_n(Completion_Head, head, __ATOMIC_RELEASE);
+        callback(completion);
+        tail = __atomic_load_n(Completion_Tail, __ATOMIC_ACQUIRE);
+    }
+}
+
+// register a group of receive buffers the kernel picks from (multishot receive)
+void Uring::register_buffers(const unsigned& count, const size_t& size, const uint16_t& group)
+{
+    Buffer_Count = count;
+    Buffer_Size = size;
+    Buffer_Ring_Size = count * sizeof(io_uring_buf);
+    void* buffer_ring = mmap(nullptr, Buffer_Ring_Size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (buffer_ring == MAP_FAILED){
+        throw std::runtime_error("Failed to map the io_uring buffer ring");
+    }
+    Buffer_Ring = static_cast<io_uring_buf_ring*>(buffer_ring);
+
+    struct io_uring_buf_reg registration{};
+    registration.ring_addr = reinterpret_cast<uint64_t>(Buffer_Ring);
+    registration.ring_entries = count;
+    registration.bgid = group;
+    if (syscall(__NR_io_uring_register, Ring_File, IORING_REGISTER_PBUF_RING, &registration, 1) < 0){
+        throw std::runtime_error(std::string("Failed to register the io_uring buffers: ") + strerror(errno));
+    }
+    Buffers.resize(count * size);
+    for (unsigned i = 0; i < count; i++){
+        recycle_buffer(i);
+    }
+}
+
+// get the memory of a receive buffer
+const char* Uring::get_buffer(const uint16_t& buffer_id) const
+{
+    return Buffers.data() + buffer_id * Buffer_Size;
+}
+
+// give back a receive buffer to the kernel
+void Uring::recycle_buffer(const uint16_t& buffer_id)
+{
+    uint16_t tail = __atomic_load_n(&Buffer_Ring->tail, __ATOMIC_RELAXED); // only this thread moves the tail
+    // the entries start at the beginning of the ring (in C++ the flexible array of the kernel header is shifted by its empty struct)
+    io_uring_buf& buffer = reinterpret_cast<io_uring_buf*>(Buffer_Ring)[tail & (Buffer_Count - 1)];
+    buffer.addr = reinterpret_cast<uint64_t>(Buffers.data() + buffer_id * Buffer_Size);
+    buffer.len = Buffer_Size;
+    buffer.bid = buffer_id;
+    __atomic_store_n(&Buffer_Ring->tail, static_cast<uint16_t>(tail + 1), __ATOMIC_RELEASE);
+}
+
+
+// operations of the ring, stored with the socket in the user data of the entries
+enum class Uring_Operation : uint64_t
+{
+    ACCEPT = 1,
+    RECEIVE,
+    SEND,
+    WAKE, // read of the eventfd written by the feed
+    CANCEL // cancellation of the receive of a socket
+};
+
+static uint64_t uring_user_data(const Uring_Operation& operation, const int& socket)
+{
+    return (static_cast<uint64_t>(operation) << 32) | static_cast<uint32_t>(socket);
+}
+
+// arm a multishot receive on a socket, in the buffers of the group 0
+static bool uring_prepare_receive(Uring& ring, const int& socket)
+{
+    io_uring_sqe* entry = ring.get_submission_entry();
+    if (entry == nullptr){
+        return false;
+    }
+    entry->opcode = IORING_OP_RECV;
+    entry->fd = socket;
+    entry->flags = IOSQE_BUFFER_SELECT;
+    entry->buf_group = 0;
+    entry->ioprio = IORING_RECV_MULTISHOT;
+    entry->user_data = uring_user_data(Uring_Operation::RECEIVE, socket);
+    return true;
+}
+
+// cancel the multishot receive of a socket (its last completion comes with -ECANCELED)
+static bool uring_prepare_cancel_receive(Uring& ring, const int& socket)
+{
+    io_uring_sqe* entry = ring.get_submission_entry();
+    if (entry == nullptr){
+        return false;
+    }
+    entry->opcode = IORING_OP_ASYNC_CANCEL;
+    entry->fd = -1;
+    entry->addr = uring_user_data(Uring_Operation::RECEIVE, socket);
+    entry->user_data = uring_user_data(Uring_Operation::CANCEL, socket);
+    return true;
+}
+
+// arm a multishot accept on the listen socket
+static bool uring_prepare_accept(Uring& ring, const int& listen_socket)
+{
+    io_uring_sqe* entry = ring.get_submission_entry();
+    if (entry == nullptr){
+        return false;
+    }
+    entry->opcode = IORING_OP_ACCEPT;
+    entry->fd = listen_socket;
+    entry->accept_flags = SOCK_CLOEXEC;
+    entry->ioprio = IORING_ACCEPT_MULTISHOT;
+    entry->user_data = uring_user_data(Uring_Operation::ACCEPT, listen_socket);
+    return true;
+}
+
+// arm a read of the eventfd of the feed (one at a time, armed again when it completes)
+static bool uring_prepare_wake_read(Uring& ring, const int& wake_file, uint64_t* wake_count)
+{
+    io_uring_sqe* entry = ring.get_submission_entry();
+    if (entry == nullptr){
+        return false;
+    }
+    entry->opcode = IORING_OP_READ;
+    entry->fd = wake_file;
+    entry->addr = reinterpret_cast<uint64_t>(wake_count);
+    entry->len = sizeof(*wake_count);
+    entry->off = static_cast<uint64_t>(-1); // not a pread, the eventfd has no position
+    entry->user_data = uring_user_data(Uring_Operation::WAKE, wake_file);
+    return true;
+}
+
+
+// constructor
+Uring_Gateway::Uring_Gateway(const std::vector<int>& ring_listen_sockets, const std::vector<int>& shared_listen_sockets, Request_Handler handler, const Heartbeat_Policy& heartbeat, Rate_Limiter* limiter, Response_Workers* workers) : Ring_Listen_Sockets(ring_listen_sockets), Shared_Listen_Sockets(shared_listen_sockets), Ring_Count(ring_listen_sockets.size()), Handler(std::move(handler)), Heartbeat(heartbeat), Limiter(limiter), Workers(workers), Session_Count(0)
+{
+
+}
+
+// check that the kernel accepts the rings and the multishot operations (a receive is tried on a pair of sockets)
+bool Uring_Gateway::is_supported()
+{
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) < 0){
+        return false;
+    }
+    bool supported = false;
+    try {
+        Uring ring(8);
+        ring.register_buffers(2, BUFFER_SIZE, 0);
+        uring_prepare_receive(ring, sockets[0]);
+        ring.submit_and_wait(0);
+        if (write(sockets[1], "probe", 5) == 5){
+            ring.submit_and_wait(GATEWAY_WAIT_TIMEOUT);
+            ring.for_each_completion([&supported](const io_uring_cqe& completion){
+                supported = completion.res == 5 && (completion.flags & IORING_CQE_F_MORE);
+            });
+        }
+    }
+    catch (const std::exception& e){
+        std::cerr << e.what() << std::endl;
+    }
+    close(sockets[0]);
+    close(sockets[1]);
+    return supported;
+}
+
+// run the rings until the flag is set, then close the sessions
+void Uring_Gateway::run(const std::atomic<bool>& shutdown_flag)
+{
+    std::vector<std::thread> rings;
+    for (size_t i = 0; i < Ring_Count; i++){
+        rings.emplace_back(&Uring_Gateway::run_ring, this, Ring_Listen_Sockets[i], std::cref(shutdown_flag));
+    }
+    for (auto& ring : rings){
+        ring.join();
+    }
+}
+
+// number of connected sessions
+size_t Uring_Gateway::get_session_count() const
+{
+    return Session_Count.load();
+}
+
+// event loop of one ring thread, accepting from its own listen socket and the shared ones
+void Uring_Gateway::run_ring(const int& listen_socket, const std::atomic<bool>& shutdown_flag)
+{
+    // connection of the ring : the session, the output being sent and the operations running on the socket
+    struct Connection
+    {
+        std::unique_ptr<Session> session;
+        std::string sending; // output handed to the kernel (it must not move until the send completes)
+        size_t sending_offset;
+        bool send_running;
+        bool receive_running;
+        bool receive_paused; // the receive is cancelled while URING_PARKED_MAX bytes are parked
+        std::string parked; // bytes received while the session waits for a deferred response, handled once it is over
+        bool shut; // the socket has been shut down, it is closed once its operations are over
+    };
+    std::unordered_map<int, Connection> connections; // declared before the ring, so that the ring (and its operations) goes first
+
+    std::unique_ptr<Uring> ring;
+    try {
+        ring = std::make_unique<Uring>(URING_QUEUE_DEPTH);
+        ring->register_buffers(URING_BUFFER_COUNT, BUFFER_SIZE, 0);
+    }
+    catch (const std::exception& e){
+        std::cerr << "Error io_uring: " << e.what() << std::endl;
+        return;
+    }
+    uring_prepare_accept(*ring, listen_socket);
+    for (const int& shared_socket : Shared_Listen_Sockets){
+        uring_prepare_accept(*ring, shared_socket);
+    }
+
+    // the feed wakes the ring through an eventfd when messages are published for its subscribed sessions
+    int wake_file = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_file < 0){
+        perror("Error eventfd");
+        return;
+    }
+    uint64_t wake_count = 0; // read by the kernel
+    uring_prepare_wake_read(*ring, wake_file, &wake_count);
+    std::set<Market_Feed*> feeds; // feeds waking this ring
+    std::set<int> subscribers; // sockets of the sessions subscribed to a feed
+    std::set<int> deferring; // sockets of the sessions waiting for responses computed by other threads
+
+    // close the socket once no operation uses it anymore
+    auto release = [&](const int& socket, Connection& connection){
+        if (connection.shut && !connection.send_running && !connection.receive_running){
+            close(socket);
+            connections.erase(socket);
+            subscribers.erase(socket);
+            deferring.erase(socket);
+            Session_Count--;
+        }
+    };
+    // the shutdown ends the multishot receive, the socket is closed when its completion arrives
+    auto shut = [&](const int& socket, Connection& connection){
+        if (!connection.shut){
+            shutdown(socket, SHUT_RDWR);
+            connection.shut = true;
+        }
+        release(socket, connection);
+    };
+    // send the pending output (one send at a time per socket, so that the responses keep their order)
+    auto send_output = [&](const int& socket, Connection& connection){
+        if (connection.send_running || connection.shut){
+            return;
+        }
+        if (connection.sending_offset >= connection.sending.size()){
+            if (!connection.session->has_output()){
+                if (connection.session->is_closing()){
+                    shut(socket, connection);
+                }
+                return;
+            }
+            connection.session->take_output(connection.sending);
+            connection.sending_offset = 0;
+        }
+        io_uring_sqe* entry = ring->get_submission_entry();
+        if (entry == nullptr){
+            shut(socket, connection);
+            return;
+        }
+        entry->opcode = IORING_OP_SEND;
+        entry->fd = socket;
+        entry->addr = reinterpret_cast<uint64_t>(connection.sending.data() + connection.sending_offset);
+        entry->len = connection.sending.size() - connection.sending_offset;
+        entry->msg_flags = MSG_NOSIGNAL;
+        entry->user_data = uring_user_data(Uring_Operation::SEND, socket);
+        connection.send_running = true;
+    };
+    // append the messages of the feed to the output of a session (it is a subscriber until it unsubscribes), the session is shut if it is too slow
+    auto deliver_feed = [&](const int& socket, Connection& connection){
+        Market_Feed* feed = connection.session->get_feed();
+        if (feed == nullptr){
+            subscribers.erase(socket);
+            return;
+        }
+        if (subscribers.insert(socket).second && feeds.insert(feed).second){
+            feed->add_wake_file(wake_file);
+        }
+        if (connection.session->deliver_feed(connection.sending.size() - connection.sending_offset) == Feed_Delivery::TOO_SLOW){
+            shut(socket, connection);
+        }
+    };
+    // send the messages of the feed to every subscribed session
+    auto deliver_to_subscribers = [&](){
+        std::vector<int> subscribed(subscribers.begin(), subscribers.end());
+        for (const int& subscriber : subscribed){
+            auto it = connections.find(subscriber);
+            if (it == connections.end()){
+                subscribers.erase(subscriber);
+                continue;
+            }
+            Connection& connection = it->second;
+            deliver_feed(subscriber, connection);
+            if (connections.count(subscriber) > 0){
+                send_output(subscriber, connection);
+            }
+        }
+    };
+    // hand received bytes to the session, its requests are handled once their frames are complete
+    // (the bytes received while the session waits for a deferred response are parked : its next requests wait for it, they keep their order)
+    auto receive_input = [&](const int& socket, Connection& connection, const char* data, const size_t& length){
+        size_t offset = 0;
+        // the received bytes may not all fit in the frame buffer, the requests completed are handled to make room
+        while (offset < length && !connection.shut && !connection.session->is_closing()){
+            if (connection.session->is_deferring()){
+                connection.parked.append(data + offset, length - offset);
+                if (connection.parked.size() >= URING_PARKED_MAX && !connection.receive_paused){
+                    connection.receive_paused = true; // the client waits in the kernel buffers until the parked bytes are handled
+                    if (connection.receive_running){
+                        uring_prepare_cancel_receive(*ring, socket);
+                    }
+                }
+                break;
+            }
+            size_t copied = connection.session->get_input().append(data + offset, length - offset);
+            if (copied == 0){
+                shut(socket, connection); // a frame too large for the buffer (the receive still runs, the connection stays until it ends)
+                break;
+            }
+            offset += copied;
+            if (!connection.session->process_input(Handler)){
+                connection.session->close_after_output();
+            }
+            // the chunks of a deferred response go once the output handed to the kernel is sent (the client holds back the producer, not the memory)
+            if (connection.sending.empty() ? connection.session->collect_deferred() : connection.session->is_deferring()){
+                deferring.insert(socket);
+            }
+            if (connection.session->take_shared_memory_request()){
+                connection.session->send("Error: Shared memory needs the epoll network mode"); // the rings are served by the epoll reactors only
+            }
+        }
+    };
+    // send the deferred responses ready, then handle the requests received meanwhile (in the frame buffer, then the parked bytes), false if the connection is released
+    // (the chunks of a streamed response are taken once the previous ones are sent, at most SESSION_OUTPUT_HIGH_WATER bytes at a time)
+    auto serve_deferred = [&](const int& socket, Connection& connection){
+        Session& session = *connection.session;
+        while (!connection.shut && session.is_deferring()){
+            if (!connection.sending.empty()){
+                deferring.insert(socket); // the next chunks are taken when the send completes
+                return true;
+            }
+            if (session.collect_deferred()){
+                deferring.insert(socket); // woken when the response is posted
+                return true;
+            }
+            deferring.erase(socket);
+            if (session.is_closing()){
+                break;
+            }
+            if (!session.resume_input(Handler)){ // one of them may defer its response in turn
+                session.close_after_output();
+            }
+            if (!session.is_deferring() && !connection.parked.empty()){
+                std::string parked = std::move(connection.parked);
+                connection.parked.clear();
+                receive_input(socket, connection, parked.data(), parked.size());
+                if (connections.count(socket) == 0){
+                    return false; // shut while its receive was paused
+                }
+            }
+        }
+        deferring.erase(socket);
+        if (connection.receive_paused && connection.parked.size() < URING_PARKED_MAX && !connection.shut){
+            connection.receive_paused = false;
+            if (!connection.receive_running){ // otherwise the cancellation is still running, its completion arms the receive again
+                if (uring_prepare_receive(*ring, socket)){
+                    connection.receive_running = true;
+                }
+                else {
+                    shut(socket, connection);
+                    return connections.count(socket) > 0;
+                }
+            }
+        }
+        return true;
+    };
+    // send the deferred responses that are ready (a login checked by the auth threads)
+    auto deliver_deferred = [&](){
+        std::vector<int> waiting(deferring.begin(), deferring.end());
+        for (const int& socket : waiting){
+            auto it = connections.find(socket);
+            if (it == connections.end()){
+                deferring.erase(socket);
+                continue;
+            }
+            if (serve_deferred(socket, it->second)){
+                send_output(socket, it->second);
+            }
+        }
+    };
+
+    auto handle_completion = [&](const io_uring_cqe& completion){
+        Uring_Operation operation = static_cast<Uring_Operation>(completion.user_data >> 32);
+        int socket = static_cast<int>(completion.user_data & 0xFFFFFFFF);
+        bool more = completion.flags & IORING_CQE_F_MORE;
+
+        // new connections
+        if (operation == Uring_Operation::ACCEPT){
+            if (completion.res >= 0){
+                int client_socket = completion.res;
+                if (uring_prepare_receive(*ring, client_socket)){
+                    connections[client_socket] = Connection{std::make_unique<Session>(client_socket, false, wake_file), "", 0, false, true, false, "", false};
+                    connections[client_socket].session->set_rate_limiter(Limiter);
+                    connections[client_socket].session->set_response_workers(Workers);
+                    Session_Count++;
+                }
+                else {
+                    close(client_socket);
+                }
+            }
+            else if (completion.res != -EAGAIN && completion.res != -EINTR && completion.res != -ECANCELED){
+                std::cerr << "Error accept: " << strerror(-completion.res) << std::endl;
+            }
+            if (!more && !shutdown_flag.load()){
+                uring_prepare_accept(*ring, socket); // the multishot accept stopped, it is armed again
+            }
+            return;
+        }
+
+        // messages published by a feed
+        if (operation == Uring_Operation::WAKE){
+            if (!shutdown_flag.load()){
+                uring_prepare_wake_read(*ring, wake_file, &wake_count);
+            }
+            deliver_to_subscribers();
+            deliver_deferred();
+            return;
+        }
+
+        auto it = connections.find(socket);
+        if (it == connections.end() || operation == Uring_Operation::CANCEL){
+            return;
+        }
+        Connection& connection = it->second;
+
+        // the requests (copied from the received buffer in the frame buffer of the session, handled once their frames are complete)
+        if (operation == Uring_Operation::RECEIVE){
+            if (completion.res > 0 && (completion.flags & IORING_CQE_F_BUFFER)){
+                uint16_t buffer_id = completion.flags >> IORING_CQE_BUFFER_SHIFT;
+                receive_input(socket, connection, ring->get_buffer(buffer_id), completion.res);
+                ring->recycle_buffer(buffer_id);
+                if (connection.session->get_feed() != nullptr || subscribers.count(socket) > 0){
+                    deliver_feed(socket, connection); // the snapshot follows the answer of the subscription
+                }
+                if (connections.count(socket) > 0){
+                    send_output(socket, connection);
+                }
+            }
+            if (!more){
+                connection.receive_running = false;
+                // the receive stops when the buffers ran out (armed again), when it is paused, or when the client is gone
+                if (connection.shut || !(completion.res > 0 || completion.res == -ENOBUFS || completion.res == -ECANCELED)){
+                    shut(socket, connection);
+                }
+                else if (!connection.receive_paused){
+                    if (uring_prepare_receive(*ring, socket)){
+                        connection.receive_running = true;
+                    }
+                    else {
+                        shut(socket, connection);
+                    }
+                }
+            }
+            return;
+        }
+
+        // the end of a send
+        if (operation == Uring_Operation::SEND){
+            connection.send_running = false;
+            if (completion.res < 0){
+                shut(socket, connection);
+                return;
+            }
+            connection.sending_offset += completion.res;
+            if (connection.sending_offset >= connection.sending.size()){
+                connection.sending.clear();
+                connection.sending_offset = 0;
+                if (!serve_deferred(socket, connection)){ // the client took the output, the next chunks of a streamed response follow
+                    return;
+                }
+            }
+            if (connection.session->get_feed() != nullptr){
+                deliver_feed(socket, connection); // the messages held back while the output was full
+                if (connections.count(socket) == 0){
+                    return;
+                }
+            }
+            send_output(socket, connection);
+            release(socket, connection);
+        }
+    };
+
+    // send the heartbeats of the idle sessions, shut the sessions whose client stopped sending them
+    auto last_heartbeat_check = std::chrono::steady_clock::now();
+    auto check_heartbeats = [&](){
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_heartbeat_check < std::chrono::milliseconds(GATEWAY_WAIT_TIMEOUT)){
+            return;
+        }
+        last_heartbeat_check = now;
+        std::vector<int> sockets;
+        for (auto& [socket, connection] : connections){
+            sockets.push_back(socket);
+        }
+        for (const int& socket : sockets){
+            auto it = connections.find(socket);
+            if (it == connections.end() || it->second.shut){
+                continue;
+            }
+            if (!it->second.session->check_heartbeat(Heartbeat)){
+                shut(socket, it->second);
+                continue;
+            }
+            send_output(socket, it->second);
+        }
+    };
+
+    while (!shutdown_flag.load()){
+        int result = ring->submit_and_wait(GATEWAY_WAIT_TIMEOUT);
+        if (result < 0 && result != -ETIME && result != -EINTR && result != -EBUSY){
+            std::cerr << "Error io_uring_enter: " << strerror(-result) << std::endl;
+            break;
+        }
+        if (result == -ETIME){
+            deliver_to_subscribers(); // the lagging subscribers are checked even when nothing is published
+        }
+        ring->for_each_completion(handle_completion);
+        check_heartbeats();
+    }
+
+    // the market session is over : the remaining sessions are closed
+    for (Market_Feed* feed : feeds){
+        feed->remove_wake_file(wake_file);
+    }
+    ring.reset();
+    for (auto& [socket, connection] : connections){
+        close(socket);
+        Session_Count--;
+    }
+    connections.clear(); // the sessions stop their mailboxes from writing the eventfd
+    close(wake_file);
+}
+#endif // URING_AVAILABLE
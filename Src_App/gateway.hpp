@@ -0,0 +1,351 @@
+//==========================================================================
+// File that defines the network gateway of the server : the client sessions and the event loop serving them
+//==========================================================================
+#ifndef GATEWAY_HPP
+#define GATEWAY_HPP
+#include "database_management.hpp"
+
+
+#include <deque>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <ucontext.h>
+#include "feed.hpp"
+#include "local_transport.hpp"
+#include "rate_limit.hpp"
+#include "session_journal.hpp"
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#define EPOLL_AVAILABLE
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define URING_AVAILABLE
+#endif
+#endif
+
+
+#define GATEWAY_MAX_EVENTS 256 // events handled by a reactor for each epoll_wait
+#define GATEWAY_WAIT_TIMEOUT 100 // milliseconds, a reactor checks the shutdown flag at least this often
+#define URING_QUEUE_DEPTH 4096 // entries of the submission queue of a ring
+#define URING_BUFFER_COUNT 4096 // receive buffers registered by a ring (power of two), each one of BUFFER_SIZE bytes
+#define URING_PARKED_MAX (64 * 1024) // bytes a ring keeps for a session waiting for a deferred response, its receive is cancelled beyond (armed again once they are handled)
+#define SESSION_COALESCE_SIZE (64 * 1024) // output a thread-per-client session keeps before writing it (a larger response goes in gathered writes)
+#define SESSION_MAX_FLUSH_DELAY 2 // milliseconds, a thread-per-client session handling pipelined requests writes its output at least this often
+#define SESSION_OUTPUT_HIGH_WATER (256 * 1024) // bytes of a streamed response an event loop session holds (output and mailbox), its producer waits for the client beyond
+#define SESSION_STREAM_STALL_TIMEOUT 10000 // milliseconds a streamed response waits for its client to take a chunk, the session is closed beyond
+#define RESPONSE_THREAD_COUNT 4 // threads producing the streamed responses of the event loop sessions (histories read from the database and the tick store)
+#define RESPONSE_STACK_SIZE (256 * 1024) // stack of the producer of a streamed response, it waits for its client on it without holding a response thread
+
+
+class Session;
+
+// how the kernel sends the bytes written to a TCP socket (no effect on the local sockets)
+enum class Send_Policy
+{
+    NO_DELAY, // the session coalesces its output itself, each write leaves at once (TCP_NODELAY)
+    CORKED // a response written in several calls : only full segments leave until the cork is removed (TCP_CORK)
+};
+void set_send_policy(const int& socket, const Send_Policy& policy);
+
+// process a request of a session (a view in the session's receive buffer, valid during the call), returns false if the session must be closed
+using Request_Handler = std::function<bool(Session& session, std::string_view request)>;
+// a response the request handler hands to another thread, which calls it (once) when the response is ready
+// (with the client the response authenticates, -1 if none : it is bound to the session once the response is sent)
+using Deferred_Response = std::function<void(std::string response, const ID& client_id)>;
+// writes a large response piece by piece (a history read row by row), on a response thread for an event loop session
+using Response_Producer = std::function<void(Response_Writer& writer)>;
+
+// a piece of a response computed by another thread (a whole response, or a chunk of a streamed one)
+struct Deferred_Chunk
+{
+    std::string tag; // correlation tag of the request
+    bool journaled; // the response is sequenced and kept in the stream of the client
+    std::string data;
+    bool last; // the chunk ends the response
+    ID client_id; // client authenticated by the response (-1 if none), bound to the session once it is sent
+};
+
+// the responses computed by other threads for a session, until its transport sends them (the session may be closed before they are ready)
+class Session_Mailbox
+{
+private:
+    std::mutex Mutex;
+    std::condition_variable Ready; // a response is complete
+    std::deque<Deferred_Chunk> Chunks; // ready to be sent, in order
+    size_t Queued_Size; // bytes of the chunks
+    size_t Pending; // responses expected and not complete yet
+    int Wake_File; // eventfd of the event loop of the session (-1 for a thread-per-client session, it waits instead)
+    bool Detached; // the session is closed
+    std::function<void()> Parked; // resumes the producer waiting for the client to take chunks (empty if none)
+    std::chrono::steady_clock::time_point Parked_Since; // when the producer was parked, or the client last took chunks
+
+public:
+    // constructor
+    Session_Mailbox(const int& wake_file);
+
+    void expect(); // a response will be posted
+    void post(std::string tag, const bool& journaled, std::string response, const ID& client_id); // a whole response is ready (from any thread), the event loop is woken up
+    bool post_chunk(const std::string& tag, const bool& journaled, const char* data, const size_t& length, const bool& last); // a chunk of a streamed response, queued at once (false once the session is closed : the producer stops)
+    bool is_full(); // SESSION_OUTPUT_HIGH_WATER bytes are queued, the producer must wait for the client
+    bool park(std::function<void()> resume); // keep the producer until the client took chunks (resume is called then, or when the session is closed), false if there is room already
+    bool take(std::vector<Deferred_Chunk>& chunks, const size_t& max_size); // move the chunks ready out (up to max_size bytes, at least one if max_size is not 0), true while some are still expected
+    bool has_chunks(); // chunks are ready to be taken
+    bool is_waiting(); // a response is expected, or its chunks are not all taken
+    bool is_stalled(); // a producer is parked and the client took nothing for SESSION_STREAM_STALL_TIMEOUT
+    void wait(); // until every response expected is ready
+    void detach(); // the session is closed, the event loop is not woken anymore and the producers stop
+};
+
+// a few threads producing the streamed responses of the event loop sessions : they read the database and wait for the slow clients, the event loops do not
+class Response_Workers
+{
+private:
+    std::deque<std::function<void()>> Tasks;
+    std::vector<std::thread> Threads;
+    std::mutex Mutex;
+    std::condition_variable Tasks_Available;
+    bool Stopping;
+
+    void run_worker(); // run the tasks until the workers stop
+
+public:
+    // constructor
+    Response_Workers(const size_t& thread_count);
+    // destructor
+    ~Response_Workers(); // the threads are stopped
+    Response_Workers(const Response_Workers&) = delete;
+    Response_Workers& operator=(const Response_Workers&) = delete;
+
+    void submit(std::function<void()> task); // run a task on a thread
+    void stop(); // stop the threads once their running task is over, the tasks still waiting are dropped (their sessions are closed)
+};
+
+// a streamed response of an event loop session : its producer runs on its own stack, so that it gives back its response thread while the client is slow
+// (it is suspended once SESSION_OUTPUT_HIGH_WATER bytes are queued, and submitted again when the event loop took them : a slow client holds a stack, not a thread)
+class Response_Stream
+{
+private:
+    std::shared_ptr<Session_Mailbox> Mailbox;
+    std::string Tag; // correlation tag of the request
+    bool Journaled; // the response is sequenced and kept in the stream of the client
+    Response_Producer Producer;
+    void* Stack; // a guard page, then RESPONSE_STACK_SIZE bytes
+    ucontext_t Context; // the producer
+    ucontext_t Caller; // the response thread running it
+    bool Done;
+
+    static void run_producer(unsigned int high, unsigned int low); // entry of the stack (the address of the stream in two halves)
+    void write_chunk(const char* data, const size_t& length, const bool& last); // sink of the producer, suspended while the mailbox is full
+
+public:
+    // constructor
+    Response_Stream(std::shared_ptr<Session_Mailbox> mailbox, std::string tag, const bool& journaled, Response_Producer producer); // throws if the stack can not be mapped
+    // destructor
+    ~Response_Stream(); // (a stream dropped while suspended, when the workers stop, does not unwind its producer)
+    Response_Stream(const Response_Stream&) = delete;
+    Response_Stream& operator=(const Response_Stream&) = delete;
+
+    static void run(const std::shared_ptr<Response_Stream>& stream, Response_Workers& workers); // run the producer on the calling response thread until it ends, or until it waits for its client
+};
+
+// state of a client connection : the requests are received in its frame buffer, the request handler writes the responses in it, the transport delivers them
+class Session
+{
+private:
+    int Socket;
+    bool Blocking; // a thread-per-client session sends right away, an event loop session keeps the output until the socket is writable
+    Frame_Buffer Input; // bytes received, read frame by frame
+    std::string Request; // request received in several frames, until its last frame
+    std::string Output; // frames waiting to be written (a thread-per-client session writes them at the end of each batch of requests)
+    size_t Output_Offset; // bytes of Output already written
+    std::chrono::steady_clock::time_point Output_Since; // when the oldest frame of the output of a thread-per-client session was queued
+    bool Corked; // a thread-per-client response larger than the output buffer is being written, the socket is corked until the batch ends
+    bool Closing; // the session is closed once its output is written
+    std::string Correlation_Tag; // sent before the responses of the request being processed (empty if the request has no correlation id)
+    bool Responding; // a response has been started (its last frame is not sent yet), the tag is already before it
+    bool Journaled; // the responses of the request being processed are sequenced once the session is resumed (the views are not, a client missing one asks it again)
+    ID Client_Id; // client whose password or token the session checked (-1 until then), the requests on the stream and the rate limits of a client go by it
+    bool Heartbeats; // the client sends heartbeats : the session sends them too, and is closed when the client stays silent
+    std::chrono::steady_clock::time_point Last_Received; // bytes received from the client
+    std::chrono::steady_clock::time_point Last_Sent; // frames queued for the client
+    int Wake_File; // eventfd of the event loop, woken when a deferred response is ready (-1 for a thread-per-client session)
+    std::shared_ptr<Session_Mailbox> Mailbox; // deferred responses (created by the first one)
+    Market_Feed* Feed; // market data feed the session is subscribed to (nullptr if none)
+    uint64_t Feed_Sequence; // next message of the feed to deliver (0 : the snapshot first)
+    bool Shared_Memory_Requested; // the client asked to move its requests and responses to shared memory rings
+    Client_Stream* Stream; // sequenced messages of the client, once it resumed its session (nullptr if not)
+    uint64_t Message_Sequence; // sequence of the message being sent (0 if it is not sequenced), its chunks are kept in the stream as they are framed
+    Rate_Limiter* Limiter; // rate limits of the requests (nullptr : none)
+    Rate_Buckets Rate; // tokens of the session
+    Response_Workers* Workers; // threads producing the streamed responses of an event loop session (nullptr : produced by the event loop)
+    bool Compression; // the client asked for the large responses to be compressed
+    std::unique_ptr<Deflate_Stream> Deflater; // compression of the response being sent (nullptr if it is sent as it is)
+    std::string Compressed; // compressed bytes of the last chunk
+
+    void send_chunk(const char* data, size_t length, const bool& last); // send a chunk of a response, compressed if the session asked for it and the response is large
+    void send_frames(const char* data, size_t length, const bool& last); // frame the data (split in frames of at most FRAME_MAX_SIZE bytes)
+    void write_frame(const char* data, const size_t& length, const bool& last); // keep a frame in the output (a thread-per-client session writes it with the output once it is full)
+    void write_sequenced(const uint64_t& sequence, std::string_view message); // keep a message of the stream in the output, after its sequence frame
+    bool handle_requests(const Request_Handler& handler); // handle the requests fully received, false if the session must be closed
+    bool handle_request(const Request_Handler& handler, std::string_view request); // handle a request the rate limits accept (the others are answered at once), false if the session must be closed
+    void flush_output(); // write the whole output of a thread-per-client session, then uncork its socket
+
+public:
+    // constructor
+    Session(const int& socket, const bool& blocking, const int& wake_file = -1);
+    // destructor
+    ~Session(); // the session stops being a subscriber of its feed, and stops sequencing the messages of its client
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    // getters
+    int get_socket() const;
+    bool has_output() const;
+    bool is_closing() const;
+    Frame_Buffer& get_input();
+    Market_Feed* get_feed() const;
+    ID get_client_id() const; // the client authenticated by the session, -1 if none
+
+    bool process_input(const Request_Handler& handler); // handle the requests fully received, false if the session must be closed
+    bool resume_input(const Request_Handler& handler); // handle the requests left in the frame buffer while a deferred response was sent, false if the session must be closed
+    bool check_heartbeat(const Heartbeat_Policy& policy); // send a heartbeat if nothing was sent during the interval, false if the client was silent for the timeout (or left a streamed response stalled)
+    void set_client_id(const ID& client_id); // bind the client whose password or token was checked
+    void set_correlation_tag(std::string tag); // tag the next responses (a frame before the first frame of each response), empty to stop
+    void set_journaled(const bool& enabled); // sequence and journal the responses of the request being processed (the default for each request), false for the responses a gap fill does not need
+    void set_rate_limiter(Rate_Limiter* limiter); // check the requests against the rate limits before handling them
+    void set_response_workers(Response_Workers* workers); // produce the streamed responses on these threads (event loop sessions)
+    void set_compression(const bool& enabled); // compress the responses of at least COMPRESSION_THRESHOLD bytes from the next one
+    bool resume(Client_Stream& stream, const std::optional<uint64_t>& last_seen); // sequence the next messages in the stream of the client, after sending the ones following the last one it saw (false if some of them are lost)
+    Deferred_Response defer(); // a response computed by another thread, with the correlation tag of the request (a thread-per-client session waits for it before the next request)
+    bool collect_deferred(); // send the deferred responses ready, true if some are still expected
+    bool has_deferred_chunks() const; // chunks of deferred responses are ready to be sent
+    bool is_deferring() const; // an event loop session waits for a deferred response : its next requests are not handled (nor received) until it is sent
+    void stream(const Response_Producer& producer); // send a large response as it is produced (on a response thread for an event loop session, its output never holds more than SESSION_OUTPUT_HIGH_WATER bytes of it)
+    void send(const std::string& data); // send a response to the client
+    void send(const char* data, const size_t& length);
+    Response_Sink get_sink(); // sink for a Response_Writer writing to this session (one response in several frames)
+    bool write_output(); // write as much of the output as the socket accepts, false on a socket error
+    bool write_output(const std::function<ssize_t(const char*, size_t)>& writer); // the same with another transport (the writer returns the bytes taken, 0 if it is full, -1 on error)
+    void take_output(std::string& output); // move the pending output out of the session (for the transports writing asynchronously)
+    void close_after_output(); // close the session once the output is written
+    bool subscribe(Market_Feed& feed); // deliver the feed to the session, from a snapshot (false for a thread-per-client session, the feed is pushed by the event loops)
+    void unsubscribe();
+    Feed_Delivery deliver_feed(const size_t& sending); // append the messages of the feed not delivered yet to the output, unless the output and the bytes being sent by the transport exceed the bound
+    bool request_shared_memory(); // ask the event loop to attach shared memory rings once the answer is written (false for a thread-per-client session)
+    bool has_shared_memory_request() const;
+    bool take_shared_memory_request(); // true once after a request (the flag is cleared)
+};
+
+// raise the limit of open file descriptors to its maximum (one descriptor per connected client)
+void raise_file_descriptor_limit();
+
+// create the TCP listen sockets of a port, one per acceptor thread (SO_REUSEPORT : the kernel spreads the new connections across them), empty on error
+std::vector<int> create_listen_sockets(const int& port, const size_t& count, const int& backlog);
+
+
+#ifdef EPOLL_AVAILABLE
+// a fixed set of reactor threads, each one with its own epoll instance and its own sessions, serving non-blocking sockets
+class Epoll_Gateway
+{
+private:
+    std::vector<int> Reactor_Listen_Sockets; // TCP, one per reactor (bound with SO_REUSEPORT, the kernel spreads the connections), non-blocking
+    std::vector<int> Shared_Listen_Sockets; // Unix-domain, shared by the reactors (EPOLLEXCLUSIVE wakes only one of them per connection)
+    size_t Reactor_Count;
+    Request_Handler Handler;
+    Heartbeat_Policy Heartbeat;
+    Rate_Limiter* Limiter; // nullptr : no rate limit
+    Response_Workers* Workers; // nullptr : the streamed responses are produced by the reactors
+    std::atomic<size_t> Session_Count;
+
+    void run_reactor(const int& listen_socket, const std::atomic<bool>& shutdown_flag); // event loop of one reactor thread, accepting from its own listen socket and the shared ones
+
+public:
+    // constructor
+    Epoll_Gateway(const std::vector<int>& reactor_listen_sockets, const std::vector<int>& shared_listen_sockets, Request_Handler handler, const Heartbeat_Policy& heartbeat, Rate_Limiter* limiter = nullptr, Response_Workers* workers = nullptr); // one reactor per socket of the first list
+    Epoll_Gateway(const Epoll_Gateway&) = delete;
+    Epoll_Gateway& operator=(const Epoll_Gateway&) = delete;
+
+    void run(const std::atomic<bool>& shutdown_flag); // run the reactors until the flag is set, then close the sessions
+    size_t get_session_count() const; // number of connected sessions
+};
+#endif // EPOLL_AVAILABLE
+
+
+#ifdef URING_AVAILABLE
+// an io_uring instance (submission and completion queues mapped in memory) used without liburing
+class Uring
+{
+private:
+    int Ring_File;
+    unsigned Entries;
+    void* Submission_Ring;
+    size_t Submission_Ring_Size;
+    void* Completion_Ring;
+    size_t Completion_Ring_Size;
+    io_uring_sqe* Submission_Entries;
+    unsigned* Submission_Head;
+    unsigned* Submission_Tail;
+    unsigned* Submission_Mask;
+    unsigned* Submission_Array;
+    unsigned* Completion_Head;
+    unsigned* Completion_Tail;
+    unsigned* Completion_Mask;
+    io_uring_cqe* Completion_Entries;
+    unsigned Local_Tail; // submission entries prepared but not submitted yet are between *Submission_Tail and Local_Tail
+    io_uring_buf_ring* Buffer_Ring; // ring of the registered receive buffers
+    size_t Buffer_Ring_Size;
+    unsigned Buffer_Count;
+    size_t Buffer_Size;
+    std::vector<char> Buffers; // memory of the registered receive buffers
+
+    void unmap(); // unmap the queues and close the ring
+
+public:
+    // constructor
+    Uring(const unsigned& entries); // create and map the ring, throws if the kernel refuses it
+    // destructor
+    ~Uring();
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    io_uring_sqe* get_submission_entry(); // get a free submission entry (the pending ones are submitted if the queue is full)
+    int submit_and_wait(const int& timeout_ms); // submit all the prepared entries and wait for a completion (or the timeout) with a single system call
+    void for_each_completion(const std::function<void(const io_uring_cqe&)>& callback); // consume the completions available
+    void register_buffers(const unsigned& count, const size_t& size, const uint16_t& group); // register a group of receive buffers the kernel picks from (multishot receive)
+    const char* get_buffer(const uint16_t& buffer_id) const; // get the memory of a receive buffer
+    void recycle_buffer(const uint16_t& buffer_id); // give back a receive buffer to the kernel
+};
+
+// a fixed set of threads, each one with its own io_uring : multishot accept and receive in registered buffers, and one system call per loop for all the submissions
+class Uring_Gateway
+{
+private:
+    std::vector<int> Ring_Listen_Sockets; // TCP, one per ring (SO_REUSEPORT)
+    std::vector<int> Shared_Listen_Sockets; // Unix-domain, a multishot accept of each ring on each of them
+    size_t Ring_Count;
+    Request_Handler Handler;
+    Heartbeat_Policy Heartbeat;
+    Rate_Limiter* Limiter; // nullptr : no rate limit
+    Response_Workers* Workers; // nullptr : the streamed responses are produced by the rings
+    std::atomic<size_t> Session_Count;
+
+    void run_ring(const int& listen_socket, const std::atomic<bool>& shutdown_flag); // event loop of one ring thread, accepting from its own listen socket and the shared ones
+
+public:
+    // constructor
+    Uring_Gateway(const std::vector<int>& ring_listen_sockets, const std::vector<int>& shared_listen_sockets, Request_Handler handler, const Heartbeat_Policy& heartbeat, Rate_Limiter* limiter = nullptr, Response_Workers* workers = nullptr); // one ring per socket of the first list
+    Uring_Gateway(const Uring_Gateway&) = delete;
+    Uring_Gateway& operator=(const Uring_Gateway&) = delete;
+
+    static bool is_supported(); // check that the kernel accepts the rings and the multishot operations
+    void run(const std::atomic<bool>& shutdown_flag); // run the rings until the flag is set, then close the sessions
+    size_t get_session_count() const; // number of connected sessions
+};
+#endif // URING_AVAILABLE
+
+
+#endif // GATEWAY_HPP
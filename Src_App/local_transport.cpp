@@ -0,0 +1,460 @@
+#include "local_transport.hpp"
+
+
+// create the Unix-domain listen socket of the server (the file of a previous run is removed), -1 on error
+int create_local_listen_socket(const std::string& path)
+{
+    struct sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)){
+        std::cerr << "Error: Local socket path too long: " << path << std::endl;
+        return -1;
+    }
+    int local_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (local_socket < 0){
+        perror("Error socket (local)");
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    unlink(path.c_str());
+    if (bind(local_socket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 || listen(local_socket, SOMAXCONN) < 0){
+        perror("Error bind (local)");
+        close(local_socket);
+        return -1;
+    }
+    return local_socket;
+}
+
+
+#ifdef SHARED_MEMORY_AVAILABLE
+// constructor
+Shared_Ring::Shared_Ring() : Header(nullptr), Data(nullptr), Size(0)
+{
+
+}
+
+Shared_Ring::Shared_Ring(char* memory, const int& index) : Header(reinterpret_cast<Shared_Ring_Header*>(memory) + index), Data(memory + SHARED_RING_HEADER_SPACE + index * SHARED_RING_SIZE), Size(SHARED_RING_SIZE)
+{
+    static_assert(2 * sizeof(Shared_Ring_Header) <= SHARED_RING_HEADER_SPACE, "the headers of the rings must fit before their data");
+    static_assert((SHARED_RING_SIZE & (SHARED_RING_SIZE - 1)) == 0, "the size of a ring must be a power of two");
+}
+
+
+// bytes written and not read yet, throws if the other process moved its position out of the ring
+// (the memory is shared with the client : a head beyond the tail, or a tail more than a ring ahead, would make the copies leave the ring)
+size_t Shared_Ring::get_used(const uint64_t& head, const uint64_t& tail) const
+{
+    uint64_t used = tail - head;
+    if (used > Size){
+        throw std::runtime_error(fmt::format("the positions of the shared ring are corrupted (head {}, tail {})", head, tail));
+    }
+    return used;
+}
+
+// copy as many bytes as fit, returns the number copied (throws if the positions are corrupted)
+size_t Shared_Ring::write(const char* data, const size_t& length)
+{
+    uint64_t tail = Header->tail.load(std::memory_order_relaxed); // only the writer moves it
+    uint64_t head = Header->head.load(std::memory_order_acquire);
+    size_t count = std::min<size_t>(length, Size - get_used(head, tail));
+    size_t offset = tail & (Size - 1);
+    size_t first = std::min(count, Size - offset);
+    std::memcpy(Data + offset, data, first);
+    std::memcpy(Data, data + first, count - first);
+    Header->tail.store(tail + count, std::memory_order_release);
+    return count;
+}
+
+// after a write : true if the reader sleeps and must be woken (the flag is cleared)
+bool Shared_Ring::take_reader_sleeping()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst); // the tail is visible before the flag is read (the reader does the opposite)
+    return Header->reader_sleeping.load(std::memory_order_relaxed) != 0 && Header->reader_sleeping.exchange(0) != 0;
+}
+
+// the ring is full : ask the reader to wake the writer, false if there is space already (no need to sleep)
+bool Shared_Ring::wait_for_space()
+{
+    Header->writer_waiting.store(1, std::memory_order_seq_cst);
+    if (get_used(Header->head.load(std::memory_order_seq_cst), Header->tail.load(std::memory_order_relaxed)) < Size){
+        Header->writer_waiting.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+// copy as many bytes as available, returns the number copied (throws if the positions are corrupted)
+size_t Shared_Ring::read(char* buffer, const size_t& length)
+{
+    uint64_t head = Header->head.load(std::memory_order_relaxed); // only the reader moves it
+    uint64_t tail = Header->tail.load(std::memory_order_acquire);
+    size_t count = std::min<size_t>(length, get_used(head, tail));
+    size_t offset = head & (Size - 1);
+    size_t first = std::min(count, Size - offset);
+    std::memcpy(buffer, Data + offset, first);
+    std::memcpy(buffer + first, Data, count - first);
+    Header->head.store(head + count, std::memory_order_release);
+    return count;
+}
+
+// after a read : true if the writer waits for space and must be woken (the flag is cleared)
+bool Shared_Ring::take_writer_waiting()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return Header->writer_waiting.load(std::memory_order_relaxed) != 0 && Header->writer_waiting.exchange(0) != 0;
+}
+
+// before sleeping : ask the writer to wake the reader, false if bytes arrived meanwhile (no need to sleep)
+bool Shared_Ring::prepare_sleep()
+{
+    Header->reader_sleeping.store(1, std::memory_order_seq_cst);
+    if (Header->head.load(std::memory_order_relaxed) != Header->tail.load(std::memory_order_seq_cst)){
+        Header->reader_sleeping.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+
+// bytes of a shared memory holding the two rings
+size_t shared_memory_size()
+{
+    return SHARED_RING_HEADER_SPACE + 2 * SHARED_RING_SIZE;
+}
+
+// write 1 in an eventfd
+static void wake(const int& wake_file)
+{
+    uint64_t one = 1;
+    if (write(wake_file, &one, sizeof(one)) < 0 && errno != EAGAIN){
+        perror("Error write (shared memory wake up)");
+    }
+}
+
+
+// the shared memory of a local client, on the server side
+// constructor : create the memory and the eventfds, throws if the system refuses them
+Shared_Memory_Channel::Shared_Memory_Channel() : Memory_File(-1), Memory(nullptr), Server_Wake(-1), Client_Wake(-1)
+{
+    Memory_File = memfd_create("stock_exchange_rings", MFD_CLOEXEC);
+    if (Memory_File < 0 || ftruncate(Memory_File, shared_memory_size()) < 0){
+        int error = errno;
+        if (Memory_File >= 0){
+            close(Memory_File);
+        }
+        throw std::runtime_error(std::string("Failed to create the shared memory: ") + strerror(error));
+    }
+    void* memory = mmap(nullptr, shared_memory_size(), PROT_READ | PROT_WRITE, MAP_SHARED, Memory_File, 0);
+    if (memory == MAP_FAILED){
+        close(Memory_File);
+        throw std::runtime_error("Failed to map the shared memory");
+    }
+    Memory = static_cast<char*>(memory);
+    for (int index = 0; index < 2; index++){
+        new (Memory + index * sizeof(Shared_Ring_Header)) Shared_Ring_Header(); // the memory of a new memfd is zeroed, the rings start empty
+    }
+    Requests = Shared_Ring(Memory, 0);
+    Responses = Shared_Ring(Memory, 1);
+    Server_Wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    Client_Wake = eventfd(0, EFD_CLOEXEC); // the client blocks on it
+    if (Server_Wake < 0 || Client_Wake < 0){
+        release();
+        throw std::runtime_error("Failed to create the eventfds of the shared memory");
+    }
+    Requests.prepare_sleep(); // the reactor waits for the first request on its eventfd
+}
+
+// destructor
+Shared_Memory_Channel::~Shared_Memory_Channel()
+{
+    release();
+}
+
+// unmap the memory and close the descriptors
+void Shared_Memory_Channel::release()
+{
+    if (Memory != nullptr){
+        munmap(Memory, shared_memory_size());
+        Memory = nullptr;
+    }
+    for (int* file : {&Memory_File, &Server_Wake, &Client_Wake}){
+        if (*file >= 0){
+            close(*file);
+            *file = -1;
+        }
+    }
+}
+
+int Shared_Memory_Channel::get_wake_file() const
+{
+    return Server_Wake;
+}
+
+// send the answer of the shm_attach request with the memory and the eventfds (SCM_RIGHTS) : the bytes sent, 0 if the socket buffer is full, -1 on error
+// (a non-blocking socket takes the small answer whole or not at all)
+ssize_t Shared_Memory_Channel::send_descriptors(const int& socket)
+{
+    std::string answer = fmt::format("{} {}", SHARED_MEMORY_ATTACHED, SHARED_RING_SIZE);
+    char header[FRAME_HEADER_SIZE];
+    write_frame_header(header, answer.size(), true);
+    struct iovec parts[2] = {{header, FRAME_HEADER_SIZE}, {answer.data(), answer.size()}};
+    int files[3] = {Memory_File, Server_Wake, Client_Wake};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(files))] = {};
+    struct msghdr message{};
+    message.msg_iov = parts;
+    message.msg_iovlen = 2;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr* control_message = CMSG_FIRSTHDR(&message);
+    control_message->cmsg_level = SOL_SOCKET;
+    control_message->cmsg_type = SCM_RIGHTS;
+    control_message->cmsg_len = CMSG_LEN(sizeof(files));
+    std::memcpy(CMSG_DATA(control_message), files, sizeof(files));
+    ssize_t sent = sendmsg(socket, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+        return 0;
+    }
+    if (sent != static_cast<ssize_t>(FRAME_HEADER_SIZE + answer.size())){
+        perror("Error sendmsg (shared memory)");
+        return -1;
+    }
+    return sent;
+}
+
+// copy the requests available in the frame buffer (as many bytes as fit)
+ssize_t Shared_Memory_Channel::receive(Frame_Buffer& input)
+{
+    size_t free_length;
+    char* free_space = input.get_free_space(free_length);
+    size_t length;
+    try {
+        length = Requests.read(free_space, free_length);
+    }
+    catch (const std::runtime_error& e){
+        std::cerr << "Error receiving from the shared memory: " << e.what() << std::endl;
+        return -1; // a protocol violation : the session is closed
+    }
+    input.commit(length);
+    if (length > 0 && Requests.take_writer_waiting()){
+        wake(Client_Wake);
+    }
+    return length;
+}
+
+// copy responses in the ring (as many bytes as fit, 0 if it is full, -1 if the client corrupted the ring)
+ssize_t Shared_Memory_Channel::send(const char* data, const size_t& length)
+{
+    size_t written = 0;
+    try {
+        written = Responses.write(data, length);
+        while (written < length && !Responses.wait_for_space()){
+            written += Responses.write(data + written, length - written); // the client read meanwhile
+        }
+    }
+    catch (const std::runtime_error& e){
+        std::cerr << "Error sending to the shared memory: " << e.what() << std::endl;
+        return -1; // a protocol violation : the session is closed
+    }
+    if (written > 0 && Responses.take_reader_sleeping()){
+        wake(Client_Wake);
+    }
+    return written; // the rest is sent when the client wakes the server up (it has read)
+}
+
+// consume the wake ups of the eventfd
+void Shared_Memory_Channel::clear_wake()
+{
+    uint64_t count;
+    while (read(Server_Wake, &count, sizeof(count)) > 0);
+}
+
+// before waiting for the eventfd : false if requests arrived meanwhile
+bool Shared_Memory_Channel::sleep()
+{
+    return Requests.prepare_sleep();
+}
+
+
+// the shared memory transport, on the client side
+// constructor : connect to the local socket and attach the shared memory, throws on failure
+Shared_Memory_Client::Shared_Memory_Client(const std::string& socket_path, const ID& client_id) : Socket(-1), Memory_File(-1), Memory(nullptr), Server_Wake(-1), Client_Wake(-1)
+{
+    struct sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Socket < 0 || connect(Socket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0){
+        int error = errno;
+        release();
+        throw std::runtime_error(std::string("Failed to connect to the local socket: ") + strerror(error));
+    }
+    std::string request = fmt::format("{} shm_attach", client_id);
+    send_frame(Socket, request.data(), request.size(), true);
+
+    // the answer is one frame, the descriptors come with it
+    char buffer[FRAME_HEADER_SIZE + 256];
+    int files[3] = {-1, -1, -1};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(files))] = {};
+    struct iovec part = {buffer, sizeof(buffer)};
+    struct msghdr message{};
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t length = recvmsg(Socket, &message, MSG_CMSG_CLOEXEC);
+    struct cmsghdr* control_message = CMSG_FIRSTHDR(&message);
+    if (length > FRAME_HEADER_SIZE && control_message != nullptr && control_message->cmsg_type == SCM_RIGHTS && control_message->cmsg_len == CMSG_LEN(sizeof(files))){
+        std::memcpy(files, CMSG_DATA(control_message), sizeof(files));
+    }
+    Memory_File = files[0];
+    Server_Wake = files[1];
+    Client_Wake = files[2];
+    if (Memory_File < 0){
+        std::string answer = length > FRAME_HEADER_SIZE ? std::string(buffer + FRAME_HEADER_SIZE, length - FRAME_HEADER_SIZE) : "no answer";
+        release();
+        throw std::runtime_error("The server refused the shared memory: " + answer);
+    }
+    void* memory = mmap(nullptr, shared_memory_size(), PROT_READ | PROT_WRITE, MAP_SHARED, Memory_File, 0);
+    if (memory == MAP_FAILED){
+        release();
+        throw std::runtime_error("Failed to map the shared memory");
+    }
+    Memory = static_cast<char*>(memory);
+    Requests = Shared_Ring(Memory, 0);
+    Responses = Shared_Ring(Memory, 1);
+}
+
+// destructor
+Shared_Memory_Client::~Shared_Memory_Client()
+{
+    release();
+}
+
+// unmap the memory and close the descriptors
+void Shared_Memory_Client::release()
+{
+    if (Memory != nullptr){
+        munmap(Memory, shared_memory_size());
+        Memory = nullptr;
+    }
+    for (int* file : {&Socket, &Memory_File, &Server_Wake, &Client_Wake}){
+        if (*file >= 0){
+            close(*file);
+            *file = -1;
+        }
+    }
+}
+
+// sleep on the eventfd of the client
+void Shared_Memory_Client::wait()
+{
+    uint64_t count;
+    if (read(Client_Wake, &count, sizeof(count)) < 0 && errno != EINTR){
+        throw std::runtime_error(std::string("Failed to wait for the server: ") + strerror(errno));
+    }
+}
+
+// send a request (in frames the receive buffer of a server session holds)
+void Shared_Memory_Client::send(const char* data, const size_t& length)
+{
+    size_t offset = 0;
+    do {
+        size_t frame_length = std::min<size_t>(length - offset, REQUEST_BUFFER_SIZE - FRAME_HEADER_SIZE);
+        char header[FRAME_HEADER_SIZE];
+        write_frame_header(header, frame_length, offset + frame_length == length);
+        for (auto [part, part_length] : {std::pair<const char*, size_t>{header, FRAME_HEADER_SIZE}, {data + offset, frame_length}}){
+            while (part_length > 0){
+                size_t written = Requests.write(part, part_length);
+                part += written;
+                part_length -= written;
+                if (part_length > 0 && Requests.wait_for_space()){
+                    if (Requests.take_reader_sleeping()){
+                        wake(Server_Wake); // the server must read for the ring to empty
+                    }
+                    wait();
+                }
+            }
+        }
+        offset += frame_length;
+    } while (offset < length);
+    if (Requests.take_reader_sleeping()){
+        wake(Server_Wake);
+    }
+}
+
+// receive a message, polling the ring before sleeping on the eventfd
+std::string Shared_Memory_Client::receive()
+{
+    std::string message;
+    Frame frame;
+    size_t empty_polls = 0;
+    while (true){
+        while (Input.next_frame(frame)){
+            message.append(frame.data, frame.size);
+            if (frame.last){
+                return message;
+            }
+        }
+        size_t free_length;
+        char* free_space = Input.get_free_space(free_length);
+        size_t length = Responses.read(free_space, free_length);
+        Input.commit(length);
+        if (length > 0){
+            empty_polls = 0;
+            if (Responses.take_writer_waiting()){
+                wake(Server_Wake); // the server has responses left to write
+            }
+            continue;
+        }
+        if (++empty_polls >= SHARED_MEMORY_SPIN_COUNT && Responses.prepare_sleep()){
+            wait();
+            empty_polls = 0;
+        }
+        std::this_thread::yield(); // the server may share the core
+    }
+}
+
+
+// measure the time of a hop through a ring (ping-pong between two threads polling a pair of rings), in nanoseconds
+void benchmark_shared_ring(const size_t& count)
+{
+    std::vector<char> memory(shared_memory_size() + alignof(Shared_Ring_Header));
+    char* aligned_memory = memory.data() + (alignof(Shared_Ring_Header) - reinterpret_cast<uintptr_t>(memory.data()) % alignof(Shared_Ring_Header)) % alignof(Shared_Ring_Header);
+    for (int index = 0; index < 2; index++){
+        new (aligned_memory + index * sizeof(Shared_Ring_Header)) Shared_Ring_Header();
+    }
+    Shared_Ring requests(aligned_memory, 0);
+    Shared_Ring responses(aligned_memory, 1);
+    New_Order order{}; // a message of the size of a binary order
+    std::thread echo([&](){
+        char buffer[sizeof(New_Order)];
+        for (size_t index = 0; index < count; ++index){
+            size_t received = 0;
+            while (received < sizeof(buffer)){
+                size_t length = requests.read(buffer + received, sizeof(buffer) - received);
+                received += length;
+                if (length == 0){
+                    std::this_thread::yield(); // the other thread may share the core
+                }
+            }
+            while (responses.write(buffer, sizeof(buffer)) == 0);
+        }
+    });
+    char buffer[sizeof(New_Order)];
+    auto start = std::chrono::steady_clock::now();
+    for (size_t index = 0; index < count; ++index){
+        while (requests.write(reinterpret_cast<const char*>(&order), sizeof(order)) == 0);
+        size_t received = 0;
+        while (received < sizeof(buffer)){
+            size_t length = responses.read(buffer + received, sizeof(buffer) - received);
+            received += length;
+            if (length == 0){
+                std::this_thread::yield();
+            }
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    echo.join();
+    std::cout << fmt::format("{} round trips of {} bytes in {} ms : {:.1f} ns per hop\n", count, sizeof(New_Order), elapsed / 1000000, static_cast<double>(elapsed) / std::max<size_t>(2 * count, 1));
+}
+#endif // SHARED_MEMORY_AVAILABLE
@@ -0,0 +1,132 @@
+//==========================================================================
+// File that defines the transports of the clients running on the same machine as the server :
+// a Unix-domain socket, and a pair of shared memory rings (requests, responses) attached through it
+//==========================================================================
+#ifndef LOCAL_TRANSPORT_HPP
+#define LOCAL_TRANSPORT_HPP
+#include "database_management.hpp"
+
+
+#include <sys/mman.h>
+#include <sys/un.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#define SHARED_MEMORY_AVAILABLE
+#endif
+#include "protocol.hpp"
+
+
+#define LOCAL_SOCKET_PATH "/tmp/stock_exchange.sock" // Unix-domain socket of the server, next to the TCP port
+#define SHARED_RING_SIZE (1 << 20) // bytes of each ring (power of two)
+#define SHARED_RING_HEADER_SPACE 4096 // the headers of the two rings, at the start of the shared memory
+#define SHARED_MEMORY_SPIN_COUNT 100000 // empty polls of a client before it sleeps on its eventfd
+#define SHARED_MEMORY_ATTACHED "SHARED_MEMORY_ATTACHED" // answer of a shm_attach request, it carries the descriptors
+
+
+// create the Unix-domain listen socket of the server (the file of a previous run is removed), -1 on error
+int create_local_listen_socket(const std::string& path);
+
+
+#ifdef SHARED_MEMORY_AVAILABLE
+// positions and sleep flags of a ring, each one in its own cache line (the two processes do not share a line they both write)
+struct Shared_Ring_Header
+{
+    alignas(64) std::atomic<uint64_t> head; // bytes read, moved by the reader only
+    alignas(64) std::atomic<uint64_t> tail; // bytes written, moved by the writer only
+    alignas(64) std::atomic<uint32_t> reader_sleeping; // the reader waits on its eventfd, the writer must wake it
+    std::atomic<uint32_t> writer_waiting; // the writer found the ring full, the reader must wake it once it has read
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the rings need lock-free atomics to be shared between processes");
+
+// a single-producer single-consumer byte ring in shared memory, carrying frames as a socket would
+class Shared_Ring
+{
+private:
+    Shared_Ring_Header* Header;
+    char* Data;
+    size_t Size;
+
+    size_t get_used(const uint64_t& head, const uint64_t& tail) const; // bytes written and not read yet, throws if the other process moved its position out of the ring
+
+public:
+    // constructor
+    Shared_Ring(); // not attached
+    Shared_Ring(char* memory, const int& index); // the ring index (0 : requests, 1 : responses) of a shared memory of shared_memory_size() bytes
+
+    // producer
+    size_t write(const char* data, const size_t& length); // copy as many bytes as fit, returns the number copied (throws if the positions are corrupted)
+    bool take_reader_sleeping(); // after a write : true if the reader sleeps and must be woken (the flag is cleared)
+    bool wait_for_space(); // the ring is full : ask the reader to wake the writer, false if there is space already (no need to sleep)
+
+    // consumer
+    size_t read(char* buffer, const size_t& length); // copy as many bytes as available, returns the number copied (throws if the positions are corrupted)
+    bool take_writer_waiting(); // after a read : true if the writer waits for space and must be woken (the flag is cleared)
+    bool prepare_sleep(); // before sleeping : ask the writer to wake the reader, false if bytes arrived meanwhile (no need to sleep)
+};
+
+// bytes of a shared memory holding the two rings
+size_t shared_memory_size();
+
+// the shared memory of a local client, on the server side : it is created by the server and its descriptors are sent to the client
+class Shared_Memory_Channel
+{
+private:
+    int Memory_File;
+    char* Memory;
+    int Server_Wake; // eventfd written by the client (requests written, or space in the responses), watched by the reactor
+    int Client_Wake; // eventfd written by the server (responses written, or space in the requests)
+    Shared_Ring Requests;
+    Shared_Ring Responses;
+
+    void release(); // unmap the memory and close the descriptors
+
+public:
+    // constructor
+    Shared_Memory_Channel(); // create the memory and the eventfds, throws if the system refuses them
+    // destructor
+    ~Shared_Memory_Channel();
+    Shared_Memory_Channel(const Shared_Memory_Channel&) = delete;
+    Shared_Memory_Channel& operator=(const Shared_Memory_Channel&) = delete;
+
+    int get_wake_file() const;
+    ssize_t send_descriptors(const int& socket); // send the answer of the shm_attach request with the memory and the eventfds (SCM_RIGHTS) : the bytes sent, 0 if the socket buffer is full, -1 on error
+    ssize_t receive(Frame_Buffer& input); // copy the requests available in the frame buffer (as many bytes as fit, -1 if the client corrupted the ring)
+    ssize_t send(const char* data, const size_t& length); // copy responses in the ring (as many bytes as fit, 0 if it is full, -1 if the client corrupted the ring)
+    void clear_wake(); // consume the wake ups of the eventfd
+    bool sleep(); // before waiting for the eventfd : false if requests arrived meanwhile
+};
+
+// the shared memory transport, on the client side
+class Shared_Memory_Client
+{
+private:
+    int Socket; // Unix-domain connection, closing it ends the session
+    int Memory_File;
+    char* Memory;
+    int Server_Wake;
+    int Client_Wake;
+    Shared_Ring Requests;
+    Shared_Ring Responses;
+    Frame_Buffer Input;
+
+    void release(); // unmap the memory and close the descriptors
+    void wait(); // sleep on the eventfd of the client
+
+public:
+    // constructor
+    Shared_Memory_Client(const std::string& socket_path, const ID& client_id); // connect to the local socket and attach the shared memory, throws on failure
+    // destructor
+    ~Shared_Memory_Client();
+    Shared_Memory_Client(const Shared_Memory_Client&) = delete;
+    Shared_Memory_Client& operator=(const Shared_Memory_Client&) = delete;
+
+    void send(const char* data, const size_t& length); // send a request (in frames the receive buffer of a server session holds)
+    std::string receive(); // receive a message, polling the ring before sleeping on the eventfd
+};
+
+// measure the time of a hop through a ring (ping-pong between two threads polling a pair of rings), in nanoseconds
+void benchmark_shared_ring(const size_t& count);
+#endif // SHARED_MEMORY_AVAILABLE
+
+
+#endif // LOCAL_TRANSPORT_HPP
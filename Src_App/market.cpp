@@ -2,13 +2,13 @@
 
 
 // constructor
-Market::Market(Database_Manager& database) : Exchange_Price(0.0), Database(database)
+Market::Market(Database_Manager& database) : Exchange_Price(0.0), Database(database), Ticks(std::make_unique<Tick_Store>(TICK_STORE_DIRECTORY)), Bars(std::make_unique<Bar_Aggregator>(database)), Feed(std::make_unique<Market_Feed>()), Sessions(std::make_unique<Session_Journal>(SESSION_JOURNAL_DIRECTORY)), Auth(std::make_unique<Auth_Service>(database)), Versions(std::make_unique<View_Versions>()), Snapshots(std::make_unique<Snapshot_Store>()), Book_Changed(true)
 {
 
 }
 
 // implement a move constructor
-Market::Market(Market&& other) noexcept : Buy_Orders(std::move(other.Buy_Orders)), Sell_Orders(std::move(other.Sell_Orders)), Exchange_Price(other.Exchange_Price), Database(other.Database)
+Market::Market(Market&& other) noexcept : Buy_Orders(std::move(other.Buy_Orders)), Sell_Orders(std::move(other.Sell_Orders)), Exchange_Price(other.Exchange_Price), Database(other.Database), Ticks(std::move(other.Ticks)), Bars(std::move(other.Bars)), Feed(std::move(other.Feed)), Sessions(std::move(other.Sessions)), Auth(std::move(other.Auth)), Versions(std::move(other.Versions)), Snapshots(std::move(other.Snapshots)), Book_Changed(other.Book_Changed.load())
 {
 
 }
@@ -20,6 +20,14 @@ Market& Market::operator=(Market&& other) noexcept
         Buy_Orders = std::move(other.Buy_Orders);
         Sell_Orders = std::move(other.Sell_Orders);
         Exchange_Price = other.Exchange_Price;
+        Ticks = std::move(other.Ticks);
+        Bars = std::move(other.Bars);
+        Feed = std::move(other.Feed);
+        Sessions = std::move(other.Sessions);
+        Auth = std::move(other.Auth);
+        Versions = std::move(other.Versions);
+        Snapshots = std::move(other.Snapshots);
+        Book_Changed = other.Book_Changed.load();
         // Database reference remains unchanged
     }
     return *this;
@@ -32,6 +40,41 @@ Database_Manager& Market::get_database() const
     return Database;
 }
 
+Tick_Store& Market::get_tick_store() const
+{
+    return *Ticks;
+}
+
+Bar_Aggregator& Market::get_bar_aggregator() const
+{
+    return *Bars;
+}
+
+Market_Feed& Market::get_feed() const
+{
+    return *Feed;
+}
+
+Session_Journal& Market::get_session_journal() const
+{
+    return *Sessions;
+}
+
+Auth_Service& Market::get_auth_service() const
+{
+    return *Auth;
+}
+
+View_Versions& Market::get_view_versions() const
+{
+    return *Versions;
+}
+
+const Snapshot_Store& Market::get_snapshots() const
+{
+    return *Snapshots;
+}
+
 
 // clients handling
 // deposit funds into the account of a client
@@ -39,6 +82,7 @@ void Market::deposit(const ID& client_id, const double& amount)
 {
     Client client(client_id, Database);
     client.deposit(amount);
+    client_changed(client_id);
 }
 
 // withdraw funds from the account of a client
@@ -46,6 +90,7 @@ void Market::withdraw(const ID& client_id, const double& amount)
 {
     Client client(client_id, Database);
     client.withdraw(amount);
+    client_changed(client_id);
 }
 
 // returns True if the amount can be withdrawn from the client balance
@@ -62,6 +107,27 @@ bool Market::has_shares(const ID& client_id, const ID& action_id, const int& qua
     return client.has_shares(action_id, quantity);
 }
 
+// amount reserved for a buy order of the client
+double Market::get_order_cost(const ID& client_id, const int& quantity, const double& price, const ID& action_id) const
+{
+    Client client(client_id, Database);
+    return client.get_order_cost(quantity, price, action_id);
+}
+
+// balance of the client minus the amount reserved for its pending orders
+double Market::get_available_balance(const ID& client_id) const
+{
+    Client client(client_id, Database);
+    return client.get_available_balance();
+}
+
+// quantity of an action in the portfolio of the client
+int Market::get_shares(const ID& client_id, const ID& action_id) const
+{
+    Client client(client_id, Database);
+    return client.get_shares(action_id);
+}
+
 // check if a client exists
 bool Market::client_exists(const ID& client_id) const
 {
@@ -82,56 +148,27 @@ bool Market::client_name_exists(const std::string& client_name) const
     return Database.execute_SQL_query_ID(query) != -1;
 }
 
-// check if a client is registered with the given name and password and return its ID
-ID Market::client_id_if_name_and_password_registered(const std::string& client_name, const std::string& client_password)
-{
-    ID client_id = -1;  // default value in case no client is found
-    // convert the client password to the appropriate encrypted format (binary)
-    std::vector<unsigned char> encrypted_password(client_password.begin(), client_password.end());
-
-    // prepare the SQL query to search for the client by name and encrypted password
-    std::string query = "SELECT client_id FROM clients WHERE name = ? AND encrypted_password = ?";
-
-    sqlite3_stmt* stmt;
-    // prepare the SQL query
-    if (sqlite3_prepare_v2(Database.get_database(), query.c_str(), -1, &stmt, nullptr) != SQLITE_OK){
-        std::cerr << "Error preparing SQL: " << sqlite3_errmsg(Database.get_database()) << std::endl;
-        return client_id;
-    }
-
-    // bind the client_name to the first placeholder
-    sqlite3_bind_text(stmt, 1, client_name.c_str(), -1, SQLITE_STATIC);
-    // bind the encrypted_password (as BLOB) to the second placeholder
-    sqlite3_bind_blob(stmt, 2, encrypted_password.data(), encrypted_password.size(), SQLITE_STATIC);
-
-    // execute the query
-    if (sqlite3_step(stmt) == SQLITE_ROW){
-        // fetch the client ID from the result
-        client_id = sqlite3_column_int(stmt, 0); // assuming the first column is the client_id
-    }
-    // finalize the statement
-    sqlite3_finalize(stmt);
-    return client_id;
-}
-
-// add a client to the market with its balance and portfolio (action_id and quantity)
+// add a client to the market with its balance and portfolio (action_id and quantity), the password is stored as a salted hash
 void Market::add_client(const ID& client_id, const std::string& client_name, const std::string& client_password, const double& balance, std::unordered_map<ID, int> portfolio)
 {
-    // convert the std::string password to std::vector<unsigned char> for storage as BLOB
-    std::vector<unsigned char> encrypted_password(client_password.begin(), client_password.end());
+    // PBKDF2 hash of the password with a salt of its own (the AES column stays empty)
+    std::string password_salt = random_bytes(PASSWORD_SALT_SIZE);
+    std::string password_hash = hash_password(client_password, password_salt, PASSWORD_HASH_ITERATIONS);
     
     // insert client into the "clients" table
-    std::string query = "INSERT INTO clients (client_id, name, encrypted_password, balance) VALUES (?, ?, ?, ?)";
+    std::string query = "INSERT INTO clients (client_id, name, encrypted_password, password_salt, password_hash, password_iterations, balance) VALUES (?, ?, X'', ?, ?, ?, ?)";
     sqlite3_stmt* stmt;
     if (sqlite3_prepare_v2(Database.get_database(), query.c_str(), -1, &stmt, nullptr) == SQLITE_OK){
         // bind client_id (INTEGER)
         sqlite3_bind_int(stmt, 1, client_id);
         // bind client_name (TEXT)
         sqlite3_bind_text(stmt, 2, client_name.c_str(), -1, SQLITE_STATIC);
-        // bind encrypted_password (BLOB)
-        sqlite3_bind_blob(stmt, 3, encrypted_password.data(), encrypted_password.size(), SQLITE_STATIC);
+        // bind the password salt and hash (BLOB) and the rounds of the hash (INTEGER)
+        sqlite3_bind_blob(stmt, 3, password_salt.data(), password_salt.size(), SQLITE_STATIC);
+        sqlite3_bind_blob(stmt, 4, password_hash.data(), password_hash.size(), SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 5, PASSWORD_HASH_ITERATIONS);
         // bind balance (REAL)
-        sqlite3_bind_double(stmt, 4, balance);
+        sqlite3_bind_double(stmt, 6, balance);
         // execute the insert statement
         if (sqlite3_step(stmt) != SQLITE_DONE){
             std::cerr << "Error inserting client into database: " << sqlite3_errmsg(Database.get_database()) << std::endl;
@@ -152,6 +189,7 @@ void Market::add_client(const ID& client_id, const std::string& client_name, con
         );
         Database.execute_SQL(query);
     }
+    client_changed(client_id);
 }
 
 // remove a client from the market
@@ -172,6 +210,8 @@ void Market::remove_client(const ID& client_id)
         client_id
     );
     Database.execute_SQL(query);
+    book_changed(client_id);
+    client_changed(client_id);
 }
 
 // get the client id from a client name
@@ -185,24 +225,26 @@ ID Market::get_client_id_from_name(const std::string& client_name) const
 }
 
 // update the portfolio of a client with a new action
-void Market::update_client_portfolio(const ID& client_id, const Order_Type& order_type, const ID& action_id, const int& quantity, const double& price, const ID& daily_time, const ID& date_time)
+void Market::update_client_portfolio(const ID& client_id, const Order_Type& order_type, const ID& action_id, const int& quantity, const double& price, const ID& time)
 {
     Client client(client_id, Database);
-    client.update_portfolio(order_type, action_id, quantity, price, daily_time, date_time);
+    client.update_portfolio(order_type, action_id, quantity, price, time);
+    client_changed(client_id);
 }
 
 // add an order to the completed orders of a client
-void Market::add_order_to_client_completed_orders(const ID& client_id, const ID& order_id, const ID& order_time_date, const ID& order_time_daily, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time_date, const ID& expiration_time_daily)
+void Market::add_order_to_client_completed_orders(const ID& client_id, const ID& order_id, const ID& order_time, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time)
 {
     Client client(client_id, Database);
-    client.add_completed_order(order_id, order_time_date, order_time_daily, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time_date, expiration_time_daily);
+    client.add_completed_order(order_id, order_time, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time);
 }
 
 // add an order to the pending orders of a client
-void Market::add_order_to_client_pending_orders(const ID& client_id, const ID& order_id, const ID& order_time_date, const ID& order_time_daily, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time_date, const ID& expiration_time_daily)
+void Market::add_order_to_client_pending_orders(const ID& client_id, const ID& order_id, const ID& order_time, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time)
 {
     Client client(client_id, Database);
-    client.add_pending_order(order_id, order_time_date, order_time_daily, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time_date, expiration_time_daily);
+    client.add_pending_order(order_id, order_time, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time);
+    book_changed(client_id);
 }
 
 // remove an order from the pending orders of a client
@@ -214,6 +256,7 @@ void Market::remove_order_from_client_pending_orders(const ID& client_id, const
         client_id
     );
     Database.execute_SQL(query);
+    book_changed(client_id);
 }
 
 
@@ -229,7 +272,7 @@ bool Market::action_exists(const ID& action_id) const
 }
 
 // add an action to the market
-void Market::add_action(const ID& action_id, const std::string& name, const int& quantity, const double& price, const ID& daily_time, const ID& date_time)
+void Market::add_action(const ID& action_id, const std::string& name, const int& quantity, const double& price, const ID& time)
 {
     // if the action is already in the market, we add the quantity
     if (action_exists(action_id)){
@@ -250,14 +293,9 @@ void Market::add_action(const ID& action_id, const std::string& name, const int&
         );
         Database.execute_SQL(query);
     }
-    std::string query2 = fmt::format(
-        "INSERT INTO prices (action_id, price, date_time, daily_time) VALUES ({}, {}, {}, {})",
-        action_id,
-        price,
-        daily_time,
-        date_time
-    );
-    Database.execute_SQL(query2);
+    Database.set_last_price(action_id, price, time);
+    Ticks->append(action_id, time, price, 0); // listing price
+    Versions->action_changed(action_id);
 }
 
 // remove an action from the market
@@ -273,16 +311,32 @@ void Market::remove_action(const ID& action_id)
         action_id
     );
     Database.execute_SQL(query);
+    Ticks->remove_action(action_id);
+    Bars->remove_action(action_id);
     query = fmt::format(
         "DELETE FROM orders WHERE action_id = {}",
         action_id
     );
     Database.execute_SQL(query);
+    Book_Changed = true;
     query = fmt::format(
         "DELETE FROM client_portfolio WHERE action_id = {}",
         action_id
     );
     Database.execute_SQL(query);
+    Versions->action_changed(action_id);
+    Snapshots->all_clients_changed(); // their shares and pending orders of the action are gone
+}
+
+// give the last price of each action (the last tick of the tick store) to the feed, once the history is imported
+void Market::load_last_prices()
+{
+    for (const ID& action_id : Database.execute_SQL_query_IDs("SELECT action_id FROM actions")){
+        std::optional<Tick> last_tick = Ticks->get_last_tick(action_id);
+        if (last_tick){
+            Feed->set_last_price(action_id, last_tick->time, last_tick->price);
+        }
+    }
 }
 
 // get the market value (sum of the values of all the actions)
@@ -292,21 +346,10 @@ double Market::get_market_value() const
         SELECT SUM(a.quantity * p.price) 
         FROM actions a 
         LEFT JOIN prices p ON a.action_id = p.action_id
-        WHERE (p.date_time, p.daily_time) = (
-            SELECT p2.date_time, p2.daily_time
+        WHERE p.time = (
+            SELECT MAX(p2.time)
             FROM prices p2
             WHERE p2.action_id = a.action_id
-            AND p2.date_time = (
-                SELECT MAX(date_time)
-                FROM prices
-                WHERE action_id = p2.action_id
-            )
-            AND p2.daily_time = (
-                SELECT MAX(daily_time)
-                FROM prices
-                WHERE action_id = p2.action_id
-                AND date_time = p2.date_time
-            )
         )
     )";
     return Database.execute_SQL_query_double(query);
@@ -315,7 +358,7 @@ double Market::get_market_value() const
 
 // market functionment
 // accumulate an order to the market and sort the orders by priority (add the order to the pending orders for the client)
-void Market::accumulate_order(const ID& client_id, const ID& order_id, const ID& order_time_date, const ID& order_time_daily, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time_date, const ID& expiration_time_daily)
+void Market::accumulate_order(const ID& client_id, const ID& order_id, const ID& order_time, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time)
 {
     // check if the client exists
     if (!client_exists(client_id)){
@@ -324,19 +367,20 @@ void Market::accumulate_order(const ID& client_id, const ID& order_id, const ID&
     }
 
     // add the order to the pending orders of the client
-    add_order_to_client_pending_orders(client_id, order_id, order_time_date, order_time_daily, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time_date, expiration_time_daily);
-
-    // create a shared pointer for the new order
-    auto order = std::make_unique<Order>(order_id, Database);
+    add_order_to_client_pending_orders(client_id, order_id, order_time, order_type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time);
 
     // accumulate the order to the market and sort the orders by priority
+    insert_order(std::make_unique<Order>(order_id, Database), order_type, action_id);
+}
+
+// insert an order in the market orders of its action, at its priority
+void Market::insert_order(std::unique_ptr<Order> order, const Order_Type& order_type, const ID& action_id)
+{
     if (order_type == Order_Type::BUY){
         auto buy_cmp = [](const std::unique_ptr<Order>& a, const std::unique_ptr<Order>& b){
             if (a->get_price() != b->get_price())
                 return a->get_price() > b->get_price(); // higher price first
-            if (a->get_date_order_time() != b->get_date_order_time())
-                return a->get_date_order_time() < b->get_date_order_time(); // earlier date first
-            return a->get_daily_order_time() < b->get_daily_order_time(); // earlier intraday time
+            return a->get_order_time() < b->get_order_time(); // earlier time first
         };
         auto& orders = Buy_Orders[action_id];
         auto it = std::lower_bound(orders.begin(), orders.end(), order, buy_cmp);
@@ -346,9 +390,7 @@ void Market::accumulate_order(const ID& client_id, const ID& order_id, const ID&
         auto sell_cmp = [](const std::unique_ptr<Order>& a, const std::unique_ptr<Order>& b){
             if (a->get_price() != b->get_price())
                 return a->get_price() < b->get_price(); // lower price first
-            if (a->get_date_order_time() != b->get_date_order_time())
-                return a->get_date_order_time() < b->get_date_order_time(); // earlier date first
-            return a->get_daily_order_time() < b->get_daily_order_time(); // earlier intraday time
+            return a->get_order_time() < b->get_order_time(); // earlier time first
         };
         auto& orders = Sell_Orders[action_id];
         auto it = std::lower_bound(orders.begin(), orders.end(), order, sell_cmp);
@@ -389,6 +431,132 @@ void Market::deaccumulate_order(const ID& client_id, const ID& order_id, const O
 
 }
 
+// cancel a pending order of the client (in the market orders or waiting for its trigger), false if it is not pending
+bool Market::cancel_order(const ID& client_id, const ID& order_id)
+{
+    std::string query = fmt::format(
+        "SELECT order_type, action_id FROM orders WHERE order_id = {} AND order_status = 'PENDING' AND client_id = {}",
+        order_id,
+        client_id
+    );
+    std::vector<std::vector<std::string>> rows = Database.execute_SQL_query_vec_strings(query);
+    if (rows.empty() || rows[0].size() < 2){
+        return false;
+    }
+    Order_Type order_type = string_to_order_type(rows[0][0]);
+    ID action_id = std::stoll(rows[0][1]);
+
+    remove_order_from_client_pending_orders(client_id, order_id);
+    // only the orders being matched are in the market orders, the others wait for their trigger in the database
+    auto& orders = (order_type == Order_Type::BUY) ? Buy_Orders[action_id] : Sell_Orders[action_id];
+    auto it = std::find_if(orders.begin(), orders.end(),
+        [&](const std::unique_ptr<Order>& o){
+            return o->get_order_id() == order_id;
+        });
+    if (it != orders.end()){
+        orders.erase(it);
+    }
+    return true;
+}
+
+// change the quantity and the price of a pending order of the client (it loses its time priority), the reason if it is refused
+std::optional<Reject_Reason> Market::amend_order(const ID& client_id, const ID& order_id, const int& quantity, const double& price, const ID& amend_time)
+{
+    std::string query = fmt::format(
+        "SELECT order_type, action_id, trigger_type, quantity, price FROM orders WHERE order_id = {} AND order_status = 'PENDING' AND client_id = {}",
+        order_id,
+        client_id
+    );
+    std::vector<std::vector<std::string>> rows = Database.execute_SQL_query_vec_strings(query);
+    if (rows.empty() || rows[0].size() < 5){
+        return Reject_Reason::UNKNOWN_ORDER;
+    }
+    Order_Type order_type = string_to_order_type(rows[0][0]);
+    ID action_id = std::stoll(rows[0][1]);
+    if (string_to_trigger(rows[0][2]) == Order_Trigger::MARKET){
+        return Reject_Reason::INVALID_TRIGGER; // a market order has no price to amend, it is matched as it comes
+    }
+
+    // the amended order must be covered as a new one would be : its own reservation is given back before the new cost is checked
+    Client client(client_id, Database);
+    if (order_type == Order_Type::BUY){
+        double reserved = std::stoi(rows[0][3]) * std::stod(rows[0][4]);
+        if (quantity * price > client.get_available_balance() + reserved){
+            return Reject_Reason::INSUFFICIENT_BALANCE;
+        }
+    }
+    else if (!client.has_shares(action_id, quantity)){
+        return Reject_Reason::INSUFFICIENT_SHARES;
+    }
+
+    query = fmt::format(
+        "UPDATE orders SET quantity = {}, price = {}, order_time = {} WHERE order_id = {} AND order_status = 'PENDING' AND client_id = {}",
+        quantity,
+        price,
+        amend_time,
+        order_id,
+        client_id
+    );
+    Database.execute_SQL(query);
+    book_changed(client_id);
+    // the order is sorted again in the market orders (if it is being matched)
+    auto& orders = (order_type == Order_Type::BUY) ? Buy_Orders[action_id] : Sell_Orders[action_id];
+    auto it = std::find_if(orders.begin(), orders.end(),
+        [&](const std::unique_ptr<Order>& o){
+            return o->get_order_id() == order_id;
+        });
+    if (it != orders.end()){
+        std::unique_ptr<Order> order = std::move(*it);
+        orders.erase(it);
+        insert_order(std::move(order), order_type, action_id);
+    }
+    return std::nullopt;
+}
+
+// create orders of a client in one statement (the market orders are accumulated, the others wait for their trigger), true if a market order was accumulated
+bool Market::add_orders(const ID& client_id, const std::vector<Order_Request>& orders)
+{
+    bool market_order_added = false;
+    Client client(client_id, Database);
+    client.add_pending_orders(orders);
+    book_changed(client_id);
+    // the market orders are matched right away, the others are read from the database when their trigger is reached
+    for (const Order_Request& order : orders){
+        if (order.trigger_type == Order_Trigger::MARKET){
+            insert_order(std::make_unique<Order>(order.order_id, Database), order.order_type, order.action_id);
+            market_order_added = true;
+        }
+    }
+    return market_order_added;
+}
+
+// cancel in one statement the pending orders of a client, of an action (-1 for all) and of a type (all if none), returns their ids
+std::vector<ID> Market::cancel_orders(const ID& client_id, const ID& action_id, const std::optional<Order_Type>& order_type)
+{
+    std::string filter = fmt::format("client_id = {} AND order_status = 'PENDING'", client_id);
+    if (action_id != -1){
+        filter += fmt::format(" AND action_id = {}", action_id);
+    }
+    if (order_type){
+        filter += fmt::format(" AND order_type = '{}'", order_type_to_string(*order_type));
+    }
+    std::vector<ID> cancelled_orders = Database.execute_SQL_query_IDs(fmt::format("DELETE FROM orders WHERE {} RETURNING order_id", filter)); // the ids of exactly the rows deleted
+    book_changed(client_id);
+
+    // only the orders being matched are in the market orders, the others waited for their trigger in the database
+    std::unordered_set<ID> cancelled(cancelled_orders.begin(), cancelled_orders.end());
+    auto is_cancelled = [&cancelled](const std::unique_ptr<Order>& order){
+        return cancelled.count(order->get_order_id()) > 0;
+    };
+    for (auto* orders : {&Buy_Orders, &Sell_Orders}){
+        for (auto& [order_action_id, action_orders] : *orders){
+            action_orders.erase(std::remove_if(action_orders.begin(), action_orders.end(), is_cancelled), action_orders.end());
+        }
+    }
+    return cancelled_orders;
+}
+
+
 // process the fixing of the price to order the transactions by priority and update the client's portfolio
 void Market::process_fixing()
 {
@@ -419,13 +587,11 @@ void Market::process_fixing()
         std::sort(orders.begin(), orders.end(), 
             [](const std::unique_ptr<Order>& a, const std::unique_ptr<Order>& b){
                 return (a->get_price() > b->get_price()) 
-                    || (a->get_price() == b->get_price() && a->get_date_order_time() < b->get_date_order_time())
-                    || (a->get_price() == b->get_price() && a->get_date_order_time() == b->get_date_order_time() && a->get_daily_order_time() < b->get_daily_order_time());});
+                    || (a->get_price() == b->get_price() && a->get_order_time() < b->get_order_time());});
         std::sort(sell_orders_for_action.begin(), sell_orders_for_action.end(), 
             [](const std::unique_ptr<Order>& a, const std::unique_ptr<Order>& b){
                 return (a->get_price() < b->get_price()) 
-                    || (a->get_price() == b->get_price() && a->get_date_order_time() < b->get_date_order_time())
-                    || (a->get_price() == b->get_price() && a->get_date_order_time() == b->get_date_order_time() && a->get_daily_order_time() < b->get_daily_order_time());});
+                    || (a->get_price() == b->get_price() && a->get_order_time() < b->get_order_time());});
 
         int buy_index = 0, sell_index = 0;
         while (buy_index < orders.size() && sell_index < sell_orders_for_action.size()){
@@ -437,43 +603,39 @@ void Market::process_fixing()
             // buyer 
             std::string buyer_order_info = buy_order->get_order_info();
             std::istringstream buyer_stream(buyer_order_info);
-            ID buyer_order_id, buyer_order_time_date, buyer_order_time_daily, buyer_client_id, buyer_expiration_time_date, buyer_expiration_time_daily;
+            ID buyer_order_id, buyer_order_time, buyer_client_id, buyer_expiration_time;
             std::string buyer_trigger_type_str;
             int buyer_quantity;
             double buyer_price, buyer_trigger_price_lower, buyer_trigger_price_upper;
             // extract the values
             buyer_stream >> buyer_order_id 
-                            >> buyer_order_time_date 
-                            >> buyer_order_time_daily 
+                            >> buyer_order_time 
                             >> buyer_client_id 
                             >> buyer_quantity 
                             >> buyer_trigger_type_str 
                             >> buyer_price 
                             >> buyer_trigger_price_lower 
                             >> buyer_trigger_price_upper 
-                            >> buyer_expiration_time_date 
-                            >> buyer_expiration_time_daily;
+                            >> buyer_expiration_time;
             Order_Trigger buyer_trigger_type = string_to_trigger(buyer_trigger_type_str);
 
             // seller
             std::string seller_order_info = sell_order->get_order_info();
             std::istringstream seller_stream(seller_order_info);
-            ID seller_order_id, seller_order_time_date, seller_order_time_daily, seller_client_id, seller_expiration_time_date, seller_expiration_time_daily;
+            ID seller_order_id, seller_order_time, seller_client_id, seller_expiration_time;
             std::string seller_trigger_type_str;
             int seller_quantity;
             double seller_price, seller_trigger_price_lower, seller_trigger_price_upper;
             // extract the values
             seller_stream >> seller_order_id 
-                            >> seller_order_time_date 
-                            >> seller_order_time_daily 
+                            >> seller_order_time 
                             >> seller_client_id 
                             >> seller_quantity 
                             >> seller_trigger_type_str 
                             >> seller_price 
                             >> seller_trigger_price_lower 
                             >> seller_trigger_price_upper 
-                            >> seller_expiration_time_date 
-                            >> seller_expiration_time_daily;
+                            >> seller_expiration_time;
             Order_Trigger seller_trigger_type = string_to_trigger(seller_trigger_type_str);
 
             // check if clients exist
@@ -496,12 +658,15 @@ void Market::process_fixing()
             int transaction_quantity = std::min(buyer_quantity, seller_quantity);
             Exchange_Price = seller_price;
             Time exchange_time = get_current_time_ms();
-            ID exchange_time_daily = get_daily_time(exchange_time);
-            ID exchange_time_date = get_date_time(exchange_time);
 
             // update the client's portfolio
-            update_client_portfolio(buyer_client_id, Order_Type::BUY, action_id, transaction_quantity, Exchange_Price, exchange_time_daily, exchange_time_date);
-            update_client_portfolio(seller_client_id, Order_Type::SELL, action_id, transaction_quantity, Exchange_Price, exchange_time_daily, exchange_time_date);
+            update_client_portfolio(buyer_client_id, Order_Type::BUY, action_id, transaction_quantity, Exchange_Price, exchange_time);
+            update_client_portfolio(seller_client_id, Order_Type::SELL, action_id, transaction_quantity, Exchange_Price, exchange_time);
+            Ticks->append(action_id, exchange_time, Exchange_Price, transaction_quantity);
+            Bars->add_trade(action_id, exchange_time, Exchange_Price, transaction_quantity);
+            Feed->publish_trade(action_id, exchange_time, Exchange_Price, transaction_quantity);
+            Book_Changed = true;
+            Versions->trade(action_id);
 
             // log transaction details
             std::string transaction_details = fmt::format(
@@ -528,19 +693,19 @@ void Market::process_fixing()
             
             // add executed portion to completed orders
             if (transaction_quantity > 0){
-                add_order_to_client_completed_orders(buyer_client_id, get_database().get_new_order_id(), exchange_time_date, exchange_time_daily, Order_Type::BUY, transaction_quantity, action_id, buyer_trigger_type, Exchange_Price, buyer_trigger_price_lower, buyer_trigger_price_upper, buyer_expiration_time_date, buyer_expiration_time_daily);
-                add_order_to_client_completed_orders(seller_client_id, get_database().get_new_order_id(), exchange_time_date, exchange_time_daily, Order_Type::SELL, transaction_quantity, action_id, seller_trigger_type, Exchange_Price, seller_trigger_price_lower, seller_trigger_price_upper, seller_expiration_time_date, seller_expiration_time_daily);
+                add_order_to_client_completed_orders(buyer_client_id, get_database().get_new_order_id(), exchange_time, Order_Type::BUY, transaction_quantity, action_id, buyer_trigger_type, Exchange_Price, buyer_trigger_price_lower, buyer_trigger_price_upper, buyer_expiration_time);
+                add_order_to_client_completed_orders(seller_client_id, get_database().get_new_order_id(), exchange_time, Order_Type::SELL, transaction_quantity, action_id, seller_trigger_type, Exchange_Price, seller_trigger_price_lower, seller_trigger_price_upper, seller_expiration_time);
             }
             // if there is remaining quantity, remove the old order and add an updated one
             if (buyer_quantity > transaction_quantity){
                 ID new_buyer_order_id = get_database().get_new_order_id();
-                add_order_to_client_pending_orders(buyer_client_id, new_buyer_order_id, buyer_order_time_date, buyer_order_time_daily, Order_Type::BUY, buyer_quantity - transaction_quantity, action_id, buyer_trigger_type, buyer_price, buyer_trigger_price_lower, buyer_trigger_price_upper, buyer_expiration_time_date, buyer_expiration_time_daily);
+                add_order_to_client_pending_orders(buyer_client_id, new_buyer_order_id, buyer_order_time, Order_Type::BUY, buyer_quantity - transaction_quantity, action_id, buyer_trigger_type, buyer_price, buyer_trigger_price_lower, buyer_trigger_price_upper, buyer_expiration_time);
                 Buy_Orders[action_id].push_back(std::make_unique<Order>(new_buyer_order_id, Database));
                 is_new_order_added = true;
             }
             if (seller_quantity > transaction_quantity){
                 ID new_seller_order_id = get_database().get_new_order_id();
-                add_order_to_client_pending_orders(seller_client_id, new_seller_order_id, seller_order_time_date, seller_order_time_daily, Order_Type::SELL, seller_quantity - transaction_quantity, action_id, seller_trigger_type, seller_price, seller_trigger_price_lower, seller_trigger_price_upper, seller_expiration_time_date, seller_expiration_time_daily);
+                add_order_to_client_pending_orders(seller_client_id, new_seller_order_id, seller_order_time, Order_Type::SELL, seller_quantity - transaction_quantity, action_id, seller_trigger_type, seller_price, seller_trigger_price_lower, seller_trigger_price_upper, seller_expiration_time);
                 Sell_Orders[action_id].push_back(std::make_unique<Order>(new_seller_order_id, Database));
                 is_new_order_added = true;
             }
@@ -609,43 +774,39 @@ void Market::process_continuous_trading()
                     // buyer 
                     std::string buyer_order_info = buy_order->get_order_info();
                     std::istringstream buyer_stream(buyer_order_info);
-                    ID buyer_order_id, buyer_order_time_date, buyer_order_time_daily, buyer_client_id, buyer_expiration_time_date, buyer_expiration_time_daily;
+                    ID buyer_order_id, buyer_order_time, buyer_client_id, buyer_expiration_time;
                     std::string buyer_trigger_type_str;
                     int buyer_quantity;
                     double buyer_price, buyer_trigger_price_lower, buyer_trigger_price_upper;
                     // extract the values
                     buyer_stream >> buyer_order_id 
-                                    >> buyer_order_time_date 
-                                    >> buyer_order_time_daily 
+                                    >> buyer_order_time 
                                     >> buyer_client_id 
                                     >> buyer_quantity 
                                     >> buyer_trigger_type_str 
                                     >> buyer_price 
                                     >> buyer_trigger_price_lower 
                                     >> buyer_trigger_price_upper 
-                                    >> buyer_expiration_time_date 
-                                    >> buyer_expiration_time_daily;
+                                    >> buyer_expiration_time;
                     Order_Trigger buyer_trigger_type = string_to_trigger(buyer_trigger_type_str);
 
                     // seller
                     std::string seller_order_info = sell_order->get_order_info();
                     std::istringstream seller_stream(seller_order_info);
-                    ID seller_order_id, seller_order_time_date, seller_order_time_daily, seller_client_id, seller_expiration_time_date, seller_expiration_time_daily;
+                    ID seller_order_id, seller_order_time, seller_client_id, seller_expiration_time;
                     std::string seller_trigger_type_str;
                     int seller_quantity;
                     double seller_price, seller_trigger_price_lower, seller_trigger_price_upper;
                     // extract the values
                     seller_stream >> seller_order_id 
-                                    >> seller_order_time_date 
-                                    >> seller_order_time_daily 
+                                    >> seller_order_time 
                                     >> seller_client_id 
                                     >> seller_quantity 
                                     >> seller_trigger_type_str 
                                     >> seller_price 
                                     >> seller_trigger_price_lower 
                                     >> seller_trigger_price_upper 
-                                    >> seller_expiration_time_date 
-                                    >> seller_expiration_time_daily;
+                                    >> seller_expiration_time;
                     Order_Trigger seller_trigger_type = string_to_trigger(seller_trigger_type_str);
 
                     // check if clients exist
@@ -658,12 +819,15 @@ void Market::process_continuous_trading()
                     int transaction_quantity = std::min(buyer_quantity, seller_quantity);
                     Exchange_Price = seller_price;
                     Time exchange_time = get_current_time_ms();
-                    ID exchange_time_daily = get_daily_time(exchange_time);
-                    ID exchange_time_date = get_date_time(exchange_time);
         
                     // update the client's portfolio
-                    update_client_portfolio(buyer_client_id, Order_Type::BUY, action_id, transaction_quantity, Exchange_Price, exchange_time_daily, exchange_time_date);
-                    update_client_portfolio(seller_client_id, Order_Type::SELL, action_id, transaction_quantity, Exchange_Price, exchange_time_daily, exchange_time_date);
+                    update_client_portfolio(buyer_client_id, Order_Type::BUY, action_id, transaction_quantity, Exchange_Price, exchange_time);
+                    update_client_portfolio(seller_client_id, Order_Type::SELL, action_id, transaction_quantity, Exchange_Price, exchange_time);
+                    Ticks->append(action_id, exchange_time, Exchange_Price, transaction_quantity);
+                    Bars->add_trade(action_id, exchange_time, Exchange_Price, transaction_quantity);
+                    Feed->publish_trade(action_id, exchange_time, Exchange_Price, transaction_quantity);
+                    Book_Changed = true;
+                    Versions->trade(action_id);
         
                     // log transaction details
                     std::string transaction_details = fmt::format(
@@ -690,20 +854,20 @@ void Market::process_continuous_trading()
                     
                     // add executed portion to completed orders
                     if (transaction_quantity > 0){
-                        add_order_to_client_completed_orders(buyer_client_id, get_database().get_new_order_id(), exchange_time_date, exchange_time_daily, Order_Type::BUY, transaction_quantity, action_id, buyer_trigger_type, Exchange_Price, buyer_trigger_price_lower, buyer_trigger_price_upper, buyer_expiration_time_date, buyer_expiration_time_daily);
-                        add_order_to_client_completed_orders(seller_client_id, get_database().get_new_order_id(), exchange_time_date, exchange_time_daily, Order_Type::SELL, transaction_quantity, action_id, seller_trigger_type, Exchange_Price, seller_trigger_price_lower, seller_trigger_price_upper, seller_expiration_time_date, seller_expiration_time_daily);
+                        add_order_to_client_completed_orders(buyer_client_id, get_database().get_new_order_id(), exchange_time, Order_Type::BUY, transaction_quantity, action_id, buyer_trigger_type, Exchange_Price, buyer_trigger_price_lower, buyer_trigger_price_upper, buyer_expiration_time);
+                        add_order_to_client_completed_orders(seller_client_id, get_database().get_new_order_id(), exchange_time, Order_Type::SELL, transaction_quantity, action_id, seller_trigger_type, Exchange_Price, seller_trigger_price_lower, seller_trigger_price_upper, seller_expiration_time);
                     }
 
                     // if there is remaining quantity, remove the old order and add an updated one
                     if (buyer_quantity > transaction_quantity){
                         ID new_buyer_order_id = get_database().get_new_order_id();
-                        add_order_to_client_pending_orders(buyer_client_id, new_buyer_order_id, buyer_order_time_date, buyer_order_time_daily, Order_Type::BUY, buyer_quantity-transaction_quantity, action_id, buyer_trigger_type, buyer_price, buyer_trigger_price_lower, buyer_trigger_price_upper, buyer_expiration_time_date, buyer_expiration_time_daily);
+                        add_order_to_client_pending_orders(buyer_client_id, new_buyer_order_id, buyer_order_time, Order_Type::BUY, buyer_quantity-transaction_quantity, action_id, buyer_trigger_type, buyer_price, buyer_trigger_price_lower, buyer_trigger_price_upper, buyer_expiration_time);
                         Buy_Orders[action_id].push_back(std::make_unique<Order>(new_buyer_order_id, Database));
                         is_new_order_added = true;
                     }
                     if (seller_quantity > transaction_quantity){
                         ID new_seller_order_id = get_database().get_new_order_id();
-                        add_order_to_client_pending_orders(seller_client_id, new_seller_order_id, seller_order_time_date, seller_order_time_daily, Order_Type::SELL, seller_quantity-transaction_quantity, action_id, seller_trigger_type, seller_price, seller_trigger_price_lower, seller_trigger_price_upper, seller_expiration_time_date, seller_expiration_time_daily);
+                        add_order_to_client_pending_orders(seller_client_id, new_seller_order_id, seller_order_time, Order_Type::SELL, seller_quantity-transaction_quantity, action_id, seller_trigger_type, seller_price, seller_trigger_price_lower, seller_trigger_price_upper, seller_expiration_time);
                         Sell_Orders[action_id].push_back(std::make_unique<Order>(new_seller_order_id, Database));
                         is_new_order_added = true;
                     }
@@ -734,112 +898,165 @@ void Market::process_continuous_trading()
     }
 }
 
+// pending orders of a client added, changed or removed : the book is published again, the market view gets a new version, the client a new snapshot
+void Market::book_changed(const ID& client_id)
+{
+    Book_Changed = true;
+    Versions->book_changed();
+    Snapshots->client_changed(client_id);
+}
 
-// string representation methods 
-// get the orders info as a string : order_time_date order_time_daily client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time_date expiration_time_daily,... (BUY then SELL orders)
-std::string Market::get_orders_info() const
-{    
-    // getting the buy orders
-    std::string buy_query = R"(SELECT o.order_time_date, o.order_time_daily, c.name, o.order_type, o.quantity, a.name, o.trigger_type, o.price, o.trigger_price_lower, o.trigger_price_upper, o.expiration_time_date, o.expiration_time_daily 
-                            FROM orders o JOIN actions a ON o.action_id = a.action_id JOIN clients c ON o.client_id = c.client_id
-                            WHERE o.order_type = 'BUY' AND o.order_status = 'PENDING')";
-                            // ORDER BY o.price DESC, o.time DESC)";
-    std::vector<std::vector<std::string>> buy_orders_info = Database.execute_SQL_query_vec_strings(buy_query);
-
-    // getting the sell orders
-    std::string sell_query = R"(SELECT o.order_time_date, o.order_time_daily, c.name, o.order_type, o.quantity, a.name, o.trigger_type, o.price, o.trigger_price_lower, o.trigger_price_upper, o.expiration_time_date, o.expiration_time_daily 
-                            FROM orders o JOIN actions a ON o.action_id = a.action_id JOIN clients c ON o.client_id = c.client_id
-                            WHERE o.order_type = 'SELL' AND o.order_status = 'PENDING')";
-                            // ORDER BY o.price ASC, o.time DESC)";
-    std::vector<std::vector<std::string>> sell_orders_info = Database.execute_SQL_query_vec_strings(sell_query);
-
-    // join the buy and sell orders info into a single string
-    std::string result;
-    // process buy orders
-    if (!buy_orders_info.empty()){
-        for (int i=0; i<buy_orders_info.size(); i++){
-            if (buy_orders_info[i].size() >= 12){
-                result += fmt::format(
-                    "{} {} {} {} {} {} {} {} {} {},",
-                    two_times_to_string(std::stoll(buy_orders_info[i][0]), std::stoll(buy_orders_info[i][1])),
-                    buy_orders_info[i][2],
-                    buy_orders_info[i][3],
-                    buy_orders_info[i][4],
-                    buy_orders_info[i][5],
-                    buy_orders_info[i][6],
-                    buy_orders_info[i][7],
-                    buy_orders_info[i][8],
-                    buy_orders_info[i][9],
-                    two_times_to_string(std::stoll(buy_orders_info[i][10]), std::stoll(buy_orders_info[i][11]))
-                );
-            }
+// balance or shares of a client changed : its portfolio gets a new version and a new snapshot
+void Market::client_changed(const ID& client_id)
+{
+    Versions->client_changed(client_id);
+    Snapshots->client_changed(client_id);
+}
+
+// publish in the feed the price levels changed since the last publication (nothing if no pending order changed)
+void Market::publish_book_changes()
+{
+    if (!Book_Changed.exchange(false)){
+        return;
+    }
+    Book_Levels levels;
+    std::vector<std::vector<std::string>> rows = Database.execute_SQL_query_vec_strings(std::string(sql_book_levels));
+    for (const auto& row : rows){
+        if (row.size() == 4){
+            levels[{std::stoll(row[0]), string_to_order_type(row[1]), std::stod(row[2])}] = std::stoll(row[3]);
         }
     }
-    // process sell orders
-    if (!sell_orders_info.empty()){
-        for (int i=0; i<sell_orders_info.size(); i++){
-            if (sell_orders_info[i].size() >= 12){
-                result += fmt::format(
-                    "{} {} {} {} {} {} {} {} {} {},",
-                    two_times_to_string(std::stoll(sell_orders_info[i][0]), std::stoll(sell_orders_info[i][1])),
-                    sell_orders_info[i][2],
-                    sell_orders_info[i][3],
-                    sell_orders_info[i][4],
-                    sell_orders_info[i][5],
-                    sell_orders_info[i][6],
-                    sell_orders_info[i][7],
-                    sell_orders_info[i][8],
-                    sell_orders_info[i][9],
-                    two_times_to_string(std::stoll(sell_orders_info[i][10]), std::stoll(sell_orders_info[i][11]))
-                );
+    Feed->publish_book(levels);
+}
+
+
+// build again the views changed since the last snapshots and swap them in (with the market mutex held : no order is matched meanwhile)
+// (the versions are read before the views : a change made meanwhile gives a newer version, built again at the next publication)
+void Market::publish_snapshots()
+{
+    std::shared_ptr<const Market_Snapshot> market = Snapshots->get_market();
+    if (!market || market->version != Versions->get_market_version()){
+        Snapshots->publish_market(build_market_snapshot());
+    }
+    bool all_clients = false;
+    std::vector<ID> changed = Snapshots->take_changed_clients(all_clients);
+    if (all_clients){
+        changed.clear();
+        for (const auto& row : Database.execute_SQL_query_vec_strings("SELECT client_id FROM clients")){
+            if (!row.empty()){
+                changed.push_back(std::stoll(row[0]));
             }
         }
     }
-    if (!result.empty()){
-        result.pop_back(); // remove trailing comma
+    if (changed.empty() && !all_clients){
+        return;
+    }
+    std::vector<std::pair<ID, std::shared_ptr<const Client_Snapshot>>> clients;
+    clients.reserve(changed.size());
+    for (const ID& client_id : changed){
+        clients.emplace_back(client_id, build_client_snapshot(client_id));
+    }
+    Snapshots->publish_clients(clients, all_clients);
+}
+
+// read the market view and the actions from the database
+std::shared_ptr<const Market_Snapshot> Market::build_market_snapshot() const
+{
+    auto market = std::make_shared<Market_Snapshot>();
+    market->version = Versions->get_market_version();
+    market->prices_version = Versions->get_prices_version();
+    market->market_info = get_market_info();
+    for (const auto& row : Database.execute_SQL_query_vec_strings("SELECT action_id, name, quantity FROM actions ORDER BY action_id ASC")){
+        if (row.size() == 3){
+            market->action_ids[std::stoll(row[0])] = market->actions.size();
+            market->action_names[row[1]] = market->actions.size();
+            market->actions.push_back(Action_Snapshot{std::stoll(row[0]), row[1], std::stoi(row[2]), false, 0.0, 0});
+        }
+    }
+    // the last price of each action, the last tick of the tick store (kept by the appends of the trades, nothing is scanned)
+    for (Action_Snapshot& action : market->actions){
+        std::optional<Tick> last_tick = Ticks->get_last_tick(action.action_id);
+        if (last_tick){
+            action.priced = true;
+            action.last_price = last_tick->price;
+            action.last_time = last_tick->time;
+        }
+    }
+    return market;
+}
+
+// read the balance, the shares and the pending orders of a client (nullptr if it does not exist)
+std::shared_ptr<const Client_Snapshot> Market::build_client_snapshot(const ID& client_id) const
+{
+    if (!client_exists(client_id)){
+        return nullptr;
+    }
+    auto snapshot = std::make_shared<Client_Snapshot>();
+    snapshot->version = Versions->get_client_version(client_id);
+    Client client(client_id, Database);
+    snapshot->balance = client.get_balance();
+    std::string query = fmt::format(sql_client_portfolio, client_id);
+    for (const auto& row : Database.execute_SQL_query_vec_strings(query)){
+        if (row.size() == 2){
+            snapshot->shares.emplace_back(std::stoll(row[0]), std::stoi(row[1]));
+        }
+    }
+    snapshot->pending_orders_info = client.get_pending_orders_info();
+    return snapshot;
+}
+
+// string representation methods 
+// get the orders info as a string : order_time client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time,... (BUY then SELL orders)
+std::string Market::get_orders_info() const
+{    
+    std::string result;
+    {
+        Response_Writer writer([&result](const char* data, size_t length, bool){ result.append(data, length); });
+        write_orders_info(writer);
     }
     return result;
 }
 
+// stream the orders info, row by row, in the writer
+void Market::write_orders_info(Response_Writer& writer) const
+{
+    // the buy orders
+    std::string buy_query = fmt::format(sql_pending_orders_of_side, "BUY");
+    ::write_orders_info(Database, buy_query, writer);
+
+    // the sell orders
+    std::string sell_query = fmt::format(sql_pending_orders_of_side, "SELL");
+    ::write_orders_info(Database, sell_query, writer);
+}
+
 // get the actions info as a string : action_name quantity last_price time,...
 std::string Market::get_actions_info() const
 {
-    std::string query = R"(SELECT a.name, a.quantity, p.price, p.daily_time, p.date_time
+    std::string query = R"(SELECT a.name, a.quantity, p.price, p.time
         FROM actions a LEFT JOIN prices p ON a.action_id = p.action_id
-        WHERE (p.date_time, p.daily_time) = (
-            SELECT p2.date_time, p2.daily_time
+        WHERE p.time = (
+            SELECT MAX(p2.time)
             FROM prices p2
             WHERE p2.action_id = a.action_id
-            AND p2.date_time = (
-                SELECT MAX(date_time)
-                FROM prices
-                WHERE action_id = p2.action_id
-            )
-            AND p2.daily_time = (
-                SELECT MAX(daily_time)
-                FROM prices
-                WHERE action_id = p2.action_id
-                AND date_time = p2.date_time
-            )
         )
     )";
     std::vector<std::vector<std::string>> market_action_info = Database.execute_SQL_query_vec_strings(query);
 
     // check if we have enough data before accessing elements
-    if (market_action_info.empty() || market_action_info[0].size() < 5){
+    if (market_action_info.empty() || market_action_info[0].size() < 4){
         return "";
     }
 
     // join the action info into a single string
     std::string result;
     for (const auto& action_info : market_action_info){
-        if (action_info.size() >= 5){
+        if (action_info.size() >= 4){
             result += fmt::format(
                 "{} {} {} {},",
                 action_info[0],
                 action_info[1], 
                 action_info[2],
-                two_times_to_string(std::stoll(action_info[3]), std::stoll(action_info[4]))
+                time_to_string(std::stoull(action_info[3]))
             );
         }
     }
@@ -849,7 +1066,7 @@ std::string Market::get_actions_info() const
     return result;
 }
 
-// get the market info as a string : market_value;order_time_date order_time_daily client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time_date expiration_time_daily,... (BUY then SELL orders);action_name quantity last_price time,...
+// get the market info as a string : market_value;order_time client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time,... (BUY then SELL orders);action_name quantity last_price time,...
 std::string Market::get_market_info() const
 {
     std::string result = fmt::format(
@@ -861,3 +1078,11 @@ std::string Market::get_market_info() const
     return result;
 }
 
+// stream the market info in the writer (the orders are not gathered in memory)
+void Market::write_market_info(Response_Writer& writer) const
+{
+    writer.write(fmt::format("{};", get_market_value()));
+    write_orders_info(writer);
+    writer.write(";" + get_actions_info());
+}
+
@@ -6,8 +6,13 @@
 #include "database_management.hpp"
 
 
+#include "auth.hpp"
 #include "client.hpp"
+#include "feed.hpp"
+#include "market_snapshot.hpp"
 #include "messages.hpp"
+#include "session_journal.hpp"
+#include "view_versions.hpp"
 
 
 class Market
@@ -18,6 +23,21 @@ private:
     std::unordered_map<ID, std::vector<std::unique_ptr<Order>>> Sell_Orders; // sell orders for each action (refered by the action id)
     double Exchange_Price; // price of the transaction
     Database_Manager& Database; // reference to the database manager for queries (actions and clients)
+    std::unique_ptr<Tick_Store> Ticks; // price history of the actions (columnar, compressed)
+    std::unique_ptr<Bar_Aggregator> Bars; // OHLCV bars of the actions, updated at each trade
+    std::unique_ptr<Market_Feed> Feed; // market data feed, the trades are published at once, the book by publish_book_changes
+    std::unique_ptr<Session_Journal> Sessions; // sequenced messages sent to each client, for the gap fill of a resumed session
+    std::unique_ptr<Auth_Service> Auth; // logins checked by worker threads, session tokens
+    std::unique_ptr<View_Versions> Versions; // versions of the market, portfolio and history views, a client polling an unchanged view gets NOT_MODIFIED
+    std::unique_ptr<Snapshot_Store> Snapshots; // views read by the display requests, published by publish_snapshots
+    std::atomic<bool> Book_Changed; // pending orders added, changed or removed since the last publication of the book
+
+    void book_changed(const ID& client_id); // pending orders of a client added, changed or removed : the book is published again, the market view gets a new version, the client a new snapshot
+    void client_changed(const ID& client_id); // balance or shares of a client changed : its portfolio gets a new version and a new snapshot
+    std::shared_ptr<const Market_Snapshot> build_market_snapshot() const; // read the market view and the actions from the database
+    std::shared_ptr<const Client_Snapshot> build_client_snapshot(const ID& client_id) const; // read the balance, the shares and the pending orders of a client (nullptr if it does not exist)
+
+    void insert_order(std::unique_ptr<Order> order, const Order_Type& order_type, const ID& action_id); // insert an order in the market orders of its action, at its priority
 
 public:
     // constructor
@@ -29,39 +49,57 @@ public:
 
     // getters
     Database_Manager& get_database() const;
+    Tick_Store& get_tick_store() const;
+    Bar_Aggregator& get_bar_aggregator() const;
+    Market_Feed& get_feed() const;
+    Session_Journal& get_session_journal() const;
+    Auth_Service& get_auth_service() const;
+    View_Versions& get_view_versions() const;
+    const Snapshot_Store& get_snapshots() const;
 
     // clients handling
     void deposit(const ID& client_id, const double& amount); // deposit funds into the account of a client
     void withdraw(const ID& client_id, const double& amount); // withdraw funds from the account of a client
     bool can_afford(const ID& client_id, const int& quantity, const double& price, const ID& action_id) const; // returns True if the amount can be withdrawn from the client balance
     bool has_shares(const ID& client_id, const ID& action_id, const int& quantity) const; // returns True if the action can be removed from the portfolio of the client
+    double get_order_cost(const ID& client_id, const int& quantity, const double& price, const ID& action_id) const; // amount reserved for a buy order of the client
+    double get_available_balance(const ID& client_id) const; // balance of the client minus the amount reserved for its pending orders
+    int get_shares(const ID& client_id, const ID& action_id) const; // quantity of an action in the portfolio of the client
     bool client_exists(const ID& client_id) const; // check if a client exists
     bool client_name_exists(const std::string& client_name) const; // check if a client exists with the given name
-    ID client_id_if_name_and_password_registered(const std::string& client_name, const std::string& client_password); // check if a client is registered with the given name and password and return its ID
-    void add_client(const ID& client_id, const std::string& client_name, const std::string& client_password, const double& balance, std::unordered_map<ID, int> portfolio); // add a client to the market with its balance and portfolio (action_id and quantity)
+    void add_client(const ID& client_id, const std::string& client_name, const std::string& client_password, const double& balance, std::unordered_map<ID, int> portfolio); // add a client to the market with its balance and portfolio (action_id and quantity), the password is stored as a salted hash
     void remove_client(const ID& client_id); // remove a client from the market
     ID get_client_id_from_name(const std::string& client_name) const; // get the client id from a client name
-    void update_client_portfolio(const ID& client_id, const Order_Type& order_type, const ID& action_id, const int& quantity, const double& price, const ID& daily_time, const ID& date_time); // update the portfolio of a client with a new action
-    void add_order_to_client_completed_orders(const ID& client_id, const ID& order_id, const ID& order_time_date, const ID& order_time_daily, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time_date, const ID& expiration_time_daily); // add an order to the completed orders of a client
-    void add_order_to_client_pending_orders(const ID& client_id, const ID& order_id, const ID& order_time_date, const ID& order_time_daily, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time_date, const ID& expiration_time_daily); // add an order to the pending orders of a client
+    void update_client_portfolio(const ID& client_id, const Order_Type& order_type, const ID& action_id, const int& quantity, const double& price, const ID& time); // update the portfolio of a client with a new action
+    void add_order_to_client_completed_orders(const ID& client_id, const ID& order_id, const ID& order_time, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time); // add an order to the completed orders of a client
+    void add_order_to_client_pending_orders(const ID& client_id, const ID& order_id, const ID& order_time, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time); // add an order to the pending orders of a client
     void remove_order_from_client_pending_orders(const ID& client_id, const ID& order_id); // remove an order from the pending orders of a client
 
     // actions handling
     bool action_exists(const ID& action_id) const; // check if an action exists
-    void add_action(const ID& action_id, const std::string& name, const int& quantity, const double& price, const ID& daily_time, const ID& date_time); // add an action to the market
+    void add_action(const ID& action_id, const std::string& name, const int& quantity, const double& price, const ID& time); // add an action to the market
     void remove_action(const ID& action_id); // remove an action from the market
+    void load_last_prices(); // give the last price of each action (the last tick of the tick store) to the feed, once the history is imported
     double get_market_value() const; // get the market value (sum of the values of all the actions)
 
     // market functionment
-    void accumulate_order(const ID& client_id, const ID& order_id, const ID& order_time_date, const ID& order_time_daily, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time_date, const ID& expiration_time_daily); // accumulate an order to the market and sort the orders by priority (add the order to the pending orders for the client)    
+    void accumulate_order(const ID& client_id, const ID& order_id, const ID& order_time, const Order_Type& order_type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& expiration_time); // accumulate an order to the market and sort the orders by priority (add the order to the pending orders for the client)    
     void deaccumulate_order(const ID& client_id, const ID& order_id,  const Order_Type& order_type, const ID& action_id); // remove an order from the pending orders of the client (if it exists) and remove it from the market orders by making again the market sorting
+    bool cancel_order(const ID& client_id, const ID& order_id); // cancel a pending order of the client (in the market orders or waiting for its trigger), false if it is not pending
+    std::optional<Reject_Reason> amend_order(const ID& client_id, const ID& order_id, const int& quantity, const double& price, const ID& amend_time); // change the quantity and the price of a pending order of the client (it loses its time priority), the reason if it is refused (not pending, a market order, not covered by the balance or the shares)
+    bool add_orders(const ID& client_id, const std::vector<Order_Request>& orders); // create orders of a client in one transaction (the market orders are accumulated, the others wait for their trigger), true if a market order was accumulated
+    std::vector<ID> cancel_orders(const ID& client_id, const ID& action_id, const std::optional<Order_Type>& order_type); // cancel in one transaction the pending orders of a client, of an action (-1 for all) and of a type (all if none), returns their ids
     void process_fixing(); // process the fixing of the price to order the transactions by priority
     void process_continuous_trading(); // process the continuous trading of the market, transactions between buyers and sellers of different actions
+    void publish_book_changes(); // publish in the feed the price levels changed since the last publication (nothing if no pending order changed)
+    void publish_snapshots(); // build again the views changed since the last snapshots and swap them in (with the market mutex held : no order is matched meanwhile)
 
     // string representation methods
-    std::string get_orders_info() const; // get the orders info as a string : order_time_date order_time_daily client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time_date expiration_time_daily,... (BUY then SELL orders)
+    std::string get_orders_info() const; // get the orders info as a string : order_time client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time,... (BUY then SELL orders)
+    void write_orders_info(Response_Writer& writer) const; // stream the orders info, row by row, in the writer (same format)
     std::string get_actions_info() const; // get the actions info as a string : action_name quantity last_price time,...
-    std::string get_market_info() const; // get the market info as a string : market_value;order_time_date order_time_daily client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time_date expiration_time_daily,... (BUY then SELL orders);action_name quantity last_price time,...
+    std::string get_market_info() const; // get the market info as a string : market_value;order_time client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time,... (BUY then SELL orders);action_name quantity last_price time,...
+    void write_market_info(Response_Writer& writer) const; // stream the market info in the writer (same format)
 };
 
 
@@ -0,0 +1,117 @@
+#include "market_snapshot.hpp"
+
+
+// nullptr if no action has this name
+const Action_Snapshot* Market_Snapshot::find_action(std::string_view name) const
+{
+    auto it = action_names.find(std::string(name));
+    return it == action_names.end() ? nullptr : &actions[it->second];
+}
+
+const Action_Snapshot* Market_Snapshot::find_action(const ID& action_id) const
+{
+    auto it = action_ids.find(action_id);
+    return it == action_ids.end() ? nullptr : &actions[it->second];
+}
+
+
+// as Client::get_portfolio_info, with the last prices of the market snapshot (the actions without a price are not shown)
+std::string Client_Snapshot::get_portfolio_info(const Market_Snapshot& market) const
+{
+    std::vector<Portfolio_Row> rows;
+    rows.reserve(shares.size());
+    for (const auto& [action_id, quantity] : shares){
+        const Action_Snapshot* action = market.find_action(action_id);
+        if (action != nullptr && action->priced){
+            rows.push_back(Portfolio_Row{action->name, quantity, action->last_price, action->last_time});
+        }
+    }
+    return format_portfolio_info(balance, rows);
+}
+
+uint64_t Client_Snapshot::get_portfolio_version(const Market_Snapshot& market) const
+{
+    return std::max(version, market.prices_version);
+}
+
+
+// constructor
+Snapshot_Store::Snapshot_Store() : Market(nullptr), All_Clients_Changed(true)
+{
+    for (auto& shard : Clients){
+        shard.store(std::make_shared<const Client_Snapshots>());
+    }
+}
+
+void Snapshot_Store::client_changed(const ID& client_id)
+{
+    std::lock_guard<std::mutex> lock(Changed_Mutex);
+    Changed_Clients.insert(client_id);
+}
+
+void Snapshot_Store::all_clients_changed()
+{
+    std::lock_guard<std::mutex> lock(Changed_Mutex);
+    All_Clients_Changed = true;
+}
+
+// the clients to build again, all of them if all_clients is set
+std::vector<ID> Snapshot_Store::take_changed_clients(bool& all_clients)
+{
+    std::lock_guard<std::mutex> lock(Changed_Mutex);
+    std::vector<ID> changed(Changed_Clients.begin(), Changed_Clients.end());
+    Changed_Clients.clear();
+    all_clients = All_Clients_Changed;
+    All_Clients_Changed = false;
+    return changed;
+}
+
+
+void Snapshot_Store::publish_market(std::shared_ptr<const Market_Snapshot> market)
+{
+    std::lock_guard<std::mutex> lock(Publish_Mutex);
+    Market.store(std::move(market), std::memory_order_release);
+}
+
+// a nullptr removes the client, all_clients drops the clients not given
+void Snapshot_Store::publish_clients(const std::vector<std::pair<ID, std::shared_ptr<const Client_Snapshot>>>& clients, const bool& all_clients)
+{
+    std::lock_guard<std::mutex> lock(Publish_Mutex);
+    // each shard changed is copied once, whatever the number of its clients changed
+    std::array<std::shared_ptr<Client_Snapshots>, SNAPSHOT_CLIENT_SHARDS> shards;
+    for (const auto& [client_id, client] : clients){
+        size_t index = static_cast<uint64_t>(client_id) % SNAPSHOT_CLIENT_SHARDS;
+        if (!shards[index]){
+            shards[index] = all_clients ? std::make_shared<Client_Snapshots>() : std::make_shared<Client_Snapshots>(*Clients[index].load(std::memory_order_acquire));
+        }
+        if (client){
+            (*shards[index])[client_id] = client;
+        }
+        else {
+            shards[index]->erase(client_id);
+        }
+    }
+    for (size_t index = 0; index < SNAPSHOT_CLIENT_SHARDS; index++){
+        if (shards[index]){
+            Clients[index].store(std::move(shards[index]), std::memory_order_release);
+        }
+        else if (all_clients){
+            Clients[index].store(std::make_shared<const Client_Snapshots>(), std::memory_order_release);
+        }
+    }
+}
+
+
+// nullptr before the first publication
+std::shared_ptr<const Market_Snapshot> Snapshot_Store::get_market() const
+{
+    return Market.load(std::memory_order_acquire);
+}
+
+// nullptr if the client is unknown
+std::shared_ptr<const Client_Snapshot> Snapshot_Store::get_client(const ID& client_id) const
+{
+    std::shared_ptr<const Client_Snapshots> shard = Clients[static_cast<uint64_t>(client_id) % SNAPSHOT_CLIENT_SHARDS].load(std::memory_order_acquire);
+    auto it = shard->find(client_id);
+    return it == shard->end() ? nullptr : it->second;
+}
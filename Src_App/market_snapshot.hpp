@@ -0,0 +1,89 @@
+//==========================================================================
+// File that defines the snapshots of the market read by the display requests : immutable views of the book, of the actions and of each client,
+// built by the engine after each batch of changes and swapped in at once, so that a reader takes no lock and never queries the database
+//==========================================================================
+#ifndef MARKET_SNAPSHOT_HPP
+#define MARKET_SNAPSHOT_HPP
+#include "database_management.hpp"
+
+
+#include <array>
+#include <unordered_set>
+#include "client.hpp"
+
+
+#define SNAPSHOT_CLIENT_SHARDS 64 // the snapshots of the clients are split in this many maps : a change of one client copies only the map of its shard
+
+
+// an action as displayed
+struct Action_Snapshot
+{
+    ID action_id;
+    std::string name;
+    int quantity;
+    bool priced; // false if the action has no price yet
+    double last_price;
+    Time last_time;
+};
+
+// the market as displayed, with the actions (the names of the display requests, the last prices of the portfolios)
+struct Market_Snapshot
+{
+    uint64_t version; // version of the market view
+    uint64_t prices_version; // version of the last prices
+    std::string market_info; // market_value;orders;actions (as Market::get_market_info)
+    std::vector<Action_Snapshot> actions; // by action id
+    std::unordered_map<std::string, size_t> action_names; // index in actions, by name
+    std::unordered_map<ID, size_t> action_ids; // index in actions, by action id
+
+    const Action_Snapshot* find_action(std::string_view name) const; // nullptr if no action has this name
+    const Action_Snapshot* find_action(const ID& action_id) const;
+};
+
+// a client as displayed
+struct Client_Snapshot
+{
+    uint64_t version; // version of the balance and shares (the portfolio has the latest of it and of the prices)
+    double balance;
+    std::vector<std::pair<ID, int>> shares; // quantity of each action held, by action id
+    std::string pending_orders_info; // as Client::get_pending_orders_info
+
+    std::string get_portfolio_info(const Market_Snapshot& market) const; // as Client::get_portfolio_info, with the last prices of the market snapshot
+    uint64_t get_portfolio_version(const Market_Snapshot& market) const;
+};
+
+using Client_Snapshots = std::unordered_map<ID, std::shared_ptr<const Client_Snapshot>>;
+
+// the last snapshots published : a reader loads a pointer and keeps the snapshot alive as long as it reads it, a writer builds a new one and swaps the pointer
+class Snapshot_Store
+{
+private:
+    std::atomic<std::shared_ptr<const Market_Snapshot>> Market;
+    std::array<std::atomic<std::shared_ptr<const Client_Snapshots>>, SNAPSHOT_CLIENT_SHARDS> Clients;
+    std::mutex Publish_Mutex; // one writer at a time (the readers never take it)
+    std::mutex Changed_Mutex;
+    std::unordered_set<ID> Changed_Clients; // clients changed since their last snapshot
+    bool All_Clients_Changed; // every client is built again (the start, an action removed)
+
+public:
+    // constructor
+    Snapshot_Store();
+    Snapshot_Store(const Snapshot_Store&) = delete;
+    Snapshot_Store& operator=(const Snapshot_Store&) = delete;
+
+    // changes (marked once the change is done, the next publication builds the client again)
+    void client_changed(const ID& client_id);
+    void all_clients_changed();
+    std::vector<ID> take_changed_clients(bool& all_clients); // the clients to build again, all of them if all_clients is set
+
+    // publication
+    void publish_market(std::shared_ptr<const Market_Snapshot> market);
+    void publish_clients(const std::vector<std::pair<ID, std::shared_ptr<const Client_Snapshot>>>& clients, const bool& all_clients); // a nullptr removes the client, all_clients drops the clients not given
+
+    // reading (no lock)
+    std::shared_ptr<const Market_Snapshot> get_market() const; // nullptr before the first publication
+    std::shared_ptr<const Client_Snapshot> get_client(const ID& client_id) const; // nullptr if the client is unknown
+};
+
+
+#endif // MARKET_SNAPSHOT_HPP
@@ -96,10 +96,8 @@ void Message::log_message(const ID& client_id, const Sender& message_sender, con
             type = "ERROR";
             break;
     }
-    ID message_daily_time = get_daily_time(time);
-    ID message_date_time = get_date_time(time);
     std::ostringstream query;
-    query << "INSERT INTO messages (message_id, client_id, message_sender, message_type, content, daily_time, date_time) VALUES (" << Message_Id << ", " << client_id << ", '" << sender << "', '" << type << "', '" << content << "', " << message_daily_time << ", " << message_date_time << ")";
+    query << "INSERT INTO messages (message_id, client_id, message_sender, message_type, content, time) VALUES (" << Message_Id << ", " << client_id << ", '" << sender << "', '" << type << "', '" << content << "', " << time << ")";
     Database.execute_SQL(query.str());
 }
 
@@ -108,12 +106,12 @@ void Message::log_message(const ID& client_id, const Sender& message_sender, con
 void Message::display_message() const
 {   
     std::ostringstream query;
-    query << "SELECT client_id, message_sender, message_type, content, daily_time, date_time FROM messages WHERE message_id = " << Message_Id;
+    query << "SELECT client_id, message_sender, message_type, content, time FROM messages WHERE message_id = " << Message_Id;
     std::vector<std::vector<std::string>> message_info = Database.execute_SQL_query_vec_strings(query.str());
     if (message_info.empty()){
         std::cerr << "Error: Message not found.\n";
         return;
     }
-    std::cout << "Message ID: " << Message_Id << ", Client ID: " << message_info[0][0] << ", Sender: " << message_info[0][1] << ", Type: " << message_info[0][2] << ", Content: " << message_info[0][3] << ",Time: " << two_times_to_string(std::stoll(message_info[0][5]), std::stoll(message_info[0][4])) << "\n";
+    std::cout << "Message ID: " << Message_Id << ", Client ID: " << message_info[0][0] << ", Sender: " << message_info[0][1] << ", Type: " << message_info[0][2] << ", Content: " << message_info[0][3] << ",Time: " << time_to_string(std::stoull(message_info[0][4])) << "\n";
 }
 
@@ -75,19 +75,10 @@ ID Order::get_order_id() const
     return Order_Id;
 }
 
-ID Order::get_date_order_time() const
+ID Order::get_order_time() const
 {   
     std::string query = fmt::format(
-        "SELECT order_time_date FROM orders WHERE order_id = {}",
-        get_order_id()
-    );
-    return Database.execute_SQL_query_ID(query);
-}
-
-ID Order::get_daily_order_time() const
-{   
-    std::string query = fmt::format(
-        "SELECT order_time_daily FROM orders WHERE order_id = {}",
+        "SELECT order_time FROM orders WHERE order_id = {}",
         get_order_id()
     );
     return Database.execute_SQL_query_ID(query);
@@ -128,22 +119,22 @@ void Order::set_quantity(const int& new_quantity)
 
 
 // string representation methods for market usage
-// get the order info as a string : order_id order_time_date order_time_daily client_id quantity trigger_type price trigger_price_lower trigger_price_upper expiration_time_date expiration_time_daily
+// get the order info as a string : order_id order_time client_id quantity trigger_type price trigger_price_lower trigger_price_upper expiration_time
 std::string Order::get_order_info() const
 {   
     std::string query = fmt::format(
-        "SELECT order_id, order_time_date, order_time_daily, client_id, quantity, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time_date, expiration_time_daily FROM orders WHERE order_id = {}",
+        "SELECT order_id, order_time, client_id, quantity, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time FROM orders WHERE order_id = {}",
         get_order_id()
     );
     std::vector<std::vector<std::string>> order_info = Database.execute_SQL_query_vec_strings(query);
     
     // check if we have enough data before accessing elements
-    if (order_info.empty() || order_info[0].size() < 11){
+    if (order_info.empty() || order_info[0].size() < 9){
         return ""; // return empty if data is missing
     }
     
     std::string order_infos = fmt::format(
-        "{} {} {} {} {} {} {} {} {} {} {}",
+        "{} {} {} {} {} {} {} {} {}",
         order_info[0][0],
         order_info[0][1], 
         order_info[0][2],
@@ -152,10 +143,28 @@ std::string Order::get_order_info() const
         order_info[0][5],
         order_info[0][6],
         order_info[0][7],
-        order_info[0][8],
-        order_info[0][9], 
-        order_info[0][10]
+        order_info[0][8]
     );
     return order_infos;
 }
 
+// stream the rows of a query on the orders as : order_time client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time,...
+void write_orders_info(Database_Manager& database, const std::string& query, Response_Writer& writer)
+{
+    SQL_Cursor cursor = database.open_cursor(query);
+    while (cursor.next()){
+        writer.write_row(fmt::format(
+            "{} {} {} {} {} {} {} {} {} {}",
+            time_to_string(cursor.get_int64(0)),
+            cursor.get_string(1),
+            cursor.get_string(2),
+            cursor.get_string(3),
+            cursor.get_string(4),
+            cursor.get_string(5),
+            cursor.get_string(6),
+            cursor.get_string(7),
+            cursor.get_string(8),
+            time_to_string(cursor.get_int64(9))
+        ));
+    }
+}
@@ -31,6 +31,25 @@ Order_Trigger string_to_trigger(const std::string& trigger_type_str);
 std::string trigger_to_string(const Order_Trigger& trigger_type);
 
 
+// an order to create, with the parameters of the orders table
+struct Order_Request
+{
+    ID order_id;
+    ID order_time;
+    Order_Type order_type;
+    int quantity;
+    ID action_id;
+    Order_Trigger trigger_type;
+    double price;
+    double trigger_price_lower;
+    double trigger_price_upper;
+    ID expiration_time;
+};
+
+// stream the rows of a query on the orders (order_time, client_name, order_type, quantity, action_name, trigger_type, price, trigger_price_lower, trigger_price_upper, expiration_time) as : order_time client_name order_type quantity action_name trigger_type price trigger_price_lower trigger_price_upper expiration_time,...
+void write_orders_info(Database_Manager& database, const std::string& query, Response_Writer& writer);
+
+
 class Order
 {
 private:
@@ -44,8 +63,7 @@ public:
 
     // getters
     ID get_order_id() const;
-    ID get_date_order_time() const;
-    ID get_daily_order_time() const;
+    ID get_order_time() const;
     int get_quantity() const;
     double get_price() const;
 
@@ -53,7 +71,7 @@ public:
     void set_quantity(const int& new_quantity);
 
     // string representation methods for market usage
-    std::string get_order_info() const; // get the order info as a string : order_id order_time_date order_time_daily client_id quantity trigger_type price trigger_price_lower trigger_price_upper expiration_time_date expiration_time_daily
+    std::string get_order_info() const; // get the order info as a string : order_id order_time client_id quantity trigger_type price trigger_price_lower trigger_price_upper expiration_time
 };
 
 
@@ -0,0 +1,98 @@
+#include "protocol.hpp"
+
+
+// converting a Binary_Kind enum to a string
+std::string binary_kind_to_string(const Binary_Kind& kind)
+{
+    switch (kind){
+        case Binary_Kind::NEW_ORDER: return "NEW_ORDER";
+        case Binary_Kind::CANCEL: return "CANCEL";
+        case Binary_Kind::AMEND: return "AMEND";
+        case Binary_Kind::ACK: return "ACK";
+        case Binary_Kind::REJECT: return "REJECT";
+        case Binary_Kind::MARKET_DATA: return "MARKET_DATA";
+        case Binary_Kind::NEW_ORDERS: return "NEW_ORDERS";
+        case Binary_Kind::MASS_CANCEL: return "MASS_CANCEL";
+        case Binary_Kind::ORDERS_ACK: return "ORDERS_ACK";
+        case Binary_Kind::BOOK_UPDATE: return "BOOK_UPDATE";
+        case Binary_Kind::PHASE_CHANGE: return "PHASE_CHANGE";
+        case Binary_Kind::FEED_SNAPSHOT: return "FEED_SNAPSHOT";
+    }
+    return "UNKNOWN";
+}
+
+// converting a Reject_Reason enum to a string
+std::string reject_reason_to_string(const Reject_Reason& reason)
+{
+    switch (reason){
+        case Reject_Reason::MALFORMED: return "MALFORMED";
+        case Reject_Reason::UNSUPPORTED_VERSION: return "UNSUPPORTED_VERSION";
+        case Reject_Reason::UNKNOWN_KIND: return "UNKNOWN_KIND";
+        case Reject_Reason::UNKNOWN_CLIENT: return "UNKNOWN_CLIENT";
+        case Reject_Reason::UNKNOWN_ACTION: return "UNKNOWN_ACTION";
+        case Reject_Reason::UNKNOWN_ORDER: return "UNKNOWN_ORDER";
+        case Reject_Reason::INVALID_SIDE: return "INVALID_SIDE";
+        case Reject_Reason::INVALID_TRIGGER: return "INVALID_TRIGGER";
+        case Reject_Reason::INVALID_QUANTITY: return "INVALID_QUANTITY";
+        case Reject_Reason::INVALID_PRICE: return "INVALID_PRICE";
+        case Reject_Reason::INSUFFICIENT_BALANCE: return "INSUFFICIENT_BALANCE";
+        case Reject_Reason::INSUFFICIENT_SHARES: return "INSUFFICIENT_SHARES";
+        case Reject_Reason::RATE_LIMITED: return "RATE_LIMITED";
+    }
+    return "UNKNOWN";
+}
+
+
+// check whether a request is a binary message (otherwise it is a text request)
+bool is_binary_message(const char* data, const size_t& size)
+{
+    return size > 0 && static_cast<uint8_t>(data[0]) == PROTOCOL_MAGIC;
+}
+
+// read the header of a binary message, false if the message is too short for it
+bool decode_binary_header(const char* data, const size_t& size, Binary_Header& header)
+{
+    if (size < sizeof(Binary_Header)){
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(Binary_Header));
+    header.length = swap_little_endian(header.length);
+    return true;
+}
+
+// read the correlation id of a request (the first field of every request, after the header), 0 if the request is too short for it
+uint64_t decode_correlation_id(const char* data, const size_t& size)
+{
+    static_assert(offsetof(New_Order, correlation_id) == sizeof(Binary_Header) && offsetof(Cancel, correlation_id) == sizeof(Binary_Header) && offsetof(Amend, correlation_id) == sizeof(Binary_Header)
+        && offsetof(New_Orders, correlation_id) == sizeof(Binary_Header) && offsetof(Mass_Cancel, correlation_id) == sizeof(Binary_Header));
+    uint64_t correlation_id = 0;
+    if (size >= sizeof(Binary_Header) + sizeof(correlation_id)){
+        std::memcpy(&correlation_id, data + sizeof(Binary_Header), sizeof(correlation_id));
+    }
+    return swap_little_endian(correlation_id);
+}
+
+// number of orders a request creates, amends or cancels (the count of a NewOrders), read without decoding the request
+uint32_t count_binary_orders(const char* data, const size_t& size)
+{
+    Binary_Header header;
+    if (!decode_binary_header(data, size, header)){
+        return 0;
+    }
+    switch (static_cast<Binary_Kind>(header.kind)){
+        case Binary_Kind::NEW_ORDER:
+        case Binary_Kind::CANCEL:
+        case Binary_Kind::AMEND:
+        case Binary_Kind::MASS_CANCEL:
+            return 1;
+        case Binary_Kind::NEW_ORDERS: {
+            uint32_t count = 0;
+            if (size >= offsetof(New_Orders, count) + sizeof(count)){
+                std::memcpy(&count, data + offsetof(New_Orders, count), sizeof(count));
+            }
+            return std::clamp<uint32_t>(swap_little_endian(count), 1, BINARY_MAX_ENTRIES); // a larger count is malformed, the handler rejects it
+        }
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,382 @@
+//==========================================================================
+// File that defines the binary order-entry protocol : versioned messages of fixed size, little-endian and aligned
+//==========================================================================
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+#include "database_management.hpp"
+
+
+#include <array>
+#include <bit>
+#include <type_traits>
+
+
+#define PROTOCOL_MAGIC 0xB7 // first byte of a binary message (a text request starts with a printable character)
+#define PROTOCOL_VERSION 4 // 2 : correlation id of the requests, echoed in their Ack or Reject, 3 : NewOrders and MassCancel, 4 : market data feed
+#define BINARY_MAX_ENTRIES 1024 // orders of a NewOrders
+#define MASS_CANCEL_ANY_ACTION -1
+#define MASS_CANCEL_ANY_SIDE 0xFF
+#define SNAPSHOT_LAST_PRICE 0xFF // side of the entries of a FeedSnapshot giving the last price of an action
+
+
+// kinds of the binary messages
+enum class Binary_Kind : uint8_t
+{
+    NEW_ORDER = 1, // client -> server
+    CANCEL, // client -> server
+    AMEND, // client -> server
+    ACK, // server -> client
+    REJECT, // server -> client
+    MARKET_DATA = 7, // server -> client (6 is not used anymore, the kinds keep their values on the wire)
+    NEW_ORDERS, // client -> server, several orders created together
+    MASS_CANCEL, // client -> server, the pending orders of the client (of an action, of a side)
+    ORDERS_ACK, // server -> client, answer of a NewOrders or a MassCancel with the ids of the orders
+    BOOK_UPDATE, // server -> client (feed), a price level added, changed or deleted
+    PHASE_CHANGE, // server -> client (feed)
+    FEED_SNAPSHOT // server -> client (feed), the whole book and the last prices
+};
+// converting a Binary_Kind enum to a string
+std::string binary_kind_to_string(const Binary_Kind& kind);
+
+// reasons of a Reject
+enum class Reject_Reason : uint16_t
+{
+    MALFORMED = 1, // wrong size or header
+    UNSUPPORTED_VERSION,
+    UNKNOWN_KIND,
+    UNKNOWN_CLIENT,
+    UNKNOWN_ACTION,
+    UNKNOWN_ORDER, // the order is not pending (or not of the client)
+    INVALID_SIDE,
+    INVALID_TRIGGER,
+    INVALID_QUANTITY,
+    INVALID_PRICE,
+    INSUFFICIENT_BALANCE,
+    INSUFFICIENT_SHARES,
+    RATE_LIMITED // the session or the client sent too many requests or orders, the request was not processed
+};
+// converting a Reject_Reason enum to a string
+std::string reject_reason_to_string(const Reject_Reason& reason);
+
+// changes of a price level of the book
+enum class Book_Update_Type : uint8_t
+{
+    ADD = 1,
+    CHANGE,
+    DELETE
+};
+
+// phases of the market session
+enum class Market_Phase : uint8_t
+{
+    PRE_OPEN = 1,
+    OPEN, // fixing
+    CONTINUOUS_TRADING,
+    PRE_CLOSE,
+    CLOSE // closing fixing, then closed
+};
+
+
+// header of every binary message
+struct Binary_Header
+{
+    uint8_t magic; // PROTOCOL_MAGIC
+    uint8_t version; // PROTOCOL_VERSION
+    uint8_t kind; // Binary_Kind
+    uint8_t reserved;
+    uint32_t length; // size of the whole message, header included
+};
+
+
+// schema of the messages : the fields of each message, in wire order, so that every field is aligned on its size
+// (the sides are the Order_Type values, the triggers the Order_Trigger values, the times milliseconds since Unix epoch)
+// a request carries a correlation id chosen by the client, its Ack or Reject carries it back (the client can keep many requests in flight)
+#define ORDER_ENTRY_FIELDS(FIELD) \
+    FIELD(int64_t, action_id) \
+    FIELD(double, price) \
+    FIELD(double, trigger_price_lower) \
+    FIELD(double, trigger_price_upper) \
+    FIELD(uint64_t, validity_time) /* 0 if the order does not expire */ \
+    FIELD(uint32_t, quantity) \
+    FIELD(uint8_t, side) \
+    FIELD(uint8_t, trigger) \
+    FIELD(uint16_t, reserved)
+
+#define NEW_ORDER_FIELDS(FIELD) \
+    FIELD(uint64_t, correlation_id) \
+    FIELD(int64_t, client_id) \
+    ORDER_ENTRY_FIELDS(FIELD)
+
+#define CANCEL_FIELDS(FIELD) \
+    FIELD(uint64_t, correlation_id) \
+    FIELD(int64_t, client_id) \
+    FIELD(int64_t, order_id)
+
+#define AMEND_FIELDS(FIELD) \
+    FIELD(uint64_t, correlation_id) \
+    FIELD(int64_t, client_id) \
+    FIELD(int64_t, order_id) \
+    FIELD(double, price) \
+    FIELD(uint32_t, quantity) \
+    FIELD(uint32_t, reserved)
+
+#define ACK_FIELDS(FIELD) \
+    FIELD(uint64_t, correlation_id) \
+    FIELD(int64_t, order_id) \
+    FIELD(uint64_t, time) \
+    FIELD(uint8_t, acked_kind) \
+    FIELD(uint8_t, reserved_1) \
+    FIELD(uint16_t, reserved_2) \
+    FIELD(uint32_t, reserved_3)
+
+#define REJECT_FIELDS(FIELD) \
+    FIELD(uint64_t, correlation_id) \
+    FIELD(int64_t, order_id) /* -1 if the order was not created */ \
+    FIELD(uint8_t, rejected_kind) \
+    FIELD(uint8_t, reserved_1) \
+    FIELD(uint16_t, reason) \
+    FIELD(uint32_t, entry) /* index of the refused order of a NewOrders, 0 otherwise */
+
+// the messages of the feed carry the sequence of the feed : a subscriber that misses one subscribes again to get a snapshot
+// a MarketData is a trade, its price is the new last price of the action
+#define MARKET_DATA_FIELDS(FIELD) \
+    FIELD(uint64_t, sequence) \
+    FIELD(int64_t, action_id) \
+    FIELD(double, price) \
+    FIELD(uint64_t, time) \
+    FIELD(uint32_t, quantity) \
+    FIELD(uint32_t, reserved)
+
+// a NewOrders is followed by count Order_Entry, the orders are accepted or rejected together
+#define NEW_ORDERS_FIELDS(FIELD) \
+    FIELD(uint64_t, correlation_id) \
+    FIELD(int64_t, client_id) \
+    FIELD(uint32_t, count) \
+    FIELD(uint32_t, reserved)
+
+#define MASS_CANCEL_FIELDS(FIELD) \
+    FIELD(uint64_t, correlation_id) \
+    FIELD(int64_t, client_id) \
+    FIELD(int64_t, action_id) /* MASS_CANCEL_ANY_ACTION for all the actions */ \
+    FIELD(uint8_t, side) /* MASS_CANCEL_ANY_SIDE for both sides */ \
+    FIELD(uint8_t, reserved_1) \
+    FIELD(uint16_t, reserved_2) \
+    FIELD(uint32_t, reserved_3)
+
+// an OrdersAck is followed by count Order_Id_Entry : the orders created (in the order of the NewOrders) or cancelled
+#define ORDERS_ACK_FIELDS(FIELD) \
+    FIELD(uint64_t, correlation_id) \
+    FIELD(uint64_t, time) \
+    FIELD(uint8_t, acked_kind) \
+    FIELD(uint8_t, reserved_1) \
+    FIELD(uint16_t, reserved_2) \
+    FIELD(uint32_t, count)
+
+#define ORDER_ID_ENTRY_FIELDS(FIELD) \
+    FIELD(int64_t, order_id)
+
+// the quantity of a level is the total of its pending orders (0 when it is deleted)
+#define BOOK_UPDATE_FIELDS(FIELD) \
+    FIELD(uint64_t, sequence) \
+    FIELD(int64_t, action_id) \
+    FIELD(double, price) \
+    FIELD(int64_t, quantity) \
+    FIELD(uint8_t, side) \
+    FIELD(uint8_t, update) /* Book_Update_Type */ \
+    FIELD(uint16_t, reserved_1) \
+    FIELD(uint32_t, reserved_2)
+
+#define PHASE_CHANGE_FIELDS(FIELD) \
+    FIELD(uint64_t, sequence) \
+    FIELD(uint64_t, time) \
+    FIELD(uint8_t, phase) /* Market_Phase */ \
+    FIELD(uint8_t, reserved_1) \
+    FIELD(uint16_t, reserved_2) \
+    FIELD(uint32_t, reserved_3)
+
+// a FeedSnapshot is followed by count Snapshot_Entry, it is the state after the message of its sequence
+#define FEED_SNAPSHOT_FIELDS(FIELD) \
+    FIELD(uint64_t, sequence) \
+    FIELD(uint64_t, time) \
+    FIELD(uint8_t, phase) \
+    FIELD(uint8_t, reserved_1) \
+    FIELD(uint16_t, reserved_2) \
+    FIELD(uint32_t, count)
+
+#define SNAPSHOT_ENTRY_FIELDS(FIELD) \
+    FIELD(int64_t, action_id) \
+    FIELD(double, price) \
+    FIELD(int64_t, quantity) \
+    FIELD(uint8_t, side) /* SNAPSHOT_LAST_PRICE for the last price of the action (the quantity of its last trade) */ \
+    FIELD(uint8_t, reserved_1) \
+    FIELD(uint16_t, reserved_2) \
+    FIELD(uint32_t, reserved_3)
+
+// the messages : name, kind, fields
+#define BINARY_MESSAGES(MESSAGE) \
+    MESSAGE(New_Order, NEW_ORDER, NEW_ORDER_FIELDS) \
+    MESSAGE(Cancel, CANCEL, CANCEL_FIELDS) \
+    MESSAGE(Amend, AMEND, AMEND_FIELDS) \
+    MESSAGE(Ack, ACK, ACK_FIELDS) \
+    MESSAGE(Reject, REJECT, REJECT_FIELDS) \
+    MESSAGE(Market_Data, MARKET_DATA, MARKET_DATA_FIELDS) \
+    MESSAGE(New_Orders, NEW_ORDERS, NEW_ORDERS_FIELDS) \
+    MESSAGE(Mass_Cancel, MASS_CANCEL, MASS_CANCEL_FIELDS) \
+    MESSAGE(Orders_Ack, ORDERS_ACK, ORDERS_ACK_FIELDS) \
+    MESSAGE(Book_Update, BOOK_UPDATE, BOOK_UPDATE_FIELDS) \
+    MESSAGE(Phase_Change, PHASE_CHANGE, PHASE_CHANGE_FIELDS) \
+    MESSAGE(Feed_Snapshot, FEED_SNAPSHOT, FEED_SNAPSHOT_FIELDS)
+
+// the entries following a message : name, fields
+#define BINARY_ENTRIES(ENTRY) \
+    ENTRY(Order_Entry, ORDER_ENTRY_FIELDS) \
+    ENTRY(Order_Id_Entry, ORDER_ID_ENTRY_FIELDS) \
+    ENTRY(Snapshot_Entry, SNAPSHOT_ENTRY_FIELDS)
+
+
+// the structures of the messages, generated from the schema
+#define BINARY_FIELD_DECLARATION(type, name) type name;
+#define BINARY_MESSAGE_DECLARATION(Name, KIND, FIELDS) \
+    struct Name \
+    { \
+        static constexpr Binary_Kind kind = Binary_Kind::KIND; \
+        Binary_Header header; \
+        FIELDS(BINARY_FIELD_DECLARATION) \
+    }; \
+    static_assert(std::is_trivially_copyable_v<Name> && std::is_standard_layout_v<Name>, #Name " must be copied with memcpy"); \
+    static_assert(sizeof(Name) % 8 == 0 && alignof(Name) <= 8, #Name " must be a whole number of aligned words (without implicit padding)");
+BINARY_MESSAGES(BINARY_MESSAGE_DECLARATION)
+#define BINARY_ENTRY_DECLARATION(Name, FIELDS) \
+    struct Name \
+    { \
+        FIELDS(BINARY_FIELD_DECLARATION) \
+    }; \
+    static_assert(std::is_trivially_copyable_v<Name> && std::is_standard_layout_v<Name>, #Name " must be copied with memcpy"); \
+    static_assert(sizeof(Name) % 8 == 0 && alignof(Name) <= 8, #Name " must be a whole number of aligned words (without implicit padding)");
+BINARY_ENTRIES(BINARY_ENTRY_DECLARATION)
+#undef BINARY_ENTRY_DECLARATION
+#undef BINARY_MESSAGE_DECLARATION
+#undef BINARY_FIELD_DECLARATION
+
+
+// convert a value between the host and the wire order (little-endian), nothing to do on a little-endian host
+template <typename T>
+T swap_little_endian(const T& value)
+{
+    if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1){
+        auto bytes = std::bit_cast<std::array<uint8_t, sizeof(T)>>(value);
+        std::reverse(bytes.begin(), bytes.end());
+        return std::bit_cast<T>(bytes);
+    }
+    return value;
+}
+
+// convert every field of a message between the host and the wire order, and describe a message (generated from the schema)
+#define BINARY_FIELD_SWAP(type, name) message.name = swap_little_endian(message.name);
+#define BINARY_FIELD_DESCRIPTION(type, name) description += fmt::format(" {}={}", #name, message.name);
+#define BINARY_MESSAGE_FUNCTIONS(Name, KIND, FIELDS) \
+    inline void swap_fields(Name& message) \
+    { \
+        message.header.length = swap_little_endian(message.header.length); \
+        FIELDS(BINARY_FIELD_SWAP) \
+    } \
+    inline std::string describe(const Name& message) \
+    { \
+        std::string description = #Name; \
+        FIELDS(BINARY_FIELD_DESCRIPTION) \
+        return description; \
+    }
+BINARY_MESSAGES(BINARY_MESSAGE_FUNCTIONS)
+#define BINARY_ENTRY_FUNCTIONS(Name, FIELDS) \
+    inline void swap_fields(Name& message) \
+    { \
+        FIELDS(BINARY_FIELD_SWAP) \
+    } \
+    inline std::string describe(const Name& message) \
+    { \
+        std::string description = #Name; \
+        FIELDS(BINARY_FIELD_DESCRIPTION) \
+        return description; \
+    }
+BINARY_ENTRIES(BINARY_ENTRY_FUNCTIONS)
+#undef BINARY_ENTRY_FUNCTIONS
+#undef BINARY_MESSAGE_FUNCTIONS
+#undef BINARY_FIELD_DESCRIPTION
+#undef BINARY_FIELD_SWAP
+
+
+// check whether a request is a binary message (otherwise it is a text request)
+bool is_binary_message(const char* data, const size_t& size);
+
+// read the header of a binary message, false if the message is too short for it
+bool decode_binary_header(const char* data, const size_t& size, Binary_Header& header);
+
+// read the correlation id of a request (the first field of every request, after the header), 0 if the request is too short for it
+uint64_t decode_correlation_id(const char* data, const size_t& size);
+
+// number of orders a request creates, amends or cancels (the count of a NewOrders), read without decoding the request
+uint32_t count_binary_orders(const char* data, const size_t& size);
+
+// decode a binary message : a bounds check and a memcpy, false if the size, the header or the kind do not match
+template <typename Message>
+bool decode_binary(const char* data, const size_t& size, Message& message)
+{
+    if (size != sizeof(Message)){
+        return false;
+    }
+    std::memcpy(&message, data, sizeof(Message));
+    swap_fields(message);
+    return message.header.magic == PROTOCOL_MAGIC && message.header.version == PROTOCOL_VERSION && message.header.kind == static_cast<uint8_t>(Message::kind) && message.header.length == sizeof(Message);
+}
+
+// decode a binary message followed by message.count entries, false if the sizes, the header or the kind do not match
+template <typename Message, typename Entry>
+bool decode_binary(const char* data, const size_t& size, Message& message, std::vector<Entry>& entries)
+{
+    if (size < sizeof(Message)){
+        return false;
+    }
+    std::memcpy(&message, data, sizeof(Message));
+    swap_fields(message);
+    if (message.header.magic != PROTOCOL_MAGIC || message.header.version != PROTOCOL_VERSION || message.header.kind != static_cast<uint8_t>(Message::kind) || message.header.length != size){
+        return false;
+    }
+    if (message.count > BINARY_MAX_ENTRIES || size != sizeof(Message) + message.count * sizeof(Entry)){
+        return false;
+    }
+    entries.resize(message.count);
+    std::memcpy(entries.data(), data + sizeof(Message), message.count * sizeof(Entry));
+    for (Entry& entry : entries){
+        swap_fields(entry);
+    }
+    return true;
+}
+
+// encode a binary message in a buffer of sizeof(Message) bytes (the header is filled)
+template <typename Message>
+void encode_binary(Message message, char* buffer)
+{
+    message.header = Binary_Header{PROTOCOL_MAGIC, PROTOCOL_VERSION, static_cast<uint8_t>(Message::kind), 0, sizeof(Message)};
+    swap_fields(message);
+    std::memcpy(buffer, &message, sizeof(Message));
+}
+
+// encode a binary message followed by its entries (the header and the count are filled)
+template <typename Message, typename Entry>
+std::string encode_binary(Message message, const std::vector<Entry>& entries)
+{
+    std::string buffer(sizeof(Message) + entries.size() * sizeof(Entry), '\0');
+    message.header = Binary_Header{PROTOCOL_MAGIC, PROTOCOL_VERSION, static_cast<uint8_t>(Message::kind), 0, static_cast<uint32_t>(buffer.size())};
+    message.count = static_cast<uint32_t>(entries.size());
+    swap_fields(message);
+    std::memcpy(buffer.data(), &message, sizeof(Message));
+    for (size_t index = 0; index < entries.size(); ++index){
+        Entry entry = entries[index];
+        swap_fields(entry);
+        std::memcpy(buffer.data() + sizeof(Message) + index * sizeof(Entry), &entry, sizeof(Entry));
+    }
+    return buffer;
+}
+
+
+#endif // PROTOCOL_HPP
@@ -0,0 +1,143 @@
+#include "rate_limit.hpp"
+
+
+// policy from the rates of one session (the buckets hold RATE_LIMIT_BURST_SECONDS of their rate, a client id gets RATE_LIMIT_CLIENT_SESSIONS times the rates)
+Rate_Policy make_rate_policy(const double& messages_per_second, const double& orders_per_second)
+{
+    auto limit = [](const double& rate){
+        return Rate_Limit{rate, rate * RATE_LIMIT_BURST_SECONDS};
+    };
+    return Rate_Policy{
+        limit(messages_per_second),
+        limit(orders_per_second),
+        limit(messages_per_second * RATE_LIMIT_CLIENT_SESSIONS),
+        limit(orders_per_second * RATE_LIMIT_CLIENT_SESSIONS)
+    };
+}
+
+// converting a Rate_Decision enum to a string
+std::string rate_decision_to_string(const Rate_Decision& decision)
+{
+    switch (decision){
+        case Rate_Decision::ACCEPT: return "ACCEPT";
+        case Rate_Decision::SESSION_MESSAGES: return "SESSION_MESSAGES";
+        case Rate_Decision::SESSION_ORDERS: return "SESSION_ORDERS";
+        case Rate_Decision::CLIENT_MESSAGES: return "CLIENT_MESSAGES";
+        case Rate_Decision::CLIENT_ORDERS: return "CLIENT_ORDERS";
+    }
+    return "UNKNOWN";
+}
+
+
+// constructor
+Token_Bucket::Token_Bucket() : Tokens(-1), Last_Refill()
+{
+
+}
+
+// false (nothing taken) if the bucket does not hold the cost
+bool Token_Bucket::take(const Rate_Limit& limit, const std::chrono::steady_clock::time_point& now, const double& cost)
+{
+    if (limit.rate <= 0 || cost <= 0){
+        return true;
+    }
+    if (Tokens < 0){
+        Tokens = limit.burst;
+    }
+    else {
+        double elapsed = std::chrono::duration<double>(now - Last_Refill).count();
+        Tokens = std::min(limit.burst, Tokens + elapsed * limit.rate);
+    }
+    Last_Refill = now;
+    if (Tokens < cost){
+        return false;
+    }
+    Tokens -= cost;
+    return true;
+}
+
+std::chrono::steady_clock::time_point Token_Bucket::get_last_refill() const
+{
+    return Last_Refill;
+}
+
+
+// constructor
+Rate_Limiter::Rate_Limiter(const Rate_Policy& policy, Request_Classifier classify, Request_Rejecter reject) : Policy(policy), Classify(std::move(classify)), Reject(std::move(reject)), Accepted(0), Refused{}, Orders_Refused(0)
+{
+
+}
+
+// take the tokens of a request in the buckets of its session and of the client the session authenticated (-1 : the session buckets only), the first bucket short of tokens refuses it
+// (a request refused still took its message tokens : a client flooding refused requests stays refused;
+// the client id named by a request is not trusted, a session cannot drain the buckets of another client)
+Rate_Decision Rate_Limiter::admit(Rate_Buckets& session, const ID& client_id, std::string_view request)
+{
+    auto now = std::chrono::steady_clock::now();
+    Request_Class request_class = Classify(request);
+    Rate_Decision decision = Rate_Decision::ACCEPT;
+    if (!session.messages.take(Policy.session_messages, now, 1)){
+        decision = Rate_Decision::SESSION_MESSAGES;
+    }
+    else if (!session.orders.take(Policy.session_orders, now, request_class.orders)){
+        decision = Rate_Decision::SESSION_ORDERS;
+    }
+    else if (client_id != -1){
+        decision = admit_client(client_id, request_class, now);
+    }
+    if (decision == Rate_Decision::ACCEPT){
+        Accepted.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        Refused[static_cast<size_t>(decision)].fetch_add(1, std::memory_order_relaxed);
+        Orders_Refused.fetch_add(request_class.orders, std::memory_order_relaxed);
+    }
+    return decision;
+}
+
+// take the tokens of the request in the buckets of the client
+Rate_Decision Rate_Limiter::admit_client(const ID& client_id, const Request_Class& request, const std::chrono::steady_clock::time_point& now)
+{
+    Client_Shard& shard = Shards[static_cast<uint64_t>(client_id) % RATE_LIMIT_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+    // the buckets of the idle clients are dropped, so that the clients gone do not pile up
+    if (now - shard.Last_Prune > std::chrono::milliseconds(RATE_LIMIT_CLIENT_IDLE)){
+        for (auto it = shard.Clients.begin(); it != shard.Clients.end();){
+            if (now - it->second.messages.get_last_refill() > std::chrono::milliseconds(RATE_LIMIT_CLIENT_IDLE)){
+                it = shard.Clients.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        shard.Last_Prune = now;
+    }
+    Rate_Buckets& client = shard.Clients[client_id];
+    if (!client.messages.take(Policy.client_messages, now, 1)){
+        return Rate_Decision::CLIENT_MESSAGES;
+    }
+    if (!client.orders.take(Policy.client_orders, now, request.orders)){
+        return Rate_Decision::CLIENT_ORDERS;
+    }
+    return Rate_Decision::ACCEPT;
+}
+
+// answer a request refused
+void Rate_Limiter::reject(Session& session, std::string_view request, const Rate_Decision& decision)
+{
+    Reject(session, request, decision);
+}
+
+// requests accepted and refused, by bucket
+std::string Rate_Limiter::get_counters() const
+{
+    return fmt::format(
+        "accepted {},refused session_messages {},refused session_orders {},refused client_messages {},refused client_orders {},orders refused {}",
+        Accepted.load(std::memory_order_relaxed),
+        Refused[static_cast<size_t>(Rate_Decision::SESSION_MESSAGES)].load(std::memory_order_relaxed),
+        Refused[static_cast<size_t>(Rate_Decision::SESSION_ORDERS)].load(std::memory_order_relaxed),
+        Refused[static_cast<size_t>(Rate_Decision::CLIENT_MESSAGES)].load(std::memory_order_relaxed),
+        Refused[static_cast<size_t>(Rate_Decision::CLIENT_ORDERS)].load(std::memory_order_relaxed),
+        Orders_Refused.load(std::memory_order_relaxed)
+    );
+}
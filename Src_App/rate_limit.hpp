@@ -0,0 +1,121 @@
+//==========================================================================
+// File that defines the rate limits of the requests : token buckets per session and per client id,
+// checked by the gateway before a request is parsed, so that the burst of one client cannot take the capacity of the market
+//==========================================================================
+#ifndef RATE_LIMIT_HPP
+#define RATE_LIMIT_HPP
+#include "database_management.hpp"
+
+
+#include <array>
+
+
+#define RATE_LIMIT_MESSAGES 5000 // requests per second of a session (0 : no limit)
+#define RATE_LIMIT_ORDERS 1000 // orders per second of a session, created, amended or cancelled (0 : no limit)
+#define RATE_LIMIT_BURST_SECONDS 2 // a bucket holds this many seconds of its rate (a NewOrders of BINARY_MAX_ENTRIES orders must fit)
+#define RATE_LIMIT_CLIENT_SESSIONS 2 // a client id gets the rates of this many sessions, whatever the number of sessions it opens
+#define RATE_LIMIT_SHARDS 16 // the buckets of the client ids are split in this many maps, each one with its own mutex (the reactors rarely wait for each other)
+#define RATE_LIMIT_CLIENT_IDLE 10000 // milliseconds, the buckets of a client id idle for this long are full again and are dropped
+#define RATE_LIMIT_RESPONSE "Error: Rate limit exceeded, the request was not processed"
+
+
+class Session;
+
+// rate and capacity of a token bucket
+struct Rate_Limit
+{
+    double rate; // tokens per second (0 : no limit)
+    double burst; // tokens the bucket holds
+};
+
+// the limits of the sessions and of the client ids
+struct Rate_Policy
+{
+    Rate_Limit session_messages;
+    Rate_Limit session_orders;
+    Rate_Limit client_messages;
+    Rate_Limit client_orders;
+};
+// policy from the rates of one session (the buckets hold RATE_LIMIT_BURST_SECONDS of their rate, a client id gets RATE_LIMIT_CLIENT_SESSIONS times the rates)
+Rate_Policy make_rate_policy(const double& messages_per_second, const double& orders_per_second);
+
+// tokens refilled at a constant rate up to the capacity, a request takes some of them (not thread-safe : one per session, or guarded by a mutex)
+class Token_Bucket
+{
+private:
+    double Tokens; // negative until the first request, the bucket starts full
+    std::chrono::steady_clock::time_point Last_Refill;
+
+public:
+    // constructor
+    Token_Bucket();
+
+    bool take(const Rate_Limit& limit, const std::chrono::steady_clock::time_point& now, const double& cost); // false (nothing taken) if the bucket does not hold the cost
+    std::chrono::steady_clock::time_point get_last_refill() const;
+};
+
+// buckets of a session or of a client id
+struct Rate_Buckets
+{
+    Token_Bucket messages;
+    Token_Bucket orders;
+};
+
+// what the gateway needs to know about a request before it is parsed
+struct Request_Class
+{
+    uint32_t orders; // orders created, amended or cancelled by the request
+};
+// read the orders of a request without parsing it
+using Request_Classifier = std::function<Request_Class(std::string_view request)>;
+
+// bucket that refused a request
+enum class Rate_Decision
+{
+    ACCEPT,
+    SESSION_MESSAGES,
+    SESSION_ORDERS,
+    CLIENT_MESSAGES,
+    CLIENT_ORDERS
+};
+// converting a Rate_Decision enum to a string
+std::string rate_decision_to_string(const Rate_Decision& decision);
+
+// answer the client of a request refused by the rate limits, without processing the request
+using Request_Rejecter = std::function<void(Session& session, std::string_view request, const Rate_Decision& decision)>;
+
+// the rate limits shared by all the sessions of the server, with the buckets of the client ids and the counters of the requests refused
+class Rate_Limiter
+{
+private:
+    // buckets of a part of the client ids
+    struct Client_Shard
+    {
+        std::mutex Mutex;
+        std::unordered_map<ID, Rate_Buckets> Clients;
+        std::chrono::steady_clock::time_point Last_Prune;
+    };
+
+    Rate_Policy Policy;
+    Request_Classifier Classify;
+    Request_Rejecter Reject;
+    std::array<Client_Shard, RATE_LIMIT_SHARDS> Shards;
+    std::atomic<uint64_t> Accepted;
+    std::array<std::atomic<uint64_t>, 5> Refused; // by Rate_Decision
+    std::atomic<uint64_t> Orders_Refused;
+
+    Rate_Decision admit_client(const ID& client_id, const Request_Class& request, const std::chrono::steady_clock::time_point& now); // take the tokens of the request in the buckets of the client
+
+public:
+    // constructor
+    Rate_Limiter(const Rate_Policy& policy, Request_Classifier classify, Request_Rejecter reject);
+    Rate_Limiter(const Rate_Limiter&) = delete;
+    Rate_Limiter& operator=(const Rate_Limiter&) = delete;
+
+    Rate_Decision admit(Rate_Buckets& session, const ID& client_id, std::string_view request); // take the tokens of a request in the buckets of its session and of the client the session authenticated (-1 : the session buckets only), the first bucket short of tokens refuses it
+    void reject(Session& session, std::string_view request, const Rate_Decision& decision); // answer a request refused
+    std::string get_counters() const; // requests accepted and refused, by bucket
+};
+
+
+#endif // RATE_LIMIT_HPP
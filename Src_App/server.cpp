@@ -1,264 +1,811 @@
 #include "database_management.hpp"
+#include "gateway.hpp"
 #include "market.hpp"
+#include "protocol.hpp"
+#include "text_protocol.hpp"
+#include "view_cache.hpp"
 
 
-bool is_continuous_trading_period = false; // indicator for continuous trading period
+std::atomic<bool> is_continuous_trading_period(false); // indicator for continuous trading period
 std::mutex mtx;  // mutex for shared resources (e.g., Stock_Market)
-bool processing = false; // flag to prevent multiple processing at the same time
+std::condition_variable orders_to_process_cv; // wakes the market thread when orders have been accumulated
+bool orders_to_process = false; // orders accumulated since the last continuous trading processing (protected by mtx)
 std::atomic<bool> shutdown_flag(false); // global flag to stop client threads
+Heartbeat_Policy heartbeat_policy; // heartbeats of the sessions whose client sends them
+std::unique_ptr<Rate_Limiter> rate_limiter; // rate limits of the requests of the sessions (nullptr : none)
+std::unique_ptr<View_Cache> view_cache; // views shared by the identical display requests (nullptr : each request computes its view)
+std::unique_ptr<Response_Workers> response_workers; // threads producing the histories displayed to the event loop sessions (nullptr : thread-per-client mode)
 
 
-// Function to handle client requests
-void handle_client(int client_socket, Market& stock_market, const int& process_time)
+// hand a validated order to the market (text and binary requests)
+void submit_order(Market& stock_market, const ID& client_id, const ID& order_id, const Time& order_time, const Order_Type& type, const int& quantity, const ID& action_id, const Order_Trigger& trigger_type, const double& price, const double& trigger_price_lower, const double& trigger_price_upper, const ID& validity_time)
 {
-    ID order_id = -1;
-    char buffer[BUFFER_SIZE];
+    // running the session by making the trades for an order without any trigger
+    // otherwise it will be delayed until the trigger is reached (dealed with another thread and function)
+    if (trigger_type == Order_Trigger::MARKET){
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stock_market.accumulate_order(client_id, order_id, order_time, type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, validity_time);
+            orders_to_process = true;
+        }
+        Message server_accumulating_order_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+        server_accumulating_order_message.log_message(
+            0, 
+            Message::Sender::SERVER_MESSAGE, 
+            Message::Type::ACCUMULATING_ORDER, 
+            "Accumulating the order …", 
+            get_current_time_ms()
+        );
+        // the trades are processed by the market thread, so that the request is never blocked by the processing
+        if (is_continuous_trading_period){
+            orders_to_process_cv.notify_one();
+        }
+    }
+    // we still create the order in the database even if it is not processed yet
+    else {
+        stock_market.add_order_to_client_pending_orders(client_id, order_id, order_time, type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, validity_time);
+    }
+}
 
-    while (!shutdown_flag.load()){
-        memset(buffer, 0, BUFFER_SIZE);
-        int valread = read(client_socket, buffer, BUFFER_SIZE);
-        if (valread <= 0){
-            break; // client disconnected (maybe the monitor_server function detected it)
-        }
-        std::string input(buffer);
-        std::cout << "Client input : " << input << std::endl;
-        
-        const std::string authentification_prefix = "Authentification Request: ";
-        // Check if the message starts with the expected prefix
-        if (input.rfind(authentification_prefix, 0) == 0){
-            // Extract username and password
-            std::istringstream ss(input.substr(authentification_prefix.size()));
-            std::string username, password;
-            if (!(ss >> username >> password)){
-                send(client_socket, "AUTHENTIFICATION_FAILURE_INPUT", strlen("AUTHENTIFICATION_FAILURE_INPUT"), 0);
-                Message authentification_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                authentification_error_message.log_message(
-                    0, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::AUTHENTIFICATION_FAILURE_INPUT, 
-                    "Invalid input", 
-                    get_current_time_ms()
-                );
-                break;
+
+// create orders of a client in one transaction and give them to the market in one step
+void submit_orders(Market& stock_market, const ID& client_id, const std::vector<Order_Request>& orders)
+{
+    bool market_order_added;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        market_order_added = stock_market.add_orders(client_id, orders);
+        orders_to_process = orders_to_process || market_order_added;
+    }
+    if (market_order_added && is_continuous_trading_period){
+        orders_to_process_cv.notify_one();
+    }
+}
+
+
+// read the order of a NewOrder or of an entry of a NewOrders, false with the reason if it is not valid
+template <typename Binary_Order>
+bool read_binary_order(const Binary_Order& binary_order, Order_Request& order, Reject_Reason& reason)
+{
+    if (binary_order.side > static_cast<uint8_t>(Order_Type::SELL)){
+        reason = Reject_Reason::INVALID_SIDE;
+        return false;
+    }
+    if (binary_order.trigger < static_cast<uint8_t>(Order_Trigger::MARKET) || binary_order.trigger > static_cast<uint8_t>(Order_Trigger::LIMIT_STOP)){
+        reason = Reject_Reason::INVALID_TRIGGER;
+        return false;
+    }
+    if (binary_order.quantity == 0 || binary_order.quantity > static_cast<uint32_t>(std::numeric_limits<int>::max())){
+        reason = Reject_Reason::INVALID_QUANTITY;
+        return false;
+    }
+    order.order_type = static_cast<Order_Type>(binary_order.side);
+    order.trigger_type = static_cast<Order_Trigger>(binary_order.trigger);
+    order.quantity = static_cast<int>(binary_order.quantity);
+    order.action_id = binary_order.action_id;
+
+    // the prices given depend on the trigger type, as for the text orders
+    order.price = binary_order.price;
+    order.trigger_price_lower = binary_order.trigger_price_lower;
+    order.trigger_price_upper = binary_order.trigger_price_upper;
+    bool valid_prices = true;
+    if (order.trigger_type == Order_Trigger::MARKET){
+        order.price = max_number; // prioritized, the client is charged the selling price
+        order.trigger_price_lower = 0.0;
+        order.trigger_price_upper = max_number;
+    }
+    else if (order.trigger_type == Order_Trigger::LIMIT){
+        valid_prices = order.price > 0.0 && order.trigger_price_lower > 0.0;
+        order.trigger_price_upper = max_number;
+    }
+    else if (order.trigger_type == Order_Trigger::STOP){
+        valid_prices = order.price > 0.0 && order.trigger_price_upper > 0.0;
+        order.trigger_price_lower = 0.0;
+    }
+    else {
+        valid_prices = order.price > 0.0 && order.trigger_price_lower > 0.0 && order.trigger_price_upper > 0.0;
+    }
+    if (!valid_prices){
+        reason = Reject_Reason::INVALID_PRICE;
+        return false;
+    }
+    order.expiration_time = binary_order.validity_time == 0 ? no_expiration_time : static_cast<ID>(binary_order.validity_time);
+    return true;
+}
+
+
+// send a binary message to a session
+template <typename Binary_Message>
+void send_binary(Session& session, const Binary_Message& message)
+{
+    char buffer[sizeof(Binary_Message)];
+    encode_binary(message, buffer);
+    session.send(buffer, sizeof(buffer));
+}
+
+// reject a binary request, the rejection is logged like the errors of the text requests
+void reject_binary_request(Session& session, Market& stock_market, const ID& client_id, const Binary_Kind& kind, const uint64_t& correlation_id, const ID& order_id, const Reject_Reason& reason, const size_t& entry = 0)
+{
+    Reject reject{};
+    reject.correlation_id = correlation_id;
+    reject.entry = static_cast<uint32_t>(entry);
+    reject.order_id = order_id;
+    reject.rejected_kind = static_cast<uint8_t>(kind);
+    reject.reason = static_cast<uint16_t>(reason);
+    send_binary(session, reject);
+    Message reject_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+    reject_message.log_message(
+        client_id, 
+        Message::Sender::SERVER_MESSAGE, 
+        Message::Type::ERROR, 
+        fmt::format("Binary {} rejected: {}", binary_kind_to_string(kind), reject_reason_to_string(reason)), 
+        get_current_time_ms()
+    );
+}
+
+// process a binary request of a client (NewOrder, Cancel or Amend), answered by an Ack or a Reject
+bool process_binary_request(Session& session, std::string_view input, Market& stock_market)
+{
+    uint64_t correlation_id = decode_correlation_id(input.data(), input.size()); // echoed in the answer, even if the request is malformed
+    Binary_Header header;
+    if (!decode_binary_header(input.data(), input.size(), header)){
+        reject_binary_request(session, stock_market, 0, Binary_Kind::NEW_ORDER, correlation_id, -1, Reject_Reason::MALFORMED);
+        return true;
+    }
+    Binary_Kind kind = static_cast<Binary_Kind>(header.kind);
+    if (header.version != PROTOCOL_VERSION){
+        reject_binary_request(session, stock_market, 0, kind, correlation_id, -1, Reject_Reason::UNSUPPORTED_VERSION);
+        return true;
+    }
+
+    if (kind == Binary_Kind::NEW_ORDER){
+        New_Order new_order;
+        if (!decode_binary(input.data(), input.size(), new_order)){
+            reject_binary_request(session, stock_market, 0, kind, correlation_id, -1, Reject_Reason::MALFORMED);
+            return true;
+        }
+        std::cout << "Client input : " << describe(new_order) << std::endl;
+        ID client_id = new_order.client_id;
+        Order_Request order;
+        Reject_Reason reason;
+        if (!read_binary_order(new_order, order, reason)){
+            reject_binary_request(session, stock_market, client_id, kind, correlation_id, -1, reason);
+            return true;
+        }
+
+        if (!stock_market.client_exists(client_id)){
+            reject_binary_request(session, stock_market, 0, kind, correlation_id, -1, Reject_Reason::UNKNOWN_CLIENT);
+            return true;
+        }
+        if (!stock_market.action_exists(order.action_id)){
+            reject_binary_request(session, stock_market, client_id, kind, correlation_id, -1, Reject_Reason::UNKNOWN_ACTION);
+            return true;
+        }
+        if (order.order_type == Order_Type::BUY && !stock_market.can_afford(client_id, order.quantity, order.price, order.action_id)){
+            reject_binary_request(session, stock_market, client_id, kind, correlation_id, -1, Reject_Reason::INSUFFICIENT_BALANCE);
+            return true;
+        }
+        if (order.order_type == Order_Type::SELL && !stock_market.has_shares(client_id, order.action_id, order.quantity)){
+            reject_binary_request(session, stock_market, client_id, kind, correlation_id, -1, Reject_Reason::INSUFFICIENT_SHARES);
+            return true;
+        }
+
+        order.order_id = stock_market.get_database().get_new_order_id();
+        order.order_time = get_current_time_ms();
+        Ack ack{};
+        ack.correlation_id = correlation_id;
+        ack.order_id = order.order_id;
+        ack.time = order.order_time;
+        ack.acked_kind = static_cast<uint8_t>(kind);
+        send_binary(session, ack);
+        Message order_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+        order_message.log_message(
+            client_id, 
+            Message::Sender::CLIENT_MESSAGE, 
+            Message::Type::ORDER, 
+            fmt::format("Order created with ID: {} from {}", order.order_id, describe(new_order)), 
+            order.order_time
+        );
+        submit_order(stock_market, client_id, order.order_id, order.order_time, order.order_type, order.quantity, order.action_id, order.trigger_type, order.price, order.trigger_price_lower, order.trigger_price_upper, order.expiration_time);
+        return true;
+    }
+
+    if (kind == Binary_Kind::NEW_ORDERS){
+        New_Orders new_orders;
+        std::vector<Order_Entry> entries;
+        if (!decode_binary(input.data(), input.size(), new_orders, entries) || entries.empty()){
+            reject_binary_request(session, stock_market, 0, kind, correlation_id, -1, Reject_Reason::MALFORMED);
+            return true;
+        }
+        std::cout << "Client input : " << describe(new_orders) << std::endl;
+        ID client_id = new_orders.client_id;
+        if (!stock_market.client_exists(client_id)){
+            reject_binary_request(session, stock_market, 0, kind, correlation_id, -1, Reject_Reason::UNKNOWN_CLIENT);
+            return true;
+        }
+
+        // the orders are checked as a set : the balance and the shares are read once, and must cover all the orders together
+        std::vector<Order_Request> orders(entries.size());
+        std::unordered_map<ID, bool> existing_actions;
+        std::unordered_map<ID, int> available_shares;
+        double available_balance = stock_market.get_available_balance(client_id);
+        Time order_time = get_current_time_ms();
+        for (size_t index = 0; index < entries.size(); ++index){
+            Order_Request& order = orders[index];
+            Reject_Reason reason;
+            if (!read_binary_order(entries[index], order, reason)){
+                reject_binary_request(session, stock_market, client_id, kind, correlation_id, -1, reason, index);
+                return true;
+            }
+            auto action_iterator = existing_actions.find(order.action_id);
+            if (action_iterator == existing_actions.end()){
+                action_iterator = existing_actions.emplace(order.action_id, stock_market.action_exists(order.action_id)).first;
+            }
+            if (!action_iterator->second){
+                reject_binary_request(session, stock_market, client_id, kind, correlation_id, -1, Reject_Reason::UNKNOWN_ACTION, index);
+                return true;
+            }
+            if (order.order_type == Order_Type::BUY){
+                available_balance -= stock_market.get_order_cost(client_id, order.quantity, order.price, order.action_id);
+                if (available_balance < 0.0){
+                    reject_binary_request(session, stock_market, client_id, kind, correlation_id, -1, Reject_Reason::INSUFFICIENT_BALANCE, index);
+                    return true;
+                }
             }
-            ID potential_client_id = stock_market.client_id_if_name_and_password_registered(username, encrypt_AES(password, key, iv));
-            if (potential_client_id != -1){
-                std::string response = fmt::format("AUTHENTIFICATION_SUCCESS {}", potential_client_id);
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message authentification_success_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                authentification_success_message.log_message(
-                    potential_client_id,
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::AUTHENTIFICATION_SUCCESS, 
-                    "Authentification success", 
-                    get_current_time_ms()
-                );
-            } 
             else {
-                if (stock_market.client_name_exists(username)){
-                    send(client_socket, "AUTHENTIFICATION_FAILURE_PASSWORD", strlen("AUTHENTIFICATION_FAILURE_PASSWORD"), 0);
-                    ID client_id_without_password = stock_market.get_client_id_from_name(username);
-                    Message authentification_failure_password_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                    authentification_failure_password_message.log_message(
-                        client_id_without_password, 
-                        Message::Sender::SERVER_MESSAGE, 
-                        Message::Type::AUTHENTIFICATION_FAILURE_PASSWORD, 
-                        "Wrong password", 
-                        get_current_time_ms()
-                    );
-                } 
-                else {
-                    send(client_socket, "AUTHENTIFICATION_FAILURE_USERNAME", strlen("AUTHENTIFICATION_FAILURE_USERNAME"), 0);
-                    Message authentification_failure_username_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                    authentification_failure_username_message.log_message(
-                        0, 
-                        Message::Sender::SERVER_MESSAGE, 
-                        Message::Type::AUTHENTIFICATION_FAILURE_USERNAME, 
-                        "Unknown username", 
-                        get_current_time_ms()
-                    );
+                auto shares_iterator = available_shares.find(order.action_id);
+                if (shares_iterator == available_shares.end()){
+                    shares_iterator = available_shares.emplace(order.action_id, stock_market.get_shares(client_id, order.action_id)).first;
+                }
+                shares_iterator->second -= order.quantity;
+                if (shares_iterator->second < 0){
+                    reject_binary_request(session, stock_market, client_id, kind, correlation_id, -1, Reject_Reason::INSUFFICIENT_SHARES, index);
+                    return true;
                 }
             }
-            continue;
+            order.order_id = stock_market.get_database().get_new_order_id();
+            order.order_time = order_time;
         }
-        const std::string client_connected_prefix = "CLIENT_CONNECTED";
-        if (input.find(client_connected_prefix) != std::string::npos){
-            std::istringstream iss(input);
-            ID client_id;
-            std::string command; // = "CLIENT_CONNECTED"
-            iss >> client_id >> command;
-            Message client_connection(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-            client_connection.log_message(
-                client_id, 
+
+        // the orders are written in one transaction and given to the market in one step
+        submit_orders(stock_market, client_id, orders);
+        Orders_Ack orders_ack{};
+        orders_ack.correlation_id = correlation_id;
+        orders_ack.time = order_time;
+        orders_ack.acked_kind = static_cast<uint8_t>(kind);
+        std::vector<Order_Id_Entry> order_ids;
+        order_ids.reserve(orders.size());
+        for (const Order_Request& order : orders){
+            order_ids.push_back(Order_Id_Entry{order.order_id});
+        }
+        session.send(encode_binary(orders_ack, order_ids));
+        Message orders_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+        orders_message.log_message(
+            client_id, 
+            Message::Sender::CLIENT_MESSAGE, 
+            Message::Type::ORDER, 
+            fmt::format("{} orders created from {}", orders.size(), describe(new_orders)), 
+            order_time
+        );
+        return true;
+    }
+
+    if (kind == Binary_Kind::MASS_CANCEL){
+        Mass_Cancel mass_cancel;
+        if (!decode_binary(input.data(), input.size(), mass_cancel)){
+            reject_binary_request(session, stock_market, 0, kind, correlation_id, -1, Reject_Reason::MALFORMED);
+            return true;
+        }
+        std::cout << "Client input : " << describe(mass_cancel) << std::endl;
+        std::optional<Order_Type> side;
+        if (mass_cancel.side != MASS_CANCEL_ANY_SIDE){
+            if (mass_cancel.side > static_cast<uint8_t>(Order_Type::SELL)){
+                reject_binary_request(session, stock_market, mass_cancel.client_id, kind, correlation_id, -1, Reject_Reason::INVALID_SIDE);
+                return true;
+            }
+            side = static_cast<Order_Type>(mass_cancel.side);
+        }
+        if (!stock_market.client_exists(mass_cancel.client_id)){
+            reject_binary_request(session, stock_market, 0, kind, correlation_id, -1, Reject_Reason::UNKNOWN_CLIENT);
+            return true;
+        }
+        std::vector<ID> cancelled_orders;
+        {
+            std::lock_guard<std::mutex> lock(mtx); // the market orders are shared with the market thread
+            cancelled_orders = stock_market.cancel_orders(mass_cancel.client_id, mass_cancel.action_id, side);
+        }
+        Orders_Ack orders_ack{};
+        orders_ack.correlation_id = correlation_id;
+        orders_ack.time = get_current_time_ms();
+        orders_ack.acked_kind = static_cast<uint8_t>(kind);
+        std::vector<Order_Id_Entry> order_ids;
+        order_ids.reserve(cancelled_orders.size());
+        for (const ID& order_id : cancelled_orders){
+            order_ids.push_back(Order_Id_Entry{order_id});
+        }
+        session.send(encode_binary(orders_ack, order_ids));
+        Message cancel_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+        cancel_message.log_message(
+            mass_cancel.client_id, 
+            Message::Sender::CLIENT_MESSAGE, 
+            Message::Type::ORDER, 
+            fmt::format("{} orders cancelled from {}", cancelled_orders.size(), describe(mass_cancel)), 
+            orders_ack.time
+        );
+        return true;
+    }
+
+    if (kind == Binary_Kind::CANCEL){
+        Cancel cancel;
+        if (!decode_binary(input.data(), input.size(), cancel)){
+            reject_binary_request(session, stock_market, 0, kind, correlation_id, -1, Reject_Reason::MALFORMED);
+            return true;
+        }
+        std::cout << "Client input : " << describe(cancel) << std::endl;
+        bool cancelled;
+        {
+            std::lock_guard<std::mutex> lock(mtx); // the market orders are shared with the market thread
+            cancelled = stock_market.cancel_order(cancel.client_id, cancel.order_id);
+        }
+        if (!cancelled){
+            reject_binary_request(session, stock_market, cancel.client_id, kind, correlation_id, cancel.order_id, Reject_Reason::UNKNOWN_ORDER);
+            return true;
+        }
+        Ack ack{};
+        ack.correlation_id = correlation_id;
+        ack.order_id = cancel.order_id;
+        ack.time = get_current_time_ms();
+        ack.acked_kind = static_cast<uint8_t>(kind);
+        send_binary(session, ack);
+        Message cancel_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+        cancel_message.log_message(
+            cancel.client_id, 
+            Message::Sender::CLIENT_MESSAGE, 
+            Message::Type::ORDER, 
+            fmt::format("Order {} cancelled", cancel.order_id), 
+            ack.time
+        );
+        return true;
+    }
+
+    if (kind == Binary_Kind::AMEND){
+        Amend amend;
+        if (!decode_binary(input.data(), input.size(), amend)){
+            reject_binary_request(session, stock_market, 0, kind, correlation_id, -1, Reject_Reason::MALFORMED);
+            return true;
+        }
+        std::cout << "Client input : " << describe(amend) << std::endl;
+        if (amend.quantity == 0 || amend.quantity > static_cast<uint32_t>(std::numeric_limits<int>::max())){
+            reject_binary_request(session, stock_market, amend.client_id, kind, correlation_id, amend.order_id, Reject_Reason::INVALID_QUANTITY);
+            return true;
+        }
+        if (!(amend.price > 0.0)){
+            reject_binary_request(session, stock_market, amend.client_id, kind, correlation_id, amend.order_id, Reject_Reason::INVALID_PRICE);
+            return true;
+        }
+        Time amend_time = get_current_time_ms();
+        std::optional<Reject_Reason> refusal;
+        {
+            std::lock_guard<std::mutex> lock(mtx); // the market orders are shared with the market thread, the balance and the shares are checked against the trades
+            refusal = stock_market.amend_order(amend.client_id, amend.order_id, static_cast<int>(amend.quantity), amend.price, amend_time);
+        }
+        if (refusal){
+            reject_binary_request(session, stock_market, amend.client_id, kind, correlation_id, amend.order_id, *refusal);
+            return true;
+        }
+        Ack ack{};
+        ack.correlation_id = correlation_id;
+        ack.order_id = amend.order_id;
+        ack.time = amend_time;
+        ack.acked_kind = static_cast<uint8_t>(kind);
+        send_binary(session, ack);
+        Message amend_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+        amend_message.log_message(
+            amend.client_id, 
+            Message::Sender::CLIENT_MESSAGE, 
+            Message::Type::ORDER, 
+            fmt::format("Order {} amended: {} actions at {}$", amend.order_id, amend.quantity, amend.price), 
+            amend_time
+        );
+        return true;
+    }
+
+    reject_binary_request(session, stock_market, 0, kind, correlation_id, -1, Reject_Reason::UNKNOWN_KIND);
+    return true;
+}
+
+
+// the client already has the last version of a view : NOT_MODIFIED is sent instead of the view (returns true if it was)
+bool send_not_modified(Session& session, const std::optional<uint64_t>& last_version, const uint64_t& version)
+{
+    if (!last_version || *last_version == 0 || *last_version != version){
+        return false;
+    }
+    session.send(fmt::format("{}{}", NOT_MODIFIED_PREFIX, version));
+    return true;
+}
+
+// a view computed once for the identical display requests arriving together, and kept for the TTL of the cache
+View_Result get_view(const std::string& key, const uint64_t& version, const View_Builder& build)
+{
+    if (!view_cache){
+        return std::make_shared<const std::string>(build());
+    }
+    return view_cache->get(key, version, build);
+}
+
+// send a view shared with other sessions, after its version if the client gave one
+void send_view(Session& session, const std::optional<uint64_t>& last_version, const uint64_t& version, const View_Result& view)
+{
+    Response_Sink sink = session.get_sink();
+    if (last_version){
+        std::string header = fmt::format("{}{} ", VIEW_VERSION_PREFIX, version);
+        sink(header.data(), header.size(), false);
+    }
+    sink(view->data(), view->size(), true);
+}
+
+
+// process a text request of a client, the responses are written in its session (returns false if the session must be closed)
+bool process_text_request(Session& session, std::string_view input, Market& stock_market)
+{
+    ID order_id = -1;
+    std::cout << "Client input : " << input << std::endl;
+
+    // the request is split in views (no copy), its command is found in the keyword table
+    Text_Tokens tokens = tokenize(input);
+    Text_Command command = get_text_command(input, tokens);
+    ID client_id = 0;
+    parse_number(tokens[0], client_id);
+
+    if (command == Text_Command::AUTHENTIFICATION){
+        // Extract username and password (after "Authentification Request:")
+        std::string_view username = tokens[2];
+        std::string_view password = tokens[3];
+        if (username.empty() || password.empty()){
+            session.send("AUTHENTIFICATION_FAILURE_INPUT");
+            Message authentification_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+            authentification_error_message.log_message(
+                0, 
                 Message::Sender::SERVER_MESSAGE, 
-                Message::Type::CLIENT_CONNECTED, 
-                "Client connected", 
+                Message::Type::AUTHENTIFICATION_FAILURE_INPUT, 
+                "Invalid input", 
                 get_current_time_ms()
             );
-            continue;
+            return false;
         }
-        const std::string exit_keyword = "exit";
-        if (input.find(exit_keyword) != std::string::npos){
-            std::istringstream iss(input);
-            ID client_id;
-            std::string command; // = "exit"
-            iss >> client_id >> command;
-            Message client_disconnection(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-            client_disconnection.log_message(
+        // the password is hashed on an auth thread, the response is sent once it is checked
+        stock_market.get_auth_service().submit(std::string(username), std::string(password), session.defer());
+        return true;
+    }
+    if (command == Text_Command::AUTHENTIFICATION_TOKEN){
+        // a token of a previous login skips the hashing
+        ID token_client_id = stock_market.get_auth_service().check_token(tokens[2]);
+        if (token_client_id == -1){
+            session.send("AUTHENTIFICATION_FAILURE_TOKEN");
+            return true;
+        }
+        session.set_client_id(token_client_id);
+        session.send(fmt::format("AUTHENTIFICATION_SUCCESS {}", token_client_id));
+        Message authentification_success_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+        authentification_success_message.log_message(
+            token_client_id,
+            Message::Sender::SERVER_MESSAGE, 
+            Message::Type::AUTHENTIFICATION_SUCCESS, 
+            "Authentification success (session token)", 
+            get_current_time_ms()
+        );
+        return true;
+    }
+    if (command == Text_Command::CLIENT_CONNECTED){
+        Message client_connection(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+        client_connection.log_message(
+            client_id, 
+            Message::Sender::SERVER_MESSAGE, 
+            Message::Type::CLIENT_CONNECTED, 
+            "Client connected", 
+            get_current_time_ms()
+        );
+        return true;
+    }
+    if (command == Text_Command::EXIT){
+        Message client_disconnection(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+        client_disconnection.log_message(
+            client_id,
+            Message::Sender::SERVER_MESSAGE, 
+            Message::Type::CLIENT_DISCONNECTED, 
+            "Client disconnected", 
+            get_current_time_ms()
+        );
+        return false;
+    }
+    // the market data feed is pushed to the session by the event loop, from a snapshot
+    if (command == Text_Command::SUBSCRIBE){
+        if (!session.subscribe(stock_market.get_feed())){
+            session.send("Error: The market data feed needs the epoll or uring network mode");
+            return true;
+        }
+        session.send("Subscribed to the market data feed"); // followed by the last snapshot and the messages published after it
+        return true;
+    }
+    if (command == Text_Command::UNSUBSCRIBE){
+        session.unsubscribe();
+        session.send("Unsubscribed from the market data feed");
+        return true;
+    }
+    // a client on the same machine moves to shared memory rings, the reactor answers with their descriptors
+    if (command == Text_Command::SHM_ATTACH){
+        if (!session.request_shared_memory()){
+            session.send("Error: Shared memory needs the epoll network mode");
+        }
+        return true;
+    }
+    // a client that reconnects gets the messages it missed (after the last sequence it read), its next messages are sequenced
+    if (command == Text_Command::RESUME){
+        std::optional<uint64_t> last_seen;
+        if (!tokens[2].empty()){
+            uint64_t sequence = 0;
+            if (!parse_number(tokens[2], sequence)){
+                session.send("Error: Invalid sequence");
+                return true;
+            }
+            last_seen = sequence;
+        }
+        if (!stock_market.client_exists(client_id)){
+            session.send("Error: Unknown client");
+            return true;
+        }
+        // only the client the session authenticated (password or token) reads its journal
+        if (session.get_client_id() != client_id){
+            session.send("Error: Resume needs the client to be authenticated on this connection");
+            return true;
+        }
+        if (!session.resume(stock_market.get_session_journal().get_stream(client_id), last_seen)){
+            session.send(fmt::format("Error: The messages after sequence {} are no longer available, display completed_orders to fill the gap", *last_seen));
+            return true;
+        }
+        session.send("Session resumed");
+        return true;
+    }
+    // the responses of at least COMPRESSION_THRESHOLD bytes are deflated (they start with COMPRESSION_PREFIX), the short ones are sent as they are
+    if (command == Text_Command::COMPRESS){
+        std::string_view algorithm = tokens[2];
+        if (algorithm != "zlib" && algorithm != "off"){
+            session.send("Error: Compression not available (zlib or off)");
+            return true;
+        }
+        session.set_compression(algorithm == "zlib");
+        session.send(fmt::format("Compression: {}", algorithm));
+        return true;
+    }
+    // display the orders if the user types 'display'
+    if (command == Text_Command::DISPLAY){
+        session.set_journaled(false); // a view missed during a drop is asked again, a gap fill resends only the orders and their answers
+        std::string_view display_type = tokens[2]; // = "portfolio/pending_orders/completed_orders/market/action_name"
+        bool no_action_name_found = false;
+        // the market, the portfolio and the action views have versions : a client giving the version it has gets NOT_MODIFIED while the view has not changed
+        // (the version is read before the view, a change made meanwhile gives a newer version at the next request)
+        std::optional<uint64_t> last_version;
+        uint64_t version = 0;
+        if (take_view_version(tokens, version)){
+            last_version = version;
+        }
+        // the portfolio, the pending orders, the market and the actions are read in the snapshots published by the engine (no lock, no query)
+        const Snapshot_Store& snapshots = stock_market.get_snapshots();
+        std::shared_ptr<const Market_Snapshot> market = snapshots.get_market();
+        if (display_type == "portfolio"){
+            std::shared_ptr<const Client_Snapshot> client = snapshots.get_client(client_id);
+            version = client && market ? client->get_portfolio_version(*market) : 0;
+            if (send_not_modified(session, last_version, version)){
+                return true;
+            }
+            std::string response = client && market ? client->get_portfolio_info(*market) : "Empty portfolio";
+            if (last_version){
+                response = fmt::format("{}{} {}", VIEW_VERSION_PREFIX, version, response);
+            }
+            session.send(response);
+            Message display_portfolio_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+            display_portfolio_message.log_message(
                 client_id,
-                Message::Sender::SERVER_MESSAGE, 
-                Message::Type::CLIENT_DISCONNECTED, 
-                "Client disconnected", 
+                Message::Sender::CLIENT_MESSAGE, 
+                Message::Type::DISPLAY_PORTFOLIO, 
+                "Display portfolio", 
                 get_current_time_ms()
             );
-            break;
         }
-        // display the orders if the user types 'display'
-        const std::string display_keyword = "display";
-        if (input.find(display_keyword) != std::string::npos){
-            std::istringstream iss(input);
-            ID client_id;
-            std::string command; // = "display"
-            std::string display_type; // = "portfolio/pending_orders/completed_orders/market/action_name"
-            iss >> client_id >> command >> display_type;
-            bool no_action_name_found = false;
-            if (display_type == "portfolio"){
-                Client client(client_id, stock_market.get_database());
-                std::string response = client.get_portfolio_info();
-                if (response.empty()){
-                    response = "Empty portfolio";
-                }
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message display_portfolio_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                display_portfolio_message.log_message(
-                    client_id,
-                    Message::Sender::CLIENT_MESSAGE, 
-                    Message::Type::DISPLAY_PORTFOLIO, 
-                    "Display portfolio", 
-                    get_current_time_ms()
-                );
+        else if (display_type == "pending_orders"){
+            std::shared_ptr<const Client_Snapshot> client = snapshots.get_client(client_id);
+            if (client && !client->pending_orders_info.empty()){
+                session.send(client->pending_orders_info.data(), client->pending_orders_info.size());
             }
-            else if (display_type == "pending_orders"){
-                Client client(client_id, stock_market.get_database());
-                std::string response = client.get_pending_orders_info();
-                if (response.empty()){
-                    response = "No pending orders";
-                }
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message display_pending_orders_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                display_pending_orders_message.log_message(
-                    client_id,
-                    Message::Sender::CLIENT_MESSAGE, 
-                    Message::Type::DISPLAY_PENDING_ORDERS, 
-                    "Display pending orders", 
-                    get_current_time_ms());
+            else {
+                session.send("No pending orders");
             }
-            else if (display_type == "completed_orders"){
+            Message display_pending_orders_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+            display_pending_orders_message.log_message(
+                client_id,
+                Message::Sender::CLIENT_MESSAGE, 
+                Message::Type::DISPLAY_PENDING_ORDERS, 
+                "Display pending orders", 
+                get_current_time_ms());
+        }
+        else if (display_type == "completed_orders"){
+            // the rows are streamed as they are read (on a response thread for an event loop session), a large history is never fully in memory
+            session.stream([&stock_market, client_id](Response_Writer& writer){
                 Client client(client_id, stock_market.get_database());
-                std::string response = client.get_completed_orders_info();
-                if (response.empty()){
-                    response = "No completed orders";
+                client.write_completed_orders_info(writer);
+                if (writer.get_written_size() == 0){
+                    writer.write("No completed orders");
                 }
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message display_completed_orders_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                display_completed_orders_message.log_message(
-                    client_id,
-                    Message::Sender::CLIENT_MESSAGE, 
-                    Message::Type::DISPLAY_COMPLETED_ORDERS, 
-                    "Display completed orders", 
-                    get_current_time_ms());
-            }
-            else if (display_type == "market"){
-                std::string response = stock_market.get_market_info();
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message display_market_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                display_market_message.log_message(client_id,
-                    Message::Sender::CLIENT_MESSAGE, 
-                    Message::Type::DISPLAY_MARKET, "Display market", get_current_time_ms());
+            });
+            Message display_completed_orders_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+            display_completed_orders_message.log_message(
+                client_id,
+                Message::Sender::CLIENT_MESSAGE, 
+                Message::Type::DISPLAY_COMPLETED_ORDERS, 
+                "Display completed orders", 
+                get_current_time_ms());
+        }
+        else if (display_type == "market" && market){
+            version = market->version;
+            if (send_not_modified(session, last_version, version)){
+                return true;
             }
-            else if (display_type != ""){ // an action's name is the display type
-                // getting the action id from the name
-                std::string query = fmt::format(
-                    "SELECT action_id FROM actions WHERE name = '{}'", 
-                    display_type
+            send_view(session, last_version, version, View_Result(market, &market->market_info)); // shares the snapshot, nothing is copied before the framing
+            Message display_market_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+            display_market_message.log_message(client_id,
+                Message::Sender::CLIENT_MESSAGE, 
+                Message::Type::DISPLAY_MARKET, "Display market", get_current_time_ms());
+        }
+        else if (display_type == "feed"){ // lag of the subscribers of the market data feed (operations)
+            std::string response = stock_market.get_feed().get_subscribers_info();
+            session.send(response.empty() ? "No subscriber to the market data feed" : response);
+        }
+        else if (display_type == "limits"){ // requests refused by the rate limits (operations)
+            session.send(rate_limiter ? rate_limiter->get_counters() : "No rate limit");
+        }
+        else if (display_type == "cache"){ // views computed and shared by the display requests (operations)
+            session.send(view_cache ? view_cache->get_counters() : "No view cache");
+        }
+        else if (display_type == "bars"){ // display bars action_name resolution [YYYY-MM-DD HH:MM:SS YYYY-MM-DD HH:MM:SS]
+            std::string_view action_name = tokens[3];
+            std::string_view resolution_name = tokens[4];
+            std::string query = fmt::format(
+                "SELECT action_id FROM actions WHERE name = '{}'", 
+                action_name
+            );
+            ID action_id = stock_market.get_database().execute_SQL_query_ID(query);
+            Time resolution = get_bar_resolution_from_string(std::string(resolution_name));
+            if (action_id == -1 || resolution == 0){
+                std::string response = fmt::format(
+                    "Error: Bars of '{}' at resolution '{}' not available (resolutions: 1s, 1min, 5min, 1d)", 
+                    action_name,
+                    resolution_name
                 );
-                ID action_id = stock_market.get_database().execute_SQL_query_ID(query);
-                if (action_id != -1){ // if we found it 
-                    Action action(action_id, stock_market.get_database());
-                    std::string response = action.get_action_info();
-                    send(client_socket, response.c_str(), response.length(), 0);
-                    Message display_action_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                    display_action_message.log_message(
-                        client_id,
-                        Message::Sender::CLIENT_MESSAGE, 
-                        Message::Type::DISPLAY_ACTION, 
-                        "Display action: " + display_type, 
-                        get_current_time_ms()
-                    );
+                session.send(response);
+                return true;
+            }
+            Time from = 0;
+            Time to = no_expiration_time;
+            if (tokens.count >= 9){
+                try {
+                    from = get_time_from_strings(tokens[5], tokens[6]);
+                    to = get_time_from_strings(tokens[7], tokens[8]);
                 }
-                else {
-                    no_action_name_found = true;
+                catch (const std::invalid_argument& error){
+                    std::string response = fmt::format("Error: Display range not recognized ({})", error.what());
+                    session.send(response);
+                    return true;
                 }
             }
-            if (no_action_name_found){
-                std::string response = fmt::format(
-                    "Error: Display type '{}' not recognized, or action does not exist", 
-                    display_type
-                );
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message display_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                display_error_message.log_message(
-                    client_id, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::ERROR, "Display type not recognized", 
-                    get_current_time_ms()
-                );
-            }
-            continue;
+            // read in the bars table, on a response thread for an event loop session
+            session.stream([&stock_market, action_id, resolution, from, to](Response_Writer& writer){
+                Action action(action_id, stock_market.get_database());
+                writer.write(action.get_bars_info(stock_market.get_bar_aggregator(), resolution, from, to));
+            });
+            Message display_bars_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+            display_bars_message.log_message(
+                client_id,
+                Message::Sender::CLIENT_MESSAGE, 
+                Message::Type::DISPLAY_ACTION, 
+                fmt::format("Display bars: {} {}", action_name, resolution_name), 
+                get_current_time_ms()
+            );
         }
-        // if the input contains a deposit command, we deposit the amount to the client
-        if (input.find("deposit") != std::string::npos){ // "amount deposit"
-            std::istringstream iss(input);
-            int client_id;
-            double amount;
-            iss >> client_id >> amount;
-            if (stock_market.client_exists(client_id)){
-                stock_market.deposit(client_id, amount);
-                std::string response = fmt::format("Deposited {}$ to client {}", amount, client_id);
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message deposit_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                deposit_message.log_message(
-                    client_id, 
+        else if (display_type != ""){ // an action's name is the display type
+            const Action_Snapshot* action_snapshot = market ? market->find_action(display_type) : nullptr;
+            if (action_snapshot != nullptr){ // if we found it 
+                ID action_id = action_snapshot->action_id;
+                version = stock_market.get_view_versions().get_action_version(action_id);
+                if (send_not_modified(session, last_version, version)){
+                    return true;
+                }
+                // optional time range : display action_name [YYYY-MM-DD HH:MM:SS YYYY-MM-DD HH:MM:SS]
+                Time from = 0;
+                Time to = no_expiration_time;
+                if (tokens.count >= 7){
+                    try {
+                        from = get_time_from_strings(tokens[3], tokens[4]);
+                        to = get_time_from_strings(tokens[5], tokens[6]);
+                    }
+                    catch (const std::invalid_argument& error){
+                        std::string response = fmt::format("Error: Display range not recognized ({})", error.what());
+                        session.send(response);
+                        return true;
+                    }
+                }
+                // the price history is read in the tick store on a response thread (event loop session) : a long one is streamed as it is read,
+                // a short one (at most VIEW_CACHE_MAX_TICKS ticks) is shared by the identical requests arriving together
+                std::string action_name = action_snapshot->name;
+                int quantity = action_snapshot->quantity;
+                bool cached = stock_market.get_tick_store().get_tick_count(action_id) <= VIEW_CACHE_MAX_TICKS;
+                session.stream([&stock_market, action_id, action_name, quantity, from, to, last_version, version, cached](Response_Writer& writer){
+                    if (last_version){
+                        writer.write(fmt::format("{}{} ", VIEW_VERSION_PREFIX, version));
+                    }
+                    if (!cached){
+                        writer.write(fmt::format("{} {}", action_name, quantity));
+                        Action action(action_id, stock_market.get_database());
+                        action.write_price_history(stock_market.get_tick_store(), writer, from, to);
+                        return;
+                    }
+                    View_Result view = get_view(fmt::format("action {} {} {}", action_id, from, to), version, [&stock_market, action_id, action_name, quantity, from, to](){
+                        std::string result = fmt::format("{} {}", action_name, quantity);
+                        Response_Writer history_writer([&result](const char* data, size_t length, bool){ result.append(data, length); });
+                        Action action(action_id, stock_market.get_database());
+                        action.write_price_history(stock_market.get_tick_store(), history_writer, from, to);
+                        history_writer.finish();
+                        return result;
+                    });
+                    writer.write(*view);
+                });
+                Message display_action_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+                display_action_message.log_message(
+                    client_id,
                     Message::Sender::CLIENT_MESSAGE, 
-                    Message::Type::DEPOSIT, 
-                    response, 
-                    get_current_time_ms());
-            }
-            else {
-                std::string response = fmt::format("Client {} does not exist", client_id);
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message client_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                client_error_message.log_message(
-                    0, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::ERROR, 
-                    response, 
+                    Message::Type::DISPLAY_ACTION, 
+                    fmt::format("Display action: {}", display_type), 
                     get_current_time_ms()
                 );
             }
-            continue;
+            else {
+                no_action_name_found = true;
+            }
         }
-        // if the input contains a withdraw command, we withdraw the amount from the client
-        if (input.find("withdraw") != std::string::npos){ // "amount withdraw"
-            std::istringstream iss(input);
-            int client_id;
-            double amount;
-            iss >> client_id >> amount;
+        if (no_action_name_found){
+            std::string response = fmt::format(
+                "Error: Display type '{}' not recognized, or action does not exist", 
+                display_type
+            );
+            session.send(response);
+            Message display_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+            display_error_message.log_message(
+                client_id, 
+                Message::Sender::SERVER_MESSAGE, 
+                Message::Type::ERROR, "Display type not recognized", 
+                get_current_time_ms()
+            );
+        }
+        return true;
+    }
+    // if the input contains a deposit or withdraw command, we deposit the amount to the client or withdraw it from him
+    if (command == Text_Command::DEPOSIT || command == Text_Command::WITHDRAW){ // "[amount] value deposit|withdraw"
+        // the amount is the first number between the client id and the command
+        double amount = 0.0;
+        bool amount_found = false;
+        for (size_t index = 1; index + 1 < tokens.count && !amount_found; ++index){
+            amount_found = parse_number(tokens[index], amount);
+        }
+        if (!amount_found){
+            session.send("Error: Amount not recognized (use amount [value] deposit|withdraw)");
+            return true;
+        }
+        if (command == Text_Command::WITHDRAW){
             if (stock_market.client_exists(client_id)){
                 if (stock_market.can_afford(client_id, 1, amount, -1)){
                     stock_market.withdraw(client_id, amount);
                     std::string response = fmt::format("Withdrew {}$ from client {}", amount, client_id);
-                    send(client_socket, response.c_str(), response.length(), 0);
+                    session.send(response);
                     Message withdraw_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
                     withdraw_message.log_message(
                         client_id, 
@@ -270,7 +817,7 @@ void handle_client(int client_socket, Market& stock_market, const int& process_t
                 } 
                 else {
                     std::string response = fmt::format("Insufficient balance for client {} to withdraw {}", client_id, amount);
-                    send(client_socket, response.c_str(), response.length(), 0);
+                    session.send(response);
                     Message withdraw_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
                     withdraw_error_message.log_message(
                         client_id, 
@@ -283,7 +830,7 @@ void handle_client(int client_socket, Market& stock_market, const int& process_t
             } 
             else {
                 std::string response = fmt::format("Client {} does not exist", client_id);
-                send(client_socket, response.c_str(), response.length(), 0);
+                session.send(response);
                 Message client_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
                 client_error_message.log_message(
                     0, 
@@ -293,426 +840,259 @@ void handle_client(int client_socket, Market& stock_market, const int& process_t
                     get_current_time_ms()
                 );
             }
-            continue;
+            return true;
         }
-
-        // if the input contains an order, we then process it
-        std::istringstream iss(input);
-        std::string type_str, trigger_type_str, validity_date_str, validity_daily_time_str;
-        ID client_id, action_id;
-        int quantity;
-        double price, trigger_price_lower, trigger_price_upper; 
-        iss >> client_id 
-            >> type_str 
-            >> quantity
-            >> action_id
-            >> trigger_type_str;
-
-        // verifying that this is a BUY or SELL order 
-        Order_Type type = Order_Type::BUY;
-        if (type_str == "SELL"){
-            type = Order_Type::SELL;
-        }
-        else if (type_str != "BUY"){
-            std::string response = "Error: Order type not recognized (use BUY or SELL)";
-            send(client_socket, response.c_str(), response.length(), 0);
-            Message order_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-            order_error_message.log_message(
+        if (stock_market.client_exists(client_id)){
+            stock_market.deposit(client_id, amount);
+            std::string response = fmt::format("Deposited {}$ to client {}", amount, client_id);
+            session.send(response);
+            Message deposit_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+            deposit_message.log_message(
                 client_id, 
+                Message::Sender::CLIENT_MESSAGE, 
+                Message::Type::DEPOSIT, 
+                response, 
+                get_current_time_ms());
+        }
+        else {
+            std::string response = fmt::format("Client {} does not exist", client_id);
+            session.send(response);
+            Message client_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+            client_error_message.log_message(
+                0, 
                 Message::Sender::SERVER_MESSAGE, 
                 Message::Type::ERROR, 
-                "Order type not recognized", 
+                response, 
                 get_current_time_ms()
             );
-            continue;
         }
+        return true;
+    }
+    // otherwise the input is an order : it is read and validated against the rules of its trigger type
+    Text_Order order;
+    Text_Order_Error order_error = parse_text_order(tokens, order);
+    if (order_error != Text_Order_Error::NONE){
+        std::string error = text_order_error_to_string(order_error, order);
+        session.send("Error: " + error);
+        Message order_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+        order_error_message.log_message(
+            client_id, 
+            Message::Sender::SERVER_MESSAGE, 
+            Message::Type::ERROR, 
+            error, 
+            get_current_time_ms()
+        );
+        return true;
+    }
+    Order_Type type = order.type;
+    int quantity = order.quantity;
+    ID action_id = order.action_id;
+    Order_Trigger trigger_type = order.rule->trigger;
+    double price = order.price;
+    double trigger_price_lower = order.trigger_price_lower;
+    double trigger_price_upper = order.trigger_price_upper;
+    ID validity_time = order.validity_time;
 
-        // parsing of the input based on the order type 
-        // a market order has no trigger price, so we set it to 0 and max_number
-        // on top of that, the buy price is the selling price, and the order is prioritized compared to limit orders
-        // so we set the price of the order to the maximum
-        Order_Trigger trigger_type;
-        if (trigger_type_str == "MARKET") {
-            trigger_type = Order_Trigger::MARKET;
-            price = max_number; // we set the price to the maximum, so it is prioritized, but the client will not be charged this price, but the selling price
-            trigger_price_lower = 0.0;
-            trigger_price_upper = max_number; 
-        }
-        // if the trigger type is a limit order, we set the max possible price to the maximum number
-        // the lower bound is supposed to be provided by the client 
-        else if (trigger_type_str == "LIMIT") {
-            trigger_type = Order_Trigger::LIMIT;
-            iss >> price >> trigger_price_lower;
-            trigger_price_upper = max_number;
-            // we must verify that a price has been given 
-            if (!price){
-                std::string response = "Error: Price must be provided for a limit order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message price_missing_error(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                price_missing_error.log_message(
-                    client_id,
-                    Message::Sender::SERVER_MESSAGE,
-                    Message::Type::ERROR,
-                    "Price must be provided for a limit order",
-                    get_current_time_ms()
-                );
-                continue;
-            }
-            // we must verify that the price is not negative
-            if (price < 0.0){
-                std::string response = "Error: Price must be positive for a limit order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message price_negative_error(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                price_negative_error.log_message(
-                    client_id,
-                    Message::Sender::SERVER_MESSAGE,
-                    Message::Type::ERROR,
-                    "Price must be positive for a limit order",
-                    get_current_time_ms()
-                );
-                continue;
-            }
-            // we must verify that the lower bound given exists
-            if (!trigger_price_lower){
-                std::string response = "Error: Trigger price lower must be provided for a limit order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message trigger_price_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                trigger_price_error_message.log_message(
-                    client_id, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::ERROR, 
-                    "Trigger price lower must be provided for a limit order", 
-                    get_current_time_ms()
-                );
-                continue;
-            }
-            // we must verify that the lower bound given is not negative
-            if (trigger_price_lower < 0.0){
-                std::string response = "Error: Trigger price lower must be positive for a limit order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message trigger_price_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                trigger_price_error_message.log_message(
-                    client_id, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::ERROR, 
-                    "Trigger price lower must be positive for a limit order", 
-                    get_current_time_ms()
-                );
-                continue;
-            }
-        }
-        // if the trigger type is a stop order, we set the lower bound to 0
-        // the upper bound is supposed to be provided by the client
-        else if (trigger_type_str == "STOP"){
-            trigger_type = Order_Trigger::STOP;
-            iss >> price >> trigger_price_upper;
-            trigger_price_lower = 0.0;
-            // we must verify that a price has been given 
-            if (!price){
-                std::string response = "Error: Price must be provided for a stop order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message price_missing_error(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                price_missing_error.log_message(
-                    client_id,
-                    Message::Sender::SERVER_MESSAGE,
-                    Message::Type::ERROR,
-                    "Price must be provided for a stop order",
-                    get_current_time_ms()
-                );
-                continue;
-            }
-            // we must verify that the price is not negative
-            if (price < 0.0){
-                std::string response = "Error: Price must be positive for a stop order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message price_negative_error(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                price_negative_error.log_message(
-                    client_id,
-                    Message::Sender::SERVER_MESSAGE,
-                    Message::Type::ERROR,
-                    "Price must be positive for a stop order",
-                    get_current_time_ms()
-                );
-                continue;
-            }
-            // we must verify that the upper bound given exists
-            if (!trigger_price_upper){
-                std::string response = "Error: Trigger price upper must be provided for a stop order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message trigger_price_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                trigger_price_error_message.log_message(
-                    client_id, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::ERROR, 
-                    "Trigger price upper must be provided for a stop order",    
-                    get_current_time_ms()
-                );
-                continue;
-            }
-            // we must verify that the upper bound given is not negative
-            if (trigger_price_upper < 0.0){
-                std::string response = "Error: Trigger price upper must be positive for a stop order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message trigger_price_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                trigger_price_error_message.log_message(
-                    client_id, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::ERROR, 
-                    "Trigger price upper must be positive for a stop order",
-                    get_current_time_ms()
-                );
-                continue;   
-            }
-        }
-        else if (trigger_type_str == "LIMIT_STOP") {
-            trigger_type = Order_Trigger::LIMIT_STOP;
-            iss >> price >> trigger_price_lower >> trigger_price_upper;
-            // we must verify that a price has been given 
-            if (!price){
-                std::string response = "Error: Price must be provided for a limit-stop order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message price_missing_error(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                price_missing_error.log_message(
-                    client_id,
-                    Message::Sender::SERVER_MESSAGE,
-                    Message::Type::ERROR,
-                    "Price must be provided for a limit-stop order",
-                    get_current_time_ms()
-                );
-                continue;
-            }
-            // we must verify that the price is not negative
-            if (price < 0.0){
-                std::string response = "Error: Price must be positive for a limit-stop order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message price_negative_error(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                price_negative_error.log_message(
-                    client_id,
-                    Message::Sender::SERVER_MESSAGE,
-                    Message::Type::ERROR,
-                    "Price must be positive for a limit-stop order",
-                    get_current_time_ms()
-                );
-                continue;
-            }
-            // we must verify that the lower bound given exists
-            if (!trigger_price_lower){
-                std::string response = "Error: Trigger price lower must be provided for a limit stop order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message trigger_price_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                trigger_price_error_message.log_message(
-                    client_id, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::ERROR, 
-                    "Trigger price lower must be provided for a limit stop order",
-                    get_current_time_ms()
-                );
-                continue;
-            }
-            // we must verify that the lower bound given is not negative
-            if (trigger_price_lower < 0.0){
-                std::string response = "Error: Trigger price lower must be positive for a limit stop order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message trigger_price_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                trigger_price_error_message.log_message(
-                    client_id, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::ERROR, 
-                    "Trigger price lower must be positive for a limit stop order",
-                    get_current_time_ms()
-                );
-                continue;
-            }
-            // we must verify that the upper bound given exists
-            if (!trigger_price_upper){
-                std::string response = "Error: Trigger price upper must be provided for a limit stop order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message trigger_price_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                trigger_price_error_message.log_message(
-                    client_id, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::ERROR, 
-                    "Trigger price upper must be provided for a limit stop order",
-                    get_current_time_ms()
-                );
-                continue;
-            }
-            // we must verify that the upper bound given is not negative
-            if (trigger_price_upper < 0.0){
-                std::string response = "Error: Trigger price upper must be positive for a limit stop order";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message trigger_price_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                trigger_price_error_message.log_message(
-                    client_id, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::ERROR, 
-                    "Trigger price upper must be positive for a limit stop order",
-                    get_current_time_ms()
-                );
-                continue;
-            }
-        }
-        // otherwise there has been a mistake made by the client considering the input to pass an order 
-        else {
-            std::string response = "Error: Trigger type not recognized (use MARKET, LIMIT, STOP or LIMIT_STOP)";
-            send(client_socket, response.c_str(), response.length(), 0);
-            Message trigger_type_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-            trigger_type_error_message.log_message(
+    // looking if the action exists, if not we said it 
+    if (!stock_market.action_exists(action_id)){
+        std::string response = fmt::format("Error: Action {} does not exist", action_id);
+        session.send(response);
+        Message action_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+        action_error_message.log_message(
+            client_id, 
+            Message::Sender::SERVER_MESSAGE, 
+            Message::Type::ERROR, 
+            response, 
+            get_current_time_ms()
+        );
+        return true;
+    }
+
+    // before accumulating the order, we need to check if the client has enough funds or actions
+    if (type == Order_Type::BUY){
+        if (!stock_market.can_afford(client_id, quantity, price, action_id)){
+            std::string response = "Error: Insufficient balance for buying";
+            session.send(response);
+            Message client_insufficient_balance_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+            client_insufficient_balance_message.log_message(
                 client_id, 
                 Message::Sender::SERVER_MESSAGE, 
                 Message::Type::ERROR, 
-                "Trigger type not recognized", 
+                "Insufficient balance for buying", 
                 get_current_time_ms()
             );
-            continue;
+            return true;
         }
-
-        // extracting a possible validity date entered by the client
-        iss >> validity_date_str >> validity_daily_time_str;
-        ID validity_date = max_number;
-        if (!validity_date_str.empty()){
-            validity_date = get_date_id_from_string(validity_date_str);
-        }
-        ID validity_daily = 0;
-        if (!validity_daily_time_str.empty()){
-            validity_daily = get_daily_id_from_string(validity_daily_time_str);
-        }
-
-        // looking if the action exists, if not we said it 
-        if (!stock_market.action_exists(action_id)){
-            std::string response = fmt::format("Error: Action {} does not exist", action_id);
-            send(client_socket, response.c_str(), response.length(), 0);
-            Message action_error_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-            action_error_message.log_message(
+    }
+    else if (type == Order_Type::SELL){
+        if (!stock_market.has_shares(client_id, action_id, quantity)){
+            std::string response = "Error: Failed to sell action, client does not have enough shares";
+            session.send(response);
+            Message client_failed_to_sell_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+            client_failed_to_sell_message.log_message(
                 client_id, 
                 Message::Sender::SERVER_MESSAGE, 
                 Message::Type::ERROR, 
-                response, 
+                "Failed to sell action, client does not have enough shares", 
                 get_current_time_ms()
             );
-            continue;
+            return true;
         }
+    }
 
-        // before accumulating the order, we need to check if the client has enough funds or actions
-        if (type == Order_Type::BUY){
-            if (!stock_market.can_afford(client_id, quantity, price, action_id)){
-                std::string response = "Error: Insufficient balance for buying";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message client_insufficient_balance_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                client_insufficient_balance_message.log_message(
-                    client_id, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::ERROR, 
-                    "Insufficient balance for buying", 
-                    get_current_time_ms()
-                );
-                continue;
-            }
-        }
-        else if (type == Order_Type::SELL){
-            if (!stock_market.has_shares(client_id, action_id, quantity)){
-                std::string response = "Error: Failed to sell action, client does not have enough shares";
-                send(client_socket, response.c_str(), response.length(), 0);
-                Message client_failed_to_sell_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-                client_failed_to_sell_message.log_message(
-                    client_id, 
-                    Message::Sender::SERVER_MESSAGE, 
-                    Message::Type::ERROR, 
-                    "Failed to sell action, client does not have enough shares", 
-                    get_current_time_ms()
-                );
-                continue;
-            }
-        }
+    // if the order is valid, we create it
+    order_id = stock_market.get_database().get_new_order_id();
+    Time order_time = get_current_time_ms();
 
-        // if the order is valid, we create it
-        order_id = stock_market.get_database().get_new_order_id();
-        Time order_time = get_current_time_ms();
-        ID order_time_daily = get_daily_time(order_time);
-        ID order_time_date = get_date_time(order_time);
+    std::string response = fmt::format(
+        "Order created with ID: {} for client {} to {} {} actions of {} at the price of {}$ at time {} with trigger type {} and trigger price lower {} and trigger price upper {} until validity date {}",
+        order_id, 
+        client_id, 
+        order_type_to_string(type), 
+        quantity, 
+        action_id, 
+        price,
+        time_to_string(order_time), 
+        order.rule->name, 
+        trigger_price_lower, 
+        trigger_price_upper,
+        time_to_string(validity_time)
+    );
+    Message order_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
+    order_message.log_message(
+        client_id, 
+        Message::Sender::CLIENT_MESSAGE, 
+        Message::Type::ORDER, 
+        response, 
+        order_time
+    );
+    session.send(response);
 
-        std::string response = fmt::format(
-            "Order created with ID: {} for client {} to {} {} actions of {} at the price of {}$ at time {} with trigger type {} and trigger price lower {} and trigger price upper {} until validity date {}",
-            order_id, 
-            client_id, 
-            type_str, 
-            quantity, 
-            action_id, 
-            price,
-            time_to_string(order_time), 
-            trigger_type_str, 
-            trigger_price_lower, 
-            trigger_price_upper,
-            two_times_to_string(validity_date, validity_daily)
-        );
-        Message order_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-        order_message.log_message(
-            client_id, 
-            Message::Sender::CLIENT_MESSAGE, 
-            Message::Type::ORDER, 
-            response, 
-            order_time
-        );
-        send(client_socket, response.c_str(), response.length(), 0);
-
-        // running the session by making the trades for an order without any trigger
-        // otherwise it will be delayed until the trigger is reached (dealed with another thread and function)
-        if (trigger_type == Order_Trigger::MARKET){
-            stock_market.accumulate_order(client_id, order_id, order_time_date, order_time_daily, type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, validity_date, validity_daily);
-            Message server_accumulating_order_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
-            server_accumulating_order_message.log_message(
-                0, 
-                Message::Sender::SERVER_MESSAGE, 
-                Message::Type::ACCUMULATING_ORDER, 
-                "Accumulating the order …", 
-                get_current_time_ms()
-            );
-            if (is_continuous_trading_period){
-                // if not already processing, process the trades
-                if (!processing){
-                    processing = true;
-                    mtx.lock();
-                    std::this_thread::sleep_for(std::chrono::milliseconds(process_time)); // simulate processing time
-                    stock_market.process_continuous_trading();
-                    mtx.unlock();
-                    processing = false;
-                }
+    submit_order(stock_market, client_id, order_id, order_time, type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, validity_time);
+    return true;
+}
+
+
+// orders of a request, read before it is parsed (the rate limits are checked before the request is handled, the client buckets are the ones of the client the session authenticated)
+Request_Class classify_request(std::string_view input)
+{
+    if (is_binary_message(input.data(), input.size())){
+        return Request_Class{count_binary_orders(input.data(), input.size())};
+    }
+    uint64_t correlation_id;
+    take_correlation_id(input, correlation_id);
+    Text_Tokens tokens = tokenize(input);
+    Text_Command command = get_text_command(input, tokens);
+    return Request_Class{command == Text_Command::ORDER ? 1u : 0u};
+}
+
+// answer a request refused by the rate limits : a Reject, or an error tagged with the correlation id (nothing is logged, a flood costs no write)
+void reject_rate_limited_request(Session& session, std::string_view input, const Rate_Decision& decision)
+{
+    if (is_binary_message(input.data(), input.size())){
+        Binary_Header header{};
+        decode_binary_header(input.data(), input.size(), header);
+        Reject reject{};
+        reject.correlation_id = decode_correlation_id(input.data(), input.size());
+        reject.order_id = -1;
+        reject.rejected_kind = header.kind;
+        reject.reason = static_cast<uint16_t>(Reject_Reason::RATE_LIMITED);
+        send_binary(session, reject);
+        return;
+    }
+    uint64_t correlation_id;
+    if (take_correlation_id(input, correlation_id)){
+        session.set_correlation_tag(fmt::format("{}{} ", CORRELATION_PREFIX, correlation_id));
+    }
+    session.send(fmt::format("{} ({})", RATE_LIMIT_RESPONSE, rate_decision_to_string(decision)));
+    session.set_correlation_tag("");
+}
+
+// process a request of a client, the responses are written in its session (returns false if the session must be closed)
+bool process_request(Session& session, std::string_view input, Market& stock_market)
+{
+    // the binary requests (the text requests stay available, for the console client and debugging)
+    if (is_binary_message(input.data(), input.size())){
+        return process_binary_request(session, input, stock_market);
+    }
+    // a text request with a correlation id : its responses are tagged with it, so that the client can send the next requests without waiting
+    uint64_t correlation_id;
+    if (!take_correlation_id(input, correlation_id)){
+        return process_text_request(session, input, stock_market);
+    }
+    session.set_correlation_tag(fmt::format("{}{} ", CORRELATION_PREFIX, correlation_id));
+    bool keep_session = process_text_request(session, input, stock_market);
+    session.set_correlation_tag("");
+    return keep_session;
+}
+
+
+// Function to handle client requests (thread-per-client mode : blocking reads, the responses are sent right away)
+void handle_client(int client_socket, Market& stock_market)
+{
+    Session session(client_socket, true);
+    session.set_rate_limiter(rate_limiter.get());
+    Request_Handler handler = [&stock_market](Session& session, std::string_view request){
+        return process_request(session, request, stock_market);
+    };
+
+    while (!shutdown_flag.load() && !session.is_closing()){
+        // the thread wakes up at least every heartbeat interval, to send the heartbeat of an idle session and to check that its client is alive
+        struct pollfd readable = {client_socket, POLLIN, 0};
+        int ready = poll(&readable, 1, std::min(heartbeat_policy.interval, MS_IN_S));
+        if (ready <= 0){
+            if ((ready < 0 && errno != EINTR) || !session.check_heartbeat(heartbeat_policy)){
+                break;
             }
+            continue;
         }
-        // we still create the order in the database even if it is not processed yet
-        else {
-            stock_market.add_order_to_client_pending_orders(client_id, order_id, order_time_date, order_time_daily, type, quantity, action_id, trigger_type, price, trigger_price_lower, trigger_price_upper, validity_date, validity_daily);
+        ssize_t valread = session.get_input().receive(client_socket);
+        if (valread < 0 && errno == EINTR){
+            continue;
+        }
+        if (valread <= 0){
+            break; // client disconnected, or a frame too large for the buffer
+        }
+        if (!session.process_input(handler)){
+            break;
         }
     }
     close(client_socket);
 }
 
 
-// this function will handle client connections concurrently
-void accept_clients(int server_fd, struct sockaddr_in& client_addr, socklen_t& addr_len, Market& stock_market, const int& process_time) {
+// this function will handle client connections concurrently (thread-per-client mode), from the TCP socket and the local socket
+void accept_clients(int server_fd, int local_fd, struct sockaddr_in& client_addr, socklen_t& addr_len, Market& stock_market) {
     fd_set read_fds;
     struct timeval timeout;
 
     while (!shutdown_flag.load()){
         FD_ZERO(&read_fds);
         FD_SET(server_fd, &read_fds);
+        if (local_fd >= 0){
+            FD_SET(local_fd, &read_fds);
+        }
 
         timeout.tv_sec = 1;  // timeout of 1 seconds
         timeout.tv_usec = 0;
 
-        int activity = select(server_fd + 1, &read_fds, nullptr, nullptr, &timeout);
+        int activity = select(std::max(server_fd, local_fd) + 1, &read_fds, nullptr, nullptr, &timeout);
         if (activity < 0 && errno != EINTR){
             perror("Select error");
             break;
         }
 
-        if (activity > 0 && FD_ISSET(server_fd, &read_fds)){
-            int client_socket = accept(server_fd, (struct sockaddr*)&client_addr, &addr_len);
+        for (int listen_fd : {server_fd, local_fd}){
+            if (activity <= 0 || listen_fd < 0 || !FD_ISSET(listen_fd, &read_fds)){
+                continue;
+            }
+            socklen_t client_addr_len = addr_len;
+            int client_socket = listen_fd == server_fd ? accept(server_fd, (struct sockaddr*)&client_addr, &client_addr_len) : accept(local_fd, nullptr, nullptr);
             if (client_socket < 0) {
                 perror("Error accept");
                 continue;
             }
-            std::thread client_thread(handle_client, client_socket, std::ref(stock_market), process_time);
+            std::thread client_thread(handle_client, client_socket, std::ref(stock_market));
             client_thread.detach();
         }
     }
@@ -720,7 +1100,7 @@ void accept_clients(int server_fd, struct sockaddr_in& client_addr, socklen_t& a
 
 
 // handle the market session phases independently to the clients interactions
-void market_session(Market& stock_market, int pre_open_time_delay, int open_time_delay, int continuous_trading_time_delay, int pre_close_time_delay, int continuous_trading_loop_duration)
+void market_session(Market& stock_market, int pre_open_time_delay, int open_time_delay, int continuous_trading_time_delay, int pre_close_time_delay, int continuous_trading_loop_duration, int process_time)
 {
     // pre-open phase: Accumulate orders without transactions
     std::cout << "Pre-open phase, accumulating orders …" << std::endl;
@@ -732,11 +1112,16 @@ void market_session(Market& stock_market, int pre_open_time_delay, int open_time
         "Market pre-open phase, accumulating orders", 
         get_current_time_ms()
     );
+    stock_market.get_feed().publish_phase(Market_Phase::PRE_OPEN, get_current_time_ms());
     std::this_thread::sleep_for(std::chrono::milliseconds(pre_open_time_delay));
 
     // open phase: Calculate equilibrium price (Price Fixing)
     std::cout << "Open phase, calculating equilibrium price …" << std::endl;
-    stock_market.process_fixing(); // process the fixing of the price to execute the transactions possible and defining the equilibrium price
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stock_market.process_fixing(); // process the fixing of the price to execute the transactions possible and defining the equilibrium price
+        stock_market.publish_snapshots();
+    }
     Message open_phase_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
     open_phase_message.log_message(
         0, 
@@ -745,6 +1130,7 @@ void market_session(Market& stock_market, int pre_open_time_delay, int open_time
         "Market open phase (fixing)", 
         get_current_time_ms()
     );
+    stock_market.get_feed().publish_phase(Market_Phase::OPEN, get_current_time_ms());
     std::this_thread::sleep_for(std::chrono::milliseconds(open_time_delay));
 
     // continuous trading phase: Run stock market exchange in real time
@@ -757,10 +1143,26 @@ void market_session(Market& stock_market, int pre_open_time_delay, int open_time
         "Market continuous trading phase", 
         get_current_time_ms()
     );
+    stock_market.get_feed().publish_phase(Market_Phase::CONTINUOUS_TRADING, get_current_time_ms());
     auto continuous_trading_end_time = std::chrono::steady_clock::now() + std::chrono::milliseconds(continuous_trading_time_delay);
     is_continuous_trading_period = true;
-    while (std::chrono::steady_clock::now() < continuous_trading_end_time){
-        std::this_thread::sleep_for(std::chrono::milliseconds(continuous_trading_loop_duration));
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        orders_to_process = false; // as before, the processing is triggered by the orders of the period
+        while (std::chrono::steady_clock::now() < continuous_trading_end_time){
+            // wait for new orders (or the end of the loop duration)
+            auto wake_up_time = std::min(continuous_trading_end_time, std::chrono::steady_clock::now() + std::chrono::milliseconds(continuous_trading_loop_duration));
+            orders_to_process_cv.wait_until(lock, wake_up_time, []{ return orders_to_process; });
+            if (!orders_to_process){
+                continue;
+            }
+            orders_to_process = false;
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(process_time)); // simulate processing time (the orders keep being accumulated meanwhile)
+            lock.lock();
+            stock_market.process_continuous_trading();
+            stock_market.publish_snapshots(); // the trades of the batch are displayed at once
+        }
     }
     is_continuous_trading_period = false;
 
@@ -774,11 +1176,16 @@ void market_session(Market& stock_market, int pre_open_time_delay, int open_time
         "Market pre-close phase (fixing)", 
         get_current_time_ms()
     );
+    stock_market.get_feed().publish_phase(Market_Phase::PRE_CLOSE, get_current_time_ms());
     std::this_thread::sleep_for(std::chrono::milliseconds(pre_close_time_delay));
 
     // market closing phase: Market is closing, wrap up transactions
     std::cout << "Market closing phase, calculating equilibrium price …" << std::endl;
-    stock_market.process_fixing(); // process the fixing of the price to execute the transactions possible and defining the equilibrium price
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stock_market.process_fixing(); // process the fixing of the price to execute the transactions possible and defining the equilibrium price
+        stock_market.publish_snapshots();
+    }
     Message close_phase_message(stock_market.get_database().get_new_message_id(), stock_market.get_database());
     close_phase_message.log_message(
         0, 
@@ -787,11 +1194,31 @@ void market_session(Market& stock_market, int pre_open_time_delay, int open_time
         "Market close phase, accumulating orders", 
         get_current_time_ms()
     );
+    stock_market.get_feed().publish_phase(Market_Phase::CLOSE, get_current_time_ms());
 
     shutdown_flag.store(true);
 }
 
 
+// publish the changes of the book in the market data feed, and take its snapshots, until the market session ends
+void publish_market_data(Market& stock_market)
+{
+    auto next_snapshot_time = std::chrono::steady_clock::now() + std::chrono::milliseconds(FEED_SNAPSHOT_INTERVAL);
+    while (!shutdown_flag.load()){
+        std::this_thread::sleep_for(std::chrono::milliseconds(FEED_PUBLISH_INTERVAL));
+        {
+            std::lock_guard<std::mutex> lock(mtx); // the pending orders are read while no order is matched
+            stock_market.publish_book_changes();
+            stock_market.publish_snapshots(); // the changes of the requests (orders waiting for their trigger, deposits) are seen by the display requests
+        }
+        if (std::chrono::steady_clock::now() >= next_snapshot_time){
+            stock_market.get_feed().take_snapshot(get_current_time_ms());
+            next_snapshot_time += std::chrono::milliseconds(FEED_SNAPSHOT_INTERVAL);
+        }
+    }
+}
+
+
 // function to get or generate if needed the encryption keys
 void get_or_generate_crypted_keys(Database_Manager& stock_market_database)
 {
@@ -872,11 +1299,10 @@ void display_all_messages(Market& stock_market)
 {
     // display all the messages contained in the database by chronological order
     std::cout << "\n-------------- Displaying all messages in the database --------------\n";
-    std::string messages_query = "SELECT message_id FROM Messages ORDER BY date_time ASC, daily_time ASC";
-    std::vector<ID> message_ids = stock_market.get_database().execute_SQL_query_IDs(messages_query);
-    for (const auto& message_id : message_ids){
-        Message message(message_id, stock_market.get_database());
-        message.display_message();
+    std::string messages_query = "SELECT message_id, client_id, message_sender, message_type, content, time FROM messages ORDER BY time ASC";
+    SQL_Cursor cursor = stock_market.get_database().open_cursor(messages_query); // the log can be long, it is read row by row
+    while (cursor.next()){
+        std::cout << "Message ID: " << cursor.get_int64(0) << ", Client ID: " << cursor.get_string(1) << ", Sender: " << cursor.get_string(2) << ", Type: " << cursor.get_string(3) << ", Content: " << cursor.get_string(4) << ",Time: " << time_to_string(cursor.get_int64(5)) << "\n";
     }
     std::cout << "-------------- End of messages in the database --------------\n";
 }
@@ -886,76 +1312,138 @@ int main(int argc, char* argv[])
 {
     // reset the launch time when the program starts
     Time server_launch_time = get_current_time_ms();
-    ID server_launch_time_daily = get_daily_time(server_launch_time);
-    ID server_launch_time_date = get_date_time(server_launch_time);
 
     // initialize the database with the market data
     Database_Manager Stock_Market_Database("../Data/Stock_Market_App.db");
     Market Stock_Market(Stock_Market_Database);
+    Stock_Market_Database.create_tables(); // create the missing tables and bring the schema to its last version
+    Stock_Market.get_tick_store().import_from_database(Stock_Market_Database); // fill the tick store with the prices history of the actions that have no tick yet
+    Stock_Market_Database.keep_last_prices(); // the prices table keeps only the last price of each action once the history is in the tick store
+    Stock_Market.load_last_prices(); // the snapshots of the feed start from the last ticks
 
     // update or generate the encryption keys
     get_or_generate_crypted_keys(Stock_Market_Database);
 
     // handle command-line arguments
     if (argc <= 1){
-        std::cerr << "Usage: " << argv[0] << " [init|reset|reset_prices|play]\n";
+        std::cerr << "Usage: " << argv[0] << " [init|reset|reset_prices|check_query_plans|bench_parser|bench_ring|play]\n";
         return EXIT_FAILURE;
     }
     std::string arg = argv[1];
     if (arg == "init"){
         // adding the init actions
-        Stock_Market.add_action(1, "CAC40", 20, 10.0, server_launch_time_daily, server_launch_time_date);
-        Stock_Market.add_action(2, "SP500", 10, 20.0, server_launch_time_daily, server_launch_time_date);
+        Stock_Market.add_action(1, "CAC40", 20, 10.0, server_launch_time);
+        Stock_Market.add_action(2, "SP500", 10, 20.0, server_launch_time);
 
-        // adding the init clients
-        std::string password_1 = "123";
-        std::string encrypted_password_1 = encrypt_AES(password_1, key, iv);
-        Stock_Market.add_client(1, "Client1", encrypted_password_1, 1000.0,{});
-        std::string password_2 = "123";
-        std::string encrypted_password_2 = encrypt_AES(password_2, key, iv);
-        Stock_Market.add_client(2, "Client2", encrypted_password_2, 100.0, {{1, 20}, {2, 10}});
+        // adding the init clients (their passwords are hashed by add_client)
+        Stock_Market.add_client(1, "Client1", "123", 1000.0,{});
+        Stock_Market.add_client(2, "Client2", "123", 100.0, {{1, 20}, {2, 10}});
 
         Stock_Market_Database.close_database(); // close the database
         return EXIT_SUCCESS;
     } 
     if (arg == "reset"){
         Stock_Market_Database.reset_database();
+        Stock_Market.get_tick_store().clear();
+        Stock_Market.get_session_journal().clear();
         // update or generate the encryption keys
         get_or_generate_crypted_keys(Stock_Market_Database);
         Stock_Market_Database.close_database(); // close the database
         return EXIT_SUCCESS;
     }
     if (arg == "reset_prices"){
-        Stock_Market_Database.reset_database_action_prices(server_launch_time_daily, server_launch_time_date);
+        Stock_Market_Database.reset_database_action_prices(server_launch_time);
+        Stock_Market.get_tick_store().clear();
+        Stock_Market.get_tick_store().import_from_database(Stock_Market_Database);
         Stock_Market_Database.close_database(); // close the database
         return EXIT_SUCCESS;
     } 
+    if (arg == "check_query_plans"){
+        int full_scans = Stock_Market_Database.check_hot_query_plans();
+        Stock_Market_Database.close_database(); // close the database
+        if (full_scans > 0){
+            std::cerr << full_scans << " hot queries fall back to a full scan\n";
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    if (arg == "bench_parser"){
+        benchmark_text_parser(argc >= 3 ? std::stoul(argv[2]) : 1000000);
+        Stock_Market_Database.close_database(); // close the database
+        return EXIT_SUCCESS;
+    }
+    if (arg == "bench_ring"){
+#ifdef SHARED_MEMORY_AVAILABLE
+        benchmark_shared_ring(argc >= 3 ? std::stoul(argv[2]) : 1000000);
+#else
+        std::cerr << "The shared memory transport is not available on this system\n";
+#endif
+        Stock_Market_Database.close_database(); // close the database
+        return EXIT_SUCCESS;
+    }
     // handle the play part there
     if (argc < 2 || std::string(argv[1]) != "play"){        
-        std::cerr << "Usage: " << argv[0] << " play\n";
+        std::cerr << "Usage: " << argv[0] << " play [threads|epoll|uring] [reactor_count] [backlog] [heartbeat_interval] [heartbeat_timeout] [messages_per_second] [orders_per_second] [view_cache_ttl]\n";
         return EXIT_FAILURE;
     }
-
-    // create the server socket
-    int server_fd;
-    struct sockaddr_in address;
-    socklen_t addr_len = sizeof(address);
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0){
-        perror("Error socket");
-        exit(EXIT_FAILURE);
+    // the network mode : a thread per client, or a few reactor threads (epoll or io_uring) serving all the clients (epoll by default when available)
+#ifdef EPOLL_AVAILABLE
+    std::string network_mode = argc >= 3 ? argv[2] : "epoll";
+#else
+    std::string network_mode = argc >= 3 ? argv[2] : "threads";
+#endif
+    size_t reactor_count = std::max<size_t>(argc >= 4 ? std::stoul(argv[3]) : std::thread::hardware_concurrency(), 1);
+    int backlog = argc >= 5 ? std::stoi(argv[4]) : SOMAXCONN; // connections waiting to be accepted on each listen socket (capped by net.core.somaxconn)
+    heartbeat_policy.interval = std::max(argc >= 6 ? std::stoi(argv[5]) : HEARTBEAT_INTERVAL, 1); // milliseconds
+    heartbeat_policy.timeout = std::max(argc >= 7 ? std::stoi(argv[6]) : HEARTBEAT_TIMEOUT, heartbeat_policy.interval);
+    // requests and orders per second of a session (0 : no limit), a client id gets the rates of RATE_LIMIT_CLIENT_SESSIONS sessions
+    double messages_per_second = std::max(argc >= 8 ? std::stod(argv[7]) : RATE_LIMIT_MESSAGES, 0.0);
+    double orders_per_second = std::max(argc >= 9 ? std::stod(argv[8]) : RATE_LIMIT_ORDERS, 0.0);
+    if (messages_per_second > 0 || orders_per_second > 0){
+        rate_limiter = std::make_unique<Rate_Limiter>(make_rate_policy(messages_per_second, orders_per_second), classify_request, reject_rate_limited_request);
     }
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(SERVER_PORT);
-    if (bind(server_fd, (struct sockaddr*)&address, addr_len) < 0){
-        perror("Error bind");
-        exit(EXIT_FAILURE);
+    // milliseconds a view computed for a display request is shared with the next identical ones
+    int view_cache_ttl = std::max(argc >= 10 ? std::stoi(argv[9]) : VIEW_CACHE_TTL, 0);
+    view_cache = std::make_unique<View_Cache>(std::chrono::milliseconds(view_cache_ttl));
+    if (network_mode != "threads" && network_mode != "epoll" && network_mode != "uring"){
+        std::cerr << "Unknown network mode '" << network_mode << "' (threads, epoll or uring)\n";
+        return EXIT_FAILURE;
+    }
+#ifndef EPOLL_AVAILABLE
+    if (network_mode == "epoll"){
+        std::cerr << "The epoll network mode is not available on this system\n";
+        return EXIT_FAILURE;
+    }
+#endif
+#ifdef URING_AVAILABLE
+    if (network_mode == "uring" && !Uring_Gateway::is_supported()){
+        std::cerr << "The kernel does not support the io_uring network mode, falling back to epoll\n";
+        network_mode = "epoll";
     }
-    if (listen(server_fd, 5) < 0){
-        perror("Error listen");
+#else
+    if (network_mode == "uring"){
+        std::cerr << "The io_uring network mode is not available on this system\n";
+        return EXIT_FAILURE;
+    }
+#endif
+    raise_file_descriptor_limit(); // one descriptor per connected client
+
+    // create the server sockets : one per reactor, bound to the same port with SO_REUSEPORT (a burst of connections is spread by the kernel), one for the thread-per-client mode
+    std::vector<int> listen_sockets = create_listen_sockets(SERVER_PORT, network_mode == "threads" ? 1 : reactor_count, backlog);
+    if (listen_sockets.empty()){
         exit(EXIT_FAILURE);
     }
-    std::cout << "Waiting for connexion on the port " << SERVER_PORT << "...\n";
+    int server_fd = listen_sockets[0];
+    struct sockaddr_in address;
+    socklen_t addr_len = sizeof(address);
+    std::cout << "Waiting for connexion on the port " << SERVER_PORT << " (" << listen_sockets.size() << " listen sockets, backlog " << backlog << ")...\n";
+    // the clients on the same machine connect to a Unix-domain socket (no TCP stack), and may move to shared memory rings from it
+    int local_fd = create_local_listen_socket(LOCAL_SOCKET_PATH);
+    std::vector<int> shared_listen_sockets;
+    if (local_fd >= 0){
+        shared_listen_sockets.push_back(local_fd);
+        std::cout << "Waiting for local connexion on " << LOCAL_SOCKET_PATH << "...\n";
+    }
 
     std::cout << "Initial market state:\n";
     std::cout << Stock_Market.get_market_info() << std::endl;
@@ -976,18 +1464,55 @@ int main(int argc, char* argv[])
     int pre_close_time_delay = 1000;                // calculate equilibrium price before market close
     int process_time = 500;                        // simulate processing time
 
+    // the display requests read the snapshots of the market and of the clients, published before the first connection
+    Stock_Market.publish_snapshots();
+
     // start the market session in a separate thread
-    std::thread market_thread(market_session, std::ref(Stock_Market), pre_open_time_delay, open_time_delay, continuous_trading_time_delay, pre_close_time_delay, continuous_trading_loop_duration);
+    std::thread market_thread(market_session, std::ref(Stock_Market), pre_open_time_delay, open_time_delay, continuous_trading_time_delay, pre_close_time_delay, continuous_trading_loop_duration, process_time);
+    std::thread feed_thread(publish_market_data, std::ref(Stock_Market));
+    // the passwords of the logins are hashed by their own threads, away from the network threads
+    Stock_Market.get_auth_service().start(AUTH_THREAD_COUNT);
     
     // start accepting clients concurrently
-    std::thread accept_thread(accept_clients, server_fd, std::ref(address), std::ref(addr_len), std::ref(Stock_Market), process_time);
+    std::thread accept_thread;
+    if (network_mode == "threads"){
+        std::cout << "Network mode: one thread per client\n";
+        accept_thread = std::thread(accept_clients, server_fd, local_fd, std::ref(address), std::ref(addr_len), std::ref(Stock_Market));
+    }
+#ifdef EPOLL_AVAILABLE
+    std::unique_ptr<Epoll_Gateway> gateway;
+    if (network_mode == "epoll"){
+        std::cout << "Network mode: epoll, " << reactor_count << " reactor threads\n";
+        response_workers = std::make_unique<Response_Workers>(RESPONSE_THREAD_COUNT); // the histories are read away from the reactors
+        gateway = std::make_unique<Epoll_Gateway>(listen_sockets, shared_listen_sockets, [&Stock_Market](Session& session, std::string_view request){
+            return process_request(session, request, Stock_Market);
+        }, heartbeat_policy, rate_limiter.get(), response_workers.get());
+        accept_thread = std::thread(&Epoll_Gateway::run, gateway.get(), std::cref(shutdown_flag));
+    }
+#endif
+#ifdef URING_AVAILABLE
+    std::unique_ptr<Uring_Gateway> uring_gateway;
+    if (network_mode == "uring"){
+        std::cout << "Network mode: io_uring, " << reactor_count << " ring threads\n";
+        response_workers = std::make_unique<Response_Workers>(RESPONSE_THREAD_COUNT); // the histories are read away from the rings
+        uring_gateway = std::make_unique<Uring_Gateway>(listen_sockets, shared_listen_sockets, [&Stock_Market](Session& session, std::string_view request){
+            return process_request(session, request, Stock_Market);
+        }, heartbeat_policy, rate_limiter.get(), response_workers.get());
+        accept_thread = std::thread(&Uring_Gateway::run, uring_gateway.get(), std::cref(shutdown_flag));
+    }
+#endif
 
     // join the market thread to ensure the market session ends
     market_thread.join();
+    feed_thread.join();
 
     // all client threads must stop after the market session ends, so we close the server socket
     std::cout << "Market session ended. Closing all client connections...\n";
     accept_thread.join(); // closing the server socket
+    Stock_Market.get_auth_service().stop();
+    if (response_workers){
+        response_workers->stop(); // the sessions are closed, their producers stop at their next chunk
+    }
     // adding the message to the log that the server is closing
     Message server_closing(Stock_Market.get_database().get_new_message_id(), Stock_Market.get_database());
     server_closing.log_message(
@@ -998,6 +1523,9 @@ int main(int argc, char* argv[])
         get_current_time_ms()
     );
 
+    // the open bars are written so that they are found again at the next session
+    Stock_Market.get_bar_aggregator().flush();
+
     // getting the clients ids that were connected but not disconnected
     // (they could have connected, decomnected and reconnected, but not disconnected properly, and by the server shutdown)
     log_others_client_disconnects(Stock_Market, server_launch_time);
@@ -1006,7 +1534,13 @@ int main(int argc, char* argv[])
     display_all_messages(Stock_Market);
 
     Stock_Market_Database.close_database(); // close the database
-    close(server_fd);
+    for (const int& listen_socket : listen_sockets){
+        close(listen_socket);
+    }
+    if (local_fd >= 0){
+        close(local_fd);
+        unlink(LOCAL_SOCKET_PATH);
+    }
     return EXIT_SUCCESS;
 }
 // command to use the main
@@ -1014,6 +1548,9 @@ int main(int argc, char* argv[])
 ./server.x reset : to reset the database entirely
 ./server.x reset_prices : to reset the prices of the actions in the database to only the last price and the given time (suppressed the history of prices)
 ./server.x init : to initialize the database with the little by hand market
-./server.x play : to play a session with the market
+./server.x check_query_plans : to check that the hot queries are served by an index (fails if one of them falls back to a full scan)
+./server.x bench_parser [count] : to measure the cost of reading a text request (1000000 requests by default)
+./server.x bench_ring [count] : to measure the time of a hop through a shared memory ring (1000000 round trips by default)
+./server.x play [threads|epoll|uring] [reactor_count] [backlog] [heartbeat_interval] [heartbeat_timeout] [messages_per_second] [orders_per_second] [view_cache_ttl] : to play a session with the market (epoll by default : a few reactor threads serve all the clients, uring : the same with io_uring rings ; heartbeats in milliseconds, 1000 and 3000 by default ; rate limits of a session, 5000 requests and 1000 orders per second by default, 0 for no limit ; views shared for 200 milliseconds by default)
 */
 
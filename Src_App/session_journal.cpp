@@ -0,0 +1,278 @@
+#include "session_journal.hpp"
+
+
+// write a whole buffer to a file descriptor, false on error
+static bool write_all(const int& file, const char* data, const size_t& length)
+{
+    size_t total = 0;
+    while (total < length){
+        ssize_t written = write(file, data + total, length - total);
+        if (written < 0 && errno == EINTR){
+            continue;
+        }
+        if (written <= 0){
+            return false;
+        }
+        total += written;
+    }
+    return true;
+}
+
+// read a whole buffer from a file descriptor at an offset, false if the file ends before
+static bool read_all(const int& file, char* data, const size_t& length, uint64_t offset)
+{
+    size_t total = 0;
+    while (total < length){
+        ssize_t bytes_read = pread(file, data + total, length - total, offset + total);
+        if (bytes_read < 0 && errno == EINTR){
+            continue;
+        }
+        if (bytes_read <= 0){
+            return false;
+        }
+        total += bytes_read;
+    }
+    return true;
+}
+
+
+// constructor : open (and create if needed) the journal file, the sequence goes on after its last message
+Client_Stream::Client_Stream(const std::string& path) : Path(path), Journal_File(-1), Journal_Size(0), Last_Sequence(0), Recent_Bytes(0), Owner(nullptr)
+{
+    Journal_File = open(Path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (Journal_File < 0){
+        throw std::runtime_error("Failed to open " + Path);
+    }
+    // the headers are read to find the last sequence and the checkpoints, the messages stay on disk
+    Journal_Record record;
+    while (read_all(Journal_File, reinterpret_cast<char*>(&record), sizeof(record), Journal_Size)){
+        uint64_t end = Journal_Size + sizeof(record) + record.length;
+        if (end > static_cast<uint64_t>(lseek(Journal_File, 0, SEEK_END))){
+            break; // the last record was not fully written
+        }
+        if (!(record.flags & JOURNAL_RECORD_CONTINUED) && (Checkpoints.empty() || record.sequence - Checkpoints.rbegin()->first >= SESSION_JOURNAL_INDEX_STEP)){
+            Checkpoints[record.sequence] = Journal_Size;
+        }
+        Last_Sequence = std::max(Last_Sequence, record.sequence);
+        Journal_Size = end;
+    }
+    if (ftruncate(Journal_File, Journal_Size) != 0){ // a partial record at the end is dropped
+        std::cerr << "Failed to truncate " << Path << std::endl;
+    }
+}
+
+// destructor
+Client_Stream::~Client_Stream()
+{
+    flush();
+    close(Journal_File);
+}
+
+// write the pending records in the journal file (compacted once it exceeds SESSION_JOURNAL_MAX_BYTES), the mutex must be locked
+void Client_Stream::write_pending()
+{
+    if (Pending.empty()){
+        return;
+    }
+    if (!write_all(Journal_File, Pending.data(), Pending.size())){
+        std::cerr << "Failed to write in " << Path << std::endl; // the last messages are still in memory
+    }
+    Pending.clear();
+    if (Journal_Size > SESSION_JOURNAL_MAX_BYTES){
+        compact();
+    }
+}
+
+// drop the oldest messages of the journal file, the mutex must be locked and nothing pending
+// (the file is copied from the first checkpoint in its last SESSION_JOURNAL_MAX_BYTES / 2 bytes, then renamed over the journal)
+void Client_Stream::compact()
+{
+    auto kept = std::find_if(Checkpoints.begin(), Checkpoints.end(), [this](const auto& checkpoint){
+        return Journal_Size - checkpoint.second <= SESSION_JOURNAL_MAX_BYTES / 2;
+    });
+    if (kept == Checkpoints.end()){
+        kept = std::prev(kept); // long messages since the last checkpoint : they are all kept
+    }
+    uint64_t start = kept->second;
+    if (start == 0){
+        return;
+    }
+    std::string compacted_path = Path + ".compact";
+    int compacted = open(compacted_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (compacted < 0){
+        std::cerr << "Failed to open " << compacted_path << std::endl;
+        return;
+    }
+    std::string buffer(65536, '\0');
+    for (uint64_t offset = start; offset < Journal_Size; offset += buffer.size()){
+        size_t length = std::min<uint64_t>(buffer.size(), Journal_Size - offset);
+        if (!read_all(Journal_File, buffer.data(), length, offset) || !write_all(compacted, buffer.data(), length)){
+            std::cerr << "Failed to compact " << Path << std::endl; // the journal stays as it is
+            close(compacted);
+            unlink(compacted_path.c_str());
+            return;
+        }
+    }
+    if (rename(compacted_path.c_str(), Path.c_str()) != 0){
+        std::cerr << "Failed to compact " << Path << std::endl;
+        close(compacted);
+        unlink(compacted_path.c_str());
+        return;
+    }
+    close(Journal_File);
+    Journal_File = compacted;
+    std::map<uint64_t, uint64_t> checkpoints;
+    for (auto checkpoint = kept; checkpoint != Checkpoints.end(); ++checkpoint){
+        checkpoints[checkpoint->first] = checkpoint->second - start;
+    }
+    Checkpoints.swap(checkpoints);
+    Journal_Size -= start;
+}
+
+// the session sequences its messages in the stream from now on (a previous owner stops), returns the last sequence
+uint64_t Client_Stream::take_ownership(const void* session)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Owner = session;
+    return Last_Sequence;
+}
+
+// the session stops sequencing its messages (if it still owns the stream)
+void Client_Stream::release(const void* session)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (Owner == session){
+        Owner = nullptr;
+    }
+    write_pending();
+}
+
+// the sequence of the next message of the session, 0 if it does not own the stream anymore
+uint64_t Client_Stream::reserve(const void* session)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (Owner != session){
+        return 0;
+    }
+    return ++Last_Sequence;
+}
+
+// keep a chunk of a message sent with a reserved sequence (in memory and in the journal)
+// (a message whose sequence was reserved before the client resumed elsewhere is still kept, the sequences stay ordered in memory)
+void Client_Stream::append(const uint64_t& sequence, std::string_view chunk, const bool& first, const bool& last)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Journal_Record record = {sequence, static_cast<uint32_t>(chunk.size()), (first ? 0u : JOURNAL_RECORD_CONTINUED) | (last ? 0u : JOURNAL_RECORD_MORE)};
+    if (first && (Checkpoints.empty() || sequence - Checkpoints.rbegin()->first >= SESSION_JOURNAL_INDEX_STEP)){
+        Checkpoints[sequence] = Journal_Size;
+    }
+    Pending.append(reinterpret_cast<const char*>(&record), sizeof(record));
+    Pending.append(chunk);
+    Journal_Size += sizeof(record) + chunk.size();
+
+    auto position = std::upper_bound(Recent.begin(), Recent.end(), sequence, [](const uint64_t& value, const Retained_Message& item){
+        return value < item.sequence;
+    });
+    if (first){
+        Recent.insert(position, Retained_Message{sequence, std::string(chunk), last});
+    }
+    else if (position != Recent.begin() && std::prev(position)->sequence == sequence){
+        std::prev(position)->message.append(chunk);
+        std::prev(position)->complete = last;
+    }
+    else {
+        return; // its start already left the memory
+    }
+    Recent_Bytes += chunk.size();
+    while (Recent.size() > SESSION_RETRANSMIT_MESSAGES || Recent_Bytes > SESSION_RETRANSMIT_BYTES){
+        Recent_Bytes -= Recent.front().message.size();
+        Recent.pop_front();
+    }
+}
+
+// write the pending records in the journal file
+void Client_Stream::flush()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    write_pending();
+}
+
+// call the callback on the messages following a sequence, false if some of them are lost (a gap the client must fill another way)
+// (from memory if the last messages cover the gap, otherwise from the journal, read from the closest checkpoint)
+bool Client_Stream::replay(const uint64_t& after, const std::function<void(const uint64_t&, std::string_view)>& callback)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (after > Last_Sequence){
+        return false; // sequences the stream never gave (the journals have been cleared)
+    }
+    if (after == Last_Sequence){
+        return true;
+    }
+    if (!Recent.empty() && Recent.front().sequence <= after + 1){
+        for (const auto& retained : Recent){
+            if (retained.sequence > after && retained.complete){
+                callback(retained.sequence, retained.message);
+            }
+        }
+        return true;
+    }
+    write_pending(); // before the checkpoints are read, the journal may be compacted
+    auto checkpoint = Checkpoints.upper_bound(after + 1);
+    if (checkpoint == Checkpoints.begin()){
+        return false; // the journal starts after the gap
+    }
+    --checkpoint;
+    uint64_t offset = checkpoint->second;
+    Journal_Record record;
+    std::map<uint64_t, std::string> messages; // messages whose last chunk is not read yet
+    std::string chunk;
+    while (offset < Journal_Size && read_all(Journal_File, reinterpret_cast<char*>(&record), sizeof(record), offset)){
+        offset += sizeof(record);
+        if (record.sequence > after){
+            chunk.resize(record.length);
+            if (!read_all(Journal_File, chunk.data(), record.length, offset)){
+                std::cerr << "Failed to read " << Path << std::endl;
+                return false;
+            }
+            auto message = messages.find(record.sequence);
+            if (!(record.flags & JOURNAL_RECORD_CONTINUED)){
+                message = messages.insert_or_assign(record.sequence, chunk).first;
+            }
+            else if (message != messages.end()){
+                message->second.append(chunk);
+            }
+            if (message != messages.end() && !(record.flags & JOURNAL_RECORD_MORE)){
+                callback(record.sequence, message->second);
+                messages.erase(message);
+            }
+        }
+        offset += record.length;
+    }
+    return true;
+}
+
+// constructor
+Session_Journal::Session_Journal(const std::string& directory) : Directory(directory)
+{
+    std::filesystem::create_directories(Directory);
+}
+
+// get (and open if needed) the stream of a client
+Client_Stream& Session_Journal::get_stream(const ID& client_id)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto& stream = Streams[client_id];
+    if (!stream){
+        stream = std::make_unique<Client_Stream>(Directory + "/" + std::to_string(client_id) + ".journal");
+    }
+    return *stream;
+}
+
+// delete the journals of all the clients
+void Session_Journal::clear()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Streams.clear(); // close the files before removing them
+    std::filesystem::remove_all(Directory);
+    std::filesystem::create_directories(Directory);
+}
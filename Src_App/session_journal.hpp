@@ -0,0 +1,90 @@
+//==========================================================================
+// File that defines the journal of the sessions : the messages sent to each client are sequenced and kept,
+// so that a client reconnecting after a drop receives only the messages it missed
+//==========================================================================
+#ifndef SESSION_JOURNAL_HPP
+#define SESSION_JOURNAL_HPP
+#include "database_management.hpp"
+
+
+#include <deque>
+
+
+#define SESSION_JOURNAL_DIRECTORY "../Data/Sessions" // one journal file per client in this directory
+#define SESSION_RETRANSMIT_MESSAGES 1024 // last messages of a client kept in memory for a gap fill (the older ones are read from its journal)
+#define SESSION_RETRANSMIT_BYTES (1024 * 1024) // bytes of these messages
+#define SESSION_JOURNAL_INDEX_STEP 256 // the journal offset of one message out of this many is kept in memory (a gap fill reads from the closest one)
+#define SESSION_JOURNAL_MAX_BYTES (16 * 1024 * 1024) // bytes of a journal file : past them the oldest messages are dropped (about half of the file is kept), a client resuming from before them gets a gap
+#define JOURNAL_RECORD_CONTINUED 1 // the record continues the message of its sequence
+#define JOURNAL_RECORD_MORE 2 // the message goes on in a next record of its sequence
+
+
+// header of a chunk of a message in a journal file, followed by the chunk (a message is journaled as it is framed, in one record per chunk)
+struct Journal_Record
+{
+    uint64_t sequence;
+    uint32_t length;
+    uint32_t flags; // JOURNAL_RECORD_CONTINUED, JOURNAL_RECORD_MORE (0 : a whole message)
+};
+
+// a message kept in memory for a gap fill
+struct Retained_Message
+{
+    uint64_t sequence;
+    std::string message;
+    bool complete; // its last chunk is appended (a message still being sent is not replayed)
+};
+
+// the sequenced messages sent to one client, whichever session sent them : the last ones in memory, the last SESSION_JOURNAL_MAX_BYTES in the journal file
+// (one session owns the stream at a time, the last one that resumed it, so that the sequences are written in order)
+class Client_Stream
+{
+private:
+    std::string Path;
+    int Journal_File; // opened in append mode
+    std::string Pending; // records not written in the journal file yet (written once per batch of requests)
+    uint64_t Journal_Size; // bytes of the journal file, with the pending records
+    uint64_t Last_Sequence;
+    std::deque<Retained_Message> Recent; // the last messages, by sequence
+    size_t Recent_Bytes;
+    std::map<uint64_t, uint64_t> Checkpoints; // journal offset of one message out of SESSION_JOURNAL_INDEX_STEP, by sequence
+    const void* Owner; // session sequencing its messages in the stream (nullptr if none)
+    std::mutex Mutex;
+
+    void write_pending(); // write the pending records in the journal file (compacted once it exceeds SESSION_JOURNAL_MAX_BYTES), the mutex must be locked
+    void compact(); // drop the oldest messages of the journal file, the mutex must be locked and nothing pending
+
+public:
+    // constructor
+    Client_Stream(const std::string& path); // open (and create if needed) the journal file, the sequence goes on after its last message
+    // destructor
+    ~Client_Stream();
+    Client_Stream(const Client_Stream&) = delete;
+    Client_Stream& operator=(const Client_Stream&) = delete;
+
+    uint64_t take_ownership(const void* session); // the session sequences its messages in the stream from now on (a previous owner stops), returns the last sequence
+    void release(const void* session); // the session stops sequencing its messages (if it still owns the stream)
+    uint64_t reserve(const void* session); // the sequence of the next message of the session, 0 if it does not own the stream anymore
+    void append(const uint64_t& sequence, std::string_view chunk, const bool& first, const bool& last); // keep a chunk of a message sent with a reserved sequence (in memory and in the journal)
+    void flush(); // write the pending records in the journal file
+    bool replay(const uint64_t& after, const std::function<void(const uint64_t&, std::string_view)>& callback); // call the callback on the messages following a sequence, false if some of them are lost (a gap the client must fill another way)
+};
+
+// the streams of all the clients, opened on first use
+class Session_Journal
+{
+private:
+    std::string Directory;
+    std::unordered_map<ID, std::unique_ptr<Client_Stream>> Streams;
+    std::mutex Mutex;
+
+public:
+    // constructor
+    Session_Journal(const std::string& directory);
+
+    Client_Stream& get_stream(const ID& client_id); // get (and open if needed) the stream of a client
+    void clear(); // delete the journals of all the clients
+};
+
+
+#endif // SESSION_JOURNAL_HPP
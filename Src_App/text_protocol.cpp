@@ -0,0 +1,193 @@
+#include "text_protocol.hpp"
+
+
+// the token, empty past the last one
+std::string_view Text_Tokens::operator[](const size_t& index) const
+{
+    return index < count ? items[index] : std::string_view();
+}
+
+// split a request on the blanks
+Text_Tokens tokenize(std::string_view input)
+{
+    Text_Tokens tokens{};
+    size_t position = 0;
+    while (tokens.count < TEXT_MAX_TOKENS){
+        position = input.find_first_not_of(" \t\r\n", position);
+        if (position == std::string_view::npos){
+            break;
+        }
+        size_t end = input.find_first_of(" \t\r\n", position);
+        if (end == std::string_view::npos){
+            end = input.size();
+        }
+        tokens.items[tokens.count++] = input.substr(position, end - position);
+        position = end;
+    }
+    return tokens;
+}
+
+// remove the correlation id at the start of a request, false if the request has none
+bool take_correlation_id(std::string_view& request, uint64_t& correlation_id)
+{
+    if (request.empty() || request.front() != CORRELATION_PREFIX){
+        return false;
+    }
+    size_t end = request.find(' ');
+    if (end == std::string_view::npos || !parse_number(request.substr(1, end - 1), correlation_id)){
+        return false;
+    }
+    request.remove_prefix(end + 1);
+    return true;
+}
+
+// remove "version last_version" at the end of a request, false if the request has none
+bool take_view_version(Text_Tokens& tokens, uint64_t& version)
+{
+    if (tokens.count < 2 || tokens[tokens.count - 2] != VIEW_VERSION_KEYWORD || !parse_number(tokens[tokens.count - 1], version)){
+        return false;
+    }
+    tokens.count -= 2;
+    return true;
+}
+
+
+// find the command of a request in the keyword table
+Text_Command get_text_command(std::string_view input, const Text_Tokens& tokens)
+{
+    if (input.substr(0, std::string_view(AUTHENTIFICATION_PREFIX).size()) == AUTHENTIFICATION_PREFIX){
+        return Text_Command::AUTHENTIFICATION;
+    }
+    if (input.substr(0, std::string_view(TOKEN_AUTHENTIFICATION_PREFIX).size()) == TOKEN_AUTHENTIFICATION_PREFIX){
+        return Text_Command::AUTHENTIFICATION_TOKEN;
+    }
+    for (const Text_Keyword& keyword : text_keywords){
+        std::string_view token = keyword.at_end ? (tokens.count > 1 ? tokens[tokens.count - 1] : std::string_view()) : tokens[1];
+        if (token == keyword.keyword){
+            return keyword.command;
+        }
+    }
+    return Text_Command::ORDER;
+}
+
+
+// the prices read after the trigger type, in this order, and the errors when they are missing or negative
+struct Price_Field
+{
+    bool Trigger_Rule::* needed;
+    double Text_Order::* value;
+    double default_value; // when the trigger type does not need it
+    Text_Order_Error missing;
+    Text_Order_Error negative;
+};
+static constexpr std::array<Price_Field, 3> price_fields = {{
+    {&Trigger_Rule::needs_price, &Text_Order::price, max_number, Text_Order_Error::PRICE_MISSING, Text_Order_Error::PRICE_NEGATIVE}, // a market order is prioritized, the client is charged the selling price
+    {&Trigger_Rule::needs_trigger_price_lower, &Text_Order::trigger_price_lower, 0.0, Text_Order_Error::TRIGGER_PRICE_LOWER_MISSING, Text_Order_Error::TRIGGER_PRICE_LOWER_NEGATIVE},
+    {&Trigger_Rule::needs_trigger_price_upper, &Text_Order::trigger_price_upper, max_number, Text_Order_Error::TRIGGER_PRICE_UPPER_MISSING, Text_Order_Error::TRIGGER_PRICE_UPPER_NEGATIVE}
+}};
+
+// read and validate an order (the prices not needed by the trigger type are set as for any order of this type)
+Text_Order_Error parse_text_order(const Text_Tokens& tokens, Text_Order& order)
+{
+    order = Text_Order{0, Order_Type::BUY, 0, -1, nullptr, 0.0, 0.0, 0.0, no_expiration_time};
+    parse_number(tokens[0], order.client_id);
+
+    // verifying that this is a BUY or SELL order
+    if (tokens[1] == "BUY"){
+        order.type = Order_Type::BUY;
+    }
+    else if (tokens[1] == "SELL"){
+        order.type = Order_Type::SELL;
+    }
+    else {
+        return Text_Order_Error::ORDER_TYPE;
+    }
+    if (!parse_number(tokens[2], order.quantity) || order.quantity <= 0){
+        return Text_Order_Error::QUANTITY;
+    }
+    if (!parse_number(tokens[3], order.action_id)){
+        return Text_Order_Error::ACTION;
+    }
+    for (const Trigger_Rule& rule : trigger_rules){
+        if (tokens[4] == rule.name){
+            order.rule = &rule;
+        }
+    }
+    if (order.rule == nullptr){
+        return Text_Order_Error::TRIGGER_TYPE;
+    }
+
+    // the prices needed by the trigger type must be given and positive
+    size_t next_token = 5;
+    for (const Price_Field& field : price_fields){
+        double& value = order.*field.value;
+        if (!(order.rule->*field.needed)){
+            value = field.default_value;
+            continue;
+        }
+        if (!parse_number(tokens[next_token++], value) || value == 0.0){
+            return field.missing;
+        }
+        if (value < 0.0){
+            return field.negative;
+        }
+    }
+
+    // a possible validity date
+    if (!tokens[next_token].empty()){
+        try {
+            order.validity_time = get_time_from_strings(tokens[next_token], tokens[next_token + 1]);
+        }
+        catch (const std::invalid_argument&){
+            return Text_Order_Error::VALIDITY_DATE;
+        }
+    }
+    return Text_Order_Error::NONE;
+}
+
+// the message of an error (built only when the order is refused), without the "Error: " prefix
+std::string text_order_error_to_string(const Text_Order_Error& error, const Text_Order& order)
+{
+    std::string_view label = order.rule != nullptr ? order.rule->label : "";
+    switch (error){
+        case Text_Order_Error::NONE: return "";
+        case Text_Order_Error::ORDER_TYPE: return "Order type not recognized (use BUY or SELL)";
+        case Text_Order_Error::QUANTITY: return "Quantity must be a positive integer";
+        case Text_Order_Error::ACTION: return "Action id not recognized";
+        case Text_Order_Error::TRIGGER_TYPE: return "Trigger type not recognized (use MARKET, LIMIT, STOP or LIMIT_STOP)";
+        case Text_Order_Error::PRICE_MISSING: return fmt::format("Price must be provided for a {} order", label);
+        case Text_Order_Error::PRICE_NEGATIVE: return fmt::format("Price must be positive for a {} order", label);
+        case Text_Order_Error::TRIGGER_PRICE_LOWER_MISSING: return fmt::format("Trigger price lower must be provided for a {} order", label);
+        case Text_Order_Error::TRIGGER_PRICE_LOWER_NEGATIVE: return fmt::format("Trigger price lower must be positive for a {} order", label);
+        case Text_Order_Error::TRIGGER_PRICE_UPPER_MISSING: return fmt::format("Trigger price upper must be provided for a {} order", label);
+        case Text_Order_Error::TRIGGER_PRICE_UPPER_NEGATIVE: return fmt::format("Trigger price upper must be positive for a {} order", label);
+        case Text_Order_Error::VALIDITY_DATE: return "Validity date not recognized (use YYYY-MM-DD HH:MM:SS)";
+    }
+    return "Order not recognized";
+}
+
+
+// measure the cost of reading a text request (tokenization, keyword table, order validation), in nanoseconds per request
+void benchmark_text_parser(const size_t& count)
+{
+    static constexpr std::array<std::string_view, 6> requests = {
+        "1 BUY 10 1 MARKET",
+        "2 SELL 5 2 LIMIT 21.5 20.0 2030-01-01 12:00:00",
+        "1 BUY 3 1 LIMIT_STOP 11.0 9.5 12.5",
+        "1 amount 100 deposit",
+        "2 display pending_orders",
+        "1 BUY 10 1 LIMIT -4 2"
+    };
+    size_t accepted = 0; // so that the parsing is not optimized away
+    auto start = std::chrono::steady_clock::now();
+    for (size_t index = 0; index < count; ++index){
+        std::string_view request = requests[index % requests.size()];
+        Text_Tokens tokens = tokenize(request);
+        if (get_text_command(request, tokens) == Text_Command::ORDER){
+            Text_Order order;
+            accepted += parse_text_order(tokens, order) == Text_Order_Error::NONE;
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << fmt::format("{} requests parsed in {} ms : {:.1f} ns per request ({} valid orders)\n", count, elapsed / 1000000, static_cast<double>(elapsed) / std::max<size_t>(count, 1), accepted);
+}
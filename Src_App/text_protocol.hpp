@@ -0,0 +1,148 @@
+//==========================================================================
+// File that defines the text requests : tokenization, keyword table and order validation, without heap allocation
+//==========================================================================
+#ifndef TEXT_PROTOCOL_HPP
+#define TEXT_PROTOCOL_HPP
+#include "database_management.hpp"
+
+
+#include <array>
+#include "order.hpp"
+
+
+#define TEXT_MAX_TOKENS 16 // tokens kept from a text request (the longest one, a LIMIT_STOP order with a validity date, has 11)
+#define AUTHENTIFICATION_PREFIX "Authentification Request: "
+#define TOKEN_AUTHENTIFICATION_PREFIX "Authentification Token: " // a reconnection with the session token of the last login
+#define CORRELATION_PREFIX '#' // "#correlation_id request" : the responses of the request start with "#correlation_id "
+#define VIEW_VERSION_KEYWORD "version" // "client_id display view [arguments] version last_version" : the last version of the view the client has (0 for none)
+#define VIEW_VERSION_PREFIX "Version " // "Version version view" : a view displayed with its version
+#define NOT_MODIFIED_PREFIX "NOT_MODIFIED " // "NOT_MODIFIED version" : the view has not changed since the version the client has
+
+
+// tokens of a text request, views in the request (nothing is copied)
+struct Text_Tokens
+{
+    std::array<std::string_view, TEXT_MAX_TOKENS> items;
+    size_t count;
+
+    std::string_view operator[](const size_t& index) const; // the token, empty past the last one
+};
+// split a request on the blanks
+Text_Tokens tokenize(std::string_view input);
+// remove the correlation id at the start of a request, false if the request has none
+bool take_correlation_id(std::string_view& request, uint64_t& correlation_id);
+// remove "version last_version" at the end of a request, false if the request has none
+bool take_view_version(Text_Tokens& tokens, uint64_t& version);
+
+// parse a whole token as a number (std::from_chars, no locale and no allocation)
+template <typename Number>
+bool parse_number(std::string_view token, Number& value)
+{
+    if (!token.empty() && token.front() == '+'){
+        token.remove_prefix(1); // from_chars does not accept the sign +
+    }
+    auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+    return error == std::errc() && end == token.data() + token.size() && !token.empty();
+}
+
+
+// commands of the text requests
+enum class Text_Command
+{
+    AUTHENTIFICATION, // Authentification Request: username password
+    AUTHENTIFICATION_TOKEN, // Authentification Token: token
+    CLIENT_CONNECTED, // client_id CLIENT_CONNECTED
+    EXIT, // client_id exit
+    DISPLAY, // client_id display type [arguments] [version last_version]
+    DEPOSIT, // client_id [amount] value deposit
+    WITHDRAW, // client_id [amount] value withdraw
+    SUBSCRIBE, // client_id subscribe (market data feed)
+    UNSUBSCRIBE, // client_id unsubscribe
+    SHM_ATTACH, // client_id shm_attach (local socket : the requests and responses move to shared memory rings)
+    RESUME, // client_id resume [last_sequence] (the messages after the last sequence are sent again, the next ones are sequenced)
+    COMPRESS, // client_id compress zlib|off (the large responses are compressed)
+    ORDER // client_id BUY/SELL quantity action_id trigger_type [prices] [validity_date validity_time] (any other request is read as an order)
+};
+
+// keyword of a command, and its place : after the client id, or at the end of the request
+struct Text_Keyword
+{
+    std::string_view keyword;
+    Text_Command command;
+    bool at_end;
+};
+inline constexpr std::array<Text_Keyword, 12> text_keywords = {{
+    {"CLIENT_CONNECTED", Text_Command::CLIENT_CONNECTED, false},
+    {"exit", Text_Command::EXIT, false},
+    {"display", Text_Command::DISPLAY, false},
+    {"subscribe", Text_Command::SUBSCRIBE, false},
+    {"unsubscribe", Text_Command::UNSUBSCRIBE, false},
+    {"shm_attach", Text_Command::SHM_ATTACH, false},
+    {"resume", Text_Command::RESUME, false},
+    {"compress", Text_Command::COMPRESS, false},
+    {"BUY", Text_Command::ORDER, false},
+    {"SELL", Text_Command::ORDER, false},
+    {"deposit", Text_Command::DEPOSIT, true},
+    {"withdraw", Text_Command::WITHDRAW, true}
+}};
+// find the command of a request in the keyword table
+Text_Command get_text_command(std::string_view input, const Text_Tokens& tokens);
+
+
+// prices a trigger type needs, in the order they are given after it
+struct Trigger_Rule
+{
+    std::string_view name;
+    Order_Trigger trigger;
+    bool needs_price;
+    bool needs_trigger_price_lower;
+    bool needs_trigger_price_upper;
+    std::string_view label; // in the error messages
+};
+inline constexpr std::array<Trigger_Rule, 4> trigger_rules = {{
+    {"MARKET", Order_Trigger::MARKET, false, false, false, "market"},
+    {"LIMIT", Order_Trigger::LIMIT, true, true, false, "limit"},
+    {"STOP", Order_Trigger::STOP, true, false, true, "stop"},
+    {"LIMIT_STOP", Order_Trigger::LIMIT_STOP, true, true, true, "limit stop"}
+}};
+
+// an order read from a text request
+struct Text_Order
+{
+    ID client_id;
+    Order_Type type;
+    int quantity;
+    ID action_id;
+    const Trigger_Rule* rule;
+    double price;
+    double trigger_price_lower;
+    double trigger_price_upper;
+    ID validity_time;
+};
+
+// what is wrong with a text order
+enum class Text_Order_Error
+{
+    NONE,
+    ORDER_TYPE,
+    QUANTITY,
+    ACTION,
+    TRIGGER_TYPE,
+    PRICE_MISSING,
+    PRICE_NEGATIVE,
+    TRIGGER_PRICE_LOWER_MISSING,
+    TRIGGER_PRICE_LOWER_NEGATIVE,
+    TRIGGER_PRICE_UPPER_MISSING,
+    TRIGGER_PRICE_UPPER_NEGATIVE,
+    VALIDITY_DATE
+};
+// read and validate an order (the prices not needed by the trigger type are set as for any order of this type)
+Text_Order_Error parse_text_order(const Text_Tokens& tokens, Text_Order& order);
+// the message of an error (built only when the order is refused), without the "Error: " prefix
+std::string text_order_error_to_string(const Text_Order_Error& error, const Text_Order& order);
+
+// measure the cost of reading a text request (tokenization, keyword table, order validation), in nanoseconds per request
+void benchmark_text_parser(const size_t& count);
+
+
+#endif // TEXT_PROTOCOL_HPP
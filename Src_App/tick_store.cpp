@@ -0,0 +1,526 @@
+#include "tick_store.hpp"
+
+
+// helpers for the encoding of the columns
+// zigzag : small negative and positive numbers both give small unsigned numbers
+static uint64_t zigzag_encode(const int64_t& value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t zigzag_decode(const uint64_t& value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// varint : 7 bits per byte, the high bit tells if another byte follows
+static void write_varint(uint64_t value, std::string& output)
+{
+    while (value >= 0x80){
+        output.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    output.push_back(static_cast<char>(value));
+}
+
+static uint64_t read_varint(const unsigned char*& data, const unsigned char* end)
+{
+    uint64_t value = 0;
+    int shift = 0;
+    while (data < end){
+        unsigned char byte = *data++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)){
+            break;
+        }
+        shift += 7;
+    }
+    return value;
+}
+
+// write a whole buffer to a file descriptor
+static void write_all(const int& file, const void* data, const size_t& length)
+{
+    const char* bytes = static_cast<const char*>(data);
+    size_t total = 0;
+    while (total < length){
+        ssize_t written = write(file, bytes + total, length - total);
+        if (written <= 0){
+            throw std::runtime_error("Failed to write in the tick store");
+        }
+        total += written;
+    }
+}
+
+// append a buffer to a file and return the offset where it has been written
+static uint64_t append_to_file(const std::string& path, const void* data, const size_t& length)
+{
+    int file = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (file < 0){
+        throw std::runtime_error("Failed to open " + path);
+    }
+    uint64_t offset = lseek(file, 0, SEEK_END);
+    write_all(file, data, length);
+    close(file);
+    return offset;
+}
+
+
+// encoding of the columns of a block
+// times : delta-of-delta, zigzag varints (the first time is in the block index)
+void encode_times(const std::vector<Tick>& ticks, std::string& output)
+{
+    int64_t previous_delta = 0;
+    for (size_t i = 1; i < ticks.size(); i++){
+        int64_t delta = static_cast<int64_t>(ticks[i].time - ticks[i - 1].time);
+        write_varint(zigzag_encode(delta - previous_delta), output);
+        previous_delta = delta;
+    }
+}
+
+void decode_times(const unsigned char* data, const size_t& length, const Time& first_time, const uint32_t& count, std::vector<Tick>& ticks)
+{
+    const unsigned char* end = data + length;
+    Time time = first_time;
+    int64_t delta = 0;
+    ticks[0].time = time;
+    for (uint32_t i = 1; i < count; i++){
+        delta += zigzag_decode(read_varint(data, end));
+        time += delta;
+        ticks[i].time = time;
+    }
+}
+
+// prices : XOR with the previous price, keeping only the meaningful bytes (a control byte gives the leading and trailing zero bytes)
+void encode_prices(const std::vector<Tick>& ticks, std::string& output)
+{
+    uint64_t previous_bits = 0;
+    for (const auto& tick : ticks){
+        uint64_t bits;
+        std::memcpy(&bits, &tick.price, sizeof(bits));
+        uint64_t xor_bits = bits ^ previous_bits;
+        previous_bits = bits;
+        if (xor_bits == 0){
+            output.push_back(static_cast<char>(0xFF)); // same price as the previous one
+            continue;
+        }
+        int leading_bytes = __builtin_clzll(xor_bits) / 8;
+        int trailing_bytes = __builtin_ctzll(xor_bits) / 8;
+        int meaningful_bytes = 8 - leading_bytes - trailing_bytes;
+        output.push_back(static_cast<char>((leading_bytes << 4) | trailing_bytes));
+        uint64_t meaningful_bits = xor_bits >> (8 * trailing_bytes);
+        for (int i = 0; i < meaningful_bytes; i++){
+            output.push_back(static_cast<char>(meaningful_bits >> (8 * i)));
+        }
+    }
+}
+
+void decode_prices(const unsigned char* data, const size_t& length, const uint32_t& count, std::vector<Tick>& ticks)
+{
+    const unsigned char* end = data + length;
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < count && data < end; i++){
+        unsigned char control = *data++;
+        if (control != 0xFF){
+            int leading_bytes = control >> 4;
+            int trailing_bytes = control & 0x0F;
+            int meaningful_bytes = 8 - leading_bytes - trailing_bytes;
+            uint64_t meaningful_bits = 0;
+            for (int j = 0; j < meaningful_bytes; j++){
+                meaningful_bits |= static_cast<uint64_t>(data[j]) << (8 * j);
+            }
+            data += meaningful_bytes;
+            bits ^= meaningful_bits << (8 * trailing_bytes);
+        }
+        std::memcpy(&ticks[i].price, &bits, sizeof(bits));
+    }
+}
+
+// quantities : zigzag varints
+void encode_quantities(const std::vector<Tick>& ticks, std::string& output)
+{
+    for (const auto& tick : ticks){
+        write_varint(zigzag_encode(tick.quantity), output);
+    }
+}
+
+void decode_quantities(const unsigned char* data, const size_t& length, const uint32_t& count, std::vector<Tick>& ticks)
+{
+    const unsigned char* end = data + length;
+    for (uint32_t i = 0; i < count; i++){
+        ticks[i].quantity = zigzag_decode(read_varint(data, end));
+    }
+}
+
+
+// read-only memory mapping of an append-only file, remapped when the file grows
+// constructor
+Mapped_File::Mapped_File(const std::string& path) : Path(path), Data(nullptr), Size(0)
+{
+    // create the file if it does not exist yet
+    int file = open(Path.c_str(), O_RDONLY | O_CREAT, 0644);
+    if (file < 0){
+        throw std::runtime_error("Failed to open " + Path);
+    }
+    close(file);
+    remap();
+}
+
+// destructor
+Mapped_File::~Mapped_File()
+{
+    unmap();
+}
+
+// getters
+const unsigned char* Mapped_File::get_data() const
+{
+    return Data;
+}
+
+size_t Mapped_File::get_size() const
+{
+    return Size;
+}
+
+// map again the file after it has grown
+void Mapped_File::remap()
+{
+    unmap();
+    int file = open(Path.c_str(), O_RDONLY);
+    if (file < 0){
+        return; // the file has been removed
+    }
+    struct stat file_stat;
+    if (fstat(file, &file_stat) == 0 && file_stat.st_size > 0){
+        void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, file, 0);
+        if (data == MAP_FAILED){
+            close(file);
+            throw std::runtime_error("Failed to map " + Path);
+        }
+        madvise(data, file_stat.st_size, MADV_SEQUENTIAL); // the blocks are decoded in order
+        Data = static_cast<const unsigned char*>(data);
+        Size = file_stat.st_size;
+    }
+    close(file); // the mapping stays valid after closing the file
+}
+
+// release the mapping
+void Mapped_File::unmap()
+{
+    if (Data != nullptr){
+        munmap(const_cast<unsigned char*>(Data), Size);
+    }
+    Data = nullptr;
+    Size = 0;
+}
+
+
+// column files of one action
+// constructor : open (and create if needed) the column files, replay the open block
+Instrument_Ticks::Instrument_Ticks(const std::string& path) : Path(path), Times(path + ".time"), Prices(path + ".price"), Quantities(path + ".quantity"), Index(path + ".index"), Sealed_Tick_Count(0)
+{
+    for (size_t i = 0; i < get_block_count(); i++){
+        Sealed_Tick_Count += get_blocks()[i].count;
+    }
+    Tail_File = open((Path + ".tail").c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (Tail_File < 0){
+        throw std::runtime_error("Failed to open " + Path + ".tail");
+    }
+
+    // the ticks of the open block are replayed from the tail file
+    struct stat tail_stat;
+    fstat(Tail_File, &tail_stat);
+    Open_Block.resize(tail_stat.st_size / sizeof(Tick));
+    if (!Open_Block.empty() && pread(Tail_File, Open_Block.data(), Open_Block.size() * sizeof(Tick), 0) != static_cast<ssize_t>(Open_Block.size() * sizeof(Tick))){
+        throw std::runtime_error("Failed to read " + Path + ".tail");
+    }
+    if (Open_Block.size() >= TICK_BLOCK_SIZE){
+        Open_Block.resize(TICK_BLOCK_SIZE);
+        // a full tail means that the process stopped while sealing it, the block is sealed again unless its index entry was written
+        size_t block_count = get_block_count();
+        const Tick_Block_Index* last_block = block_count > 0 ? &get_blocks()[block_count - 1] : nullptr;
+        if (last_block != nullptr && last_block->count == Open_Block.size() && last_block->first_time == Open_Block.front().time && last_block->last_time == Open_Block.back().time){
+            Open_Block.clear();
+            if (ftruncate(Tail_File, 0) != 0){
+                throw std::runtime_error("Failed to truncate " + Path + ".tail");
+            }
+        }
+        else {
+            seal_block();
+        }
+    }
+
+    // the last tick, in the open block or else at the end of the last sealed block
+    if (!Open_Block.empty()){
+        Last_Tick = Open_Block.back();
+    }
+    else if (get_block_count() > 0){
+        std::vector<Tick> ticks;
+        decode_block(get_blocks()[get_block_count() - 1], ticks);
+        if (!ticks.empty()){
+            Last_Tick = ticks.back();
+        }
+    }
+}
+
+// destructor
+Instrument_Ticks::~Instrument_Ticks()
+{
+    if (Tail_File >= 0){
+        close(Tail_File);
+    }
+}
+
+// get the block index (mapped)
+const Tick_Block_Index* Instrument_Ticks::get_blocks() const
+{
+    return reinterpret_cast<const Tick_Block_Index*>(Index.get_data());
+}
+
+// get the number of sealed blocks
+size_t Instrument_Ticks::get_block_count() const
+{
+    return Index.get_size() / sizeof(Tick_Block_Index);
+}
+
+// encode the open block and append it to the column files
+void Instrument_Ticks::seal_block()
+{
+    if (Open_Block.empty()){
+        return;
+    }
+    std::string times, prices, quantities;
+    encode_times(Open_Block, times);
+    encode_prices(Open_Block, prices);
+    encode_quantities(Open_Block, quantities);
+
+    Tick_Block_Index block{};
+    block.first_time = Open_Block.front().time;
+    block.last_time = Open_Block.back().time;
+    block.min_price = Open_Block.front().price;
+    block.max_price = Open_Block.front().price;
+    for (const auto& tick : Open_Block){
+        block.min_price = std::min(block.min_price, tick.price);
+        block.max_price = std::max(block.max_price, tick.price);
+    }
+    block.count = Open_Block.size();
+    block.time_length = times.size();
+    block.price_length = prices.size();
+    block.quantity_length = quantities.size();
+
+    // the columns are written before the index entry, so that a block is never indexed before its data
+    block.time_offset = append_to_file(Path + ".time", times.data(), times.size());
+    block.price_offset = append_to_file(Path + ".price", prices.data(), prices.size());
+    block.quantity_offset = append_to_file(Path + ".quantity", quantities.data(), quantities.size());
+    append_to_file(Path + ".index", &block, sizeof(block));
+    Times.remap();
+    Prices.remap();
+    Quantities.remap();
+    Index.remap();
+
+    Sealed_Tick_Count += Open_Block.size();
+    Open_Block.clear();
+    if (ftruncate(Tail_File, 0) != 0){
+        throw std::runtime_error("Failed to truncate " + Path + ".tail");
+    }
+}
+
+// decode a sealed block
+void Instrument_Ticks::decode_block(const Tick_Block_Index& block, std::vector<Tick>& ticks) const
+{
+    ticks.resize(block.count);
+    decode_times(Times.get_data() + block.time_offset, block.time_length, block.first_time, block.count, ticks);
+    decode_prices(Prices.get_data() + block.price_offset, block.price_length, block.count, ticks);
+    decode_quantities(Quantities.get_data() + block.quantity_offset, block.quantity_length, block.count, ticks);
+}
+
+// append a tick (its time can not go back in the past)
+void Instrument_Ticks::append(Tick tick)
+{
+    Time last_time = 0;
+    if (!Open_Block.empty()){
+        last_time = Open_Block.back().time;
+    }
+    else if (get_block_count() > 0){
+        last_time = get_blocks()[get_block_count() - 1].last_time;
+    }
+    tick.time = std::max(tick.time, last_time); // the system clock may go back, the history must stay ordered
+
+    write_all(Tail_File, &tick, sizeof(tick));
+    Open_Block.push_back(tick);
+    Last_Tick = tick;
+    if (Open_Block.size() >= TICK_BLOCK_SIZE){
+        seal_block();
+    }
+}
+
+// get the position of the first block that ends after from (the open block comes after the sealed ones)
+size_t Instrument_Ticks::find_block(const Time& from) const
+{
+    const Tick_Block_Index* blocks = get_blocks();
+    size_t block_count = get_block_count();
+    // the blocks are ordered by time
+    const Tick_Block_Index* block = std::lower_bound(blocks, blocks + block_count, from,
+        [](const Tick_Block_Index& index, const Time& time){
+            return index.last_time < time;
+        });
+    return block - blocks;
+}
+
+// get the ticks between from and to (included) of the block at the given position, false when there is no more block in the range
+bool Instrument_Ticks::read_block(const size_t& position, const Time& from, const Time& to, std::vector<Tick>& ticks) const
+{
+    size_t block_count = get_block_count();
+    if (position < block_count){
+        const Tick_Block_Index& block = get_blocks()[position];
+        if (block.first_time > to){
+            return false;
+        }
+        decode_block(block, ticks);
+    }
+    else if (position == block_count){
+        ticks = Open_Block;
+    }
+    else {
+        return false;
+    }
+    ticks.erase(std::remove_if(ticks.begin(), ticks.end(), [&from, &to](const Tick& tick){
+        return tick.time < from || tick.time > to;
+    }), ticks.end());
+    return true;
+}
+
+// number of ticks stored (constant time)
+size_t Instrument_Ticks::get_tick_count() const
+{
+    return Sealed_Tick_Count + Open_Block.size();
+}
+
+// the last tick stored, none if there is no tick
+const std::optional<Tick>& Instrument_Ticks::get_last_tick() const
+{
+    return Last_Tick;
+}
+
+// delete the column files
+void Instrument_Ticks::remove_files()
+{
+    Times.unmap();
+    Prices.unmap();
+    Quantities.unmap();
+    Index.unmap();
+    Open_Block.clear();
+    Last_Tick.reset();
+    Sealed_Tick_Count = 0;
+    for (const auto& extension : {".time", ".price", ".quantity", ".index", ".tail"}){
+        std::filesystem::remove(Path + extension);
+    }
+}
+
+
+// tick store
+// constructor
+Tick_Store::Tick_Store(const std::string& directory) : Directory(directory)
+{
+    std::filesystem::create_directories(Directory);
+}
+
+// get (and open if needed) the column files of an action, the mutex must be locked
+Instrument_Ticks& Tick_Store::get_instrument(const ID& action_id) const
+{
+    auto& instrument = const_cast<Tick_Store*>(this)->Instruments[action_id];
+    if (!instrument){
+        instrument = std::make_unique<Instrument_Ticks>(Directory + "/" + std::to_string(action_id));
+    }
+    return *instrument;
+}
+
+// append a tick to the history of an action
+void Tick_Store::append(const ID& action_id, const Time& time, const double& price, const int64_t& quantity)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    get_instrument(action_id).append(Tick{time, price, quantity});
+}
+
+// call the callback on the ticks of an action between from and to (included)
+void Tick_Store::scan(const ID& action_id, const Time& from, const Time& to, const std::function<void(const Tick&)>& callback) const
+{
+    // a block is copied under the lock, then handed to the callback without it (a slow reader must not hold back the market)
+    // the blocks are only appended, so a block sealed meanwhile keeps its position; the scan ends with the open block
+    // (once it is copied, the market may seal it with more ticks : the block after it would not have them)
+    std::vector<Tick> ticks;
+    ticks.reserve(TICK_BLOCK_SIZE);
+    size_t position;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        position = get_instrument(action_id).find_block(from);
+    }
+    bool open_block = false;
+    while (!open_block){
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Instrument_Ticks& instrument = get_instrument(action_id);
+            open_block = position == instrument.get_block_count();
+            if (!instrument.read_block(position, from, to, ticks)){
+                break;
+            }
+        }
+        for (const auto& tick : ticks){
+            callback(tick);
+        }
+        position++;
+    }
+}
+
+// number of ticks of an action (constant time : the event loops read it)
+size_t Tick_Store::get_tick_count(const ID& action_id) const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    return get_instrument(action_id).get_tick_count();
+}
+
+// the last tick of an action (its last price), none if it has no tick
+std::optional<Tick> Tick_Store::get_last_tick(const ID& action_id) const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    return get_instrument(action_id).get_last_tick();
+}
+
+// delete the history of an action
+void Tick_Store::remove_action(const ID& action_id)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    get_instrument(action_id).remove_files();
+    Instruments.erase(action_id);
+}
+
+// delete the history of all the actions
+void Tick_Store::clear()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Instruments.clear(); // close the files before removing them
+    std::filesystem::remove_all(Directory);
+    std::filesystem::create_directories(Directory);
+}
+
+// import the prices table for the actions that have no tick yet
+void Tick_Store::import_from_database(Database_Manager& database)
+{
+    std::vector<ID> action_ids = database.execute_SQL_query_IDs("SELECT action_id FROM actions");
+    for (const auto& action_id : action_ids){
+        if (get_tick_count(action_id) > 0){
+            continue;
+        }
+        std::string query = fmt::format(
+            "SELECT time, price FROM prices WHERE action_id = {} ORDER BY time ASC",
+            action_id
+        );
+        std::vector<std::vector<std::string>> prices = database.execute_SQL_query_vec_strings(query);
+        for (const auto& row : prices){
+            if (row.size() >= 2){
+                append(action_id, std::stoull(row[0]), std::stod(row[1]), 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,138 @@
+//==========================================================================
+// File that defines the columnar store of the price history (ticks) of the actions
+//==========================================================================
+#ifndef TICK_STORE_HPP
+#define TICK_STORE_HPP
+#include "database_management.hpp"
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#define TICK_STORE_DIRECTORY "../Data/Ticks" // one set of column files per action in this directory
+#define TICK_BLOCK_SIZE 4096 // number of ticks encoded together in a block
+
+
+// a trade (or a listing price) of an action
+struct Tick
+{
+    Time time; // milliseconds since Unix epoch
+    double price;
+    int64_t quantity; // 0 for a listing price
+};
+
+// entry of the block index file, with the bounds of the block to skip it without decoding it
+struct Tick_Block_Index
+{
+    Time first_time; // time of the first tick of the block
+    Time last_time; // time of the last tick of the block
+    double min_price;
+    double max_price;
+    uint64_t time_offset; // offset of the block in the time column file
+    uint64_t price_offset; // offset of the block in the price column file
+    uint64_t quantity_offset; // offset of the block in the quantity column file
+    uint32_t time_length; // length in bytes of the block in the time column file
+    uint32_t price_length; // length in bytes of the block in the price column file
+    uint32_t quantity_length; // length in bytes of the block in the quantity column file
+    uint32_t count; // number of ticks in the block
+};
+
+
+// encoding of the columns of a block
+// times : delta-of-delta, zigzag varints (the first time is in the block index)
+void encode_times(const std::vector<Tick>& ticks, std::string& output);
+void decode_times(const unsigned char* data, const size_t& length, const Time& first_time, const uint32_t& count, std::vector<Tick>& ticks);
+// prices : XOR with the previous price, keeping only the meaningful bytes (a control byte gives the leading and trailing zero bytes)
+void encode_prices(const std::vector<Tick>& ticks, std::string& output);
+void decode_prices(const unsigned char* data, const size_t& length, const uint32_t& count, std::vector<Tick>& ticks);
+// quantities : zigzag varints
+void encode_quantities(const std::vector<Tick>& ticks, std::string& output);
+void decode_quantities(const unsigned char* data, const size_t& length, const uint32_t& count, std::vector<Tick>& ticks);
+
+
+// read-only memory mapping of an append-only file, remapped when the file grows
+class Mapped_File
+{
+private:
+    std::string Path;
+    const unsigned char* Data;
+    size_t Size;
+
+public:
+    // constructor
+    Mapped_File(const std::string& path);
+    // destructor
+    ~Mapped_File();
+    Mapped_File(const Mapped_File&) = delete;
+    Mapped_File& operator=(const Mapped_File&) = delete;
+
+    // getters
+    const unsigned char* get_data() const;
+    size_t get_size() const;
+
+    void remap(); // map again the file after it has grown
+    void unmap(); // release the mapping
+};
+
+
+// column files of one action : .time, .price, .quantity (sealed blocks), .index (one Tick_Block_Index per block), .tail (raw ticks of the open block)
+class Instrument_Ticks
+{
+private:
+    std::string Path; // path of the files without the extension
+    Mapped_File Times;
+    Mapped_File Prices;
+    Mapped_File Quantities;
+    Mapped_File Index;
+    std::vector<Tick> Open_Block; // ticks not sealed in a block yet (also in the .tail file)
+    std::optional<Tick> Last_Tick; // the last tick appended, the last price of the action (read without decoding a block)
+    size_t Sealed_Tick_Count; // ticks of the sealed blocks, kept as they are sealed (the count is read without going through the block index)
+    int Tail_File; // descriptor of the .tail file, opened in append mode
+
+    const Tick_Block_Index* get_blocks() const; // get the block index (mapped)
+    void seal_block(); // encode the open block and append it to the column files
+    void decode_block(const Tick_Block_Index& block, std::vector<Tick>& ticks) const; // decode a sealed block
+
+public:
+    // constructor
+    Instrument_Ticks(const std::string& path); // open (and create if needed) the column files, replay the open block
+    // destructor
+    ~Instrument_Ticks();
+    Instrument_Ticks(const Instrument_Ticks&) = delete;
+    Instrument_Ticks& operator=(const Instrument_Ticks&) = delete;
+
+    void append(Tick tick); // append a tick (its time can not go back in the past)
+    size_t get_block_count() const; // get the number of sealed blocks (the position of the open block)
+    size_t find_block(const Time& from) const; // get the position of the first block that ends after from (the open block comes after the sealed ones)
+    bool read_block(const size_t& position, const Time& from, const Time& to, std::vector<Tick>& ticks) const; // get the ticks between from and to (included) of the block at the given position, false when there is no more block in the range
+    size_t get_tick_count() const; // number of ticks stored (constant time)
+    const std::optional<Tick>& get_last_tick() const; // the last tick stored, none if there is no tick
+    void remove_files(); // delete the column files
+};
+
+
+class Tick_Store
+{
+private:
+    std::string Directory;
+    std::unordered_map<ID, std::unique_ptr<Instrument_Ticks>> Instruments; // column files of each action (opened on first use)
+    mutable std::mutex Mutex; // the trades are appended by the market while the clients read the history
+
+    Instrument_Ticks& get_instrument(const ID& action_id) const; // get (and open if needed) the column files of an action, the mutex must be locked
+
+public:
+    // constructor
+    Tick_Store(const std::string& directory);
+
+    void append(const ID& action_id, const Time& time, const double& price, const int64_t& quantity); // append a tick to the history of an action
+    void scan(const ID& action_id, const Time& from, const Time& to, const std::function<void(const Tick&)>& callback) const; // call the callback on the ticks of an action between from and to (included), block by block so that the appends are not blocked during the callbacks
+    size_t get_tick_count(const ID& action_id) const; // number of ticks of an action (constant time : the event loops read it)
+    std::optional<Tick> get_last_tick(const ID& action_id) const; // the last tick of an action (its last price), none if it has no tick
+    void remove_action(const ID& action_id); // delete the history of an action
+    void clear(); // delete the history of all the actions
+    void import_from_database(Database_Manager& database); // import the prices table for the actions that have no tick yet
+};
+
+
+#endif // TICK_STORE_HPP
@@ -22,6 +22,9 @@ Time get_current_time_ms()
 // function to convert milliseconds timestamp to a human-readable string : "YYYY-MM-DD HH:MM:SS.mmm"
 std::string time_to_string(Time time_ms)
 {
+    if (time_ms == static_cast<Time>(no_expiration_time)){
+        return "NO_EXPIRATION";
+    }
     // convert milliseconds to seconds
     std::time_t seconds = time_ms / MS_IN_S;
     int milliseconds = time_ms % MS_IN_S;
@@ -37,76 +40,55 @@ std::string time_to_string(Time time_ms)
     return std::string(buffer);
 }
 
-// get the time in the day : 16h05m23.123s -> 16*60*60*1000 + 5*60*1000 + 23*1000 + 123
-ID get_daily_time(Time time_ms)
-{
-    // convert milliseconds to seconds
-    std::time_t seconds = time_ms / MS_IN_S;
-    int milliseconds = time_ms % MS_IN_S;
-
-    // convert to local time
-    std::tm now_tm = *std::localtime(&seconds);
-
-    // get the time in the day in milliseconds
-    return milliseconds + MS_IN_S * (now_tm.tm_sec + S_IN_M * (now_tm.tm_min + M_IN_H * now_tm.tm_hour));
-}
 
-// get the date : 2025-03-18 is 2025*12*31 + 3*31 + 18, and to get it we need to divide the result
-ID get_date_time(Time time_ms)
+// read the integers of a date or a time separated by the given characters (as sscanf would), returns how many were read
+static int read_time_fields(std::string_view text, std::string_view separators, int* fields, const int& count)
 {
-    // convert milliseconds to seconds
-    std::time_t seconds = time_ms / MS_IN_S;
-
-    // convert to local time
-    std::tm now_tm = *std::localtime(&seconds);
-
-    // get the date in the year
-    return now_tm.tm_mday + D_IN_M * (now_tm.tm_mon + M_IN_Y * now_tm.tm_year);
-}
-
-// convert the daily time and date time to a string (YYYY-MM-DD HH:MM:SS.mmm)
-std::string two_times_to_string(ID date_time, ID daily_time)
-{
-    // get the time in the day
-    int hours = daily_time / MS_IN_H;
-    daily_time %= MS_IN_H;
-    int minutes = daily_time / MS_IN_M;
-    daily_time %= MS_IN_M;
-    int seconds = daily_time / MS_IN_S;
-    int milliseconds = daily_time % MS_IN_S;
-
-    // get the date
-    int year = date_time / (D_IN_M * M_IN_Y);
-    date_time %= (D_IN_M * M_IN_Y);
-    int month = date_time / D_IN_M;
-    int day = date_time % D_IN_M;
-
-    // format the time in the correct readable way (YYYY-MM-DD HH:MM:SS.mmm)
-    // Reserve and format directly
-    char buffer[32];
-    std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d.%03d",
-    year + 1900, month + 1, day, 
-    hours, minutes, seconds, milliseconds);
-    return std::string(buffer);
-}
-
-// get the date from a string : "YYYY-MM-DD" -> YYYY*12*31 + MM*31 + DD
-ID get_date_id_from_string(const std::string& date_str)
-{
-    int year = std::stoi(date_str.substr(0, 4));   // characters 0-3
-    int month = std::stoi(date_str.substr(5, 2));  // characters 5-6
-    int day = std::stoi(date_str.substr(8, 2));    // characters 8-9
-    return day + D_IN_M * (month + M_IN_Y * year);
+    const char* position = text.data();
+    const char* end = text.data() + text.size();
+    int read = 0;
+    while (read < count){
+        auto [next, error] = std::from_chars(position, end, fields[read]);
+        if (error != std::errc()){
+            break;
+        }
+        read++;
+        position = next;
+        if (read == count || position == end || *position != separators[read - 1]){
+            break;
+        }
+        position++;
+    }
+    return read;
 }
 
-// get the daily time from a string : "HH:MM:SS.mmm" -> HH*60*60*1000 + MM*60*1000 + SS*1000 + mmm
-ID get_daily_id_from_string(const std::string& time_str)
+// get the time (milliseconds since Unix epoch) from a local date and a local time : "YYYY-MM-DD" "HH:MM:SS.mmm" (the milliseconds and the time are optional)
+Time get_time_from_strings(std::string_view date_str, std::string_view time_str)
 {
-    int hour = std::stoi(time_str.substr(0, 2));        // characters 0-1
-    int minute = std::stoi(time_str.substr(3, 2));      // characters 3-4
-    int second = std::stoi(time_str.substr(6, 2));      // characters 6-7
-    int millisecond = std::stoi(time_str.substr(9, 3)); // characters 9-11
-    return millisecond + MS_IN_S * (second + S_IN_M * (minute + M_IN_H * hour));
+    std::tm local_tm{};
+    int milliseconds = 0;
+    int date_fields[3] = {0, 0, 0};
+    int time_fields[4] = {0, 0, 0, 0};
+    if (read_time_fields(date_str, "--", date_fields, 3) != 3){
+        throw std::invalid_argument("Date must be given as YYYY-MM-DD");
+    }
+    if (!time_str.empty() && read_time_fields(time_str, "::.", time_fields, 4) < 2){
+        throw std::invalid_argument("Time must be given as HH:MM:SS.mmm");
+    }
+    local_tm.tm_year = date_fields[0];
+    local_tm.tm_mon = date_fields[1];
+    local_tm.tm_mday = date_fields[2];
+    local_tm.tm_hour = time_fields[0];
+    local_tm.tm_min = time_fields[1];
+    local_tm.tm_sec = time_fields[2];
+    milliseconds = time_fields[3];
+    local_tm.tm_year -= 1900;
+    local_tm.tm_mon -= 1;
+    local_tm.tm_isdst = -1; // let mktime find if the daylight saving time applies at this date
+
+    // convert the local time to seconds since Unix epoch
+    std::time_t seconds = std::mktime(&local_tm);
+    return static_cast<Time>(seconds) * MS_IN_S + milliseconds;
 }
 
 
@@ -167,76 +149,349 @@ std::string decrypt_AES(const std::string& ciphertext, unsigned char* key, unsig
     return plaintext;
 }
 
-// 
-void send_full_string(int sock, const std::string &data, std::mutex &send_mtx)
+// random bytes from the OpenSSL generator (salts, keys)
+std::string random_bytes(const size_t& count)
 {
-    std::lock_guard<std::mutex> lock(send_mtx);
-    uint64_t msg_size = data.size();
-    uint64_t net_size = htobe64(msg_size);
+    std::string bytes(count, '\0');
+    if (RAND_bytes(reinterpret_cast<unsigned char*>(bytes.data()), count) != 1){
+        throw std::runtime_error("Failed to generate random bytes");
+    }
+    return bytes;
+}
 
-    ssize_t sent = send(sock, &net_size, sizeof(net_size), 0);
-    if (sent != sizeof(net_size)){
-        throw std::runtime_error("Failed to send message size header");
+// salted slow hash of a password (PBKDF2-HMAC-SHA256)
+std::string hash_password(const std::string& password, const std::string& salt, const int& iterations)
+{
+    std::string hash(PASSWORD_HASH_SIZE, '\0');
+    if (PKCS5_PBKDF2_HMAC(password.data(), password.size(), reinterpret_cast<const unsigned char*>(salt.data()), salt.size(), iterations, EVP_sha256(), hash.size(), reinterpret_cast<unsigned char*>(hash.data())) != 1){
+        throw std::runtime_error("Failed to hash a password");
     }
+    return hash;
+}
+
+// fixed receive buffer used as a ring, the frames are read in place
+// constructor
+Frame_Buffer::Frame_Buffer(const size_t& capacity) : Data(new char[capacity]), Capacity(capacity), Read_Position(0), Write_Position(0)
+{
+
+}
+
+// move the bytes not consumed to the front if the pending frame cannot fit after them
+void Frame_Buffer::make_room()
+{
+    if (Read_Position == Write_Position){
+        Read_Position = Write_Position = 0; // everything was consumed, the next frame starts at the front
+        return;
+    }
+    if (Read_Position == 0){
+        return;
+    }
+    size_t needed = FRAME_HEADER_SIZE;
+    if (Write_Position - Read_Position >= FRAME_HEADER_SIZE){
+        uint64_t net_size;
+        std::memcpy(&net_size, Data.get() + Read_Position, sizeof(net_size));
+        needed += be64toh(net_size) & ~FRAME_MORE_FLAG;
+    }
+    if (Write_Position == Capacity || Read_Position + needed > Capacity){
+        std::memmove(Data.get(), Data.get() + Read_Position, Write_Position - Read_Position); // at most one partial frame
+        Write_Position -= Read_Position;
+        Read_Position = 0;
+    }
+}
+
+// where the next bytes are received (invalidates the frames returned before)
+char* Frame_Buffer::get_free_space(size_t& length)
+{
+    make_room();
+    length = Capacity - Write_Position;
+    return Data.get() + Write_Position;
+}
+
+// count the bytes received in the free space
+void Frame_Buffer::commit(const size_t& length)
+{
+    Write_Position += length;
+}
+
+// copy bytes received elsewhere (as many as fit), returns the number copied
+size_t Frame_Buffer::append(const char* data, const size_t& length)
+{
+    size_t free_length;
+    char* free_space = get_free_space(free_length);
+    size_t copied = std::min(length, free_length);
+    std::memcpy(free_space, data, copied);
+    commit(copied);
+    return copied;
+}
+
+// one recv in the free space (same return value as recv)
+ssize_t Frame_Buffer::receive(int sock)
+{
+    size_t free_length;
+    char* free_space = get_free_space(free_length);
+    if (free_length == 0){
+        errno = EMSGSIZE;
+        return -1;
+    }
+    ssize_t length = recv(sock, free_space, free_length, 0);
+    if (length > 0){
+        commit(length);
+    }
+    return length;
+}
+
+// view of the next complete frame, false if it is not fully received, throws if it can never fit
+bool Frame_Buffer::next_frame(Frame& frame)
+{
+    if (Write_Position - Read_Position < FRAME_HEADER_SIZE){
+        return false;
+    }
+    uint64_t net_size;
+    std::memcpy(&net_size, Data.get() + Read_Position, sizeof(net_size));
+    uint64_t header = be64toh(net_size);
+    uint64_t size = header & ~FRAME_MORE_FLAG;
+    if (size > Capacity - FRAME_HEADER_SIZE){
+        throw std::runtime_error("Frame larger than the receive buffer");
+    }
+    if (Write_Position - Read_Position < FRAME_HEADER_SIZE + size){
+        return false;
+    }
+    frame.data = Data.get() + Read_Position + FRAME_HEADER_SIZE;
+    frame.size = size;
+    frame.last = !(header & FRAME_MORE_FLAG);
+    Read_Position += FRAME_HEADER_SIZE + size;
+    return true;
+}
+
+// drop the bytes received (a new connection starts)
+void Frame_Buffer::clear()
+{
+    Read_Position = Write_Position = 0;
+}
+
+// write the header of a frame
+void write_frame_header(char* header, const size_t& length, const bool& last)
+{
+    uint64_t net_size = htobe64(static_cast<uint64_t>(length) | (last ? 0 : FRAME_MORE_FLAG));
+    std::memcpy(header, &net_size, sizeof(net_size));
+}
 
+// send buffers through a socket, gathered in one system call (sendmsg), until they are all written
+void send_parts(int sock, struct iovec* parts, size_t count)
+{
+    struct msghdr message{};
+    message.msg_iov = parts;
+    message.msg_iovlen = count;
     size_t total = 0;
-    while (total < data.size()){
-        ssize_t bytes = send(sock, data.data() + total, data.size() - total, 0);
+    for (size_t i = 0; i < count; i++){
+        total += parts[i].iov_len;
+    }
+    while (total > 0){
+        ssize_t bytes = sendmsg(sock, &message, MSG_NOSIGNAL);
         if (bytes <= 0){
+            if (bytes < 0 && errno == EINTR){
+                continue;
+            }
             throw std::runtime_error("Socket send error");
         }
-        total += bytes;
+        total -= bytes;
+        // skip what was written (a partial write is rare, the parts are usually sent together)
+        while (bytes > 0 && message.msg_iovlen > 0){
+            size_t skipped = std::min<size_t>(bytes, message.msg_iov->iov_len);
+            message.msg_iov->iov_base = static_cast<char*>(message.msg_iov->iov_base) + skipped;
+            message.msg_iov->iov_len -= skipped;
+            bytes -= skipped;
+            if (message.msg_iov->iov_len == 0){
+                message.msg_iov++;
+                message.msg_iovlen--;
+            }
+        }
     }
 }
 
-// send safely a message through a socket
-std::string recv_full_string(int sock, std::string &leftover, std::mutex &recv_mtx, int timeout_sec = 10)
-{   
-    std::lock_guard<std::mutex> lock(recv_mtx);
-    uint64_t net_size;
-    size_t need = sizeof(net_size);
-
-    // If leftover has enough for size header, use it
-    if (leftover.size() < need){
-        char tmp[BUFFER_SIZE];
-        while (leftover.size() < need){
-            ssize_t r = recv(sock, tmp, sizeof(tmp), 0);
-            if (r <= 0){
-                throw std::runtime_error("Failed to read size header");
+// send one frame through a socket (header and payload in the same system call)
+void send_frame(int sock, const char* data, const size_t& length, const bool& last)
+{
+    char header[FRAME_HEADER_SIZE];
+    write_frame_header(header, length, last);
+    struct iovec parts[2] = {{header, FRAME_HEADER_SIZE}, {const_cast<char*>(data), length}};
+    send_parts(sock, parts, 2);
+}
+
+// send a whole message through a socket, in frames of at most FRAME_MAX_SIZE bytes
+void send_message(int sock, const std::string& message)
+{
+    size_t offset = 0;
+    do {
+        size_t length = std::min<size_t>(message.size() - offset, FRAME_MAX_SIZE);
+        send_frame(sock, message.data() + offset, length, offset + length == message.size());
+        offset += length;
+    } while (offset < message.size());
+}
+
+// append a whole message to an output, in frames of at most FRAME_MAX_SIZE bytes
+void append_message(std::string& output, const char* data, const size_t& length)
+{
+    size_t offset = 0;
+    do {
+        size_t frame_length = std::min<size_t>(length - offset, FRAME_MAX_SIZE);
+        char header[FRAME_HEADER_SIZE];
+        write_frame_header(header, frame_length, offset + frame_length == length);
+        output.append(header, FRAME_HEADER_SIZE);
+        output.append(data + offset, frame_length);
+        offset += frame_length;
+    } while (offset < length);
+}
+
+// read a whole message from a socket (blocking), false if the connection is closed
+bool receive_message(int sock, Frame_Buffer& buffer, std::string& message)
+{
+    message.clear();
+    Frame frame;
+    while (true){
+        while (buffer.next_frame(frame)){
+            message.append(frame.data, frame.size);
+            if (frame.last){
+                return true;
             }
-            leftover.append(tmp, r);
+        }
+        ssize_t length = buffer.receive(sock);
+        if (length < 0 && errno == EINTR){
+            continue;
+        }
+        if (length <= 0){
+            return false;
         }
     }
+}
 
-    std::memcpy(&net_size, leftover.data(), sizeof(net_size));
-    leftover.erase(0, sizeof(net_size));
+// builds a response by pieces and hands it to the sink in chunks of bounded size
+// constructor
+Response_Writer::Response_Writer(Response_Sink sink, const size_t& chunk_size) : Sink(std::move(sink)), Chunk_Size(chunk_size), Written_Size(0), Empty_Row_List(true), Finished(false)
+{
+    Buffer.reserve(Chunk_Size);
+}
 
-    uint64_t msg_size = be64toh(net_size);
-    std::string data;
-    data.reserve(msg_size);
+// destructor
+Response_Writer::~Response_Writer()
+{
+    try {
+        finish();
+    }
+    catch (const std::exception& e){
+        std::cerr << "Error while finishing a response: " << e.what() << std::endl;
+    }
+}
 
-    // consume leftover first
-    if (!leftover.empty()){
-        size_t use = msg_size < leftover.size() ? msg_size : leftover.size();
-        data.append(leftover.substr(0, use));
-        leftover.erase(0, use);
+// append data to the response
+void Response_Writer::write(const std::string& data)
+{
+    Buffer += data;
+    Written_Size += data.size();
+    if (Buffer.size() >= Chunk_Size){
+        flush();
     }
+}
 
-    // then read remainder
-    while (data.size() < msg_size){
-        char tmp[BUFFER_SIZE];
-        ssize_t r = recv(sock, tmp, sizeof(tmp), 0);
-        if (r <= 0){
-            throw std::runtime_error("Connection lost during receive");
+// append a row, separated from the previous one by a comma
+void Response_Writer::write_row(const std::string& row)
+{
+    if (!Empty_Row_List){
+        write(",");
+    }
+    Empty_Row_List = false;
+    write(row);
+}
+
+// hand the buffered data to the sink
+void Response_Writer::flush()
+{
+    if (!Buffer.empty() && !Finished){
+        Sink(Buffer.data(), Buffer.size(), false);
+        Buffer.clear();
+    }
+}
+
+// hand the last chunk to the sink, the response is complete
+void Response_Writer::finish()
+{
+    if (!Finished){
+        Finished = true;
+        Sink(Buffer.data(), Buffer.size(), true);
+        Buffer.clear();
+    }
+}
+
+size_t Response_Writer::get_written_size() const
+{
+    return Written_Size;
+}
+
+// send all the bytes through a socket (the send calls may write only a part of them)
+void send_all(int sock, const char* data, size_t length)
+{
+    size_t total = 0;
+    while (total < length){
+        ssize_t bytes = send(sock, data + total, length - total, MSG_NOSIGNAL);
+        if (bytes <= 0){
+            throw std::runtime_error("Socket send error");
         }
-        size_t needed = msg_size - data.size();
-        if ((size_t)r > needed){
-            data.append(tmp, needed);
-            leftover.assign(tmp + needed, r - needed);
-        } 
-        else {
-            data.append(tmp, r);
+        total += bytes;
+    }
+}
+
+
+// constructor
+Deflate_Stream::Deflate_Stream(const int& level) : Stream{}
+{
+    if (deflateInit(&Stream, level) != Z_OK){
+        throw std::runtime_error("Failed to initialize a zlib stream");
+    }
+}
+
+// destructor
+Deflate_Stream::~Deflate_Stream()
+{
+    deflateEnd(&Stream);
+}
+
+// append the compressed bytes zlib has ready (all of them once the last chunk is given)
+void Deflate_Stream::compress(const char* data, const size_t& length, const bool& last, std::string& output)
+{
+    Stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    Stream.avail_in = length;
+    int flush = last ? Z_FINISH : Z_NO_FLUSH;
+    char buffer[RESPONSE_CHUNK_SIZE];
+    do {
+        Stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        Stream.avail_out = sizeof(buffer);
+        if (deflate(&Stream, flush) == Z_STREAM_ERROR){
+            throw std::runtime_error("Failed to compress a response");
         }
+        output.append(buffer, sizeof(buffer) - Stream.avail_out);
+    } while (Stream.avail_out == 0 || Stream.avail_in > 0);
+}
+
+// decompress a whole deflate stream, false if it is corrupted or truncated
+bool inflate_message(std::string_view compressed, std::string& output)
+{
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK){
+        return false;
     }
-    return data;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+    stream.avail_in = compressed.size();
+    char buffer[RESPONSE_CHUNK_SIZE];
+    int result;
+    do {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        result = inflate(&stream, Z_NO_FLUSH);
+        if (result != Z_OK && result != Z_STREAM_END){
+            break;
+        }
+        output.append(buffer, sizeof(buffer) - stream.avail_out);
+    } while (result != Z_STREAM_END);
+    inflateEnd(&stream);
+    return result == Z_STREAM_END;
 }
@@ -9,8 +9,10 @@
 #include <algorithm>
 #include <arpa/inet.h>
 #include <atomic>
+#include <charconv>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -27,18 +29,23 @@
 #include <memory>
 #include <mutex>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <optional>
+#include <poll.h>
 #include <random>
 #include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <thread>
 #include <tuple>
 #include <unistd.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -48,6 +55,7 @@
 #include <libkern/OSByteOrder.h>
 #define htobe64(x) OSSwapHostToBigInt64(x)
 #define be64toh(x) OSSwapBigToHostInt64(x)
+#define MSG_NOSIGNAL 0 // macOS has no such flag, SO_NOSIGPIPE must be set on the socket instead
 #else
 #include <endian.h>
 #endif
@@ -59,7 +67,9 @@
 #include <SDL_ttf.h>
 #include <sqlite3.h>
 #include <openssl/evp.h>
+#include <openssl/hmac.h>
 #include <openssl/rand.h>
+#include <zlib.h>
 
 
 
@@ -82,25 +92,15 @@ ID generate_random_uint32();
 #define MS_IN_M 60000
 #define M_IN_H 60
 #define MS_IN_H 3600000
-#define D_IN_M 31
-#define M_IN_Y 12
 using Time = uint64_t; // type for the time in the game
+#define no_expiration_time INT64_MAX // expiration time of an order that never expires (stored as an INTEGER in the database)
 
 // function to get current time as an integer (milliseconds since Unix epoch : 1970-01-01 00:00:00 UTC)
 Time get_current_time_ms();
 // function to convert milliseconds timestamp to a human-readable string : "YYYY-MM-DD HH:MM:SS.mmm"
 std::string time_to_string(Time time_ms);
-
-// get the time in the day : 16h05m23.123s -> 16*60*60*1000 + 5*60*1000 + 23*1000 + 123
-ID get_daily_time(Time time_ms);
-// get the date : 2025-03-18 is 2025*12*31 + 3*31 + 18, and to get it we need to divide the result
-ID get_date_time(Time time_ms);
-// convert the daily time and date time to a string (YYYY-MM-DD HH:MM:SS.mmm)
-std::string two_times_to_string(ID date_time, ID daily_time);
-// get the date from a string : "YYYY-MM-DD" -> YYYY*12*31 + MM*31 + DD
-ID get_date_id_from_string(const std::string& date_str);
-// get the daily time from a string : "HH:MM:SS.mmm" -> HH*60*60*1000 + MM*60*1000 + SS*1000 + mmm
-ID get_daily_id_from_string(const std::string& time_str);
+// get the time (milliseconds since Unix epoch) from a local date and a local time : "YYYY-MM-DD" "HH:MM:SS.mmm" (the milliseconds and the time are optional)
+Time get_time_from_strings(std::string_view date_str, std::string_view time_str);
 
 
 
@@ -140,18 +140,146 @@ std::string encrypt_AES(const std::string& plaintext, unsigned char* key, unsign
 // decrypt function
 std::string decrypt_AES(const std::string& ciphertext, unsigned char* key, unsigned char* iv);
 
+#define PASSWORD_SALT_SIZE 16
+#define PASSWORD_HASH_SIZE 32 // SHA-256
+#define PASSWORD_HASH_ITERATIONS 100000 // PBKDF2 rounds of a new password hash (slow on purpose, a stolen table is expensive to attack)
+
+// random bytes from the OpenSSL generator (salts, keys)
+std::string random_bytes(const size_t& count);
+
+// salted slow hash of a password (PBKDF2-HMAC-SHA256)
+std::string hash_password(const std::string& password, const std::string& salt, const int& iterations);
+
 
 
 /////////////////////////////////////////////////////////////////////////////////////
 // Sending and receiving messages over the network
 /////////////////////////////////////////////////////////////////////////////////////
-// send safely a message through a socket
-void send_full_string(int sock, const std::string &data, std::mutex &send_mtx);
-
-// read safely a message from a socket
-std::string recv_full_string(int sock, std::string &leftover, std::mutex &recv_mtx, int timeout_sec = 10);
-// leftover is a per-client buffer that stores extra bytes read from the socket beyond the current message, ensuring no data is lost. 
-// It allows the client to correctly handle partial or multiple messages in a TCP stream across successive recv() calls.
+// every message is sent as frames : an 8 byte big-endian header with the payload length (its highest bit is set when more frames
+// of the same message follow) then the payload, so that a large response is streamed in bounded frames
+#define FRAME_HEADER_SIZE 8
+#define FRAME_MORE_FLAG (1ULL << 63)
+#define FRAME_MAX_SIZE 16384 // largest payload of a frame, the longer messages are split
+#define FRAME_BUFFER_SIZE (2 * (FRAME_HEADER_SIZE + FRAME_MAX_SIZE)) // receive buffer of the clients, holds any frame
+#define REQUEST_BUFFER_SIZE 4096 // receive buffer of a server session (the requests are short, a longer one comes in several frames)
+#define REQUEST_MAX_SIZE 65536 // largest request of a client, all its frames together (the session is closed beyond)
+#define RESPONSE_CHUNK_SIZE FRAME_MAX_SIZE // size of the chunks in which a large response is sent
+#define HEARTBEAT_MESSAGE "HEARTBEAT" // message of a session with nothing else to send (the first one from a client turns the heartbeats on)
+#define HEARTBEAT_INTERVAL 1000 // milliseconds without sending anything before a heartbeat is sent
+#define HEARTBEAT_TIMEOUT 3000 // milliseconds without receiving anything before the peer is considered dead
+#define SEQUENCE_PREFIX '@' // "@sequence " : frame before each message of a resumed session (the client asks for the messages after the last sequence it read)
+#define COMPRESSION_PREFIX "~zlib " // start of a compressed response (a deflate stream follows), sent to the sessions that asked for it
+#define COMPRESSION_THRESHOLD 4096 // bytes from which a response is compressed (the short ones, the acks, are sent as they are)
+#define COMPRESSION_LEVEL 1 // zlib level, the fastest (the responses are compressed while they are streamed)
+
+// heartbeats of a session : each side sends one when it sent nothing else during the interval, and closes the session when it received nothing during the timeout
+struct Heartbeat_Policy
+{
+    int interval = HEARTBEAT_INTERVAL; // milliseconds
+    int timeout = HEARTBEAT_TIMEOUT; // milliseconds
+};
+
+// view of a received frame, pointing in the receive buffer
+struct Frame
+{
+    const char* data;
+    size_t size;
+    bool last; // last frame of the message
+};
+
+// fixed receive buffer used as a ring : the frames are read in place, and when a frame would run past the end only the bytes
+// not consumed yet are moved back to the front (there is no copy or allocation per message)
+class Frame_Buffer
+{
+private:
+    std::unique_ptr<char[]> Data;
+    size_t Capacity;
+    size_t Read_Position; // start of the first frame not consumed
+    size_t Write_Position; // end of the bytes received
+
+    void make_room(); // move the bytes not consumed to the front if the pending frame cannot fit after them
+
+public:
+    // constructor
+    Frame_Buffer(const size_t& capacity = FRAME_BUFFER_SIZE);
+    Frame_Buffer(const Frame_Buffer&) = delete;
+    Frame_Buffer& operator=(const Frame_Buffer&) = delete;
+
+    char* get_free_space(size_t& length); // where the next bytes are received (invalidates the frames returned before)
+    void commit(const size_t& length); // count the bytes received in the free space
+    size_t append(const char* data, const size_t& length); // copy bytes received elsewhere (as many as fit), returns the number copied
+    ssize_t receive(int sock); // one recv in the free space (same return value as recv)
+    bool next_frame(Frame& frame); // view of the next complete frame, false if it is not fully received, throws if it can never fit
+    void clear(); // drop the bytes received (a new connection starts)
+};
+
+// write the header of a frame
+void write_frame_header(char* header, const size_t& length, const bool& last);
+
+// send buffers through a socket, gathered in one system call (sendmsg), until they are all written
+void send_parts(int sock, struct iovec* parts, size_t count);
+
+// send one frame through a socket (header and payload in the same system call)
+void send_frame(int sock, const char* data, const size_t& length, const bool& last);
+
+// send a whole message through a socket, in frames of at most FRAME_MAX_SIZE bytes
+void send_message(int sock, const std::string& message);
+
+// append a whole message to an output, in frames of at most FRAME_MAX_SIZE bytes
+void append_message(std::string& output, const char* data, const size_t& length);
+
+// read a whole message from a socket (blocking), false if the connection is closed
+bool receive_message(int sock, Frame_Buffer& buffer, std::string& message);
+
+// where a Response_Writer hands its chunks (last is true for the chunk ending the response)
+using Response_Sink = std::function<void(const char* data, size_t length, bool last)>;
+
+// builds a response by pieces and hands it to the sink in chunks of bounded size, so that a large result is never fully in memory
+class Response_Writer
+{
+private:
+    Response_Sink Sink; // where the chunks go (socket, string, ...)
+    std::string Buffer;
+    size_t Chunk_Size;
+    size_t Written_Size; // total size written since the creation
+    bool Empty_Row_List; // true until the first row, for the separators
+    bool Finished;
+
+public:
+    // constructor
+    Response_Writer(Response_Sink sink, const size_t& chunk_size = RESPONSE_CHUNK_SIZE);
+    // destructor
+    ~Response_Writer(); // finish the response if it was not
+
+    void write(const std::string& data); // append data to the response
+    void write_row(const std::string& row); // append a row, separated from the previous one by a comma
+    void flush(); // hand the buffered data to the sink
+    void finish(); // hand the last chunk to the sink, the response is complete
+    size_t get_written_size() const;
+};
+
+// send all the bytes through a socket (the send calls may write only a part of them)
+void send_all(int sock, const char* data, size_t length);
+
+// zlib deflate stream of one response, compressed chunk by chunk as the response is written
+class Deflate_Stream
+{
+private:
+    z_stream Stream;
+
+public:
+    // constructor
+    Deflate_Stream(const int& level = COMPRESSION_LEVEL); // throws if zlib fails to allocate its state
+    // destructor
+    ~Deflate_Stream();
+    Deflate_Stream(const Deflate_Stream&) = delete;
+    Deflate_Stream& operator=(const Deflate_Stream&) = delete;
+
+    void compress(const char* data, const size_t& length, const bool& last, std::string& output); // append the compressed bytes zlib has ready (all of them once the last chunk is given)
+};
+
+// decompress a whole deflate stream, false if it is corrupted or truncated
+bool inflate_message(std::string_view compressed, std::string& output);
 
 
 
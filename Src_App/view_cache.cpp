@@ -0,0 +1,91 @@
+#include "view_cache.hpp"
+
+
+// constructor
+View_Cache::View_Cache(const std::chrono::milliseconds& ttl) : TTL(ttl), Computations(0), Shared(0), Cached(0)
+{
+
+}
+
+// the view, computed by this request or shared with another one (an exception of build is thrown to all the requests waiting for it)
+View_Result View_Cache::get(const std::string& key, const uint64_t& version, const View_Builder& build)
+{
+    std::promise<View_Result> promise;
+    std::shared_future<View_Result> result;
+    uint64_t computation = 0; // 0 : the result of another request
+    bool stored = true;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        auto now = std::chrono::steady_clock::now();
+        auto it = Entries.find(key);
+        if (it != Entries.end() && it->second.version == version && (!it->second.computed || now - it->second.computed_time < TTL)){
+            (it->second.computed ? Cached : Shared).fetch_add(1, std::memory_order_relaxed);
+            result = it->second.result;
+        }
+        else {
+            // computed by this request, the identical ones arriving meanwhile wait for it
+            result = promise.get_future().share();
+            computation = Computations.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (it != Entries.end() && it->second.version > version){
+                stored = false; // a newer version is already cached, this older one is only sent to this request
+            }
+            else {
+                if (it == Entries.end() && Entries.size() >= VIEW_CACHE_ENTRIES){
+                    prune(now);
+                }
+                Entries[key] = Entry{version, result, computation, {}, false};
+            }
+        }
+    }
+    if (computation == 0){
+        return result.get();
+    }
+
+    bool failed = false;
+    try {
+        promise.set_value(std::make_shared<const std::string>(build()));
+    }
+    catch (...){
+        promise.set_exception(std::current_exception()); // the requests waiting for it fail too
+        failed = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        auto it = Entries.find(key);
+        if (stored && it != Entries.end() && it->second.computation == computation){ // not replaced by a newer version meanwhile
+            if (failed){
+                Entries.erase(it); // the next request computes it again
+            }
+            else {
+                it->second.computed = true;
+                it->second.computed_time = std::chrono::steady_clock::now();
+            }
+        }
+    }
+    return result.get();
+}
+
+// drop the results older than the TTL (the keys come from the requests : the time ranges of the histories do not pile up)
+void View_Cache::prune(const std::chrono::steady_clock::time_point& now)
+{
+    for (auto it = Entries.begin(); it != Entries.end();){
+        if (it->second.computed && now - it->second.computed_time >= TTL){
+            it = Entries.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+// views computed, requests sharing a computation, requests answered from the cache
+std::string View_Cache::get_counters() const
+{
+    return fmt::format(
+        "computed {},shared {},cached {},ttl {} ms",
+        Computations.load(std::memory_order_relaxed),
+        Shared.load(std::memory_order_relaxed),
+        Cached.load(std::memory_order_relaxed),
+        TTL.count()
+    );
+}
@@ -0,0 +1,57 @@
+//==========================================================================
+// File that defines the cache of the views displayed to the clients : identical display requests arriving together share one computation
+// (single flight), and its result is kept for a short time so that the next ones are answered without reading the database
+//==========================================================================
+#ifndef VIEW_CACHE_HPP
+#define VIEW_CACHE_HPP
+#include "database_management.hpp"
+
+
+#include <future>
+
+
+#define VIEW_CACHE_TTL 200 // milliseconds a view computed is answered again (0 : only the requests waiting for the computation share it)
+#define VIEW_CACHE_ENTRIES 1024 // views kept, the results older than the TTL are dropped when a new view would go beyond
+#define VIEW_CACHE_MAX_TICKS 2048 // price histories of at most this many ticks are cached, the longer ones are streamed to each request as they are read
+
+
+// a view computed once, shared by all the sessions that display it (never modified : the sessions send it while others read it)
+using View_Result = std::shared_ptr<const std::string>;
+
+// computes a view when no request is computing it and no result is fresh enough
+using View_Builder = std::function<std::string()>;
+
+class View_Cache
+{
+private:
+    // last computation of a view, running or done
+    struct Entry
+    {
+        uint64_t version; // version of the view computed (a newer version is computed again, whatever the age)
+        std::shared_future<View_Result> result;
+        uint64_t computation; // the request computing it completes only its own entry
+        std::chrono::steady_clock::time_point computed_time; // time point of the end of the computation (none while it runs)
+        bool computed;
+    };
+
+    std::chrono::milliseconds TTL;
+    std::mutex Mutex;
+    std::unordered_map<std::string, Entry> Entries; // by key of the view (its name and arguments)
+    std::atomic<uint64_t> Computations; // views computed
+    std::atomic<uint64_t> Shared; // requests that waited for the computation of another one
+    std::atomic<uint64_t> Cached; // requests answered with a result computed before
+
+    void prune(const std::chrono::steady_clock::time_point& now); // drop the results older than the TTL (the mutex is held)
+
+public:
+    // constructor
+    View_Cache(const std::chrono::milliseconds& ttl);
+    View_Cache(const View_Cache&) = delete;
+    View_Cache& operator=(const View_Cache&) = delete;
+
+    View_Result get(const std::string& key, const uint64_t& version, const View_Builder& build); // the view, computed by this request or shared with another one (an exception of build is thrown to all the requests waiting for it)
+    std::string get_counters() const; // views computed, requests sharing a computation, requests answered from the cache
+};
+
+
+#endif // VIEW_CACHE_HPP
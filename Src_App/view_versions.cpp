@@ -0,0 +1,96 @@
+#include "view_versions.hpp"
+
+
+// version of the last change of the view of an id
+void View_Version_Map::set(const ID& id, const uint64_t& version)
+{
+    Shard& shard = Shards[static_cast<uint64_t>(id) % VIEW_VERSION_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+    uint64_t& current = shard.Versions[id];
+    current = std::max(current, version);
+}
+
+// default_version if the view of the id has not changed since the start
+uint64_t View_Version_Map::get(const ID& id, const uint64_t& default_version) const
+{
+    const Shard& shard = Shards[static_cast<uint64_t>(id) % VIEW_VERSION_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+    auto it = shard.Versions.find(id);
+    return it == shard.Versions.end() ? default_version : it->second;
+}
+
+
+// constructor
+View_Versions::View_Versions() : Clock(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count())), Start_Version(Clock.load()), Book_Version(Start_Version), Prices_Version(Start_Version)
+{
+
+}
+
+// a version after all the ones given
+uint64_t View_Versions::next_version()
+{
+    return Clock.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+// raise a version to a later one (two changes may end in any order, a version never goes back)
+static void raise_version(std::atomic<uint64_t>& version, const uint64_t& value)
+{
+    uint64_t current = version.load(std::memory_order_relaxed);
+    while (current < value && !version.compare_exchange_weak(current, value, std::memory_order_release, std::memory_order_relaxed)){
+    }
+}
+
+// pending orders added, changed or removed
+void View_Versions::book_changed()
+{
+    raise_version(Book_Version, next_version());
+}
+
+// an action listed or removed : the prices, the market and its history
+void View_Versions::action_changed(const ID& action_id)
+{
+    uint64_t version = next_version();
+    Actions.set(action_id, version);
+    raise_version(Prices_Version, version);
+    raise_version(Book_Version, version); // the actions are shown in the market too
+}
+
+// the book, the prices and the history of the action
+void View_Versions::trade(const ID& action_id)
+{
+    uint64_t version = next_version();
+    Actions.set(action_id, version);
+    raise_version(Prices_Version, version);
+    raise_version(Book_Version, version);
+}
+
+// balance or shares of a client
+void View_Versions::client_changed(const ID& client_id)
+{
+    Clients.set(client_id, next_version());
+}
+
+
+// market value, pending orders and actions
+uint64_t View_Versions::get_market_version() const
+{
+    return std::max(Book_Version.load(std::memory_order_acquire), Prices_Version.load(std::memory_order_acquire));
+}
+
+// last prices of the actions
+uint64_t View_Versions::get_prices_version() const
+{
+    return Prices_Version.load(std::memory_order_acquire);
+}
+
+// balance and shares of the client (a portfolio has the latest of it and of the prices : any trade changes the prices shown, whatever the actions of the client)
+uint64_t View_Versions::get_client_version(const ID& client_id) const
+{
+    return Clients.get(client_id, Start_Version);
+}
+
+// price history of the action
+uint64_t View_Versions::get_action_version(const ID& action_id) const
+{
+    return Actions.get(action_id, Start_Version);
+}
@@ -0,0 +1,68 @@
+//==========================================================================
+// File that defines the versions of the views displayed to the clients : the market, the portfolio of each client and the history of each action,
+// so that a client polling a view it already has gets a short NOT_MODIFIED instead of the whole view
+//==========================================================================
+#ifndef VIEW_VERSIONS_HPP
+#define VIEW_VERSIONS_HPP
+#include "database_management.hpp"
+
+
+#include <array>
+
+
+#define VIEW_VERSION_SHARDS 16 // the versions of the clients and of the actions are split in this many maps, each one with its own mutex
+
+
+// versions of one kind of view (clients or actions), by id
+class View_Version_Map
+{
+private:
+    // versions of a part of the ids
+    struct Shard
+    {
+        mutable std::mutex Mutex;
+        std::unordered_map<ID, uint64_t> Versions;
+    };
+
+    std::array<Shard, VIEW_VERSION_SHARDS> Shards;
+
+public:
+    void set(const ID& id, const uint64_t& version); // version of the last change of the view of an id
+    uint64_t get(const ID& id, const uint64_t& default_version) const; // default_version if the view of the id has not changed since the start
+};
+
+// a version is the value of one clock at the last change of a view : a view depending on several states has the version of the latest one,
+// the clock starts at the time of the start (in microseconds) so that a version given by a former run of the server is never matched again
+class View_Versions
+{
+private:
+    std::atomic<uint64_t> Clock; // last version given
+    uint64_t Start_Version; // version of the views not changed since the start
+    std::atomic<uint64_t> Book_Version; // pending orders added, changed or removed
+    std::atomic<uint64_t> Prices_Version; // trades, actions listed or removed (the prices shown in every portfolio)
+    View_Version_Map Clients; // balance and shares of each client
+    View_Version_Map Actions; // price history of each action
+
+    uint64_t next_version(); // a version after all the ones given
+
+public:
+    // constructor
+    View_Versions();
+    View_Versions(const View_Versions&) = delete;
+    View_Versions& operator=(const View_Versions&) = delete;
+
+    // changes (called once the change is done : a view read before gets an older version)
+    void book_changed();
+    void action_changed(const ID& action_id); // an action listed or removed : the prices, the market and its history
+    void trade(const ID& action_id); // the book, the prices and the history of the action
+    void client_changed(const ID& client_id);
+
+    // versions of the views
+    uint64_t get_market_version() const; // market value, pending orders and actions
+    uint64_t get_prices_version() const; // last prices of the actions
+    uint64_t get_client_version(const ID& client_id) const; // balance and shares of the client (a portfolio has the latest of it and of the prices)
+    uint64_t get_action_version(const ID& action_id) const; // price history of the action
+};
+
+
+#endif // VIEW_VERSIONS_HPP